@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ActorIndexSubsystem.h"
+#include <EngineUtils.h>
+#include <Engine/Level.h>
+#include <Misc/CoreDelegates.h>
+
+void UActorIndexSubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+    Super::Initialize(Collection);
+    UWorld* world = GetWorld();
+    actorSpawnedHandle = world->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UActorIndexSubsystem::OnActorSpawned));
+    actorDestroyedHandle = world->AddOnActorDestroyedHandler(FOnActorDestroyed::FDelegate::CreateUObject(this, &UActorIndexSubsystem::OnActorDestroyed));
+    // 流式加载的子关卡中的Actor不会触发生成和销毁事件, 需要按关卡加入和移除
+    levelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UActorIndexSubsystem::OnLevelAddedToWorld);
+    levelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UActorIndexSubsystem::OnLevelRemovedFromWorld);
+#if WITH_EDITOR
+    actorLabelChangedHandle = FCoreDelegates::OnActorLabelChanged.AddUObject(this, &UActorIndexSubsystem::OnActorLabelChanged);
+#endif
+}
+
+void UActorIndexSubsystem::Deinitialize() {
+    if (UWorld* world = GetWorld()) {
+        world->RemoveOnActorSpawnedHandler(actorSpawnedHandle);
+        world->RemoveOnActorDestroyedHandler(actorDestroyedHandle);
+    }
+    FWorldDelegates::LevelAddedToWorld.Remove(levelAddedHandle);
+    FWorldDelegates::LevelRemovedFromWorld.Remove(levelRemovedHandle);
+#if WITH_EDITOR
+    FCoreDelegates::OnActorLabelChanged.Remove(actorLabelChangedHandle);
+#endif
+    actorsByLabel.Reset();
+    actorsByTag.Reset();
+    indexedActors.Reset();
+    bIndexBuilt = false;
+    Super::Deinitialize();
+}
+
+// 按名称查找Actor
+// FString作为TMap的键不区分大小写, 因此命中后再用Equals比较一次, 与原先逐个比较GetActorLabel()的结果一致
+AActor* UActorIndexSubsystem::FindActorByLabel(const FString& label, const UClass* actorClass) {
+    BuildIndex();
+    const TArray<TWeakObjectPtr<AActor>>* actors = actorsByLabel.Find(label);
+    if (!actors) return nullptr;
+    for (const TWeakObjectPtr<AActor>& weakActor : *actors) {
+        AActor* actor = weakActor.Get();
+        if (actor && actor->IsA(actorClass) && actor->GetActorLabel().Equals(label)) return actor;
+    }
+    return nullptr;
+}
+
+// 查找带有tag的全部Actor
+void UActorIndexSubsystem::FindActorsByTag(FName tag, TArray<AActor*>& outActors, const UClass* actorClass) {
+    BuildIndex();
+    const TArray<TWeakObjectPtr<AActor>>* actors = actorsByTag.Find(tag);
+    if (!actors) return;
+    for (const TWeakObjectPtr<AActor>& weakActor : *actors) {
+        AActor* actor = weakActor.Get();
+        if (actor && actor->IsA(actorClass)) outActors.Add(actor);
+    }
+}
+
+// 重新索引一个Actor
+void UActorIndexSubsystem::ReindexActor(AActor* actor) {
+    if (!bIndexBuilt || !actor) return;
+    RemoveActor(actor);
+    AddActor(actor);
+}
+
+// 遍历一次关卡建立索引
+void UActorIndexSubsystem::BuildIndex() {
+    if (bIndexBuilt) return;
+    bIndexBuilt = true;
+    for (TActorIterator<AActor> it(GetWorld()); it; ++it) {
+        AddActor(*it);
+    }
+}
+
+void UActorIndexSubsystem::AddActor(AActor* actor) {
+    FIndexedKeys& keys = indexedActors.Add(actor);
+    keys.label = actor->GetActorLabel();
+    keys.tags = actor->Tags;
+    actorsByLabel.FindOrAdd(keys.label).Add(actor);
+    for (const FName& tag : keys.tags) {
+        actorsByTag.FindOrAdd(tag).AddUnique(actor);
+    }
+}
+
+void UActorIndexSubsystem::RemoveActor(const AActor* actor) {
+    FIndexedKeys keys;
+    if (!indexedActors.RemoveAndCopyValue(actor, keys)) return;
+
+    // 顺便清理已经失效的弱引用
+    auto removeFrom = [actor](TArray<TWeakObjectPtr<AActor>>& actors) {
+        actors.RemoveAll([actor](const TWeakObjectPtr<AActor>& weakActor) {
+            return !weakActor.IsValid() || weakActor.Get() == actor;
+        });
+    };
+    if (TArray<TWeakObjectPtr<AActor>>* actors = actorsByLabel.Find(keys.label)) {
+        removeFrom(*actors);
+        if (actors->Num() == 0) actorsByLabel.Remove(keys.label);
+    }
+    for (const FName& tag : keys.tags) {
+        if (TArray<TWeakObjectPtr<AActor>>* actors = actorsByTag.Find(tag)) {
+            removeFrom(*actors);
+            if (actors->Num() == 0) actorsByTag.Remove(tag);
+        }
+    }
+}
+
+void UActorIndexSubsystem::OnActorSpawned(AActor* actor) {
+    ReindexActor(actor);
+}
+
+void UActorIndexSubsystem::OnActorDestroyed(AActor* actor) {
+    if (bIndexBuilt) RemoveActor(actor);
+}
+
+void UActorIndexSubsystem::OnActorLabelChanged(AActor* actor) {
+    // 其他World中的Actor改名也会通知到这里
+    if (actor && actor->GetWorld() == GetWorld()) ReindexActor(actor);
+}
+
+void UActorIndexSubsystem::OnLevelAddedToWorld(ULevel* level, UWorld* world) {
+    if (!bIndexBuilt || !level || world != GetWorld()) return;
+    for (AActor* actor : level->Actors) {
+        ReindexActor(actor);
+    }
+}
+
+void UActorIndexSubsystem::OnLevelRemovedFromWorld(ULevel* level, UWorld* world) {
+    if (!bIndexBuilt || world != GetWorld()) return;
+    // level为空表示整个World被清理, 下次查询时重新建立索引
+    if (!level) {
+        actorsByLabel.Reset();
+        actorsByTag.Reset();
+        indexedActors.Reset();
+        bIndexBuilt = false;
+        return;
+    }
+    for (AActor* actor : level->Actors) {
+        if (actor) RemoveActor(actor);
+    }
+}
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "ExportOBJSceneActor.h"
+#include "ActorIndexSubsystem.h"
+#include <Async/Async.h>
+#include <EngineUtils.h>
+#include <Engine/StaticMeshActor.h>
+#include <Misc/QueuedThreadPool.h>
+
+DEFINE_LOG_CATEGORY_STATIC(LogExportOBJSceneActor, All, All);
+
+AExportOBJSceneActor::AExportOBJSceneActor() {
+    PrimaryActorTick.bCanEverTick = false;
+    // 多个网格体并发导出时, 每个任务再用全部硬件线程格式化文本只会互相争抢
+    exportOptions.exportThreads = 1;
+}
+
+void AExportOBJSceneActor::BeginPlay() {
+    Super::BeginPlay();
+    ExportSceneToOBJ();
+}
+
+void AExportOBJSceneActor::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+    CancelExport();
+    Super::EndPlay(EndPlayReason);
+}
+
+// 收集静态网格体Actor并批量导出
+void AExportOBJSceneActor::ExportSceneToOBJ() {
+    if (IsExporting()) {
+        UE_LOG(LogExportOBJSceneActor, Warning, TEXT("批量导出正在进行, 忽略本次请求"));
+        return;
+    }
+    UE_LOG(LogExportOBJSceneActor, Warning, TEXT("---! 开始批量导出 !---"));
+    lastExportStats.Reset();
+    exportedTextures.Reset();
+    numSucceeded = numFailed = 0;
+
+    CollectMeshes();
+    if (pendingMeshes.Num() == 0) {
+        UE_LOG(LogExportOBJSceneActor, Error, TEXT("---! 未找到需要导出的静态网格体 !---"));
+        onExportCompleted.Broadcast(0, 0);
+        return;
+    }
+    LaunchPendingJobs();
+}
+
+// 取消批量导出
+void AExportOBJSceneActor::CancelExport() {
+    if (!IsExporting()) return;
+    numFailed += pendingMeshes.Num() - nextPendingMesh;
+    nextPendingMesh = pendingMeshes.Num();
+    for (const TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe>& job : runningJobs) {
+        job->Cancel();
+    }
+}
+
+// 批量导出的总进度: 已结束的任务记为1, 进行中的任务按各自的进度
+float AExportOBJSceneActor::GetExportProgress() const {
+    if (pendingMeshes.Num() == 0) return 0.0f;
+    float progress = static_cast<float>(numSucceeded + numFailed);
+    for (const TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe>& job : runningJobs) {
+        progress += job->GetProgress();
+    }
+    return FMath::Min(progress / pendingMeshes.Num(), 1.0f);
+}
+
+// 收集本次导出的静态网格体Actor
+// 按名称和Tag导出时通过UActorIndexSubsystem的哈希索引查找, 只有导出整个关卡时才遍历关卡
+void AExportOBJSceneActor::CollectActors(TArray<AStaticMeshActor*>& outActors) const {
+    if (bExportWholeLevel) {
+        for (TActorIterator<AStaticMeshActor> it(GetWorld()); it; ++it) {
+            outActors.Add(*it);
+        }
+        return;
+    }
+    UActorIndexSubsystem* actorIndex = GetWorld()->GetSubsystem<UActorIndexSubsystem>();
+    if (!actorIndex) return;
+    // 同时匹配名称和Tag的Actor只收集一次
+    TSet<AActor*> collected;
+    for (const FString& label : meshNames) {
+        if (AStaticMeshActor* actor = actorIndex->FindActorByLabel<AStaticMeshActor>(label)) {
+            bool bAlreadyCollected = false;
+            collected.Add(actor, &bAlreadyCollected);
+            if (!bAlreadyCollected) outActors.Add(actor);
+        } else {
+            UE_LOG(LogExportOBJSceneActor, Warning, TEXT("未找到目标网格体: %s"), *label);
+        }
+    }
+    TArray<AActor*> taggedActors;
+    for (const FName& tag : actorTags) {
+        actorIndex->FindActorsByTag(tag, taggedActors, AStaticMeshActor::StaticClass());
+    }
+    for (AActor* actor : taggedActors) {
+        bool bAlreadyCollected = false;
+        collected.Add(actor, &bAlreadyCollected);
+        if (!bAlreadyCollected) outActors.Add(static_cast<AStaticMeshActor*>(actor));
+    }
+}
+
+// 收集静态网格体Actor, 按静态网格体资源去重
+// 多个Actor引用同一个静态网格体资源时只导出一次
+void AExportOBJSceneActor::CollectMeshes() {
+    pendingMeshes.Reset();
+    nextPendingMesh = 0;
+    TArray<AStaticMeshActor*> actors;
+    CollectActors(actors);
+    TMap<UStaticMesh*, int32> meshIndices;
+    TSet<FString> usedNames;
+    int32 numActors = 0;
+
+    for (AStaticMeshActor* actor : actors) {
+        UStaticMeshComponent* component = actor->GetStaticMeshComponent();
+        UStaticMesh* meshData = component ? component->GetStaticMesh() : nullptr;
+        if (!meshData) {
+            UE_LOG(LogExportOBJSceneActor, Warning, TEXT("网格体 %s 没有静态网格体, 跳过"), *actor->GetActorLabel());
+            continue;
+        }
+        numActors++;
+
+        if (const int32* index = meshIndices.Find(meshData)) {
+            UE_LOG(LogExportOBJSceneActor, Display, TEXT("-BATCH-[%s]: 与其他Actor共用静态网格体, 导出为 %s"), *actor->GetActorLabel(),
+                *pendingMeshes[*index].name);
+            continue;
+        }
+        // 以资源名称命名输出文件, 不同目录下的同名资源追加序号
+        FString name = meshData->GetName();
+        for (int32 suffix = 1; usedNames.Contains(name); suffix++) {
+            name = FString::Printf(TEXT("%s_%d"), *meshData->GetName(), suffix);
+        }
+        usedNames.Add(name);
+        meshIndices.Add(meshData, pendingMeshes.Num());
+        pendingMeshes.Add({meshData, name});
+        UE_LOG(LogExportOBJSceneActor, Display, TEXT("-BATCH-[%s]: 导出为 %s"), *actor->GetActorLabel(), *name);
+    }
+    UE_LOG(LogExportOBJSceneActor, Warning, TEXT("-BATCH-[收集]: Actor %d 个, 去重后静态网格体 %d 个"), numActors, pendingMeshes.Num());
+}
+
+// 启动任务直到达到并发上限(游戏线程)
+// 快照在任务启动时才截取, 游戏线程的开销分散到各个任务结束的帧上, 也不会同时持有全部网格体的副本
+void AExportOBJSceneActor::LaunchPendingJobs() {
+    int32 maxJobs = maxConcurrentJobs > 0 ? maxConcurrentJobs : (GThreadPool ? GThreadPool->GetNumThreads() : 1);
+    maxJobs = FMath::Max(maxJobs, 1);
+    TWeakObjectPtr<AExportOBJSceneActor> weakThis(this);
+
+    while (runningJobs.Num() < maxJobs && nextPendingMesh < pendingMeshes.Num()) {
+        const FPendingMesh& pending = pendingMeshes[nextPendingMesh++];
+        TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe> job;
+        if (UStaticMesh* meshData = pending.mesh.Get()) {
+            job = FOBJExportJob::Create(meshData, pending.name, filePathRoot, exportOptions, &exportedTextures);
+        }
+        if (!job) {
+            numFailed++;
+            continue;
+        }
+        runningJobs.Add(job);
+
+        job->SetProgressCallback([weakThis](float) {
+            AsyncTask(ENamedThreads::GameThread, [weakThis]() {
+                if (AExportOBJSceneActor* self = weakThis.Get()) self->onExportProgress.Broadcast(self->GetExportProgress());
+            });
+        });
+        Async(EAsyncExecution::ThreadPool, [job, weakThis]() {
+            const bool bSucceeded = job->Run();
+            AsyncTask(ENamedThreads::GameThread, [job, weakThis, bSucceeded]() {
+                if (AExportOBJSceneActor* self = weakThis.Get()) self->FinishJob(job, bSucceeded);
+            });
+        });
+    }
+
+    if (!IsExporting()) {
+        UE_LOG(LogExportOBJSceneActor, Warning, TEXT("---! 批量导出结束: 成功 %d 个, 失败或取消 %d 个 !---"), numSucceeded, numFailed);
+        onExportCompleted.Broadcast(numSucceeded, numFailed);
+    }
+}
+
+// 单个任务结束(游戏线程): 记录统计信息, 启动下一个任务
+void AExportOBJSceneActor::FinishJob(const TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe>& job, bool bSucceeded) {
+    if (runningJobs.Remove(job) == 0) return;
+    if (bSucceeded) {
+        numSucceeded++;
+    } else {
+        numFailed++;
+    }
+    lastExportStats.Add(job->GetName(), job->GetStats());
+    // 只有真正写出的纹理才供之后的任务共用, 失败或被取消的任务没有写出的纹理由之后的任务自己写出
+    exportedTextures.Append(job->GetWrittenTextures());
+    job->LogStats();
+    onExportProgress.Broadcast(GetExportProgress());
+    LaunchPendingJobs();
+}
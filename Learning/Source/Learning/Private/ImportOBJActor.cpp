@@ -14,6 +14,13 @@ AImportOBJActor::AImportOBJActor() {
     // 初始化静态网格体组件
     _mesh = CreateDefaultSubobject<UStaticMeshComponent>(FName(meshName));
     SetRootComponent(_mesh);
+    // 网格体在 BeginPlay 中才设置, 运行时修改静态网格体需要组件可移动
+    _mesh->SetMobility(EComponentMobility::Movable);
+}
+
+void AImportOBJActor::BeginPlay() {
+    Super::BeginPlay();
+    // 在 BeginPlay 中导入: 构造函数执行时编辑器中设置的属性尚未应用, 且构造CDO时不应读写文件
     // 设置网格体
     _mesh->SetStaticMesh(CreateMeshDataFromFile(filePathRoot, objFileName));
     _mesh->SetRelativeLocation(FVector(0.0f, 0.0f, 0.0f));
@@ -26,10 +33,6 @@ AImportOBJActor::AImportOBJActor() {
     UE_LOG(LogImportOBJActor, Display, TEXT("--!-- 材质构建成功 --!--"));
 }
 
-void AImportOBJActor::BeginPlay() {
-    Super::BeginPlay();
-}
-
 void AImportOBJActor::Tick(float DeltaTime) {
     Super::Tick(DeltaTime);
 }
@@ -46,19 +49,71 @@ UStaticMesh* AImportOBJActor::CreateMeshDataFromFile(const FString& baseDir, con
     tinyobj::attrib_t attrib;                   // OBJ文件中的顶点属性数组
     std::vector<tinyobj::shape_t> shapes;       // OBJ文件中的图元组(UE中的多边形组), 每个图元组对应一种材质
     std::vector<tinyobj::material_t> materials; // OBJ文件中的材质
-    std::string err;
     std::string warn;
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &warn, TCHAR_TO_UTF8(*(baseDir + file)), TCHAR_TO_UTF8(*baseDir), true);
+    std::string err;
+    // 解析缓存: 文件未修改时直接读取 <objFileName>.tobjcache, 否则内存映射 + 多线程解析(使用全部硬件线程)并重写缓存
+    // 解析期间的临时容器(面的索引数组等)从 arena 中分配, 函数返回时一次性释放
+    tinyobj::ParseArena parseArena;
+    tinyobj::ObjCacheConfig cacheConfig;
+    cacheConfig.rebuild = bRebuildParseCache;
+    cacheConfig.write_cache = bUseParseCache;
+    cacheConfig.arena = &parseArena;
+    // 紧凑格式只保存文件中已有的顶点颜色, 不生成白色的默认颜色(缺少颜色时读取结果同样为白色)
+    const bool defaultColors = !bCompactAttributes;
+    bool cacheHit = false;
+    bool ret = false;
+    if (ShapeNames.Num() > 0) {
+        // 只导入指定的图元组: 读取(或生成) <objFileName>.tobjindex 索引, 只解析选中图元组的字节范围及其引用的顶点
+        const std::string objPath = TCHAR_TO_UTF8(*(baseDir + file));
+        const std::string indexPath = objPath + ".tobjindex";
+        tinyobj::obj_shape_index_t shapeIndex;
+        ret = tinyobj::LoadObjShapeIndex(&shapeIndex, &err, indexPath.c_str(), objPath.c_str());
+        if (!ret) {
+            ret = tinyobj::BuildObjShapeIndex(&shapeIndex, &err, objPath.c_str());
+            if (ret && !tinyobj::SaveObjShapeIndex(shapeIndex, &err, indexPath.c_str())) {
+                UE_LOG(LogImportOBJActor, Warning, TEXT("图元组索引写入失败: %s"), UTF8_TO_TCHAR(err.c_str()));
+            }
+        }
+        if (ret) {
+            std::vector<size_t> shapeIds;
+            for (const FString& shapeName : ShapeNames) {
+                shapeIndex.FindShapes(TCHAR_TO_UTF8(*shapeName), &shapeIds);
+            }
+            UE_LOG(LogImportOBJActor, Display, TEXT("图元组索引: 共 %d 个图元组, 选中 %d 个"), static_cast<int32>(shapeIndex.shapes.size()),
+                static_cast<int32>(shapeIds.size()));
+            ret = tinyobj::LoadObjShapes(&attrib, &shapes, &materials, &warn, &err, objPath.c_str(), shapeIndex, shapeIds, TCHAR_TO_UTF8(*baseDir), true, defaultColors);
+            // 面全部退化的图元组在索引中存在, 但不会生成 shape, 因此导入的图元组可能少于选中的数量
+            if (ret && shapes.size() < shapeIds.size()) {
+                UE_LOG(LogImportOBJActor, Display, TEXT("图元组索引: %d 个选中的图元组没有有效的面"), static_cast<int32>(shapeIds.size() - shapes.size()));
+            }
+        }
+    } else if (bUseParseCache || bRebuildParseCache) {
+        ret = tinyobj::LoadObjCached(&attrib, &shapes, &materials, &warn, &err, TCHAR_TO_UTF8(*(baseDir + file)), TCHAR_TO_UTF8(*baseDir), true, defaultColors, cacheConfig, &cacheHit);
+    } else {
+        ret = tinyobj::LoadObjParallel(&attrib, &shapes, &materials, &warn, &err, TCHAR_TO_UTF8(*(baseDir + file)), TCHAR_TO_UTF8(*baseDir), true, defaultColors, 0, &parseArena);
+    }
     if (!ret) {
-        UE_LOG(LogImportOBJActor, Error, TEXT("tinyobj::LoadObj 失败, 提示信息为: %s"), UTF8_TO_TCHAR(err.c_str()));
+        UE_LOG(LogImportOBJActor, Error, TEXT("tinyobj 读取失败, 提示信息为: %s"), UTF8_TO_TCHAR(err.c_str()));
         return staticMesh;
     } else {
-        UE_LOG(LogImportOBJActor, Display, TEXT("tinyobj::LoadObj 成功, 路径为: %s"), *(baseDir + file));
+        UE_LOG(LogImportOBJActor, Display, TEXT("tinyobj 读取成功, 路径为: %s, 命中解析缓存: %d"), *(baseDir + file), cacheHit);
     }
     for (int i = 0; i < materials.size(); i++) {
         UE_LOG(LogImportOBJActor, Display, TEXT("第%d个材质为: [%s]"), i, UTF8_TO_TCHAR(materials[i].name.c_str()));
     }
 
+    // 按平滑组为没有法线的角点生成顶点法线, 追加到 attrib.normals(需在转换为紧凑格式之前)
+    if (bGenerateNormals && !tinyobj::GenerateSmoothingGroupNormals(&attrib, &shapes)) {
+        UE_LOG(LogImportOBJActor, Warning, TEXT("部分面的顶点索引无效, 未为其生成法线"));
+    }
+
+    // 按需将顶点属性转换为紧凑格式(转换后 attrib 被清空), 之后统一通过 attrib_accessor_t 读取两种格式
+    tinyobj::compact_attrib_t compactAttrib;
+    if (bCompactAttributes) {
+        tinyobj::CompactAttrib(&attrib, &compactAttrib);
+    }
+    const tinyobj::attrib_accessor_t attribs = bCompactAttributes ? tinyobj::attrib_accessor_t(compactAttrib) : tinyobj::attrib_accessor_t(attrib);
+
     // 使用 MeshDescriptionBuilder 设置网格模型的基本属性
     FMeshDescriptionBuilder meshDescBuilder;
     meshDescBuilder.SetMeshDescription(&description);   // 设置 MeshDescription
@@ -67,16 +122,16 @@ UStaticMesh* AImportOBJActor::CreateMeshDataFromFile(const FString& baseDir, con
 
     // 向 MeshDescriptionBuilder 中输入顶点位置
     TArray<FVertexID> vertexIDs;
-    vertexIDs.SetNum(attrib.vertices.size() / 3);
-    UE_LOG(LogImportOBJActor, Display, TEXT("第一个顶点的信息: %f, %f, %f, %f, %f, %f"), 
-        attrib.vertices[0], attrib.vertices[1], attrib.vertices[2], 
-        attrib.vertices[3], attrib.vertices[4], attrib.vertices[5]);
+    vertexIDs.SetNum(attribs.num_vertices());
     for (int v = 0; v < vertexIDs.Num(); v++) {
-        vertexIDs[v] = meshDescBuilder.AppendVertex(
-            FVector(attrib.vertices[3 * v + 0], attrib.vertices[3 * v + 1], attrib.vertices[3 * v + 2])
-        );
+        tinyobj::real_t p[3];
+        attribs.GetVertex(v, p);
+        if (v == 0) {
+            UE_LOG(LogImportOBJActor, Display, TEXT("第一个顶点的信息: %f, %f, %f"), p[0], p[1], p[2]);
+        }
+        vertexIDs[v] = meshDescBuilder.AppendVertex(FVector(p[0], p[1], p[2]));
     }
-    UE_LOG(LogImportOBJActor, Display, TEXT("导入顶点位置成功, 共导入 %d 个顶点"), attrib.vertices.size() / 3);
+    UE_LOG(LogImportOBJActor, Display, TEXT("导入顶点位置成功, 共导入 %d 个顶点"), attribs.num_vertices());
 
     // 遍历所有的图元对象, 创建多边形组
     for (size_t i = 0; i < shapes.size(); ++i) {
@@ -102,12 +157,15 @@ UStaticMesh* AImportOBJActor::CreateMeshDataFromFile(const FString& baseDir, con
         // 设置材质映射, 并且根据需要创建动态材质实例
         _materialIdMap[globalData.polygonGroup] = material.name;
         if (_materialMap.find(material.name) == _materialMap.end()) {
-            // 找到已经创建好的UE材质资产(只能在构造函数中使用FObjectFinder): /Game/BasicTexture
-            static ConstructorHelpers::FObjectFinder<UMaterial> mtlAsset(*materialPath);
+            // 找到已经创建好的UE材质资产: /Game/BasicTexture
+            // 导入在 BeginPlay 中进行, 不能使用只在构造函数中有效的FObjectFinder, 先去掉路径中的类名前缀再加载
+            FString mtlAssetPath = materialPath;
+            ConstructorHelpers::StripObjectClass(mtlAssetPath, true);
+            UMaterial* mtlAsset = LoadObject<UMaterial>(nullptr, *mtlAssetPath);
             // 创建动态材质实例
-            if (mtlAsset.Succeeded()) {
+            if (mtlAsset) {
                 UE_LOG(LogImportOBJActor, Display, TEXT("[第%d个多边形组] 纹理为: %s"), i, UTF8_TO_TCHAR(material.diffuse_texname.c_str()));
-                UMaterialInstanceDynamic* mtl = UMaterialInstanceDynamic::Create(mtlAsset.Object, NULL);
+                UMaterialInstanceDynamic* mtl = UMaterialInstanceDynamic::Create(mtlAsset, NULL);
                 UTexture2D* diffuseTexture2D = CreateTexture(baseDir, UTF8_TO_TCHAR(material.diffuse_texname.c_str()));
                 if (diffuseTexture2D) {
                     mtl->SetTextureParameterValue("BaseTexture", diffuseTexture2D);
@@ -116,38 +174,28 @@ UStaticMesh* AImportOBJActor::CreateMeshDataFromFile(const FString& baseDir, con
             }
         }
 
-        // 遍历 shape.mesh 中的所有三角面, 并将三角面信息添加到 MeshDescriptionBuilder 中
-        size_t offset = 0;
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-            size_t fnum = shape.mesh.num_face_vertices[f];
-            if (fnum != 3) continue;
-
-            // 读取该三角面中三个顶点的属性
-            TriangleVertex triVertex[3];
-            for (size_t v = 0; v < 3; ++v) {
-                // 顶点编号
-                tinyobj::index_t idx = shape.mesh.indices[offset + v];
-                triVertex[v].vertexIndex = idx.vertex_index;
-                // 顶点法线
-                if (idx.normal_index >= 0) {
-                    triVertex[v].normal = FVector(
-                        attrib.normals[3 * idx.normal_index + 0],
-                        attrib.normals[3 * idx.normal_index + 1], 
-                        attrib.normals[3 * idx.normal_index + 2]);
-                }
-                // 顶点UV坐标(-!--注意要翻转Y轴--!-)
-                if (idx.texcoord_index >= 0) {
-                    triVertex[v].UV = FVector2D(
-                        attrib.texcoords[2 * idx.texcoord_index + 0], 
-                        1.0 - attrib.texcoords[2 * idx.texcoord_index + 1]);
-                } else {
-                    triVertex[v].UV = FVector2D(0.0, 0.0);
-                }
+        // 将 shape 中的面焊接为去重后的顶点: (v, vn, vt) 相同的角点共用同一个 VertexInstance
+        tinyobj::indexed_mesh_t indexedMesh;
+        if (!tinyobj::BuildIndexedMesh(attribs, shape, &indexedMesh)) {
+            UE_LOG(LogImportOBJActor, Warning, TEXT("[第%d个多边形组] 顶点索引无效, 跳过该多边形组"), i);
+            continue;
+        }
+        // 生成切线(按三角面并行计算), 随顶点实例一起写入 MeshDescription
+        if (bGenerateTangents && !tinyobj::GenerateTangents(&indexedMesh, shape)) {
+            UE_LOG(LogImportOBJActor, Display, TEXT("[第%d个多边形组] 缺少法线或UV, 不生成切线"), i);
+        }
+        // 重排三角面(提高顶点缓存命中率)与顶点实例(提高顶点读取局部性), 输出优化前后的 ACMR/ATVR
+        if (bOptimizeVertexCache) {
+            const tinyobj::vertex_cache_stats_t before = tinyobj::AnalyzeVertexCache(indexedMesh);
+            if (tinyobj::OptimizeVertexCache(&indexedMesh, &shape)) {
+                const tinyobj::vertex_cache_stats_t after = tinyobj::AnalyzeVertexCache(indexedMesh);
+                UE_LOG(LogImportOBJActor, Display, TEXT("[第%d个多边形组] 顶点缓存优化: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f"), i, before.acmr, after.acmr,
+                    before.atvr, after.atvr);
             }
-            // 将三个顶点的属性添加到 MeshDescriptionBuilder 中
-            AddTriangleData(globalData, triVertex[0], triVertex[1], triVertex[2]);
-            offset += fnum;
         }
+        // 将顶点实例与三角面信息添加到 MeshDescriptionBuilder 中
+        AddIndexedMeshData(globalData, shape, indexedMesh);
+        UE_LOG(LogImportOBJActor, Display, TEXT("[第%d个多边形组] 角点数: %d, 去重后顶点实例数: %d"), i, indexedMesh.indices.size(), indexedMesh.num_vertices());
 
         // 提示信息
         UE_LOG(LogImportOBJActor, Display, TEXT("多边形组 %s 添加成功, 对应材质为: %s"), UTF8_TO_TCHAR(shape.name.c_str()), UTF8_TO_TCHAR(material.name.c_str()));
@@ -156,7 +204,7 @@ UStaticMesh* AImportOBJActor::CreateMeshDataFromFile(const FString& baseDir, con
     // 创建 MeshDescription
     UStaticMesh::FBuildMeshDescriptionsParams builderParams;
     builderParams.bBuildSimpleCollision = true;
-    builderParams.bFastBuild = true;
+    builderParams.bFastBuild = true;  // 快速构建: 直接使用顶点实例上的法线与切线
 
     // 根据 MeshDescription 构建网格体
     TArray<const FMeshDescription*> meshDescList;
@@ -193,26 +241,52 @@ UTexture2D* AImportOBJActor::CreateTexture(const FString& baseDir, const FString
     return texture2D;
 }
 
-// 向几何体中添加三角面信息
-void AImportOBJActor::AddTriangleData(
-    GlobalData& globalData, const TriangleVertex& v1, const TriangleVertex& v2, const TriangleVertex& v3) {
+// 向几何体中添加去重后的顶点实例与三角面信息
+void AImportOBJActor::AddIndexedMeshData(GlobalData& globalData, const tinyobj::shape_t& shape, const tinyobj::indexed_mesh_t& indexedMesh) {
+    // 每个去重后的顶点新建一个 VertexInstance, 设置对应的顶点属性
+    TArray<FVertexInstanceID> instanceIDs;
+    instanceIDs.SetNum(indexedMesh.num_vertices());
+    for (int v = 0; v < instanceIDs.Num(); v++) {
+        const tinyobj::real_t* vertex = &indexedMesh.vertices[v * indexedMesh.vertex_stride];
+        instanceIDs[v] = globalData.builder->AppendInstance(globalData.vertexIDs[indexedMesh.vertex_sources[v].vertex_index]);
 
-    // 新建三个 VertexInstance, 设置对应的顶点属性
-    FVertexInstanceID i1 = globalData.builder->AppendInstance(globalData.vertexIDs[v1.vertexIndex]);
-    globalData.builder->SetInstanceNormal(i1, v1.normal);
-    globalData.builder->SetInstanceUV(i1, v1.UV, 0);
-    globalData.builder->SetInstanceColor(i1, v1.Color);
+        // 顶点法线
+        FVector normal(0.0f, 0.0f, 0.0f);
+        if (indexedMesh.normal_offset >= 0) {
+            const tinyobj::real_t* n = vertex + indexedMesh.normal_offset;
+            normal = FVector(n[0], n[1], n[2]);
+        }
+        if (!indexedMesh.tangents.empty()) {
+            // 顶点切线: UV 的 Y 轴在下方被翻转, 切线方向不变, 副切线方向相反, 因此 w > 0 时翻转副切线
+            const tinyobj::real_t* t = &indexedMesh.tangents[v * 4];
+            globalData.builder->SetInstanceTangentSpace(instanceIDs[v], normal, FVector(t[0], t[1], t[2]), t[3] > 0.0f);
+        } else {
+            globalData.builder->SetInstanceNormal(instanceIDs[v], normal);
+        }
 
-    FVertexInstanceID i2 = globalData.builder->AppendInstance(globalData.vertexIDs[v2.vertexIndex]);
-    globalData.builder->SetInstanceNormal(i2, v2.normal);
-    globalData.builder->SetInstanceUV(i2, v2.UV, 0);
-    globalData.builder->SetInstanceColor(i2, v2.Color);
+        // 顶点UV坐标(-!--注意要翻转Y轴--!-)
+        FVector2D UV(0.0f, 0.0f);
+        if (indexedMesh.texcoord_offset >= 0) {
+            const tinyobj::real_t* t = vertex + indexedMesh.texcoord_offset;
+            UV = FVector2D(t[0], 1.0 - t[1]);
+        }
+        globalData.builder->SetInstanceUV(instanceIDs[v], UV, 0);
 
-    FVertexInstanceID i3 = globalData.builder->AppendInstance(globalData.vertexIDs[v3.vertexIndex]);
-    globalData.builder->SetInstanceNormal(i3, v3.normal);
-    globalData.builder->SetInstanceUV(i3, v3.UV, 0);
-    globalData.builder->SetInstanceColor(i3, v3.Color);
+        // 顶点颜色
+        globalData.builder->SetInstanceColor(instanceIDs[v], FVector4f(1.0f, 1.0f, 1.0f, 1.0f));
+    }
 
-    // 最后, 通过三个索引值构建三角面图元
-    globalData.builder->AppendTriangle(i1, i2, i3, globalData.polygonGroup);
+    // 遍历所有三角面, 通过三个索引值构建三角面图元
+    size_t offset = 0;
+    for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+        size_t fnum = shape.mesh.num_face_vertices[f];
+        if (fnum == 3) {
+            globalData.builder->AppendTriangle(
+                instanceIDs[indexedMesh.indices[offset + 0]],
+                instanceIDs[indexedMesh.indices[offset + 1]],
+                instanceIDs[indexedMesh.indices[offset + 2]],
+                globalData.polygonGroup);
+        }
+        offset += fnum;
+    }
 }
@@ -8,7 +8,9 @@
 DEFINE_LOG_CATEGORY_STATIC(LogImportOBJNoSTLActor, All, All);
 
 AImportOBJNoMTLActor::AImportOBJNoMTLActor() {
-    PrimaryActorTick.bCanEverTick = false;
+    // 只有实时预览时才需要 Tick(在 BeginPlay 中开启)
+    PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.bStartWithTickEnabled = false;
     // 初始化静态网格体组件
     _mesh = CreateDefaultSubobject<UStaticMeshComponent>(FName(meshName));
     SetRootComponent(_mesh);
@@ -20,18 +22,29 @@ void AImportOBJNoMTLActor::BeginPlay() {
     _mesh->SetStaticMesh(CreateMeshDataFromFile(filePathRoot, objFileName));
     _mesh->SetRelativeLocation(Location);
     _mesh->SetRelativeRotation_Direct(Rotation);
+    SetActorTickEnabled(bLivePreview);
 }
 
 void AImportOBJNoMTLActor::Tick(float DeltaTime) {
     Super::Tick(DeltaTime);
+
+    // 实时预览: 文件大小或修改时间变化时重新读取(只解析新追加的内容)并重建网格体
+    _previewElapsed += DeltaTime;
+    if (!bLivePreview || _previewElapsed < PreviewInterval) {
+        return;
+    }
+    _previewElapsed = 0.0f;
+    const FString path = filePathRoot + objFileName;
+    const int64 fileSize = IFileManager::Get().FileSize(*path);
+    const FDateTime timeStamp = IFileManager::Get().GetTimeStamp(*path);
+    if (fileSize != _previewFileSize || timeStamp != _previewTimeStamp) {
+        _mesh->SetStaticMesh(CreateMeshDataFromFile(filePathRoot, objFileName));
+    }
 }
 
 UStaticMesh* AImportOBJNoMTLActor::CreateMeshDataFromFile(const FString& baseDir, const FString& file) {
     // 创建 UStaticMesh
-    UStaticMesh* staticMesh = NewObject<UStaticMesh>(this, "UserMesh");
-    FMeshDescription description;
-    FStaticMeshAttributes attributes(description);
-    attributes.Register();
+    UStaticMesh* staticMesh = NewObject<UStaticMesh>(this, MakeUniqueObjectName(this, UStaticMesh::StaticClass(), "UserMesh"));
 
     // 使用 tinyobj 读取文件内容
     tinyobj::attrib_t attrib;                    // OBJ文件中的顶点属性数组
@@ -39,86 +52,167 @@ UStaticMesh* AImportOBJNoMTLActor::CreateMeshDataFromFile(const FString& baseDir
     std::vector<tinyobj::material_t> materials;  // OBJ文件中的材质
     std::string warn;
     std::string err;
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, TCHAR_TO_UTF8(*(baseDir + file)), TCHAR_TO_UTF8(*baseDir), true, true);
+    // 解析期间的临时容器(面的索引数组等)从 arena 中分配, 函数返回时一次性释放
+    tinyobj::ParseArena parseArena;
+    bool ret = false;
+    if (bLivePreview) {
+        // 实时预览: 增量读取器保存了上次的解析进度, 只解析之后追加的内容, 文件前部被修改时自动完整重新解析
+        _previewFileSize = IFileManager::Get().FileSize(*(baseDir + file));
+        _previewTimeStamp = IFileManager::Get().GetTimeStamp(*(baseDir + file));
+        if (!_objReader.IsValid()) {
+            _objReader = MakeShared<tinyobj::ObjIncrementalReader>();
+        }
+        tinyobj::ObjIncrementalReaderConfig readerConfig;
+        readerConfig.mtl_search_path = TCHAR_TO_UTF8(*baseDir);
+        ret = _objReader->Load(TCHAR_TO_UTF8(*(baseDir + file)), readerConfig);
+        err = _objReader->Error();
+        UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("增量读取: 仅解析追加内容: %d, 本次解析 %d 字节"), _objReader->Appended(), _objReader->NumParsedBytes());
+    } else {
+        ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, TCHAR_TO_UTF8(*(baseDir + file)), TCHAR_TO_UTF8(*baseDir), true, !bCompactAttributes, &parseArena);
+    }
     if (!ret) {
         UE_LOG(LogImportOBJNoSTLActor, Error, TEXT("tinyobj::LoadObj 失败, 提示信息为: %s"), UTF8_TO_TCHAR(err.c_str()));
         return staticMesh;
     } else {
         UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("tinyobj::LoadObj 成功, 路径为: %s"), *(baseDir + file));
     }
+    const std::vector<tinyobj::shape_t>& parsedShapes = bLivePreview ? _objReader->GetShapes() : shapes;
+
+    // 按平滑组为没有法线的角点生成顶点法线(实时预览时顶点属性由增量读取器持有, 不生成)
+    if (bGenerateNormals && !bLivePreview && !tinyobj::GenerateSmoothingGroupNormals(&attrib, &shapes)) {
+        UE_LOG(LogImportOBJNoSTLActor, Warning, TEXT("部分面的顶点索引无效, 未为其生成法线"));
+    }
+
+    // 按需将顶点属性转换为紧凑格式(转换后 attrib 被清空), 之后统一通过 attrib_accessor_t 读取两种格式
+    // 实时预览时顶点属性由增量读取器持有, 不做转换
+    const bool compact = bCompactAttributes && !bLivePreview;
+    tinyobj::compact_attrib_t compactAttrib;
+    if (compact) {
+        tinyobj::CompactAttrib(&attrib, &compactAttrib);
+    }
+    const tinyobj::attrib_accessor_t attribs = compact ? tinyobj::attrib_accessor_t(compactAttrib)
+        : tinyobj::attrib_accessor_t(bLivePreview ? _objReader->GetAttrib() : attrib);
+
+    // 每级 LOD 对应一个 MeshDescription(实时预览时只有 LOD0)
+    const int numLODs = bLivePreview ? 1 : 1 + LODTriangleRatios.Num();
+    TArray<FMeshDescription> descriptions;
+    descriptions.SetNum(numLODs);
+    TArray<FMeshDescriptionBuilder> builders;
+    builders.SetNum(numLODs);
+    for (int lod = 0; lod < numLODs; lod++) {
+        FStaticMeshAttributes attributes(descriptions[lod]);
+        attributes.Register();
 
-    // 使用 MeshDescriptionBuilder 设置网格模型的基本属性
-    FMeshDescriptionBuilder meshDescBuilder;
-    meshDescBuilder.SetMeshDescription(&description);  // 设置 MeshDescription
-    meshDescBuilder.EnablePolyGroups();                // 允许使用多边形组
-    meshDescBuilder.SetNumUVLayers(1);                 // 设置UV坐标的级数为1
+        // 使用 MeshDescriptionBuilder 设置网格模型的基本属性
+        builders[lod].SetMeshDescription(&descriptions[lod]);  // 设置 MeshDescription
+        builders[lod].EnablePolyGroups();                      // 允许使用多边形组
+        builders[lod].SetNumUVLayers(1);                       // 设置UV坐标的级数为1
+    }
 
-    // 向 MeshDescriptionBuilder 中输入顶点位置
+    // 向 MeshDescriptionBuilder 中输入顶点位置(各级 LOD 的顶点ID相同)
     TArray<FVertexID> vertexIDs;
-    vertexIDs.SetNum(attrib.vertices.size() / 3);
+    vertexIDs.SetNum(attribs.num_vertices());
     for (int v = 0; v < vertexIDs.Num(); v++) {
-        vertexIDs[v] = meshDescBuilder.AppendVertex(FVector(
-            attrib.vertices[3 * v + 0] * 100.0f, 
-            attrib.vertices[3 * v + 1] * 100.0f, 
-            attrib.vertices[3 * v + 2] * 100.0f)
-        );
+        tinyobj::real_t p[3];
+        attribs.GetVertex(v, p);
+        for (int lod = 0; lod < numLODs; lod++) {
+            vertexIDs[v] = builders[lod].AppendVertex(FVector(
+                p[0] * 100.0f, 
+                p[1] * 100.0f, 
+                p[2] * 100.0f)
+            );
+        }
     }
-    UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("导入顶点位置成功, 共导入 %d 个顶点"), attrib.vertices.size() / 3);
+    UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("导入顶点位置成功, 共导入 %d 个顶点"), attribs.num_vertices());
+
+    // 每个多边形组的 meshlet(按需生成)
+    _meshlets.Reset();
+    _meshlets.SetNum(parsedShapes.size());
 
     // 遍历所有的图元对象, 创建多边形组
-    for (size_t i = 0; i < shapes.size(); ++i) {
+    for (size_t i = 0; i < parsedShapes.size(); ++i) {
         // 当前多边形组
-        tinyobj::shape_t& shape = shapes[i];
+        const tinyobj::shape_t& shape = parsedShapes[i];
 
         // 初始化 GlobalData, 用于后续传递参数
         GlobalData globalData;
-        globalData.builder = &meshDescBuilder;
+        globalData.builder = &builders[0];
         globalData.vertexIDs = vertexIDs;
-        globalData.polygonGroup = meshDescBuilder.AppendPolygonGroup();
-
-        // 遍历 shape.mesh 中的所有三角面, 并将三角面信息添加到 MeshDescriptionBuilder 中
-        size_t offset = 0;
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-            size_t fnum = shape.mesh.num_face_vertices[f];
-            if (fnum != 3) continue;
-
-            // 读取该三角面中三个顶点的属性
-            TriangleVertex triVertex[3];
-            for (size_t v = 0; v < 3; ++v) {
-                // 顶点编号
-                tinyobj::index_t idx = shape.mesh.indices[offset + v];
-                triVertex[v].vertexIndex = idx.vertex_index;
-                
-                // 顶点法线
-                if (idx.normal_index >= 0) {
-                    triVertex[v].normal = FVector(
-                        attrib.normals[3 * idx.normal_index + 0], 
-                        attrib.normals[3 * idx.normal_index + 1],
-                        attrib.normals[3 * idx.normal_index + 2]
-                    );
-                }
-                
-                // 顶点UV坐标(-!--注意要翻转Y轴--!-)
-                if (idx.texcoord_index >= 0) {
-                    triVertex[v].UV = FVector2D(
-                        attrib.texcoords[2 * idx.texcoord_index + 0], 
-                        1.0 - attrib.texcoords[2 * idx.texcoord_index + 1]
-                    );
-                } 
-                
-                // 顶点颜色
-                if (attrib.colors.size() > 3 * idx.vertex_index + 2) {
-                    triVertex[v].Color = FVector4f(
-                        attrib.colors[3 * idx.vertex_index + 0], 
-                        attrib.colors[3 * idx.vertex_index + 1],
-                        attrib.colors[3 * idx.vertex_index + 2],
-                        1.0f
-                    );
-                }
+        globalData.polygonGroup = builders[0].AppendPolygonGroup();
+        // 每级 LOD 中的多边形组与 LOD0 一一对应
+        TArray<FPolygonGroupID> lodPolygonGroups;
+        lodPolygonGroups.SetNum(numLODs);
+        for (int lod = 1; lod < numLODs; lod++) {
+            lodPolygonGroups[lod] = builders[lod].AppendPolygonGroup();
+        }
+
+        // 将 shape 中的面焊接为去重后的顶点: (v, vn, vt) 相同的角点共用同一个 VertexInstance
+        tinyobj::indexed_mesh_t indexedMesh;
+        if (!tinyobj::BuildIndexedMesh(attribs, shape, &indexedMesh)) {
+            UE_LOG(LogImportOBJNoSTLActor, Warning, TEXT("[第%d个多边形组] 顶点索引无效, 跳过该多边形组"), i);
+            continue;
+        }
+        // 生成切线(按三角面并行计算), 随顶点实例一起写入 MeshDescription
+        if (bGenerateTangents && !tinyobj::GenerateTangents(&indexedMesh, shape)) {
+            UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("[第%d个多边形组] 缺少法线或UV, 不生成切线"), i);
+        }
+        // 重排三角面(提高顶点缓存命中率)与顶点实例(提高顶点读取局部性), 输出优化前后的 ACMR/ATVR
+        // 实时预览时图元由增量读取器持有, 不做重排(其余情况下 shape 即 shapes[i])
+        if (bOptimizeVertexCache && !bLivePreview) {
+            const tinyobj::vertex_cache_stats_t before = tinyobj::AnalyzeVertexCache(indexedMesh);
+            if (tinyobj::OptimizeVertexCache(&indexedMesh, &shapes[i])) {
+                const tinyobj::vertex_cache_stats_t after = tinyobj::AnalyzeVertexCache(indexedMesh);
+                UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("[第%d个多边形组] 顶点缓存优化: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f"), i, before.acmr, after.acmr,
+                    before.atvr, after.atvr);
             }
-            // 将三个顶点的属性添加到 MeshDescriptionBuilder 中
-            AddTriangleData(globalData, triVertex[0], triVertex[1], triVertex[2]);
-            offset += fnum;
+        }
+        // 将顶点实例与三角面信息添加到 MeshDescriptionBuilder 中
+        AddIndexedMeshData(globalData, attribs, shape, indexedMesh);
+        UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("[第%d个多边形组] 角点数: %d, 去重后顶点实例数: %d"), i, indexedMesh.indices.size(), indexedMesh.num_vertices());
+
+        // 将 LOD0 的三角面划分为 meshlet(按空间分块并行), 每个附带包围球与法线锥, 供后续剔除与按簇并行处理
+        if (bBuildMeshlets) {
+            TSharedPtr<tinyobj::meshlets_t> meshlets = MakeShared<tinyobj::meshlets_t>();
+            const double startTime = FPlatformTime::Seconds();
+            if (tinyobj::BuildMeshlets(indexedMesh, shape, meshlets.Get(), MeshletMaxVertices, MeshletMaxTriangles)) {
+                const double seconds = FMath::Max(FPlatformTime::Seconds() - startTime, 1e-6);
+                UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("[第%d个多边形组] meshlet 数: %d, 平均三角面数: %.1f, 耗时 %.3f 秒(%.2f 百万三角面/秒)"), i,
+                    meshlets->meshlets.size(), meshlets->triangles.size() / 3.0 / FMath::Max<size_t>(meshlets->meshlets.size(), 1), seconds,
+                    indexedMesh.indices.size() / 3.0 / seconds / 1e6);
+                _meshlets[i] = meshlets;
+            } else {
+                UE_LOG(LogImportOBJNoSTLActor, Warning, TEXT("[第%d个多边形组] 含有非三角面或 meshlet 上限无效, 不生成 meshlet"), i);
+            }
+        }
+
+        // 生成 LOD 链: 每级由上一级按二次误差度量(QEM)简化得到, UV接缝与材质边界只沿自身收缩
+        const tinyobj::shape_t* prevShape = &shape;
+        const tinyobj::indexed_mesh_t* prevMesh = &indexedMesh;
+        float prevRatio = 1.0f;
+        tinyobj::shape_t lodShapes[2];
+        tinyobj::indexed_mesh_t lodMeshes[2];
+        for (int lod = 1; lod < numLODs; lod++) {
+            GlobalData lodData;
+            lodData.builder = &builders[lod];
+            lodData.vertexIDs = vertexIDs;
+            lodData.polygonGroup = lodPolygonGroups[lod];
+
+            const float ratio = FMath::Clamp(LODTriangleRatios[lod - 1], 0.0f, prevRatio);
+            tinyobj::shape_t& lodShape = lodShapes[lod & 1];
+            tinyobj::indexed_mesh_t& lodMesh = lodMeshes[lod & 1];
+            if (!tinyobj::SimplifyIndexedMesh(*prevMesh, *prevShape, prevRatio > 0.0f ? ratio / prevRatio : 0.0f, &lodMesh, &lodShape)) {
+                UE_LOG(LogImportOBJNoSTLActor, Warning, TEXT("[第%d个多边形组] 含有非三角面, 不生成 LOD%d"), i, lod);
+                break;
+            }
+            if (bOptimizeVertexCache) {
+                tinyobj::OptimizeVertexCache(&lodMesh, &lodShape);
+            }
+            AddIndexedMeshData(lodData, attribs, lodShape, lodMesh);
+            UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("[第%d个多边形组] LOD%d: 三角面数 %d(目标比例 %.3f), 顶点实例数 %d"), i, lod,
+                lodShape.mesh.num_face_vertices.size(), ratio, lodMesh.num_vertices());
+            prevShape = &lodShape;
+            prevMesh = &lodMesh;
+            prevRatio = ratio;
         }
 
         // 提示信息
@@ -128,38 +222,70 @@ UStaticMesh* AImportOBJNoMTLActor::CreateMeshDataFromFile(const FString& baseDir
     // 创建 MeshDescription
     UStaticMesh::FBuildMeshDescriptionsParams builderParams;
     builderParams.bBuildSimpleCollision = true;
-    builderParams.bFastBuild = true;
+    builderParams.bFastBuild = true;  // 快速构建: 直接使用顶点实例上的法线与切线
 
     // 根据 MeshDescription 构建网格体
     TArray<const FMeshDescription*> meshDescList;
-    meshDescList.Emplace(&description);
+    for (int lod = 0; lod < numLODs; lod++) {
+        meshDescList.Emplace(&descriptions[lod]);
+    }
     staticMesh->BuildFromMeshDescriptions(meshDescList, builderParams);
 
     // 返回构建成功的网格体
-    UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("--!-- 网格体构建成功 --!--"));
+    UE_LOG(LogImportOBJNoSTLActor, Display, TEXT("--!-- 网格体构建成功, LOD 数: %d --!--"), staticMesh->GetNumLODs());
     return staticMesh;
 }
 
-void AImportOBJNoMTLActor::AddTriangleData(
-    GlobalData& globalData, const TriangleVertex& v1, const TriangleVertex& v2, const TriangleVertex& v3) {
+// 向几何体中添加去重后的顶点实例与三角面信息
+void AImportOBJNoMTLActor::AddIndexedMeshData(GlobalData& globalData, const tinyobj::attrib_accessor_t& attrib, const tinyobj::shape_t& shape,
+    const tinyobj::indexed_mesh_t& indexedMesh) {
+    // 每个去重后的顶点新建一个 VertexInstance, 设置对应的顶点属性
+    TArray<FVertexInstanceID> instanceIDs;
+    instanceIDs.SetNum(indexedMesh.num_vertices());
+    for (int v = 0; v < instanceIDs.Num(); v++) {
+        const tinyobj::real_t* vertex = &indexedMesh.vertices[v * indexedMesh.vertex_stride];
+        const int vertexIndex = indexedMesh.vertex_sources[v].vertex_index;
+        instanceIDs[v] = globalData.builder->AppendInstance(globalData.vertexIDs[vertexIndex]);
 
-    // 新建三个 VertexInstance, 设置对应的顶点属性
-    FVertexInstanceID i1 = globalData.builder->AppendInstance(globalData.vertexIDs[v1.vertexIndex]);
-    globalData.builder->SetInstanceNormal(i1, v1.normal);
-    globalData.builder->SetInstanceUV(i1, v1.UV, 0);
-    globalData.builder->SetInstanceColor(i1, v1.Color);
-
-    FVertexInstanceID i2 = globalData.builder->AppendInstance(globalData.vertexIDs[v2.vertexIndex]);
-    globalData.builder->SetInstanceNormal(i2, v2.normal);
-    globalData.builder->SetInstanceUV(i2, v2.UV, 0);
-    globalData.builder->SetInstanceColor(i2, v2.Color);
+        // 顶点法线
+        FVector normal(0.0f, 0.0f, 0.0f);
+        if (indexedMesh.normal_offset >= 0) {
+            const tinyobj::real_t* n = vertex + indexedMesh.normal_offset;
+            normal = FVector(n[0], n[1], n[2]);
+        }
+        if (!indexedMesh.tangents.empty()) {
+            // 顶点切线: UV 的 Y 轴在下方被翻转, 切线方向不变, 副切线方向相反, 因此 w > 0 时翻转副切线
+            const tinyobj::real_t* t = &indexedMesh.tangents[v * 4];
+            globalData.builder->SetInstanceTangentSpace(instanceIDs[v], normal, FVector(t[0], t[1], t[2]), t[3] > 0.0f);
+        } else {
+            globalData.builder->SetInstanceNormal(instanceIDs[v], normal);
+        }
 
-    FVertexInstanceID i3 = globalData.builder->AppendInstance(globalData.vertexIDs[v3.vertexIndex]);
-    globalData.builder->SetInstanceNormal(i3, v3.normal);
-    globalData.builder->SetInstanceUV(i3, v3.UV, 0);
-    globalData.builder->SetInstanceColor(i3, v3.Color);
+        // 顶点UV坐标(-!--注意要翻转Y轴--!-)
+        FVector2D UV(0.0f, 0.0f);
+        if (indexedMesh.texcoord_offset >= 0) {
+            const tinyobj::real_t* t = vertex + indexedMesh.texcoord_offset;
+            UV = FVector2D(t[0], 1.0 - t[1]);
+        }
+        globalData.builder->SetInstanceUV(instanceIDs[v], UV, 0);
 
-    // 最后, 通过三个索引值构建三角面图元
-    globalData.builder->AppendTriangle(i1, i2, i3, globalData.polygonGroup);
+        // 顶点颜色
+        tinyobj::real_t rgb[3];
+        attrib.GetColor(vertexIndex, rgb);
+        globalData.builder->SetInstanceColor(instanceIDs[v], FVector4f(rgb[0], rgb[1], rgb[2], 1.0f));
+    }
 
-}
\ No newline at end of file
+    // 遍历所有三角面, 通过三个索引值构建三角面图元
+    size_t offset = 0;
+    for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+        size_t fnum = shape.mesh.num_face_vertices[f];
+        if (fnum == 3) {
+            globalData.builder->AppendTriangle(
+                instanceIDs[indexedMesh.indices[offset + 0]],
+                instanceIDs[indexedMesh.indices[offset + 1]],
+                instanceIDs[indexedMesh.indices[offset + 2]],
+                globalData.polygonGroup);
+        }
+        offset += fnum;
+    }
+}
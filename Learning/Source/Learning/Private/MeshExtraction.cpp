@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshExtraction.h"
+#include <MeshDescription.h>
+#include <StaticMeshAttributes.h>
+
+// 批量提取三角形
+bool MeshExtraction::ExtractTriangles(const FMeshDescription& description, FMeshExtractionResult& result) {
+    FStaticMeshConstAttributes attributes(description);
+    TVertexAttributesConstRef<FVector3f> positions = attributes.GetVertexPositions();
+    TVertexInstanceAttributesConstRef<FVector3f> normals = attributes.GetVertexInstanceNormals();
+    TVertexInstanceAttributesConstRef<FVector2f> uvs = attributes.GetVertexInstanceUVs();
+    if (!positions.IsValid() || !normals.IsValid() || !uvs.IsValid() || uvs.GetNumChannels() == 0) {
+        return false;
+    }
+
+    // 属性的原始数组, 以元素ID为下标
+    result.positions = positions.GetRawArray();
+    result.normals = normals.GetRawArray();
+    result.uvs = uvs.GetRawArray(0);
+    result.numPolygons = description.Polygons().Num();
+
+    // 按多边形组顺序, 组内逐个多边形写入其三角形, 与原先GetPolygonGroupPolygons/GetPolygonTriangles的导出顺序一致
+    // 三角形总数已知, 结果数组一次分配; 多边形和三角形ID都通过数组视图读取, 不复制
+    const int32 numGroups = description.PolygonGroups().GetArraySize();
+    const int32 numTriangles = description.Triangles().Num();
+    result.polygonGroupTriangles.Reset(numGroups + 1);
+    result.polygonGroupTriangles.SetNumZeroed(numGroups + 1);
+    result.cornerVertices.SetNumUninitialized(3 * numTriangles);
+    result.cornerInstances.SetNumUninitialized(3 * numTriangles);
+    int32 corner = 0;
+    for (int32 i = 0; i < numGroups; i++) {
+        const FPolygonGroupID groupID(i);
+        if (description.IsPolygonGroupValid(groupID)) {
+            for (const FPolygonID polygonID : description.GetPolygonGroupPolygonIDs(groupID)) {
+                for (const FTriangleID triangleID : description.GetPolygonTriangles(polygonID)) {
+                    TArrayView<const FVertexInstanceID> instances = description.GetTriangleVertexInstances(triangleID);
+                    for (int32 k = 0; k < 3; k++) {
+                        result.cornerInstances[corner + k] = instances[k].GetValue();
+                        result.cornerVertices[corner + k] = description.GetVertexInstanceVertex(instances[k]).GetValue();
+                    }
+                    corner += 3;
+                }
+            }
+        }
+        result.polygonGroupTriangles[i + 1] = corner / 3;
+    }
+    // 不属于有效多边形组的三角形不导出
+    result.cornerVertices.SetNum(corner);
+    result.cornerInstances.SetNum(corner);
+    return true;
+}
@@ -0,0 +1,425 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "OBJExportJob.h"
+#include "MeshExtraction.h"
+#include <Engine/StaticMesh.h>
+#include <Engine/Texture2D.h>
+#include <HAL/FileManager.h>
+#include <StaticMeshAttributes.h>
+#include "Learning/tiny_obj_writer.h"
+#include "./Learning/lodepng.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOBJExportJob, All, All);
+
+namespace {
+    // 各阶段结束时的进度, 写OBJ占剩余部分并按写出的元素数推进
+    const float kProgressExtracted = 0.3f;
+    const float kProgressTextures = 0.4f;
+    const float kProgressMTL = 0.42f;
+    // 写出OBJ时每段的元素数, 每段之间检查取消并更新进度
+    const size_t kWriteSliceSize = size_t(1) << 20;
+}
+
+// 截取快照(只能在游戏线程调用)
+TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe> FOBJExportJob::Create(UStaticMesh* mesh, const FString& jobName, const FString& outputRoot,
+    const FOBJExportOptions& exportOptions, const TSet<FString>* skipTextures) {
+    check(IsInGameThread());
+    const FMeshDescription* description = mesh ? mesh->GetMeshDescription(0) : nullptr;
+    if (!description) {
+        UE_LOG(LogOBJExportJob, Error, TEXT("网格体 %s 没有LOD0的网格体描述, 无法导出"), *jobName);
+        return nullptr;
+    }
+
+    double startTime = FPlatformTime::Seconds();
+    TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe> job = MakeShared<FOBJExportJob, ESPMode::ThreadSafe>();
+    job->name = jobName;
+    job->filePathRoot = outputRoot;
+    job->options = exportOptions;
+    job->createTime = startTime;
+    // 复制网格体描述只是拷贝属性数组, 远快于逐三角形提取
+    job->meshDescription = *description;
+    job->SnapshotMaterials(mesh, skipTextures);
+    job->stats.snapshotSeconds = FPlatformTime::Seconds() - startTime;
+    return job;
+}
+
+// 执行导出
+bool FOBJExportJob::Run() {
+    double phaseStart = FPlatformTime::Seconds();
+    bool bSucceeded = !bCancelled && ExtractTriangles();
+    stats.extractSeconds = FPlatformTime::Seconds() - phaseStart;
+    // 提取完成后网格体描述的副本不再需要
+    meshDescription.Empty();
+    SetProgress(kProgressExtracted);
+
+    if (bSucceeded && !bCancelled) {
+        phaseStart = FPlatformTime::Seconds();
+        ExportToPNGFiles();
+        stats.materialSeconds = FPlatformTime::Seconds() - phaseStart;
+        SetProgress(kProgressTextures);
+    }
+
+    if (bSucceeded && !bCancelled) {
+        phaseStart = FPlatformTime::Seconds();
+        bSucceeded = ExportToMTLFile();
+        stats.writeMTLSeconds = FPlatformTime::Seconds() - phaseStart;
+        SetProgress(kProgressMTL);
+    }
+
+    if (bSucceeded && !bCancelled) {
+        phaseStart = FPlatformTime::Seconds();
+        bSucceeded = ExportToOBJFile();
+        stats.writeOBJSeconds = FPlatformTime::Seconds() - phaseStart;
+    }
+
+    bSucceeded = bSucceeded && !bCancelled;
+    if (bSucceeded) SetProgress(1.0f);
+    if (bCancelled) {
+        UE_LOG(LogOBJExportJob, Warning, TEXT("--! 网格体 %s 的导出已取消 !--"), *name);
+    }
+    stats.totalSeconds = FPlatformTime::Seconds() - createTime;
+    return bSucceeded;
+}
+
+void FOBJExportJob::SetProgress(float value) {
+    progress = value;
+    if (progressCallback) progressCallback(value);
+}
+
+// 输出统计信息汇总
+void FOBJExportJob::LogStats() const {
+    UE_LOG(LogOBJExportJob, Display, TEXT("-STATS-[%s][几何]: 多边形组 %d, 多边形 %d, 三角形 %d"), *name, stats.polygonGroups, stats.polygons, stats.triangles);
+    UE_LOG(LogOBJExportJob, Display, TEXT("-STATS-[%s][写出]: 顶点位置 %d, 法线 %d, UV %d, OBJ %lld 字节, MTL %lld 字节, 纹理 %d 张 %lld 字节"), *name,
+        stats.positions, stats.normals, stats.uvs, stats.objBytes, stats.mtlBytes, stats.textures, stats.pngBytes);
+    UE_LOG(LogOBJExportJob, Display, TEXT("-STATS-[%s][耗时]: 快照(游戏线程) %.3f 秒, 提取 %.3f 秒, 纹理 %.3f 秒, 写MTL %.3f 秒, 写OBJ %.3f 秒, 总计 %.3f 秒"),
+        *name, stats.snapshotSeconds, stats.extractSeconds, stats.materialSeconds, stats.writeMTLSeconds, stats.writeOBJSeconds, stats.totalSeconds);
+    if (options.traceSampleInterval > 0) {
+        UE_LOG(LogOBJExportJob, Display, TEXT("-STATS-[%s][调试日志]: 采样间隔 %d, 共输出 %d 条"), *name, options.traceSampleInterval, stats.tracedElements);
+    }
+}
+
+// 游戏线程: 记录材质名称, 并截取BaseColor和Normal纹理的像素
+void FOBJExportJob::SnapshotMaterials(UStaticMesh* mesh, const TSet<FString>* skipTextures) {
+    FStaticMeshConstAttributes attributes(meshDescription);
+    TPolygonGroupAttributesConstRef<FName> materials = attributes.GetPolygonGroupMaterialSlotNames();
+
+    // 遍历所有多边形组, 从中找到所有的多边形对象
+    UE_LOG(LogOBJExportJob, Display, TEXT("-MTL-[多边形组数量]: %d"), meshDescription.PolygonGroups().Num());
+    for (const FPolygonGroupID groupID : meshDescription.PolygonGroups().GetElementIDs()) {
+        // 获取该多边形组对应的MTL材质
+        int mtlIndex = mesh->GetMaterialIndex(materials[groupID]);
+        UMaterialInterface* mtl = mesh->GetMaterial(mtlIndex);
+        if (!mtl) continue;
+        mtlName = mtl->GetName();
+        UE_LOG(LogOBJExportJob, Display, TEXT("-ATTR-[第%d个多边形组]: 对应材质名称 = %s"), groupID.GetValue(), *mtlName);
+
+        // 编辑器模式下: 获取BaseColor和Normal两个属性各自对应的工作流中包含的所有纹理对象
+        // 颜色贴图
+        TArray<UTexture*> textures_BaseColor;
+        mtl->GetTexturesInPropertyChain(EMaterialProperty::MP_BaseColor, textures_BaseColor, NULL, NULL);
+        mtlFiles["map_Kd"] = mtlFiles["map_Ka"] = SnapshotTextures(textures_BaseColor, skipTextures);
+        // 法线贴图
+        TArray<UTexture*> textures_Normal;
+        mtl->GetTexturesInPropertyChain(EMaterialProperty::MP_Normal, textures_Normal, NULL, NULL);
+        mtlFiles["bump"] = SnapshotTextures(textures_Normal, skipTextures);
+    }
+}
+
+// 游戏线程: 截取纹理像素, 返回MTL中引用的PNG文件名(只考虑了一张纹理)
+// 读取像素需要锁定纹理数据, 只能在游戏线程完成; PNG编码和写文件留给Run
+FString FOBJExportJob::SnapshotTextures(const TArray<UTexture*>& textureObjects, const TSet<FString>* skipTextures) {
+    // 输出的文件路径
+    FString resultFileName;
+
+    for (UTexture* texture : textureObjects) {
+        UTexture2D* texture2D = dynamic_cast<UTexture2D*>(texture);
+        if (!texture2D) continue;  // 只处理2D纹理
+
+        FString textureName = texture2D->GetFName().ToString();
+        resultFileName = textureName + ".png";
+        FString filePath = filePathRoot + textureName;
+        // 同一张纹理可能同时被多个材质属性引用, 只截取一次
+        if (textures.ContainsByPredicate([&filePath](const FTextureImage& image) { return image.filePath == filePath; })) continue;
+        // 之前结束的任务已经写出的纹理不再截取; 仍在进行中的任务可能失败或被取消, 因此不能依赖它们
+        if (skipTextures && skipTextures->Contains(filePath)) continue;
+
+        // 获取纹理的长、宽
+        FTextureImage& image = textures.AddDefaulted_GetRef();
+        image.filePath = filePath;
+        image.width = texture2D->GetSizeX();
+        image.height = texture2D->GetSizeY();
+        UE_LOG(LogOBJExportJob, Display, TEXT("-Texture-[纹理%s]的大小为: %d x %d"), *textureName, image.width, image.height);
+
+        // 获取只读锁可能会失败, 因此我们需要首先转换纹理对象为缺省状态
+        TextureCompressionSettings prevCompression = texture2D->CompressionSettings;
+        TextureMipGenSettings prevMipSettings = texture2D->MipGenSettings;
+        uint8 prevSRGB = texture2D->SRGB;
+        texture2D->CompressionSettings = TextureCompressionSettings::TC_VectorDisplacementmap;
+        texture2D->MipGenSettings = TextureMipGenSettings::TMGS_NoMipmaps;
+        texture2D->SRGB = false;
+        texture2D->UpdateResource();
+
+        // 找到纹理对象Mipmaps第1层数据, 临时锁定当前的纹理对象
+        // 获取到像素数据的内存地址, 按RGBA顺序复制后再通过Unlock()结束锁定
+        const FColor* imageData = static_cast<const FColor*>(texture2D->PlatformData->Mips[0].BulkData.LockReadOnly());
+        if (imageData != NULL) {
+            const int32 numPixels = image.width * image.height;
+            image.rgba.resize(4 * static_cast<size_t>(numPixels));
+            unsigned char* out = image.rgba.data();
+            for (int32 i = 0; i < numPixels; i++) {
+                const FColor color = imageData[i];
+                out[4 * i] = color.R;
+                out[4 * i + 1] = color.G;
+                out[4 * i + 2] = color.B;
+                out[4 * i + 3] = color.A;
+            }
+        }
+        texture2D->PlatformData->Mips[0].BulkData.Unlock();
+
+        // 将纹理参数设置回原状
+        texture2D->CompressionSettings = prevCompression;
+        texture2D->MipGenSettings = prevMipSettings;
+        texture2D->SRGB = prevSRGB;
+        texture2D->UpdateResource();
+    }
+
+    return resultFileName;
+}
+
+// 从网格体描述中获取三角形位置、法线、UV坐标等属性
+// 通过MeshExtraction批量读取属性数组并一次遍历三角形数组, 不再逐个多边形、三角形分配TArray和调用GetAttribute
+bool FOBJExportJob::ExtractTriangles() {
+    FStaticMeshConstAttributes attributes(meshDescription);
+    TPolygonGroupAttributesConstRef<FName> materials = attributes.GetPolygonGroupMaterialSlotNames();
+
+    FMeshExtractionResult extraction;
+    if (!MeshExtraction::ExtractTriangles(meshDescription, extraction)) {
+        UE_LOG(LogOBJExportJob, Error, TEXT("-ATTR-网格体 %s 缺少顶点位置、法线或UV属性, 无法提取三角形"), *name);
+        return false;
+    }
+
+    // 热循环中只累加stats的计数, 逐元素日志只在traceSampleInterval > 0时按采样输出
+    stats.polygonGroups = meshDescription.PolygonGroups().Num();
+    stats.polygons = extraction.numPolygons;
+    stats.triangles = extraction.NumTriangles();
+    for (const FPolygonGroupID groupID : meshDescription.PolygonGroups().GetElementIDs()) {
+        const int32 g = groupID.GetValue();
+        UE_LOG(LogOBJExportJob, Display, TEXT("-ATTR-[第%d个多边形组]: 多边形数量 = %d, 三角形数量 = %d, 对应材质名称 = %s"), g,
+            meshDescription.GetNumPolygonGroupPolygons(groupID), extraction.polygonGroupTriangles[g + 1] - extraction.polygonGroupTriangles[g],
+            *materials[groupID].ToString());
+    }
+    const int32 traceSampleInterval = options.traceSampleInterval;
+    if (traceSampleInterval > 0) {
+        for (int32 t = 0; t < stats.triangles; t += traceSampleInterval) {
+            UE_LOG(LogOBJExportJob, Display, TEXT("-ATTR-[第%d个三角形]: 三个顶点实例的索引值为 %d, %d, %d"), t, extraction.cornerInstances[3 * t],
+                extraction.cornerInstances[3 * t + 1], extraction.cornerInstances[3 * t + 2]);
+            stats.tracedElements++;
+        }
+    }
+
+    const int32 numCorners = extraction.cornerInstances.Num();
+    if (!options.bIndexedExport) {
+        // 每个三角形顶点单独写出: 直接从属性数组收集
+        outPositions.resize(numCorners);
+        outNormals.resize(numCorners);
+        outUVs.resize(numCorners);
+        for (int32 c = 0; c < numCorners; c++) {
+            const int32 instance = extraction.cornerInstances[c];
+            outPositions[c] = extraction.positions[extraction.cornerVertices[c]];
+            outNormals[c] = extraction.normals[instance];
+            outUVs[c] = extraction.uvs[instance];
+        }
+        return true;
+    }
+
+    // 按索引导出: FVertexID到输出顶点位置的映射, 以及法线、UV的去重表
+    // 顶点实例被相邻三角形共享, 因此每个FVertexInstanceID只查一次去重表
+    TArray<int32> positionRemap;
+    TArray<int32> normalRemap;
+    TArray<int32> uvRemap;
+    positionRemap.Init(INDEX_NONE, extraction.positions.Num());
+    normalRemap.Init(INDEX_NONE, extraction.normals.Num());
+    uvRemap.Init(INDEX_NONE, extraction.uvs.Num());
+    tinyobj::ObjAttributeDeduplicator normalDedup(3, options.dedupTolerance);
+    tinyobj::ObjAttributeDeduplicator uvDedup(2, options.dedupTolerance);
+    normalDedup.Reserve(meshDescription.VertexInstances().Num());
+    uvDedup.Reserve(meshDescription.VertexInstances().Num());
+    outPositionIndices.resize(numCorners);
+    outUVIndices.resize(numCorners);
+    outNormalIndices.resize(numCorners);
+
+    for (int32 c = 0; c < numCorners; c++) {
+        const int32 vertex = extraction.cornerVertices[c];
+        const int32 instance = extraction.cornerInstances[c];
+        int32& positionIndex = positionRemap[vertex];
+        if (positionIndex == INDEX_NONE) {
+            positionIndex = static_cast<int32>(outPositions.size());
+            outPositions.push_back(extraction.positions[vertex]);
+        }
+        int32& normalIndex = normalRemap[instance];
+        if (normalIndex == INDEX_NONE) {
+            normalIndex = normalDedup.Insert(&extraction.normals[instance].X);
+        }
+        int32& uvIndex = uvRemap[instance];
+        if (uvIndex == INDEX_NONE) {
+            uvIndex = uvDedup.Insert(&extraction.uvs[instance].X);
+        }
+        outPositionIndices[c] = positionIndex + 1;
+        outNormalIndices[c] = normalIndex + 1;
+        outUVIndices[c] = uvIndex + 1;
+    }
+
+    // 去重后的法线和UV
+    const std::vector<float>& normals = normalDedup.values();
+    outNormals.reserve(normalDedup.size());
+    for (size_t i = 0; i < normalDedup.size(); i++) {
+        outNormals.push_back(FVector3f(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]));
+    }
+    const std::vector<float>& uvs = uvDedup.values();
+    outUVs.reserve(uvDedup.size());
+    for (size_t i = 0; i < uvDedup.size(); i++) {
+        outUVs.push_back(FVector2f(uvs[2 * i], uvs[2 * i + 1]));
+    }
+    UE_LOG(LogOBJExportJob, Display, TEXT("-ATTR-[按索引导出]: 三角形顶点数 = %d, 顶点位置 = %d, 法线 = %d, UV = %d"), numCorners,
+        static_cast<int32>(outPositions.size()), static_cast<int32>(outNormals.size()), static_cast<int32>(outUVs.size()));
+    return true;
+}
+
+// 通过lodepng库编码并写出PNG文件
+void FOBJExportJob::ExportToPNGFiles() {
+    for (FTextureImage& image : textures) {
+        if (bCancelled) return;
+        if (image.rgba.empty()) continue;
+
+        // 使用loadpng库编码后写出临时文件, 再替换为目标文件
+        const FString pngPath = image.filePath + TEXT(".png");
+        const FString tempPath = pngPath + TEXT(".") + FGuid::NewGuid().ToString() + TEXT(".tmp");
+        std::vector<unsigned char> png;
+        unsigned int result = lodepng::encode(png, image.rgba, image.width, image.height);
+        if (result == 0) {
+            result = lodepng::save_file(png, TCHAR_TO_UTF8(*tempPath));
+        }
+        if (result > 0) {
+            UE_LOG(LogOBJExportJob, Error, TEXT("-Texture-[lodepng]导出失败, 提示信息为: %s"), UTF8_TO_TCHAR(lodepng_error_text(result)));
+        } else if (!IFileManager::Get().Move(*pngPath, *tempPath, true)) {
+            UE_LOG(LogOBJExportJob, Error, TEXT("-Texture-无法替换PNG文件, 路径为 %s"), *pngPath);
+            IFileManager::Get().Delete(*tempPath);
+        } else {
+            writtenTextures.Add(image.filePath);
+            stats.textures++;
+            stats.pngBytes += static_cast<int64>(png.size());
+            UE_LOG(LogOBJExportJob, Warning, TEXT("--! 导出PNG文件成功, 路径为 %s.png !--"), *image.filePath);
+        }
+        // 编码后像素不再需要
+        std::vector<unsigned char>().swap(image.rgba);
+    }
+}
+
+// 导出MTL文件
+bool FOBJExportJob::ExportToMTLFile() {
+    FString filePath = filePathRoot + name + ".mtl";
+    tinyobj::ObjWriter out(tinyobj::ObjWriter::kMinBufferSize);
+    if (!out.Open(*filePath)) {
+        UE_LOG(LogOBJExportJob, Error, TEXT("--! 无法创建MTL文件, 路径为 %s !--"), *filePath);
+        return false;
+    }
+
+    // 材质信息
+    out.Comment(TCHAR_TO_UTF8(*(TEXT("Exported from UE5: ") + name)));
+    out.Statement("newmtl", TCHAR_TO_UTF8(*mtlName));
+
+    // out.Statement("Ka", 0.2f, 0.2f, 0.2f);
+    // out.Statement("Kd", 0.6f, 0.6f, 0.6f);
+    // out.Statement("Ks", 0.9f, 0.9f, 0.9f);
+
+    // 纹理贴图
+    for (std::map<FString, FString>::iterator it = mtlFiles.begin(); it != mtlFiles.end(); ++it) {
+        out.Statement(TCHAR_TO_UTF8(*it->first), TCHAR_TO_UTF8(*it->second));
+    }
+
+    stats.mtlBytes = static_cast<int64>(out.bytes_written());
+    if (!out.Close()) {
+        UE_LOG(LogOBJExportJob, Error, TEXT("--! 写入MTL文件失败, 路径为 %s !--"), *filePath);
+        return false;
+    }
+    UE_LOG(LogOBJExportJob, Warning, TEXT("--! 导出MTL文件成功, 路径为 %s !--"), *filePath);
+    return true;
+}
+
+// 导出OBJ文件
+// 通过带大缓冲区的ObjWriter写出, 不再逐行flush, 浮点数用std::to_chars格式化
+// 顶点、法线、UV和三角面按块并行格式化后按顺序写入, 结果与单线程写出完全一致
+// 每个部分按kWriteSliceSize分段写出, 段与段之间检查取消并更新进度, 分段不影响输出内容
+bool FOBJExportJob::ExportToOBJFile() {
+    static_assert(sizeof(FVector3f) == 3 * sizeof(float) && sizeof(FVector2f) == 2 * sizeof(float), "ObjWriter需要紧密排列的float数组");
+
+    FString filePath = filePathRoot + name + ".obj";
+    tinyobj::ObjWriter out;
+    if (!out.Open(*filePath)) {
+        UE_LOG(LogOBJExportJob, Error, TEXT("--! 无法创建OBJ文件, 路径为 %s !--"), *filePath);
+        return false;
+    }
+    out.SetPrecision(options.floatPrecision);
+    unsigned int numThreads = static_cast<unsigned int>(FMath::Max(options.exportThreads, 0));
+
+    const size_t numTriangles = (options.bIndexedExport ? outPositionIndices.size() : outPositions.size()) / 3;
+    const size_t total = outPositions.size() + outNormals.size() + outUVs.size() + numTriangles;
+    size_t written = 0;
+    auto writeSliced = [&](size_t count, TFunctionRef<void(size_t, size_t)> write) {
+        for (size_t first = 0; first < count && !bCancelled; first += kWriteSliceSize) {
+            const size_t n = FMath::Min(kWriteSliceSize, count - first);
+            write(first, n);
+            written += n;
+            SetProgress(kProgressMTL + (1.0f - kProgressMTL) * static_cast<float>(written) / static_cast<float>(total));
+        }
+    };
+
+    // 注释
+    out.Comment(TCHAR_TO_UTF8(*(TEXT("Export from UE5: ") + name)));
+    out.BlankLine();
+
+    // 材质信息
+    out.Statement("mtllib", TCHAR_TO_UTF8(*(name + TEXT(".mtl"))));
+    out.Statement("g", TCHAR_TO_UTF8(*mtlName));
+    out.BlankLine();
+
+    // 顶点位置
+    writeSliced(outPositions.size(), [&](size_t first, size_t n) { out.Positions(&outPositions[first].X, n, numThreads); });
+    out.BlankLine();
+
+    // 顶点法线
+    writeSliced(outNormals.size(), [&](size_t first, size_t n) { out.Normals(&outNormals[first].X, n, numThreads); });
+    out.BlankLine();
+
+    // 顶点UV坐标(写出1 - v)
+    writeSliced(outUVs.size(), [&](size_t first, size_t n) { out.TexCoords(&outUVs[first].X, n, true, numThreads); });
+    out.BlankLine();
+
+    // 三角面索引
+    out.Statement("usemtl", TCHAR_TO_UTF8(*mtlName));
+    out.BlankLine();
+    if (options.bIndexedExport) {
+        writeSliced(numTriangles, [&](size_t first, size_t n) {
+            out.Triangles(&outPositionIndices[3 * first], &outUVIndices[3 * first], &outNormalIndices[3 * first], n, numThreads);
+        });
+    } else {
+        writeSliced(numTriangles, [&](size_t first, size_t n) { out.SequentialTriangles(static_cast<long long>(1 + 3 * first), n, numThreads); });
+    }
+
+    stats.objBytes = static_cast<int64>(out.bytes_written());
+    stats.positions = static_cast<int32>(outPositions.size());
+    stats.normals = static_cast<int32>(outNormals.size());
+    stats.uvs = static_cast<int32>(outUVs.size());
+    const bool bClosed = out.Close();
+    if (bCancelled) {
+        // 取消时不留下写了一半的OBJ文件
+        IFileManager::Get().Delete(*filePath);
+        return false;
+    }
+    if (!bClosed) {
+        UE_LOG(LogOBJExportJob, Error, TEXT("--! 写入OBJ文件失败, 路径为 %s !--"), *filePath);
+        return false;
+    }
+    UE_LOG(LogOBJExportJob, Warning, TEXT("--! 导出OBJ文件成功, 路径为 %s !--"), *filePath);
+    return true;
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorIndexSubsystem.generated.h"
+
+// 场景中Actor的名称/Tag索引, 代替每次查找都用TActorIterator遍历整个关卡并逐个比较名称
+// 第一次查询时遍历一次关卡建立索引, 之后在Actor生成、销毁、改名以及子关卡流式加载、卸载时增量更新
+UCLASS()
+class LEARNING_API UActorIndexSubsystem : public UWorldSubsystem {
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+
+    // 按名称查找actorClass类型的Actor, 名称区分大小写, 有多个同名Actor时返回其中第一个
+    AActor* FindActorByLabel(const FString& label, const UClass* actorClass = AActor::StaticClass());
+    template <typename T>
+    T* FindActorByLabel(const FString& label) { return static_cast<T*>(FindActorByLabel(label, T::StaticClass())); }
+
+    // 查找带有tag的全部actorClass类型的Actor, 追加到outActors
+    void FindActorsByTag(FName tag, TArray<AActor*>& outActors, const UClass* actorClass = AActor::StaticClass());
+
+    // 重新索引一个Actor. 运行时修改Tags没有事件通知, 修改后需要调用
+    void ReindexActor(AActor* actor);
+
+private:
+    // 一个Actor被索引时使用的名称和Tag, Actor改名或销毁时据此从索引中移除
+    struct FIndexedKeys {
+        FString label;
+        TArray<FName> tags;
+    };
+
+    bool bIndexBuilt = false;
+    TMap<FString, TArray<TWeakObjectPtr<AActor>>> actorsByLabel;
+    TMap<FName, TArray<TWeakObjectPtr<AActor>>> actorsByTag;
+    TMap<const AActor*, FIndexedKeys> indexedActors;
+
+    FDelegateHandle actorSpawnedHandle;
+    FDelegateHandle actorDestroyedHandle;
+    FDelegateHandle actorLabelChangedHandle;
+    FDelegateHandle levelAddedHandle;
+    FDelegateHandle levelRemovedHandle;
+
+    // 遍历一次关卡建立索引
+    void BuildIndex();
+    void AddActor(AActor* actor);
+    void RemoveActor(const AActor* actor);
+
+    void OnActorSpawned(AActor* actor);
+    void OnActorDestroyed(AActor* actor);
+    void OnActorLabelChanged(AActor* actor);
+    void OnLevelAddedToWorld(ULevel* level, UWorld* world);
+    void OnLevelRemovedFromWorld(ULevel* level, UWorld* world);
+};
@@ -4,11 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
-#include <map>
-#include <vector>
+#include "OBJExportJob.h"
 #include "ExportOBJActor.generated.h"
 
-class AStaticMeshActor;
 class UStaticMesh;
 
 UCLASS()
@@ -22,36 +20,58 @@ public:
     UPROPERTY(EditAnywhere, meta = (ToolTip = "导出路径"))
     FString filePathRoot = "D://Default//Desktop//OutputOBJ//";
 
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "导出参数"))
+    FOBJExportOptions exportOptions;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "在后台任务中提取、编码纹理并写出文件, 游戏线程只截取快照; 关闭时整个导出在游戏线程上同步完成"))
+    bool bAsyncExport = true;
+
+    UPROPERTY(VisibleInstanceOnly, meta = (ToolTip = "最近一次导出的统计信息"))
+    FOBJExportStats lastExportStats;
+
+    UPROPERTY(BlueprintAssignable, meta = (ToolTip = "导出完成(成功、失败或被取消)时广播"))
+    FOnOBJExportCompleted onExportCompleted;
+
+    UPROPERTY(BlueprintAssignable, meta = (ToolTip = "导出进度更新时广播"))
+    FOnOBJExportProgress onExportProgress;
+
     AExportOBJActor();
 
     // 将静态网格体导出为OBJ文件
+    UFUNCTION(BlueprintCallable)
     void ExportMeshToOBJ();
+    // 取消正在进行的导出, 完成回调仍会以失败广播
+    UFUNCTION(BlueprintCallable)
+    void CancelExport();
+    UFUNCTION(BlueprintPure)
+    bool IsExporting() const { return currentJob.IsValid(); }
+    // 当前导出的进度, 没有进行中的导出时返回0
+    UFUNCTION(BlueprintPure)
+    float GetExportProgress() const { return currentJob ? currentJob->GetProgress() : 0.0f; }
 
 protected:
+    virtual void PostLoad() override;
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
-    UStaticMesh* meshData;
-    std::vector<FVector3f> outPositions;    // 顶点位置
-    std::vector<FVector3f> outNormals;      // 顶点法线
-    std::vector<FVector2f> outUVs;          // 顶点UV坐标
-    FString mtlName;                        // 只考虑只有一个材质
-    std::map<FString, FString> mtlFiles;    // 但是材质对应的纹理可能有多个, 将其路径保存在mtlFiles映射表里
-
-    // 获取静态网格体的数据
-    void AnalyseStaticMesh();
-    // 从MeshData中获取三角形位置、法线、UV坐标等属性
-    void GetTriangleDataFromMeshData();
-    // 从MeshData中获取STL材质
-    void GetMTLFromMeshData();
-    
+    TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe> currentJob;    // 进行中的导出任务
+
+    // 旧版本逐项保存的导出参数, 只在加载旧关卡时读入(Config/DefaultEngine.ini中重定向), PostLoad时迁移到exportOptions
+    // 初始值为旧版本的默认值
+    UPROPERTY()
+    int32 floatPrecision_DEPRECATED = 4;
+    UPROPERTY()
+    int32 exportThreads_DEPRECATED = 0;
+    UPROPERTY()
+    bool bIndexedExport_DEPRECATED = true;
+    UPROPERTY()
+    float dedupTolerance_DEPRECATED = 1e-5f;
+    UPROPERTY()
+    int32 traceSampleInterval_DEPRECATED = 0;
+
+    // 导出结束(游戏线程): 记录统计信息并广播完成
+    void FinishExport(const TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe>& job, bool bSucceeded);
     // 输出网格体的基础信息: LOD层级数、顶点数、三角形面数
-    void LogBasicData();
-    
-    // 获取纹理信息, 并通过loadpng库导出为png文件
-    FString ExportToPNGFile(TArray<UTexture*> textures);
-    // 导出MTL文件
-    void ExportToMTLFile();
-    // 导出OBJ文件
-    void ExportToOBJFile();
+    void LogBasicData(const UStaticMesh* meshData) const;
 };
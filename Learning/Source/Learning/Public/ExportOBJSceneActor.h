@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "OBJExportJob.h"
+#include "ExportOBJSceneActor.generated.h"
+
+class AStaticMeshActor;
+class UStaticMesh;
+
+// 批量导出全部结束(包括被取消)时在游戏线程上广播
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnOBJSceneExportCompleted, int32, numSucceeded, int32, numFailed);
+
+// 场景批量导出: 按名称、Tag或整个关卡收集静态网格体Actor, 每个静态网格体资源只导出一次
+// 各网格体的导出任务共享后台线程池并发执行, 同时进行的任务数由maxConcurrentJobs限制
+UCLASS()
+class LEARNING_API AExportOBJSceneActor : public AActor {
+    GENERATED_BODY()
+
+public:
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "待导出的Mesh在场景中的名称"))
+    TArray<FString> meshNames;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "带有其中任一Tag的静态网格体Actor都会导出"))
+    TArray<FName> actorTags;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "导出关卡中全部静态网格体Actor, 开启时忽略meshNames和actorTags"))
+    bool bExportWholeLevel = false;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "导出路径, 每个静态网格体资源以资源名称命名OBJ和MTL文件"))
+    FString filePathRoot = "D://Default//Desktop//OutputOBJ//";
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "同时进行的导出任务数, 0表示后台线程池的线程数. 任务在游戏线程上截取快照, 限制任务数也限制了快照占用的内存", ClampMin = "0"))
+    int32 maxConcurrentJobs = 0;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "导出参数. 多个网格体已经并发导出, 因此默认每个任务单线程格式化OBJ文本"))
+    FOBJExportOptions exportOptions;
+
+    UPROPERTY(VisibleInstanceOnly, meta = (ToolTip = "最近一次批量导出中每个网格体资源的统计信息"))
+    TMap<FString, FOBJExportStats> lastExportStats;
+
+    UPROPERTY(BlueprintAssignable, meta = (ToolTip = "批量导出全部结束时广播"))
+    FOnOBJSceneExportCompleted onExportCompleted;
+
+    UPROPERTY(BlueprintAssignable, meta = (ToolTip = "批量导出进度更新时广播"))
+    FOnOBJExportProgress onExportProgress;
+
+    AExportOBJSceneActor();
+
+    // 收集静态网格体Actor并批量导出
+    UFUNCTION(BlueprintCallable)
+    void ExportSceneToOBJ();
+    // 取消批量导出: 未开始的网格体不再导出, 进行中的任务被取消
+    UFUNCTION(BlueprintCallable)
+    void CancelExport();
+    UFUNCTION(BlueprintPure)
+    bool IsExporting() const { return runningJobs.Num() > 0 || nextPendingMesh < pendingMeshes.Num(); }
+    // 最近一次批量导出的总进度, 尚未开始导出时返回0
+    UFUNCTION(BlueprintPure)
+    float GetExportProgress() const;
+
+protected:
+    virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+    // 待导出的静态网格体资源及其输出文件名
+    struct FPendingMesh {
+        TWeakObjectPtr<UStaticMesh> mesh;
+        FString name;
+    };
+
+    TArray<FPendingMesh> pendingMeshes;                                     // 去重后的全部静态网格体资源
+    int32 nextPendingMesh = 0;                                              // 下一个要启动的任务
+    TArray<TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe>> runningJobs;     // 进行中的导出任务
+    TSet<FString> exportedTextures;                                         // 已结束的任务写出的纹理, 之后启动的任务不再重复截取和写出
+    int32 numSucceeded = 0;
+    int32 numFailed = 0;
+
+    // 收集本次导出的静态网格体Actor
+    void CollectActors(TArray<AStaticMeshActor*>& outActors) const;
+    // 收集静态网格体Actor, 按静态网格体资源去重
+    void CollectMeshes();
+    // 启动任务直到达到并发上限(游戏线程)
+    void LaunchPendingJobs();
+    // 单个任务结束(游戏线程): 记录统计信息, 启动下一个任务
+    void FinishJob(const TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe>& job, bool bSucceeded);
+};
@@ -8,6 +8,10 @@
 #include "ImportOBJActor.generated.h"
 
 class FMeshDescriptionBuilder;
+namespace tinyobj {
+struct shape_t;
+struct indexed_mesh_t;
+}
 
 UCLASS()
 class LEARNING_API AImportOBJActor : public AActor {
@@ -28,6 +32,27 @@ public:
     UPROPERTY(EditAnywhere, meta = (ToolTip = "材质资产路径"))
     FString materialPath = "Material '/Game/BasicTexture.BasicTexture'";
 
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "是否使用二进制解析缓存(OBJ文件旁的 .tobjcache 文件)"))
+    bool bUseParseCache = true;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "忽略已有的解析缓存, 重新解析OBJ文件并重写缓存"))
+    bool bRebuildParseCache = false;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "解析后将顶点属性量化存储(法线16位八面体编码, UV半精度, 颜色8位), 约节省一半内存(转换期间两种格式同时存在, 峰值内存不降低)"))
+    bool bCompactAttributes = false;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "只导入这些名称的图元组(OBJ中的 o/g), 为空时导入全部. 通过 OBJ文件旁的 .tobjindex 索引只解析选中的部分"))
+    TArray<FString> ShapeNames;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "按平滑组(s)为没有法线(vn)的面生成顶点法线(按面积与角度加权, 多线程)"))
+    bool bGenerateNormals = true;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "在导入时生成切线(与 MikkTSpace 兼容, 多线程), 构建网格体时直接使用, 需要法线与UV"))
+    bool bGenerateTangents = true;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "在导入时按顶点缓存重排三角面(Forsyth 算法), 并按首次使用顺序重排顶点实例, 日志中输出优化前后的 ACMR/ATVR"))
+    bool bOptimizeVertexCache = true;
+
     // 静态网格体组件
     UPROPERTY(VisibleAnywhere)
     UStaticMeshComponent* _mesh;
@@ -45,13 +70,6 @@ private:
         TArray<FVertexID> vertexIDs;        // 顶点ID
         FPolygonGroupID polygonGroup;       // 多边形组
     };
-    // 三角形顶点实例数据
-    struct TriangleVertex {
-        int vertexIndex;    // 顶点编号
-        FVector normal;     // 顶点法线
-        FVector2D UV;       // 顶点UV贴图
-        FVector4f Color = FVector4f(1.0f, 1.0f, 1.0f, 1.0f); // 顶点颜色
-    };
 
     // 映射: 多边形组 => 材质名称
     std::map<FPolygonGroupID, std::string> _materialIdMap;
@@ -63,6 +81,6 @@ private:
     UStaticMesh* CreateMeshDataFromFile(const FString& baseDir, const FString& file);
     // 读取磁盘上的PNG图片, 创建纹理
     UTexture2D* CreateTexture(const FString& baseDir, const FString& file);
-    // 向几何体中添加三角面信息
-    void AddTriangleData(GlobalData& globalData, const TriangleVertex& v1, const TriangleVertex& v2, const TriangleVertex& v3);
+    // 向几何体中添加去重后的顶点实例与三角面信息
+    void AddIndexedMeshData(GlobalData& globalData, const tinyobj::shape_t& shape, const tinyobj::indexed_mesh_t& indexedMesh);
 };
@@ -8,6 +8,13 @@
 #include "ImportOBJNoMTLActor.generated.h"
 
 class FMeshDescriptionBuilder;
+namespace tinyobj {
+class attrib_accessor_t;
+class ObjIncrementalReader;
+struct shape_t;
+struct indexed_mesh_t;
+struct meshlets_t;
+}
 
 UCLASS()
 class LEARNING_API AImportOBJNoMTLActor : public AActor {
@@ -28,6 +35,36 @@ public:
     UPROPERTY(EditAnywhere, meta = (ToolTip = "材质资产路径"))
     FString materialPath = "Material '/Game/BasicTexture.BasicTexture'";
 
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "解析后将顶点属性量化存储(法线16位八面体编码, UV半精度, 颜色8位), 约节省一半内存(转换期间两种格式同时存在, 峰值内存不降低)"))
+    bool bCompactAttributes = false;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "实时预览: 定期检查OBJ文件, 只解析新追加的内容并重建网格体(文件前部被修改时完整重新解析). 开启后不使用紧凑顶点属性"))
+    bool bLivePreview = false;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "实时预览检查文件的间隔(秒)", EditCondition = "bLivePreview"))
+    float PreviewInterval = 1.0f;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "按平滑组(s)为没有法线(vn)的面生成顶点法线(按面积与角度加权, 多线程), 实时预览时不生成"))
+    bool bGenerateNormals = true;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "在导入时生成切线(与 MikkTSpace 兼容, 多线程), 构建网格体时直接使用, 需要法线与UV"))
+    bool bGenerateTangents = true;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "在导入时按顶点缓存重排三角面(Forsyth 算法), 并按首次使用顺序重排顶点实例, 日志中输出优化前后的 ACMR/ATVR"))
+    bool bOptimizeVertexCache = true;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "自动生成的 LOD 链: 每级相对 LOD0 保留的三角面比例(二次误差度量简化, 多线程, 保留UV接缝与材质边界). 为空时只有 LOD0, 实时预览时不生成"))
+    TArray<float> LODTriangleRatios = {0.5f, 0.25f, 0.125f};
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "将 LOD0 划分为 meshlet(顶点数与三角面数有上限的簇, 附带包围球与法线锥), 供剔除与按簇并行处理"))
+    bool bBuildMeshlets = false;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "每个 meshlet 的最大顶点数(3~255)", EditCondition = "bBuildMeshlets", ClampMin = "3", ClampMax = "255"))
+    int32 MeshletMaxVertices = 64;
+
+    UPROPERTY(EditAnywhere, meta = (ToolTip = "每个 meshlet 的最大三角面数(1~512)", EditCondition = "bBuildMeshlets", ClampMin = "1", ClampMax = "512"))
+    int32 MeshletMaxTriangles = 124;
+
     UPROPERTY(EditAnywhere, meta = (ToolTip = "初始位置"))
     FVector Location = FVector(0.0f, 0.0f, 100.0f);
 
@@ -50,22 +87,25 @@ public:
         TArray<FVertexID> vertexIDs;       // 顶点ID
         FPolygonGroupID polygonGroup;      // 多边形组
     };
-    // 三角形顶点实例数据
-    struct TriangleVertex {
-        int vertexIndex;                                      // 顶点编号
-        FVector normal  = FVector(0.0f, 0.0f, 0.0f);          // 顶点法线
-        FVector2D UV    = FVector2D(0.0f, 0.0f);              // 顶点UV贴图
-        FVector4f Color = FVector4f(1.0f, 1.0f, 1.0f, 1.0f);  // 顶点颜色
-    };
 
     // 映射: 多边形组 => 材质名称
     std::map<FPolygonGroupID, std::string> _materialIdMap;
     // 映射: 材质名称 => 材质实例
     std::map<std::string, UMaterialInstanceDynamic*> _materialMap;
+    // 每个多边形组 LOD0 的 meshlet(顶点索引即该组的顶点实例顺序), 未生成时为空
+    TArray<TSharedPtr<tinyobj::meshlets_t>> _meshlets;
 
 private:
+    // 实时预览: 保存解析进度(检查点)的增量读取器
+    TSharedPtr<tinyobj::ObjIncrementalReader> _objReader;
+    // 实时预览: 距上次检查文件经过的时间, 以及上次读取时的文件大小与修改时间
+    float _previewElapsed = 0.0f;
+    int64 _previewFileSize = -1;
+    FDateTime _previewTimeStamp;
+
     // 创建网格体数据
     UStaticMesh* CreateMeshDataFromFile(const FString& baseDir, const FString& file);
-    // 向几何体中添加三角面信息
-    void AddTriangleData(GlobalData& globalData, const TriangleVertex& v1, const TriangleVertex& v2, const TriangleVertex& v3);
+    // 向几何体中添加去重后的顶点实例与三角面信息
+    void AddIndexedMeshData(GlobalData& globalData, const tinyobj::attrib_accessor_t& attrib, const tinyobj::shape_t& shape,
+        const tinyobj::indexed_mesh_t& indexedMesh);
 };
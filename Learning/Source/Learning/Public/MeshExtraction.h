@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FMeshDescription;
+
+// 从FMeshDescription批量提取的三角形数据, 供各种导出器使用
+// 属性数组直接引用网格体描述的原始存储(不复制), 网格体描述被修改或释放后失效
+struct LEARNING_API FMeshExtractionResult {
+    TArrayView<const FVector3f> positions;      // 顶点位置, 以FVertexID为下标
+    TArrayView<const FVector3f> normals;        // 顶点实例法线, 以FVertexInstanceID为下标
+    TArrayView<const FVector2f> uvs;            // 顶点实例第0套UV, 以FVertexInstanceID为下标
+    TArray<int32> cornerVertices;               // 每个三角形顶点的FVertexID, 每3个一个三角形
+    TArray<int32> cornerInstances;              // 每个三角形顶点的FVertexInstanceID
+    TArray<int32> polygonGroupTriangles;        // 以FPolygonGroupID为下标, 第i组的三角形为[polygonGroupTriangles[i], polygonGroupTriangles[i + 1])
+    int32 numPolygons = 0;
+
+    int32 NumTriangles() const { return cornerInstances.Num() / 3; }
+};
+
+namespace MeshExtraction {
+    // 批量提取三角形: 按多边形组顺序, 组内按多边形顺序写入每个多边形的三角形顶点, 与原先的导出顺序一致
+    // 不为单个多边形、三角形或顶点实例分配容器, 也不逐个调用GetAttribute. 缺少位置、法线或UV属性时返回false
+    LEARNING_API bool ExtractTriangles(const FMeshDescription& description, FMeshExtractionResult& result);
+}
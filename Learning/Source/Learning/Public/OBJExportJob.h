@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshDescription.h"
+#include <atomic>
+#include <map>
+#include <vector>
+#include "OBJExportJob.generated.h"
+
+class UStaticMesh;
+class UTexture;
+
+// 一次导出的统计信息: 热循环中只累加计数, 导出结束后一次性输出汇总
+USTRUCT(BlueprintType)
+struct LEARNING_API FOBJExportStats {
+    GENERATED_BODY()
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "多边形组数量"))
+    int32 polygonGroups = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "多边形数量"))
+    int32 polygons = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "三角形数量"))
+    int32 triangles = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "写出的顶点位置(v)数量"))
+    int32 positions = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "写出的法线(vn)数量"))
+    int32 normals = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "写出的UV(vt)数量"))
+    int32 uvs = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "导出的纹理数量"))
+    int32 textures = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "OBJ文件字节数"))
+    int64 objBytes = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "MTL文件字节数"))
+    int64 mtlBytes = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "PNG纹理文件总字节数"))
+    int64 pngBytes = 0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "在游戏线程上截取网格体描述、材质和纹理像素快照的耗时(秒), 即导出占用游戏线程的时间"))
+    double snapshotSeconds = 0.0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "提取三角形数据的耗时(秒)"))
+    double extractSeconds = 0.0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "编码并写出PNG纹理的耗时(秒)"))
+    double materialSeconds = 0.0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "写出MTL文件的耗时(秒)"))
+    double writeMTLSeconds = 0.0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "写出OBJ文件的耗时(秒)"))
+    double writeOBJSeconds = 0.0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "导出总耗时(秒), 包括快照和后台任务"))
+    double totalSeconds = 0.0;
+
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (ToolTip = "按采样间隔输出的逐元素调试日志条数"))
+    int32 tracedElements = 0;
+};
+
+// 导出参数
+USTRUCT(BlueprintType)
+struct LEARNING_API FOBJExportOptions {
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "导出浮点数时保留的小数位数(最多9位), 小于0时输出能够精确还原的最短表示", ClampMax = "9"))
+    int32 floatPrecision = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "格式化OBJ文本时使用的线程数, 0表示使用全部硬件线程, 1表示单线程", ClampMin = "0"))
+    int32 exportThreads = 0;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "按索引导出: 顶点位置按FVertexID共享, 法线和UV在容差内去重(有损), 三角面写出共享的索引; 关闭时(默认)每个三角形顶点单独写出"))
+    bool bIndexedExport = false;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "按索引导出时法线和UV去重的量化容差, 为0时只合并完全相同的值", EditCondition = "bIndexedExport", ClampMin = "0"))
+    float dedupTolerance = 1e-5f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ToolTip = "逐三角形调试日志的采样间隔: 0为关闭, 1为每个三角形都输出, N为每N个三角形输出一条", ClampMin = "0"))
+    int32 traceSampleInterval = 0;
+};
+
+// 导出完成(成功、失败或被取消)时在游戏线程上广播
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnOBJExportCompleted, bool, bSucceeded, const FOBJExportStats&, stats);
+// 导出进度更新时在游戏线程上广播, 进度为[0, 1]
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnOBJExportProgress, float, progress);
+
+// 一个静态网格体的OBJ导出任务
+// Create在游戏线程上截取网格体描述、材质和纹理像素的快照, 之后Run可以在任意线程上执行提取、PNG编码、格式化和写文件
+// 任务不引用任何UObject, 发起导出的Actor被销毁后任务仍可安全地运行完
+class LEARNING_API FOBJExportJob {
+public:
+    // 进度回调, 在执行Run的线程上调用, 参数为[0, 1]的进度
+    using FProgressCallback = TFunction<void(float)>;
+
+    // 截取快照(只能在游戏线程调用). 网格体没有网格体描述时返回nullptr
+    // skipTextures不为空时, 其中的纹理(由之前结束的任务写出, 见GetWrittenTextures)只在MTL中引用而不再截取和写出
+    static TSharedPtr<FOBJExportJob, ESPMode::ThreadSafe> Create(UStaticMesh* mesh, const FString& jobName, const FString& outputRoot,
+        const FOBJExportOptions& exportOptions, const TSet<FString>* skipTextures = nullptr);
+
+    // 执行导出, 成功写出MTL和OBJ文件时返回true, 失败或被取消时返回false
+    bool Run();
+    // 请求取消: Run在阶段之间和写出OBJ的分段之间检查, 取消后删除写了一半的OBJ文件
+    // 任务不引用发起导出的Actor, Actor结束时只需请求取消, 不必等待任务结束
+    void Cancel() { bCancelled = true; }
+    bool IsCancelled() const { return bCancelled; }
+    float GetProgress() const { return progress; }
+    // 设置进度回调, 需要在Run之前调用. 回调不在游戏线程上时, 广播委托前应先转到游戏线程
+    void SetProgressCallback(FProgressCallback callback) { progressCallback = MoveTemp(callback); }
+
+    const FString& GetName() const { return name; }
+    // Run结束后的统计信息
+    const FOBJExportStats& GetStats() const { return stats; }
+    // Run结束后成功写出的PNG纹理(不含扩展名的路径)
+    const TArray<FString>& GetWrittenTextures() const { return writtenTextures; }
+    // 输出统计信息汇总
+    void LogStats() const;
+
+private:
+    // 快照中的一张纹理: 像素已经转换为RGBA8, 在Run中编码为PNG
+    struct FTextureImage {
+        FString filePath;
+        int32 width = 0;
+        int32 height = 0;
+        std::vector<unsigned char> rgba;
+    };
+
+    FString name;
+    FString filePathRoot;
+    FOBJExportOptions options;
+    FMeshDescription meshDescription;       // 网格体描述的副本, 后台提取不再访问UStaticMesh
+    FString mtlName;                        // 只考虑只有一个材质
+    std::map<FString, FString> mtlFiles;    // 但是材质对应的纹理可能有多个, 将其路径保存在mtlFiles映射表里
+    TArray<FTextureImage> textures;
+    TArray<FString> writtenTextures;
+    double createTime = 0.0;
+
+    std::vector<FVector3f> outPositions;    // 顶点位置
+    std::vector<FVector3f> outNormals;      // 顶点法线
+    std::vector<FVector2f> outUVs;          // 顶点UV坐标
+    std::vector<int> outPositionIndices;    // 按索引导出时每个三角形顶点的位置、UV、法线索引(从1开始)
+    std::vector<int> outUVIndices;
+    std::vector<int> outNormalIndices;
+
+    FOBJExportStats stats;
+    std::atomic<bool> bCancelled{false};
+    std::atomic<float> progress{0.0f};
+    FProgressCallback progressCallback;
+
+    // 游戏线程: 记录材质名称, 并截取BaseColor和Normal纹理的像素
+    void SnapshotMaterials(UStaticMesh* mesh, const TSet<FString>* skipTextures);
+    // 游戏线程: 截取纹理像素, 返回MTL中引用的PNG文件名(只考虑了一张纹理)
+    FString SnapshotTextures(const TArray<UTexture*>& textureObjects, const TSet<FString>* skipTextures);
+
+    // 从网格体描述中获取三角形位置、法线、UV坐标等属性
+    bool ExtractTriangles();
+    // 通过lodepng库编码并写出PNG文件, 先写入临时文件再替换, 并发写出同一张纹理的任务不会写出残缺的文件
+    void ExportToPNGFiles();
+    // 导出MTL文件
+    bool ExportToMTLFile();
+    // 导出OBJ文件
+    bool ExportToOBJFile();
+
+    void SetProgress(float value);
+};
@@ -382,6 +382,61 @@ struct shape_t {
     points_t points;
 };
 
+// Welded vertex layout of a shape's faces(see `BuildIndexedMesh`).
+// Each unique (v, vn, vt) triple becomes one interleaved vertex.
+struct indexed_mesh_t {
+    // Interleaved vertex attributes, `vertex_stride` values per vertex:
+    // position xyz, then normal xyz(when `normal_offset` >= 0), then
+    // texcoord uv(when `texcoord_offset` >= 0).
+    std::vector<real_t> vertices;
+    int vertex_stride;
+    int normal_offset;    // -1 = the shape has no normals
+    int texcoord_offset;  // -1 = the shape has no texcoords
+
+    // Indices into `attrib_t` each vertex was built from.
+    // (e.g. to look up `attrib_t::colors` or skin weights)
+    std::vector<index_t> vertex_sources;
+
+    // 32-bit vertex index of each face corner. Same order as
+    // `mesh_t::indices`, so `mesh_t::num_face_vertices` applies.
+    std::vector<unsigned int> indices;
+
+    // Tangent of each vertex(`GenerateTangents`), 4 values per vertex:
+    // tangent xyz and the bitangent sign w(+1 or -1). Empty until generated.
+    std::vector<real_t> tangents;
+
+    indexed_mesh_t() : vertex_stride(3), normal_offset(-1), texcoord_offset(-1) {}
+
+    size_t num_vertices() const { return vertex_sources.size(); }
+};
+
+// Bounded cluster of a welded triangle mesh(see `BuildMeshlets`).
+struct meshlet_t {
+    unsigned int vertex_offset;    // first entry in `meshlets_t::vertices`
+    unsigned int triangle_offset;  // first entry in `meshlets_t::triangles`(3 per triangle)
+    unsigned int vertex_count;
+    unsigned int triangle_count;
+
+    // Bounding sphere.
+    float center[3];
+    float radius;
+
+    // Normal cone. All triangles face away from a camera at `eye` when
+    // dot(normalize(cone_apex - eye), cone_axis) >= cone_cutoff.
+    // cone_cutoff is 1 when the triangles spread over too wide an angle.
+    float cone_apex[3];
+    float cone_axis[3];
+    float cone_cutoff;
+};
+
+struct meshlets_t {
+    std::vector<meshlet_t> meshlets;
+    // Welded vertex(`indexed_mesh_t`) of each meshlet vertex.
+    std::vector<unsigned int> vertices;
+    // Meshlet-local vertex index of each triangle corner.
+    std::vector<unsigned char> triangles;
+};
+
 // Vertex attributes
 struct attrib_t {
     std::vector<real_t> vertices;  // 'v'(xyz)
@@ -416,6 +471,60 @@ struct attrib_t {
     const std::vector<real_t>& GetVertexWeights() const { return vertex_weights; }
 };
 
+// Quantized vertex attributes(see `CompactAttrib`).
+// Positions keep full precision. Normals are octahedral encoded into two
+// snorm16 values(direction only), texcoords are stored as half floats and
+// colors as unorm8.
+struct compact_attrib_t {
+    std::vector<real_t> vertices;           // 'v'(xyz)
+    std::vector<short> normals;             // 'vn', 2 x snorm16 octahedral
+    std::vector<unsigned short> texcoords;  // 'vt'(uv), 2 x half float
+
+    // extension: vertex colors, 3 x unorm8.
+    // Empty when the .obj has no vertex colors.
+    std::vector<unsigned char> colors;
+
+    compact_attrib_t() {}
+
+    size_t num_vertices() const { return vertices.size() / 3; }
+    size_t num_normals() const { return normals.size() / 2; }
+    size_t num_texcoords() const { return texcoords.size() / 2; }
+    bool has_colors() const { return !colors.empty(); }
+};
+
+///
+/// Read-only view of either `attrib_t` or `compact_attrib_t`.
+/// Decodes quantized values on access, so code reading vertex data through
+/// it works with both layouts.
+///
+class attrib_accessor_t {
+public:
+    attrib_accessor_t(const attrib_t& attrib) : attrib_(&attrib), compact_(NULL) {}
+    attrib_accessor_t(const compact_attrib_t& compact) : attrib_(NULL), compact_(&compact) {}
+
+    bool compact() const { return compact_ != NULL; }
+
+    size_t num_vertices() const;
+    size_t num_normals() const;
+    size_t num_texcoords() const;
+
+    /// True when per vertex colors are stored.
+    bool has_colors() const;
+
+    /// xyz of vertex `i`.
+    void GetVertex(size_t i, real_t* xyz) const;
+    /// xyz of normal `i`.
+    void GetNormal(size_t i, real_t* xyz) const;
+    /// uv of texcoord `i`.
+    void GetTexcoord(size_t i, real_t* uv) const;
+    /// rgb of vertex `i`. White when the vertex has no color.
+    void GetColor(size_t i, real_t* rgb) const;
+
+private:
+    const attrib_t* attrib_;
+    const compact_attrib_t* compact_;
+};
+
 struct callback_t {
     // W is optional and set to 1 if there is no `w` item in `v` line
     void (*vertex_cb)(void* user_data, real_t x, real_t y, real_t z, real_t w);
@@ -445,6 +554,43 @@ struct callback_t {
           group_cb(NULL), object_cb(NULL) {}
 };
 
+///
+/// Batched variant of `callback_t`.
+/// `v`, `vn`, `vt` and `f` lines are buffered and passed as contiguous spans
+/// of up to `batch_size` elements per call, instead of one call per element.
+/// Elements of each kind are passed in file order. All pending vertices,
+/// normals and texcoords are passed before a span of faces, and all pending
+/// elements are passed before `usemtl_cb`, `mtllib_cb`, `group_cb` and
+/// `object_cb`.
+///
+struct batch_callback_t {
+    // Maximum number of elements per call.
+    size_t batch_size;
+
+    // `vertices` = xyz, `colors` = rgb(1.0 if there is no color in `v` line).
+    void (*vertices_cb)(void* user_data, const real_t* vertices, const real_t* colors, size_t num_vertices);
+    // `normals` = xyz
+    void (*normals_cb)(void* user_data, const real_t* normals, size_t num_normals);
+    // `texcoords` = uvw(v and w are set to 0 if missing in `vt` line)
+    void (*texcoords_cb)(void* user_data, const real_t* texcoords, size_t num_texcoords);
+
+    // `num_face_vertices[i]` indices of face i follow those of face i-1 in
+    // `indices`.
+    // Indices are resolved to 0-based absolute indices. -1 will be passed for
+    // undefined(or out of range relative) index in index_t members.
+    void (*faces_cb)(void* user_data, const index_t* indices, const unsigned int* num_face_vertices, size_t num_faces);
+
+    // Same as `callback_t`.
+    void (*usemtl_cb)(void* user_data, const char* name, int material_id);
+    void (*mtllib_cb)(void* user_data, const material_t* materials, int num_materials);
+    void (*group_cb)(void* user_data, const char** names, int num_names);
+    void (*object_cb)(void* user_data, const char* name);
+
+    batch_callback_t()
+        : batch_size(4096), vertices_cb(NULL), normals_cb(NULL), texcoords_cb(NULL), faces_cb(NULL), usemtl_cb(NULL), mtllib_cb(NULL),
+          group_cb(NULL), object_cb(NULL) {}
+};
+
 class MaterialReader {
 public:
     MaterialReader() {}
@@ -454,21 +600,56 @@ public:
         std::string* warn, std::string* err) = 0;
 };
 
+///
+/// Enables the process-wide .mtl cache for every `MaterialFileReader`
+/// constructed afterwards without an explicit `use_cache`, including those of
+/// `LoadObj`, `LoadObjParallel` and `ObjReader`. Default = disabled(thread safe).
+///
+void SetMaterialFileCacheEnabled(bool enabled);
+
+bool IsMaterialFileCacheEnabled();
+
 ///
 /// Read .mtl from a file.
+/// With the cache, parsed .mtl files are shared through a process-wide cache
+/// keyed by path and checked against the file content(size and hash), so a
+/// material library referenced by many .obj files is parsed once.
 ///
 class MaterialFileReader : public MaterialReader {
 public:
     // Path could contain separator(';' in Windows, ':' in Posix)
-    explicit MaterialFileReader(const std::string& mtl_basedir) : m_mtlBaseDir(mtl_basedir) {}
+    // Uses the cache when `SetMaterialFileCacheEnabled(true)` was called.
+    explicit MaterialFileReader(const std::string& mtl_basedir)
+        : m_mtlBaseDir(mtl_basedir), m_useCache(IsMaterialFileCacheEnabled()) {}
+    // `use_cache` = false always parses the .mtl file.
+    MaterialFileReader(const std::string& mtl_basedir, bool use_cache) : m_mtlBaseDir(mtl_basedir), m_useCache(use_cache) {}
     virtual ~MaterialFileReader() TINYOBJ_OVERRIDE {}
     virtual bool operator()(const std::string& matId, std::vector<material_t>* materials, std::map<std::string, int>* matMap,
         std::string* warn, std::string* err) TINYOBJ_OVERRIDE;
 
 private:
     std::string m_mtlBaseDir;
+    bool m_useCache;
+};
+
+///
+/// Statistics of the process-wide .mtl cache of `MaterialFileReader`.
+///
+struct MaterialFileCacheStats {
+    size_t hits;         // loads served from the cache
+    size_t misses;       // loads which parsed the .mtl file
+    size_t num_entries;  // cached .mtl files
+
+    MaterialFileCacheStats() : hits(0), misses(0), num_entries(0) {}
 };
 
+///
+/// Drops all entries of the process-wide .mtl cache(thread safe).
+///
+void ClearMaterialFileCache();
+
+MaterialFileCacheStats GetMaterialFileCacheStats();
+
 ///
 /// Read .mtl from a stream.
 ///
@@ -483,6 +664,75 @@ private:
     std::istream& m_inStream;
 };
 
+///
+/// Bump allocator for the temporary containers of a parse(per-face index
+/// arrays and the face/line/points groups).
+/// Memory is taken from large blocks and is only given back by `Reset` or
+/// `Release`, which turns millions of small heap allocations and frees into
+/// a few block allocations. The parsed result(`attrib_t`, `shape_t`, ...)
+/// does not refer to the arena.
+/// Not thread safe. An arena can be reused across loads: `Reset` keeps the
+/// largest block, so a following parse of a similar file mostly runs without
+/// heap allocations.
+///
+class ParseArena {
+public:
+    explicit ParseArena(size_t block_size = 1024 * 1024);
+    ~ParseArena();
+
+    ///
+    /// Returns `size` bytes aligned to `alignment`(power of two).
+    ///
+    void* Allocate(size_t size, size_t alignment);
+
+    ///
+    /// Gives back the most recent allocation or a dedicated block of a large
+    /// allocation. Other memory is reclaimed by `Reset`/`Release`.
+    ///
+    void Deallocate(void* ptr, size_t size);
+
+    ///
+    /// Releases all allocations at once. Keeps the largest block for reuse.
+    ///
+    void Reset();
+
+    ///
+    /// Releases all allocations and frees all blocks.
+    ///
+    void Release();
+
+    /// Number of `Allocate` calls since the last `Reset`/`Release`.
+    size_t NumAllocations() const { return num_allocations_; }
+
+    /// Number of heap blocks allocated since the last `Reset`/`Release`.
+    size_t NumBlockAllocations() const { return num_block_allocations_; }
+
+    /// Bytes of all blocks currently held.
+    size_t BytesReserved() const { return bytes_reserved_; }
+
+private:
+    ParseArena(const ParseArena&);
+    ParseArena& operator=(const ParseArena&);
+
+    struct block_t {
+        block_t* next;
+        size_t size;  // including this header
+        bool dedicated;
+    };
+
+    block_t* NewBlock(size_t size, bool dedicated);
+
+    block_t* blocks_;  // current block first
+    char* cur_;
+    char* end_;
+    char* last_;  // most recent allocation
+    size_t block_size_;
+    size_t next_block_size_;
+    size_t num_allocations_;
+    size_t num_block_allocations_;
+    size_t bytes_reserved_;
+};
+
 // v2 API
 struct ObjReaderConfig {
     bool triangulate;  // triangulate polygon?
@@ -505,7 +755,88 @@ struct ObjReaderConfig {
     ///
     std::string mtl_search_path;
 
-    ObjReaderConfig() : triangulate(true), triangulation_method("simple"), vertex_color(true) {}
+    ///
+    /// Number of threads used by `ParseFromFile`.
+    /// 1 = single threaded `LoadObj`(default)
+    /// 0 = use all hardware threads(`LoadObjParallel`)
+    ///
+    unsigned int num_threads;
+
+    ///
+    /// Build a welded, interleaved vertex buffer and a 32-bit index buffer
+    /// for each shape(`ObjReader::GetIndexedMeshes`).
+    /// Default = false
+    ///
+    bool indexed_vertices;
+
+    ///
+    /// Arena for the temporary containers of the parse(optional).
+    /// NULL = use the heap.
+    ///
+    ParseArena* arena;
+
+    ///
+    /// Convert the parsed attributes to `compact_attrib_t`
+    /// (`ObjReader::GetCompactAttrib`). `GetAttrib` is empty in this mode.
+    /// Vertex colors are kept only when every vertex has one(no white
+    /// fallback). The conversion runs after the parse, so this lowers the
+    /// memory held afterwards, not the peak: `attrib_t` is built first and
+    /// both layouts exist during the conversion.
+    /// Default = false
+    ///
+    bool compact_attrib;
+
+    ///
+    /// Generate normals from the smoothing groups for corners without a
+    /// normal(`GenerateSmoothingGroupNormals`).
+    /// Default = false
+    ///
+    bool generate_normals;
+
+    ObjReaderConfig()
+        : triangulate(true), triangulation_method("simple"), vertex_color(true), num_threads(1), indexed_vertices(false), arena(NULL),
+          compact_attrib(false), generate_normals(false) {}
+};
+
+///
+/// Binary parse cache configuration for `LoadObjCached`.
+///
+struct ObjCacheConfig {
+    ///
+    /// Path of the cache file.
+    /// Default = "" = `<obj filename>.tobjcache`
+    ///
+    std::string cache_filename;
+
+    ///
+    /// Ignore an existing cache, parse the .obj and rewrite the cache.
+    ///
+    bool rebuild;
+
+    ///
+    /// Write the cache after parsing when it was missing or stale.
+    ///
+    bool write_cache;
+
+    ///
+    /// Hash the .obj content on a warm load and compare it with the cache.
+    /// false = trust file size and modification time only(faster).
+    ///
+    bool verify_content_hash;
+
+    ///
+    /// Number of threads used when the .obj has to be parsed.
+    /// 0 = use all hardware threads.
+    ///
+    unsigned int num_threads;
+
+    ///
+    /// Arena for the temporary containers when the .obj has to be parsed
+    /// (optional). NULL = use the heap.
+    ///
+    ParseArena* arena;
+
+    ObjCacheConfig() : rebuild(false), write_cache(true), verify_content_hash(true), num_threads(0), arena(NULL) {}
 };
 
 ///
@@ -541,10 +872,21 @@ public:
 
     const attrib_t& GetAttrib() const { return attrib_; }
 
+    ///
+    /// Quantized attributes. Empty unless `ObjReaderConfig::compact_attrib` is set.
+    ///
+    const compact_attrib_t& GetCompactAttrib() const { return compact_attrib_; }
+
     const std::vector<shape_t>& GetShapes() const { return shapes_; }
 
     const std::vector<material_t>& GetMaterials() const { return materials_; }
 
+    ///
+    /// Welded vertex layout of each shape(same order as `GetShapes`).
+    /// Empty unless `ObjReaderConfig::indexed_vertices` is set.
+    ///
+    const std::vector<indexed_mesh_t>& GetIndexedMeshes() const { return indexed_meshes_; }
+
     ///
     /// Warning message(may be filled after `Load` or `Parse`)
     ///
@@ -559,2694 +901,8544 @@ private:
     bool valid_;
 
     attrib_t attrib_;
+    compact_attrib_t compact_attrib_;
     std::vector<shape_t> shapes_;
     std::vector<material_t> materials_;
+    std::vector<indexed_mesh_t> indexed_meshes_;
 
     std::string warning_;
     std::string error_;
 };
 
-/// ==>>========= Legacy v1 API =============================================
+///
+/// Streaming .obj reader configuration.
+///
+struct ObjStreamReaderConfig {
+    ///
+    /// Maximum number of elements(`v`, `vn`, `vt` and `f` lines) per batch.
+    ///
+    size_t batch_size;
 
-/// Loads .obj from a file.
-/// 'attrib', 'shapes' and 'materials' will be filled with parsed shape data
-/// 'shapes' will be filled with parsed shape data
-/// Returns true when loading .obj become success.
-/// Returns warning message into `warn`, and error message into `err`
-/// 'mtl_basedir' is optional, and used for base directory for .mtl file.
-/// In default(`NULL'), .mtl file is searched from an application's working
-/// directory.
-/// 'triangulate' is optional, and used whether triangulate polygon face in .obj
-/// or not.
-/// Option 'default_vcols_fallback' specifies whether vertex colors should
-/// always be defined, even if no colors are given (fallback to white).
-bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
-    const char* filename, const char* mtl_basedir = NULL, bool triangulate = true, bool default_vcols_fallback = true);
+    ///
+    /// Upper bound of the memory used by the arrays of a batch in bytes.
+    /// A batch is handed out early when it reaches this size, so the peak
+    /// memory of the reader is about one batch. 0 = no limit.
+    ///
+    size_t max_batch_bytes;
 
-/// Loads .obj from a file with custom user callback.
-/// .mtl is loaded as usual and parsed material_t data will be passed to
-/// `callback.mtllib_cb`.
-/// Returns true when loading .obj/.mtl become success.
-/// Returns warning message into `warn`, and error message into `err`
-/// See `examples/callback_api/` for how to use this function.
-bool LoadObjWithCallback(std::istream& inStream, const callback_t& callback, void* user_data = NULL, MaterialReader* readMatFn = NULL,
-    std::string* warn = NULL, std::string* err = NULL);
+    ///
+    /// Search path to .mtl file.
+    /// Default = "" = search from the same directory of .obj file.
+    ///
+    std::string mtl_search_path;
 
-/// Loads object from a std::istream, uses `readMatFn` to retrieve
-/// std::istream for materials.
-/// Returns true when loading .obj become success.
-/// Returns warning and error message into `err`
-bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
-    std::istream* inStream, MaterialReader* readMatFn = NULL, bool triangulate = true, bool default_vcols_fallback = true);
+    ///
+    /// Fill `obj_stream_batch_t::colors`(white when a `v` line has no color).
+    ///
+    bool vertex_color;
 
-/// Loads materials into std::map
-void LoadMtl(std::map<std::string, int>* material_map, std::vector<material_t>* materials, std::istream* inStream, std::string* warning,
-    std::string* err);
+    ObjStreamReaderConfig() : batch_size(65536), max_batch_bytes(16 * 1024 * 1024), vertex_color(false) {}
+};
 
 ///
-/// Parse texture name and texture option for custom texture parameter through
-/// material::unknown_parameter
-///
-/// @param[out] texname Parsed texture name
-/// @param[out] texopt Parsed texopt
-/// @param[in] linebuf Input string
+/// A batch of elements handed out by `ObjStreamReader::Next`.
+/// Face indices are resolved to 0-based absolute indices(-1 = not used), so
+/// faces can be consumed without the relative index bookkeeping of the
+/// earlier batches.
 ///
-bool ParseTextureNameAndOption(std::string* texname, texture_option_t* texopt, const char* linebuf);
-
-/// =<<========== Legacy v1 API =============================================
+struct obj_stream_batch_t {
+    std::vector<real_t> vertices;   // 'v'(xyz)
+    std::vector<real_t> colors;     // 'v'(rgb), only when `vertex_color` is set
+    std::vector<real_t> normals;    // 'vn'(xyz)
+    std::vector<real_t> texcoords;  // 'vt'(uv)
+
+    std::vector<index_t> indices;                 // face corners
+    std::vector<unsigned int> num_face_vertices;  // corners per face
+    std::vector<int> material_ids;                // per-face material ID(-1 = none)
+
+    // Shapes(`o` or `g` lines) started in this batch, and the global index of
+    // the first face of each.
+    std::vector<std::string> shape_names;
+    std::vector<size_t> shape_face_offsets;
+
+    // Global index of the first element of each kind in this batch.
+    size_t vertex_offset;
+    size_t normal_offset;
+    size_t texcoord_offset;
+    size_t face_offset;
+
+    obj_stream_batch_t() : vertex_offset(0), normal_offset(0), texcoord_offset(0), face_offset(0) {}
+
+    size_t num_vertices() const { return vertices.size() / 3; }
+    size_t num_normals() const { return normals.size() / 3; }
+    size_t num_texcoords() const { return texcoords.size() / 2; }
+    size_t num_faces() const { return num_face_vertices.size(); }
 
-}  // namespace tinyobj
+    ///
+    /// Clears the batch. The capacity of the arrays is kept, so a batch
+    /// object reused across `Next` calls does not reallocate.
+    ///
+    void clear();
 
-#endif  // TINY_OBJ_LOADER_H_
+    bool empty() const {
+        return vertices.empty() && normals.empty() && texcoords.empty() && num_face_vertices.empty() && shape_names.empty();
+    }
+};
 
-#ifdef TINYOBJLOADER_IMPLEMENTATION
-#include <cassert>
-#include <cctype>
-#include <cmath>
-#include <cstddef>
-#include <cstdlib>
-#include <cstring>
-#include <fstream>
-#include <limits>
-#include <set>
-#include <sstream>
-#include <utility>
+class obj_stream_state;
 
-#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
+///
+/// Pull-style streaming .obj reader(built on `callback_t`).
+/// Hands out fixed-size batches of vertices and faces instead of building
+/// `attrib_t`/`shape_t`, so arbitrarily large files can be read with bounded
+/// memory(e.g. into a disk backed mesh builder).
+///
+class ObjStreamReader {
+public:
+    ObjStreamReader();
+    ~ObjStreamReader();
 
-#ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
-// Assume earcut.hpp is included outside of tiny_obj_loader.h
-#else
+    ///
+    /// Open .obj file. .mtl files are loaded when `mtllib` is encountered.
+    ///
+    /// @param[in] filename wavefront .obj filename
+    /// @param[in] config Reader configuration
+    ///
+    bool Open(const std::string& filename, const ObjStreamReaderConfig& config = ObjStreamReaderConfig());
 
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Weverything"
-#endif
+    ///
+    /// Read .obj from a stream. `inStream` and `readMatFn`(optional) must
+    /// outlive the reader.
+    ///
+    bool Open(std::istream* inStream, MaterialReader* readMatFn = NULL, const ObjStreamReaderConfig& config = ObjStreamReaderConfig());
 
-#include <array>
-#include "mapbox/earcut.hpp"
+    ///
+    /// Reads the next batch into `batch`(cleared first).
+    /// Returns false when the end of the stream was reached and `batch` is
+    /// empty.
+    ///
+    bool Next(obj_stream_batch_t* batch);
 
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
+    ///
+    /// Materials of the `mtllib` lines read so far.
+    ///
+    const std::vector<material_t>& GetMaterials() const;
 
-#endif
+    const std::string& Warning() const { return warning_; }
 
-#endif  // TINYOBJLOADER_USE_MAPBOX_EARCUT
+    const std::string& Error() const { return error_; }
 
-namespace tinyobj {
+private:
+    ObjStreamReader(const ObjStreamReader&);
+    ObjStreamReader& operator=(const ObjStreamReader&);
 
-MaterialReader::~MaterialReader() {}
+    obj_stream_state* state_;
 
-struct vertex_index_t {
-    int v_idx, vt_idx, vn_idx;
-    vertex_index_t() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
-    explicit vertex_index_t(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
-    vertex_index_t(int vidx, int vtidx, int vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
+    std::string warning_;
+    std::string error_;
 };
 
-// Internal data structure for face representation
-// index + smoothing group.
-struct face_t {
-    unsigned int smoothing_group_id;  // smoothing group id. 0 = smoothing groupd is off.
-    int pad_;
-    std::vector<vertex_index_t> vertex_indices;  // face vertex indices.
+///
+/// Incremental .obj reader configuration.
+///
+struct ObjIncrementalReaderConfig {
+    bool triangulate;  // triangulate polygon?
 
-    face_t() : smoothing_group_id(0), pad_(0) {}
-};
+    /// Parse vertex color(white when a `v` line has no color).
+    bool vertex_color;
 
-// Internal data structure for line representation
-struct __line_t {
-    // l v1/vt1 v2/vt2 ...
-    // In the specification, line primitrive does not have normal index, but
-    // TinyObjLoader allow it
-    std::vector<vertex_index_t> vertex_indices;
-};
+    ///
+    /// Search path to .mtl file.
+    /// Default = "" = search from the same directory of .obj file.
+    ///
+    std::string mtl_search_path;
 
-// Internal data structure for points representation
-struct __points_t {
-    // p v1 v2 ...
-    // In the specification, point primitrive does not have normal index and
-    // texture coord index, but TinyObjLoader allow it.
-    std::vector<vertex_index_t> vertex_indices;
-};
+    ///
+    /// Hash all bytes before the checkpoint on each `Load` to detect edits.
+    /// false = only compare the last(at most 1MB) block before the
+    /// checkpoint(faster, misses edits further up in the file).
+    ///
+    bool verify_prefix;
 
-struct tag_sizes {
-    tag_sizes() : num_ints(0), num_reals(0), num_strings(0) {}
-    int num_ints;
-    int num_reals;
-    int num_strings;
+    ObjIncrementalReaderConfig() : triangulate(true), vertex_color(true), verify_prefix(true) {}
 };
 
-struct obj_shape {
-    std::vector<real_t> v;
+class obj_incremental_state;
+
+///
+/// .obj reader for files which grow while they are read(e.g. written
+/// progressively by a scanner).
+/// Keeps a checkpoint of the parser state(element counts, current material
+/// and group, byte offset) after each `Load`. The next `Load` of the same
+/// file parses only the bytes appended since then and appends to
+/// `GetAttrib`/`GetShapes`. It falls back to a full parse when bytes before
+/// the checkpoint changed, the file shrank or the configuration changed.
+///
+/// A last line without line ending is treated as still being written and
+/// is parsed once it is terminated.
+///
+class ObjIncrementalReader {
+public:
+    ObjIncrementalReader();
+    ~ObjIncrementalReader();
+
+    ///
+    /// Load .obj(and .mtl) from a file, or only the bytes appended since the
+    /// previous call with the same `filename`.
+    ///
+    /// @param[in] filename wavefront .obj filename
+    /// @param[in] config Reader configuration
+    ///
+    bool Load(const std::string& filename, const ObjIncrementalReaderConfig& config = ObjIncrementalReaderConfig());
+
+    ///
+    /// Drops the checkpoint and the parsed data.
+    ///
+    void Reset();
+
+    ///
+    /// The last `Load` only parsed appended bytes.
+    ///
+    bool Appended() const { return appended_; }
+
+    ///
+    /// Number of bytes parsed by the last `Load`.
+    ///
+    size_t NumParsedBytes() const { return num_parsed_bytes_; }
+
+    ///
+    /// Byte offset of the checkpoint(bytes of the file parsed so far).
+    ///
+    size_t CheckpointOffset() const;
+
+    const attrib_t& GetAttrib() const { return attrib_; }
+
+    const std::vector<shape_t>& GetShapes() const { return shapes_; }
+
+    const std::vector<material_t>& GetMaterials() const { return materials_; }
+
+    const std::string& Warning() const { return warning_; }
+
+    const std::string& Error() const { return error_; }
+
+private:
+    ObjIncrementalReader(const ObjIncrementalReader&);
+    ObjIncrementalReader& operator=(const ObjIncrementalReader&);
+
+    obj_incremental_state* state_;
+
+    attrib_t attrib_;
+    std::vector<shape_t> shapes_;
+    std::vector<material_t> materials_;
+
+    bool appended_;
+    size_t num_parsed_bytes_;
+
+    std::string warning_;
+    std::string error_;
+};
+
+/// ==>>========= Legacy v1 API =============================================
+
+/// Loads .obj from a file.
+/// 'attrib', 'shapes' and 'materials' will be filled with parsed shape data
+/// 'shapes' will be filled with parsed shape data
+/// Returns true when loading .obj become success.
+/// Returns warning message into `warn`, and error message into `err`
+/// 'mtl_basedir' is optional, and used for base directory for .mtl file.
+/// In default(`NULL'), .mtl file is searched from an application's working
+/// directory.
+/// 'triangulate' is optional, and used whether triangulate polygon face in .obj
+/// or not.
+/// Option 'default_vcols_fallback' specifies whether vertex colors should
+/// always be defined, even if no colors are given (fallback to white).
+/// 'arena' is optional, and used for the temporary containers of the parse
+/// (see `ParseArena`).
+bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
+    const char* filename, const char* mtl_basedir = NULL, bool triangulate = true, bool default_vcols_fallback = true,
+    ParseArena* arena = NULL);
+
+/// Loads .obj from a file with multiple threads.
+/// Arguments and output are the same as `LoadObj`.
+/// The file is memory mapped and split into newline aligned chunks. `v`, `vn`,
+/// `vt` and `f` lines of each chunk are parsed in parallel, then the chunks
+/// are merged in file order(relative indices are resolved against the global
+/// element counts, so the result is identical to `LoadObj`).
+/// 'num_threads' is the number of worker threads. 0 = use
+/// std::thread::hardware_concurrency().
+/// With an 'arena', each chunk additionally uses an internal arena of its own
+/// while the chunks are parsed in parallel.
+bool LoadObjParallel(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn,
+    std::string* err, const char* filename, const char* mtl_basedir = NULL, bool triangulate = true, bool default_vcols_fallback = true,
+    unsigned int num_threads = 0, ParseArena* arena = NULL);
+
+/// Loads .obj from a file through a binary parse cache.
+/// Arguments and output are the same as `LoadObj`(`materials` is cleared
+/// first).
+/// The parsed `attrib`, `shapes` and `materials`(and parse warnings) are
+/// serialized into a versioned binary file next to the .obj. A later load
+/// memory maps that file instead of parsing the .obj, as long as the file
+/// size, modification time and content hash of the .obj, the loader options
+/// and the .mtl files which were read are unchanged.
+/// On a cache miss the .obj is parsed with `LoadObjParallel`.
+/// 'cache_config' selects the cache path and allows forcing a rebuild.
+/// 'cache_hit'(optional) is set to true when the result came from the cache.
+bool LoadObjCached(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn,
+    std::string* err, const char* filename, const char* mtl_basedir = NULL, bool triangulate = true, bool default_vcols_fallback = true,
+    const ObjCacheConfig& cache_config = ObjCacheConfig(), bool* cache_hit = NULL);
+
+///
+/// One shape(`o`/`g` group) of a .obj file in `obj_shape_index_t`.
+/// Groups are listed when they contain the face, line or point lines for
+/// which `LoadObj` creates a `shape_t`. The index only classifies lines, so a
+/// group whose faces all triangulate to nothing(degenerate polygons) is
+/// still listed although `LoadObj` creates no shape for it.
+///
+struct obj_shape_index_entry_t {
+    std::string name;  // `shape_t::name`
+
+    // Byte range [begin, end) of the group in the .obj file.
+    unsigned long long begin;
+    unsigned long long end;
+
+    // `v`, `vn` and `vt` lines before the group(used to resolve relative
+    // indices).
+    unsigned long long vertex_offset;
+    unsigned long long normal_offset;
+    unsigned long long texcoord_offset;
+
+    // Lines of any kind before the group(for the line numbers of warnings).
+    unsigned long long line_num;
+
+    // Lines in the group.
+    unsigned long long num_vertices;
+    unsigned long long num_normals;
+    unsigned long long num_texcoords;
+    unsigned long long num_faces;
+    unsigned long long num_lines;
+    unsigned long long num_points;
+
+    // Parser state at `begin`: byte offset of the last `usemtl` and `s`
+    // line before the group(~0 = none).
+    unsigned long long material_line;
+    unsigned long long smoothing_line;
+
+    obj_shape_index_entry_t()
+        : begin(0), end(0), vertex_offset(0), normal_offset(0), texcoord_offset(0), line_num(0), num_vertices(0), num_normals(0),
+          num_texcoords(0), num_faces(0), num_lines(0), num_points(0), material_line(~0ULL), smoothing_line(~0ULL) {}
+};
+
+///
+/// Index of the shapes of a .obj file(see `BuildObjShapeIndex`), used by
+/// `LoadObjShapes` to parse only selected shapes.
+///
+struct obj_shape_index_t {
+    // .obj file the index was built from.
+    unsigned long long source_size;
+    long long source_mtime;
+
+    std::vector<obj_shape_index_entry_t> shapes;
+
+    // Byte offset of every `kObjShapeIndexBlockSize`th `v`, `vn` and `vt`
+    // line, to find the vertices referenced by a shape.
+    std::vector<unsigned long long> vertex_blocks;
+    std::vector<unsigned long long> normal_blocks;
+    std::vector<unsigned long long> texcoord_blocks;
+
+    // Byte offsets of all `mtllib` and `t` lines.
+    std::vector<unsigned long long> mtllib_lines;
+    std::vector<unsigned long long> tag_lines;
+
+    unsigned long long num_vertices;
+    unsigned long long num_normals;
+    unsigned long long num_texcoords;
+
+    obj_shape_index_t() : source_size(0), source_mtime(0), num_vertices(0), num_normals(0), num_texcoords(0) {}
+
+    ///
+    /// Appends the indices of all shapes named `name` to `ids`. An index may
+    /// refer to a group for which `LoadObjShapes` yields no shape(see
+    /// `obj_shape_index_entry_t`).
+    ///
+    void FindShapes(const std::string& name, std::vector<size_t>* ids) const;
+};
+
+///
+/// Pre-scans a .obj file and records the byte range and element counts of
+/// each shape. Only line types are classified(no number parsing), so this is
+/// much faster than `LoadObj`.
+///
+bool BuildObjShapeIndex(obj_shape_index_t* index, std::string* err, const char* filename);
+
+///
+/// Writes `index` to a binary file.
+///
+bool SaveObjShapeIndex(const obj_shape_index_t& index, std::string* err, const char* index_filename);
+
+///
+/// Reads an index written by `SaveObjShapeIndex`. Returns false when the
+/// file is missing or corrupted, or when `obj_filename`(optional) changed
+/// size or modification time since the index was built.
+///
+bool LoadObjShapeIndex(obj_shape_index_t* index, std::string* err, const char* index_filename, const char* obj_filename = NULL);
+
+///
+/// Loads only the shapes `shape_ids`(indices into `index.shapes`) of a .obj
+/// file. Each shape's byte range is parsed, then only the vertices, normals
+/// and texcoords the shapes reference are read(through the blocks of the
+/// index). `attrib` is compact: indices in `shapes` are remapped into it.
+/// Shapes are returned in file order. A selected group whose faces all
+/// triangulate to nothing yields no shape, so `shapes` may have fewer
+/// elements than `shape_ids`. `materials` is the same as with `LoadObj`.
+/// Skin weights(`vw`) are not loaded.
+///
+bool LoadObjShapes(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn,
+    std::string* err, const char* filename, const obj_shape_index_t& index, const std::vector<size_t>& shape_ids,
+    const char* mtl_basedir = NULL, bool triangulate = true, bool default_vcols_fallback = true);
+
+/// Loads .obj from a file with custom user callback.
+/// .mtl is loaded as usual and parsed material_t data will be passed to
+/// `callback.mtllib_cb`.
+/// Returns true when loading .obj/.mtl become success.
+/// Returns warning message into `warn`, and error message into `err`
+/// See `examples/callback_api/` for how to use this function.
+bool LoadObjWithCallback(std::istream& inStream, const callback_t& callback, void* user_data = NULL, MaterialReader* readMatFn = NULL,
+    std::string* warn = NULL, std::string* err = NULL);
+
+/// Loads .obj from a stream with batched user callbacks.
+/// Same as above, but `v`, `vn`, `vt` and `f` lines are passed in spans of
+/// up to `callback.batch_size` elements(see `batch_callback_t`).
+bool LoadObjWithCallback(std::istream& inStream, const batch_callback_t& callback, void* user_data = NULL,
+    MaterialReader* readMatFn = NULL, std::string* warn = NULL, std::string* err = NULL);
+
+/// Loads object from a std::istream, uses `readMatFn` to retrieve
+/// std::istream for materials.
+/// Returns true when loading .obj become success.
+/// Returns warning and error message into `err`
+bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
+    std::istream* inStream, MaterialReader* readMatFn = NULL, bool triangulate = true, bool default_vcols_fallback = true,
+    ParseArena* arena = NULL);
+
+/// Loads materials into std::map
+void LoadMtl(std::map<std::string, int>* material_map, std::vector<material_t>* materials, std::istream* inStream, std::string* warning,
+    std::string* err);
+
+///
+/// Parse texture name and texture option for custom texture parameter through
+/// material::unknown_parameter
+///
+/// @param[out] texname Parsed texture name
+/// @param[out] texopt Parsed texopt
+/// @param[in] linebuf Input string
+///
+bool ParseTextureNameAndOption(std::string* texname, texture_option_t* texopt, const char* linebuf);
+
+///
+/// Welds the face corners of `shape` into unique (v, vn, vt) vertices.
+/// Every corner is hashed once into an open addressing table, so the cost is
+/// linear in the number of corners.
+/// Out of range normal/texcoord indices are treated as missing.
+/// Returns false when a corner references an invalid vertex.
+///
+/// @param[in] attrib Vertex attributes the shape indexes into
+/// @param[in] shape Shape to weld(faces only; lines and points are ignored)
+/// @param[out] indexed_mesh Welded vertex and index buffers
+///
+bool BuildIndexedMesh(const attrib_t& attrib, const shape_t& shape, indexed_mesh_t* indexed_mesh);
+
+///
+/// Same as above, reading the attributes through `attrib_accessor_t`
+/// (e.g. from `compact_attrib_t`).
+///
+bool BuildIndexedMesh(const attrib_accessor_t& attrib, const shape_t& shape, indexed_mesh_t* indexed_mesh);
+
+///
+/// Quantizes `attrib` into `compact`(about half the memory of `attrib_t`)
+/// and releases the arrays of `attrib`. Both exist during the conversion.
+/// Vertex weights, texcoord `w` and skin weights are not kept.
+/// Colors are stored only when some vertex is not white.
+///
+/// @param[inout] attrib Parsed vertex attributes. Empty on return.
+/// @param[out] compact Quantized vertex attributes
+///
+void CompactAttrib(attrib_t* attrib, compact_attrib_t* compact);
+
+///
+/// Generates vertex normals from the smoothing groups(`s` lines) of the
+/// faces of `shapes` and appends them to `attrib->normals`.
+/// Face normals are weighted by face area and by the angle of each corner,
+/// then summed per (vertex, smoothing group). Faces of smoothing group 0 get
+/// a flat face normal. The sums are gathered per vertex in a fixed order, so
+/// the result does not depend on `num_threads`.
+/// Faces with an invalid vertex index are skipped.
+///
+/// @param[inout] attrib Vertex attributes. Generated normals are appended.
+/// @param[inout] shapes Shapes whose corners get the new normal indices
+/// @param[in] overwrite Replace existing normals too. false = only corners
+///            without a valid normal index get one.
+/// @param[in] num_threads 0 = use all hardware threads
+/// @return false when some face was skipped
+///
+bool GenerateSmoothingGroupNormals(attrib_t* attrib, std::vector<shape_t>* shapes, bool overwrite = false, unsigned int num_threads = 0);
+
+///
+/// Generates MikkTSpace style tangents for the welded vertices of
+/// `indexed_mesh`(`indexed_mesh_t::tangents`). As in MikkTSpace, each
+/// triangle's texture space tangent is projected into the plane of the corner
+/// normal and summed with the corner angle as weight. Triangles with
+/// opposite UV orientation are summed separately. Polygons are split into
+/// triangle fans.
+/// Triangles are processed in parallel and the corners are gathered per
+/// vertex in a fixed order, so the result does not depend on `num_threads`.
+///
+/// Unlike MikkTSpace, a vertex used with both UV orientations is not split:
+/// the orientation with the larger weight wins.
+///
+/// @param[inout] indexed_mesh Welded mesh built from `shape`. Needs normals
+///               and texcoords.
+/// @param[in] shape Shape `indexed_mesh` was built from(face sizes)
+/// @param[in] num_threads 0 = use all hardware threads
+/// @return false when the mesh has no normals or texcoords
+///
+bool GenerateTangents(indexed_mesh_t* indexed_mesh, const shape_t& shape, unsigned int num_threads = 0);
+
+///
+/// Post-transform vertex cache statistics of a triangle list, simulated with
+/// a FIFO cache(`AnalyzeVertexCache`).
+///
+struct vertex_cache_stats_t {
+    size_t num_triangles;
+    size_t num_vertices;     // vertices referenced by the triangles
+    size_t num_transformed;  // cache misses
+    double acmr;             // average cache miss ratio: misses per triangle(0.5 .. 3, lower is better)
+    double atvr;             // average transformed vertex ratio: misses per vertex(1 = optimal)
+
+    vertex_cache_stats_t() : num_triangles(0), num_vertices(0), num_transformed(0), acmr(0.0), atvr(0.0) {}
+};
+
+///
+/// Simulates a FIFO vertex cache of `cache_size` entries over
+/// `indexed_mesh.indices` read as a triangle list.
+///
+vertex_cache_stats_t AnalyzeVertexCache(const indexed_mesh_t& indexed_mesh, unsigned int cache_size = 16);
+
+///
+/// Reorders the triangles of `shape` for the post-transform vertex cache
+/// (Tom Forsyth's linear-speed vertex cache optimisation), then renumbers
+/// the welded vertices of `indexed_mesh` in first-use order for fetch
+/// locality. Per face arrays of `shape`(material and smoothing group ids)
+/// follow the triangles; `indexed_mesh_t::tangents` follows the vertices.
+///
+/// @param[inout] indexed_mesh Welded mesh built from `shape`
+/// @param[inout] shape Shape whose faces are reordered
+/// @param[in] cache_size Simulated LRU cache size(at most 64)
+/// @return false(and nothing changed) when some face is not a triangle
+///
+bool OptimizeVertexCache(indexed_mesh_t* indexed_mesh, shape_t* shape, unsigned int cache_size = 32);
+
+///
+/// Simplifies the triangles of a welded shape with quadric error metrics,
+/// e.g. to build a LOD chain. Edges collapse onto one of their vertices, so
+/// kept vertices keep their exact attributes. UV seams, material boundaries
+/// and open borders only collapse along themselves; corners where they meet
+/// are kept. Collapses are applied in parallel per spatial cell, and the
+/// result does not depend on `num_threads`.
+///
+/// @param[in] indexed_mesh Welded mesh built from `shape`(tangents are kept)
+/// @param[in] shape Source shape(all faces triangles)
+/// @param[in] target_ratio Fraction of the triangles to keep(0 .. 1)
+/// @param[out] lod_mesh Simplified welded mesh without unused vertices
+/// @param[out] lod_shape Simplified shape: triangle faces with attrib indices,
+///             material and smoothing group ids, consistent with `lod_mesh`
+/// @param[in] num_threads 0 = use all hardware threads
+/// @return false when some face is not a triangle or an index is invalid
+///
+bool SimplifyIndexedMesh(const indexed_mesh_t& indexed_mesh, const shape_t& shape, double target_ratio, indexed_mesh_t* lod_mesh,
+    shape_t* lod_shape, unsigned int num_threads = 0);
+
+///
+/// Partitions the triangles of a welded shape into meshlets of at most
+/// `max_vertices` vertices and `max_triangles` triangles, with a bounding
+/// sphere and a normal cone each(for cluster culling). Triangles are sorted
+/// along a Morton curve and split into chunks that are clustered in
+/// parallel; the result does not depend on `num_threads`.
+///
+/// @param[in] indexed_mesh Welded mesh built from `shape`
+/// @param[in] shape Source shape(all faces triangles)
+/// @param[out] meshlets Meshlets
+/// @param[in] max_vertices Vertices per meshlet(3 .. 255)
+/// @param[in] max_triangles Triangles per meshlet(1 .. 512)
+/// @param[in] num_threads 0 = use all hardware threads
+/// @return false when some face is not a triangle, an index is invalid or a
+///         limit is out of range
+///
+bool BuildMeshlets(const indexed_mesh_t& indexed_mesh, const shape_t& shape, meshlets_t* meshlets, unsigned int max_vertices = 64,
+    unsigned int max_triangles = 124, unsigned int num_threads = 0);
+
+/// =<<========== Legacy v1 API =============================================
+
+}  // namespace tinyobj
+
+#endif  // TINY_OBJ_LOADER_H_
+
+#ifdef TINYOBJLOADER_IMPLEMENTATION
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <utility>
+
+// C++11
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#ifndef TINYOBJLOADER_DISABLE_MMAP
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif  // TINYOBJLOADER_DISABLE_MMAP
+
+// stat() for the parse cache.
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cstdio>
+
+// SIMD token scanner.
+// SSE2 is used by default on x86/x64. Define TINYOBJLOADER_USE_AVX2(and
+// compile with /arch:AVX2 or -mavx2) to scan 32 bytes at a time, or
+// TINYOBJLOADER_NO_SIMD to use the scalar fallback only.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define TINYOBJLOADER_ASAN_ENABLED
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define TINYOBJLOADER_ASAN_ENABLED
+#endif
+
+// Aligned block loads may read past the terminating '\0' (never across a
+// page boundary), which ASan reports, so disable SIMD under ASan.
+#if !defined(TINYOBJLOADER_NO_SIMD) && !defined(TINYOBJLOADER_ASAN_ENABLED)
+#if defined(TINYOBJLOADER_USE_AVX2)
+#define TINYOBJLOADER_SIMD_AVX2
+#define TINYOBJLOADER_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TINYOBJLOADER_SIMD_SSE2
+#endif
+#endif
+
+#if defined(TINYOBJLOADER_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(TINYOBJLOADER_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(TINYOBJLOADER_SIMD_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
+
+#ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
+// Assume earcut.hpp is included outside of tiny_obj_loader.h
+#else
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+
+#include <array>
+#include "mapbox/earcut.hpp"
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#endif
+
+#endif  // TINYOBJLOADER_USE_MAPBOX_EARCUT
+
+namespace tinyobj {
+
+MaterialReader::~MaterialReader() {}
+
+// Allocations larger than a quarter of the block size get a block of their
+// own, so they can be given back to the heap(e.g. when a vector grows).
+static const size_t kArenaMaxBlockSize = 64 * 1024 * 1024;
+
+ParseArena::ParseArena(size_t block_size)
+    : blocks_(NULL), cur_(NULL), end_(NULL), last_(NULL), block_size_(block_size < 4096 ? 4096 : block_size),
+      next_block_size_(block_size_), num_allocations_(0), num_block_allocations_(0), bytes_reserved_(0) {}
+
+ParseArena::~ParseArena() { Release(); }
+
+ParseArena::block_t* ParseArena::NewBlock(size_t size, bool dedicated) {
+    block_t* block = static_cast<block_t*>(::operator new(size));
+    block->next = NULL;
+    block->size = size;
+    block->dedicated = dedicated;
+    num_block_allocations_++;
+    bytes_reserved_ += size;
+    return block;
+}
+
+void* ParseArena::Allocate(size_t size, size_t alignment) {
+    num_allocations_++;
+    if (size == 0) {
+        size = 1;
+    }
+
+    const size_t header = (sizeof(block_t) + alignment - 1) & ~(alignment - 1);
+    if (size > next_block_size_ / 4) {
+        // Dedicated block. Linked behind the current block, so the remaining
+        // space of the current block stays usable.
+        block_t* block = NewBlock(header + size, true);
+        if (blocks_) {
+            block->next = blocks_->next;
+            blocks_->next = block;
+        } else {
+            blocks_ = block;
+        }
+        return reinterpret_cast<char*>(block) + header;
+    }
+
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur_) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    if (!cur_ || p + size > reinterpret_cast<uintptr_t>(end_)) {
+        // Blocks grow geometrically up to kArenaMaxBlockSize.
+        block_t* block = NewBlock(next_block_size_, false);
+        block->next = blocks_;
+        blocks_ = block;
+        cur_ = reinterpret_cast<char*>(block) + sizeof(block_t);
+        end_ = reinterpret_cast<char*>(block) + block->size;
+        next_block_size_ = std::min(next_block_size_ * 2, std::max(kArenaMaxBlockSize, block_size_));
+        p = (reinterpret_cast<uintptr_t>(cur_) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    }
+
+    last_ = reinterpret_cast<char*>(p);
+    cur_ = last_ + size;
+    return last_;
+}
+
+void ParseArena::Deallocate(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+
+    if (ptr == last_) {
+        cur_ = last_;
+        last_ = NULL;
+        return;
+    }
+
+    if (size <= next_block_size_ / 8) {
+        // Small allocation inside a block(the threshold of dedicated blocks
+        // may have grown since). Reclaimed by Reset/Release.
+        return;
+    }
+
+    block_t** link = &blocks_;
+    while (*link) {
+        block_t* block = *link;
+        char* begin = reinterpret_cast<char*>(block);
+        if (block->dedicated && static_cast<char*>(ptr) > begin && static_cast<char*>(ptr) < begin + block->size) {
+            *link = block->next;
+            bytes_reserved_ -= block->size;
+            ::operator delete(block);
+            return;
+        }
+        link = &block->next;
+    }
+}
+
+void ParseArena::Reset() {
+    // Keep the largest regular block.
+    block_t* keep = NULL;
+    block_t* block = blocks_;
+    while (block) {
+        block_t* next = block->next;
+        if (!block->dedicated && (!keep || block->size > keep->size)) {
+            if (keep) {
+                bytes_reserved_ -= keep->size;
+                ::operator delete(keep);
+            }
+            keep = block;
+        } else {
+            bytes_reserved_ -= block->size;
+            ::operator delete(block);
+        }
+        block = next;
+    }
+
+    blocks_ = keep;
+    cur_ = NULL;
+    end_ = NULL;
+    if (keep) {
+        keep->next = NULL;
+        cur_ = reinterpret_cast<char*>(keep) + sizeof(block_t);
+        end_ = reinterpret_cast<char*>(keep) + keep->size;
+        next_block_size_ = keep->size;
+    }
+    last_ = NULL;
+    num_allocations_ = 0;
+    num_block_allocations_ = 0;
+}
+
+void ParseArena::Release() {
+    Reset();
+    if (blocks_) {
+        bytes_reserved_ -= blocks_->size;
+        ::operator delete(blocks_);
+    }
+    blocks_ = NULL;
+    cur_ = NULL;
+    end_ = NULL;
+    next_block_size_ = block_size_;
+}
+
+// std::allocator compatible allocator on a ParseArena. A NULL arena uses the
+// heap, so containers behave as with std::allocator unless an arena is set.
+// The allocator moves with the storage on swap/move assignment, so a
+// container can be swapped with one of another arena.
+template <typename T>
+class arena_allocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    arena_allocator(ParseArena* arena = NULL) : arena_(arena) {}
+
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(size_t n) {
+        if (!arena_) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (!arena_) {
+            ::operator delete(p);
+        } else {
+            arena_->Deallocate(p, n * sizeof(T));
+        }
+    }
+
+    ParseArena* arena() const { return arena_; }
+
+private:
+    ParseArena* arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+    return a.arena() != b.arena();
+}
+
+struct vertex_index_t {
+    int v_idx, vt_idx, vn_idx;
+    vertex_index_t() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
+    explicit vertex_index_t(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
+    vertex_index_t(int vidx, int vtidx, int vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
+};
+
+typedef std::vector<vertex_index_t, arena_allocator<vertex_index_t> > vertex_index_array;
+
+// Internal data structure for face representation
+// index + smoothing group.
+struct face_t {
+    unsigned int smoothing_group_id;  // smoothing group id. 0 = smoothing groupd is off.
+    int pad_;
+    vertex_index_array vertex_indices;  // face vertex indices.
+
+    explicit face_t(ParseArena* arena = NULL) : smoothing_group_id(0), pad_(0), vertex_indices(arena) {}
+};
+
+// Internal data structure for line representation
+struct __line_t {
+    // l v1/vt1 v2/vt2 ...
+    // In the specification, line primitrive does not have normal index, but
+    // TinyObjLoader allow it
+    vertex_index_array vertex_indices;
+
+    explicit __line_t(ParseArena* arena = NULL) : vertex_indices(arena) {}
+};
+
+// Internal data structure for points representation
+struct __points_t {
+    // p v1 v2 ...
+    // In the specification, point primitrive does not have normal index and
+    // texture coord index, but TinyObjLoader allow it.
+    vertex_index_array vertex_indices;
+
+    explicit __points_t(ParseArena* arena = NULL) : vertex_indices(arena) {}
+};
+
+struct tag_sizes {
+    tag_sizes() : num_ints(0), num_reals(0), num_strings(0) {}
+    int num_ints;
+    int num_reals;
+    int num_strings;
+};
+
+struct obj_shape {
+    std::vector<real_t> v;
+    std::vector<real_t> vn;
+    std::vector<real_t> vt;
+};
+
+//
+// Manages group of primitives(face, line, points, ...)
+struct PrimGroup {
+    std::vector<face_t, arena_allocator<face_t> > faceGroup;
+    std::vector<__line_t, arena_allocator<__line_t> > lineGroup;
+    std::vector<__points_t, arena_allocator<__points_t> > pointsGroup;
+
+    explicit PrimGroup(ParseArena* arena = NULL) : faceGroup(arena), lineGroup(arena), pointsGroup(arena) {}
+
+    void clear() {
+        faceGroup.clear();
+        lineGroup.clear();
+        pointsGroup.clear();
+    }
+
+    bool IsEmpty() const { return faceGroup.empty() && lineGroup.empty() && pointsGroup.empty(); }
+
+    // TODO(syoyo): bspline, surface, ...
+};
+
+// See
+// http://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
+static std::istream& safeGetline(std::istream& is, std::string& t) {
+    t.clear();
+
+    // The characters in the stream are read one-by-one using a std::streambuf.
+    // That is faster than reading them one-by-one using the std::istream.
+    // Code that uses streambuf this way must be guarded by a sentry object.
+    // The sentry object performs various tasks,
+    // such as thread synchronization and updating the stream state.
+
+    std::istream::sentry se(is, true);
+    std::streambuf* sb = is.rdbuf();
+
+    if (se) {
+        for (;;) {
+            int c = sb->sbumpc();
+            switch (c) {
+                case '\n': return is;
+                case '\r':
+                    if (sb->sgetc() == '\n') sb->sbumpc();
+                    return is;
+                case EOF:
+                    // Also handle the case when the last line has no line ending
+                    if (t.empty()) is.setstate(std::ios::eofbit);
+                    return is;
+                default: t += static_cast<char>(c);
+            }
+        }
+    }
+
+    return is;
+}
+
+#define IS_SPACE(x) (((x) == ' ') || ((x) == '\t'))
+#define IS_DIGIT(x) (static_cast<unsigned int>((x) - '0') < static_cast<unsigned int>(10))
+#define IS_NEW_LINE(x) (((x) == '\r') || ((x) == '\n') || ((x) == '\0'))
+
+//
+// Token scanners.
+//
+// Each character class provides a scalar `Match(char)` and, when SIMD is
+// enabled, a block version returning 0xFF in the matching bytes.
+// `ScanUntil` / `ScanWhile` work on '\0' terminated strings and only issue
+// aligned block loads, so they never read across a page boundary.
+// The class passed to `ScanUntil` must contain '\0', and the class passed to
+// `ScanWhile` must not, so that the scan always stops at the terminator.
+//
+#if defined(TINYOBJLOADER_SIMD_AVX2)
+typedef __m256i simd_block_t;
+static const size_t kSimdWidth = 32;
+static const unsigned int kSimdFullMask = 0xFFFFFFFFu;
+
+static inline simd_block_t SimdLoad(const char* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+static inline simd_block_t SimdLoadU(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+static inline simd_block_t SimdEq(simd_block_t a, char c) { return _mm256_cmpeq_epi8(a, _mm256_set1_epi8(c)); }
+static inline simd_block_t SimdOr(simd_block_t a, simd_block_t b) { return _mm256_or_si256(a, b); }
+static inline unsigned int SimdMask(simd_block_t a) { return static_cast<unsigned int>(_mm256_movemask_epi8(a)); }
+#elif defined(TINYOBJLOADER_SIMD_SSE2)
+typedef __m128i simd_block_t;
+static const size_t kSimdWidth = 16;
+static const unsigned int kSimdFullMask = 0xFFFFu;
+
+static inline simd_block_t SimdLoad(const char* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+static inline simd_block_t SimdLoadU(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+static inline simd_block_t SimdEq(simd_block_t a, char c) { return _mm_cmpeq_epi8(a, _mm_set1_epi8(c)); }
+static inline simd_block_t SimdOr(simd_block_t a, simd_block_t b) { return _mm_or_si128(a, b); }
+static inline unsigned int SimdMask(simd_block_t a) { return static_cast<unsigned int>(_mm_movemask_epi8(a)); }
+#endif
+
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+// `mask` must be non-zero.
+static inline unsigned int CountTrailingZeros(unsigned int mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// ' ', '\t'
+struct space_chars {
+    static inline bool Match(char c) { return (c == ' ') || (c == '\t'); }
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    static inline simd_block_t Match(simd_block_t b) { return SimdOr(SimdEq(b, ' '), SimdEq(b, '\t')); }
+#endif
+};
+
+// ' ', '\t', '\r'
+struct space_cr_chars {
+    static inline bool Match(char c) { return (c == ' ') || (c == '\t') || (c == '\r'); }
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    static inline simd_block_t Match(simd_block_t b) { return SimdOr(space_chars::Match(b), SimdEq(b, '\r')); }
+#endif
+};
+
+// ' ', '\t', '\r', '\0'
+struct token_end_chars {
+    static inline bool Match(char c) { return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\0'); }
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    static inline simd_block_t Match(simd_block_t b) { return SimdOr(space_cr_chars::Match(b), SimdEq(b, '\0')); }
+#endif
+};
+
+// '/', ' ', '\t', '\r', '\0'
+struct index_end_chars {
+    static inline bool Match(char c) { return (c == '/') || token_end_chars::Match(c); }
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    static inline simd_block_t Match(simd_block_t b) { return SimdOr(token_end_chars::Match(b), SimdEq(b, '/')); }
+#endif
+};
+
+// '\n', '\r'
+struct line_end_chars {
+    static inline bool Match(char c) { return (c == '\n') || (c == '\r'); }
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    static inline simd_block_t Match(simd_block_t b) { return SimdOr(SimdEq(b, '\n'), SimdEq(b, '\r')); }
+#endif
+};
+
+// Returns the first character of `p` which is in `CharClass`.
+template <typename CharClass>
+static inline const char* ScanUntil(const char* p) {
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    // Most tokens are a few bytes long, where a block load costs more than it
+    // saves, so scan the first vector width byte by byte.
+    for (size_t i = 0; i < kSimdWidth; i++) {
+        if (CharClass::Match(p[i])) {
+            return p + i;
+        }
+    }
+    p += kSimdWidth;
+    const size_t misalign = reinterpret_cast<size_t>(p) & (kSimdWidth - 1);
+    const char* block = p - misalign;
+    unsigned int mask = SimdMask(CharClass::Match(SimdLoad(block))) >> misalign;
+    if (mask) {
+        return p + CountTrailingZeros(mask);
+    }
+    for (;;) {
+        block += kSimdWidth;
+        mask = SimdMask(CharClass::Match(SimdLoad(block)));
+        if (mask) {
+            return block + CountTrailingZeros(mask);
+        }
+    }
+#else
+    while (!CharClass::Match(*p)) {
+        p++;
+    }
+    return p;
+#endif
+}
+
+// Returns the first character of `p` which is not in `CharClass`.
+template <typename CharClass>
+static inline const char* ScanWhile(const char* p) {
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    // Short runs(single separator) are the common case, see ScanUntil.
+    for (size_t i = 0; i < kSimdWidth; i++) {
+        if (!CharClass::Match(p[i])) {
+            return p + i;
+        }
+    }
+    p += kSimdWidth;
+    const size_t misalign = reinterpret_cast<size_t>(p) & (kSimdWidth - 1);
+    const char* block = p - misalign;
+    unsigned int mask = (~SimdMask(CharClass::Match(SimdLoad(block))) & kSimdFullMask) >> misalign;
+    if (mask) {
+        return p + CountTrailingZeros(mask);
+    }
+    for (;;) {
+        block += kSimdWidth;
+        mask = ~SimdMask(CharClass::Match(SimdLoad(block))) & kSimdFullMask;
+        if (mask) {
+            return block + CountTrailingZeros(mask);
+        }
+    }
+#else
+    while (CharClass::Match(*p)) {
+        p++;
+    }
+    return p;
+#endif
+}
+
+// Returns the first character in [p, end) which is in `CharClass`, or `end`.
+// Does not require '\0' termination.
+template <typename CharClass>
+static inline const char* ScanUntilBounded(const char* p, const char* end) {
+#if defined(TINYOBJLOADER_SIMD_SSE2)
+    const char* scalar_end = (end - p > static_cast<ptrdiff_t>(kSimdWidth)) ? p + kSimdWidth : end;
+    while (p < scalar_end && !CharClass::Match(*p)) {
+        p++;
+    }
+    if (p < scalar_end) {
+        return p;
+    }
+    while (end - p >= static_cast<ptrdiff_t>(kSimdWidth)) {
+        const unsigned int mask = SimdMask(CharClass::Match(SimdLoadU(p)));
+        if (mask) {
+            return p + CountTrailingZeros(mask);
+        }
+        p += kSimdWidth;
+    }
+#endif
+    while (p < end && !CharClass::Match(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// strspn(p, " \t")
+static inline const char* SkipSpace(const char* p) { return ScanWhile<space_chars>(p); }
+
+// strspn(p, " \t\r")
+static inline const char* SkipSpaceAndCR(const char* p) { return ScanWhile<space_cr_chars>(p); }
+
+// p + strcspn(p, " \t\r")
+static inline const char* FindTokenEnd(const char* p) { return ScanUntil<token_end_chars>(p); }
+
+// p + strcspn(p, "/ \t\r")
+static inline const char* FindIndexEnd(const char* p) { return ScanUntil<index_end_chars>(p); }
+
+// Same result as atoi() for well-formed input, without locale lookups.
+// Overflow wraps instead of being undefined.
+// `int_end`(optional) receives the character after the digits.
+static inline int ParseDecimalInt(const char* p, const char** int_end = NULL) {
+    while ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\v') || (*p == '\f') || (*p == '\r')) {
+        p++;
+    }
+    bool negative = false;
+    if (*p == '+' || *p == '-') {
+        negative = (*p == '-');
+        p++;
+    }
+    unsigned int value = 0;
+    while (IS_DIGIT(*p)) {
+        value = value * 10u + static_cast<unsigned int>(*p - '0');
+        p++;
+    }
+    if (int_end) {
+        (*int_end) = p;
+    }
+    return static_cast<int>(negative ? 0u - value : value);
+}
+
+template <typename T>
+static inline std::string toString(const T& t) {
+    std::stringstream ss;
+    ss << t;
+    return ss.str();
+}
+
+struct warning_context {
+    std::string* warn;
+    size_t line_number;
+};
+
+// Make index zero-base, and also support relative index.
+static inline bool fixIndex(int idx, int n, int* ret, bool allow_zero, const warning_context& context) {
+    if (!ret) {
+        return false;
+    }
+
+    if (idx > 0) {
+        (*ret) = idx - 1;
+        return true;
+    }
+
+    if (idx == 0) {
+        // zero is not allowed according to the spec.
+        if (context.warn) {
+            (*context.warn) += "A zero value index found (will have a value of -1 for normal and tex indices. Line " +
+                               toString(context.line_number) + ").\n";
+        }
+
+        (*ret) = idx - 1;
+        return allow_zero;
+    }
+
+    if (idx < 0) {
+        (*ret) = n + idx;  // negative value = relative
+        if ((*ret) < 0) {
+            return false;  // invalid relative index
+        }
+        return true;
+    }
+
+    return false;  // never reach here.
+}
+
+static inline std::string parseString(const char** token) {
+    std::string s;
+    (*token) = SkipSpace(*token);
+    const char* e = FindTokenEnd(*token);
+    s = std::string((*token), e);
+    (*token) = e;
+    return s;
+}
+
+static inline int parseInt(const char** token) {
+    (*token) = SkipSpace(*token);
+    int i = ParseDecimalInt(*token);
+    (*token) = FindTokenEnd(*token);
+    return i;
+}
+
+// Tries to parse a floating point number located at s.
+//
+// s_end should be a location in the string where reading should absolutely
+// stop. For example at the end of the string, to prevent buffer overflows.
+// With s_end = NULL the string must be '\0' terminated, parsing then stops at
+// the first non-conforming character(a token separator never conforms).
+//
+// parse_end(optional) receives the character where parsing stopped.
+//
+// Parses the following EBNF grammar:
+//   sign    = "+" | "-" ;
+//   END     = ? anything not in digit ?
+//   digit   = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9" ;
+//   integer = [sign] , digit , {digit} ;
+//   decimal = integer , ["." , integer] ;
+//   float   = ( decimal , END ) | ( decimal , ("E" | "e") , integer , END ) ;
+//
+//  Valid strings are for example:
+//   -0  +3.1417e+2  -0.0E-3  1.0324  -1.41   11e2
+//
+// If the parsing is a success, result is set to the parsed value and true
+// is returned.
+//
+// The function is greedy and will parse until any of the following happens:
+//  - a non-conforming character is encountered.
+//  - s_end is reached.
+//
+// The following situations triggers a failure:
+//  - s >= s_end.
+//  - parse failure.
+//
+static bool tryParseDouble(const char* s, const char* s_end, double* result, const char** parse_end = NULL) {
+    if (s_end && s >= s_end) {
+        if (parse_end) {
+            (*parse_end) = s;
+        }
+        return false;
+    }
+
+    double mantissa = 0.0;
+    // This exponent is base 2 rather than 10.
+    // However the exponent we parse is supposed to be one of ten,
+    // thus we must take care to convert the exponent/and or the
+    // mantissa to a * 2^E, where a is the mantissa and E is the
+    // exponent.
+    // To get the final double we will use ldexp, it requires the
+    // exponent to be in base 2.
+    int exponent = 0;
+
+    // NOTE: THESE MUST BE DECLARED HERE SINCE WE ARE NOT ALLOWED
+    // TO JUMP OVER DEFINITIONS.
+    char sign = '+';
+    char exp_sign = '+';
+    char const* curr = s;
+
+    // How many characters were read in a loop.
+    int read = 0;
+    // Tells whether a loop terminated due to reaching s_end.
+    bool end_not_reached = false;
+    bool leading_decimal_dots = false;
+
+    /*
+            BEGIN PARSING.
+    */
+
+    // Find out what sign we've got.
+    if (*curr == '+' || *curr == '-') {
+        sign = *curr;
+        curr++;
+        if ((curr != s_end) && (*curr == '.')) {
+            // accept. Somethig like `.7e+2`, `-.5234`
+            leading_decimal_dots = true;
+        }
+    } else if (IS_DIGIT(*curr)) { /* Pass through. */
+    } else if (*curr == '.') {
+        // accept. Somethig like `.7e+2`, `-.5234`
+        leading_decimal_dots = true;
+    } else {
+        goto fail;
+    }
+
+    // Read the integer part.
+    end_not_reached = (curr != s_end);
+    if (!leading_decimal_dots) {
+        // Up to 15 digits(10^15 < 2^53) the integer accumulation is exact and
+        // gives the same value as the digit by digit double accumulation.
+        unsigned long long value = 0;
+        while (end_not_reached && IS_DIGIT(*curr) && read < 15) {
+            value = value * 10 + static_cast<unsigned long long>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+        mantissa = static_cast<double>(value);
+        while (end_not_reached && IS_DIGIT(*curr)) {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+
+        // We must make sure we actually got something.
+        if (read == 0) goto fail;
+    }
+
+    // We allow numbers of form "#", "###" etc.
+    if (!end_not_reached) goto assemble;
+
+    // Read the decimal part.
+    if (*curr == '.') {
+        curr++;
+        read = 1;
+        end_not_reached = (curr != s_end);
+        while (end_not_reached && IS_DIGIT(*curr)) {
+            static const double pow_lut[] = {
+                1.0,
+                0.1,
+                0.01,
+                0.001,
+                0.0001,
+                0.00001,
+                0.000001,
+                0.0000001,
+            };
+            const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
+
+            // NOTE: Don't use powf here, it will absolutely murder precision.
+            mantissa += static_cast<int>(*curr - 0x30) * (read < lut_entries ? pow_lut[read] : std::pow(10.0, -read));
+            read++;
+            curr++;
+            end_not_reached = (curr != s_end);
+        }
+    } else if (*curr == 'e' || *curr == 'E') {
+    } else {
+        goto assemble;
+    }
+
+    if (!end_not_reached) goto assemble;
+
+    // Read the exponent part.
+    if (*curr == 'e' || *curr == 'E') {
+        curr++;
+        // Figure out if a sign is present and if it is.
+        end_not_reached = (curr != s_end);
+        if (end_not_reached && (*curr == '+' || *curr == '-')) {
+            exp_sign = *curr;
+            curr++;
+        } else if (IS_DIGIT(*curr)) { /* Pass through. */
+        } else {
+            // Empty E is not allowed.
+            goto fail;
+        }
+
+        read = 0;
+        end_not_reached = (curr != s_end);
+        while (end_not_reached && IS_DIGIT(*curr)) {
+            // To avoid annoying MSVC's min/max macro definiton,
+            // Use hardcoded int max value
+            if (exponent > (2147483647 / 10)) {  // 2147483647 = std::numeric_limits<int>::max()
+                // Integer overflow
+                goto fail;
+            }
+            exponent *= 10;
+            exponent += static_cast<int>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+        exponent *= (exp_sign == '+' ? 1 : -1);
+        if (read == 0) goto fail;
+    }
+
+assemble:
+    *result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    if (parse_end) {
+        (*parse_end) = curr;
+    }
+    return true;
+fail:
+    if (parse_end) {
+        (*parse_end) = curr;
+    }
+    return false;
+}
+
+// Parses the token in one pass, the token end is only searched from where the
+// number stopped(usually the separator itself).
+static inline real_t parseReal(const char** token, double default_value = 0.0) {
+    (*token) = SkipSpace(*token);
+    const char* stop;
+    double val = default_value;
+    tryParseDouble((*token), NULL, &val, &stop);
+    real_t f = static_cast<real_t>(val);
+    (*token) = FindTokenEnd(stop);
+    return f;
+}
+
+static inline bool parseReal(const char** token, real_t* out) {
+    (*token) = SkipSpace(*token);
+    const char* stop;
+    double val;
+    bool ret = tryParseDouble((*token), NULL, &val, &stop);
+    if (ret) {
+        real_t f = static_cast<real_t>(val);
+        (*out) = f;
+    }
+    (*token) = FindTokenEnd(stop);
+    return ret;
+}
+
+static inline void parseReal2(real_t* x, real_t* y, const char** token, const double default_x = 0.0, const double default_y = 0.0) {
+    (*x) = parseReal(token, default_x);
+    (*y) = parseReal(token, default_y);
+}
+
+static inline void parseReal3(real_t* x, real_t* y, real_t* z, const char** token, const double default_x = 0.0,
+    const double default_y = 0.0, const double default_z = 0.0) {
+    (*x) = parseReal(token, default_x);
+    (*y) = parseReal(token, default_y);
+    (*z) = parseReal(token, default_z);
+}
+
+static inline void parseV(real_t* x, real_t* y, real_t* z, real_t* w, const char** token, const double default_x = 0.0,
+    const double default_y = 0.0, const double default_z = 0.0, const double default_w = 1.0) {
+    (*x) = parseReal(token, default_x);
+    (*y) = parseReal(token, default_y);
+    (*z) = parseReal(token, default_z);
+    (*w) = parseReal(token, default_w);
+}
+
+// Extension: parse vertex with colors(6 items)
+static inline bool parseVertexWithColor(real_t* x, real_t* y, real_t* z, real_t* r, real_t* g, real_t* b, const char** token,
+    const double default_x = 0.0, const double default_y = 0.0, const double default_z = 0.0) {
+    (*x) = parseReal(token, default_x);
+    (*y) = parseReal(token, default_y);
+    (*z) = parseReal(token, default_z);
+
+    const bool found_color = parseReal(token, r) && parseReal(token, g) && parseReal(token, b);
+
+    if (!found_color) {
+        (*r) = (*g) = (*b) = 1.0;
+    }
+
+    return found_color;
+}
+
+static inline bool parseOnOff(const char** token, bool default_value = true) {
+    (*token) = SkipSpace(*token);
+    const char* end = FindTokenEnd(*token);
+
+    bool ret = default_value;
+    if ((0 == strncmp((*token), "on", 2))) {
+        ret = true;
+    } else if ((0 == strncmp((*token), "off", 3))) {
+        ret = false;
+    }
+
+    (*token) = end;
+    return ret;
+}
+
+static inline texture_type_t parseTextureType(const char** token, texture_type_t default_value = TEXTURE_TYPE_NONE) {
+    (*token) = SkipSpace(*token);
+    const char* end = FindTokenEnd(*token);
+    texture_type_t ty = default_value;
+
+    if ((0 == strncmp((*token), "cube_top", strlen("cube_top")))) {
+        ty = TEXTURE_TYPE_CUBE_TOP;
+    } else if ((0 == strncmp((*token), "cube_bottom", strlen("cube_bottom")))) {
+        ty = TEXTURE_TYPE_CUBE_BOTTOM;
+    } else if ((0 == strncmp((*token), "cube_left", strlen("cube_left")))) {
+        ty = TEXTURE_TYPE_CUBE_LEFT;
+    } else if ((0 == strncmp((*token), "cube_right", strlen("cube_right")))) {
+        ty = TEXTURE_TYPE_CUBE_RIGHT;
+    } else if ((0 == strncmp((*token), "cube_front", strlen("cube_front")))) {
+        ty = TEXTURE_TYPE_CUBE_FRONT;
+    } else if ((0 == strncmp((*token), "cube_back", strlen("cube_back")))) {
+        ty = TEXTURE_TYPE_CUBE_BACK;
+    } else if ((0 == strncmp((*token), "sphere", strlen("sphere")))) {
+        ty = TEXTURE_TYPE_SPHERE;
+    }
+
+    (*token) = end;
+    return ty;
+}
+
+static tag_sizes parseTagTriple(const char** token) {
+    tag_sizes ts;
+
+    (*token) = SkipSpace(*token);
+    ts.num_ints = ParseDecimalInt(*token);
+    (*token) = FindIndexEnd(*token);
+    if ((*token)[0] != '/') {
+        return ts;
+    }
+
+    (*token)++;  // Skip '/'
+
+    (*token) = SkipSpace(*token);
+    ts.num_reals = ParseDecimalInt(*token);
+    (*token) = FindIndexEnd(*token);
+    if ((*token)[0] != '/') {
+        return ts;
+    }
+    (*token)++;  // Skip '/'
+
+    ts.num_strings = parseInt(token);
+
+    return ts;
+}
+
+// Parse triples with index offsets: i, i/j/k, i//k, i/j
+static bool parseTriple(const char** token, int vsize, int vnsize, int vtsize, vertex_index_t* ret, const warning_context& context) {
+    if (!ret) {
+        return false;
+    }
+
+    vertex_index_t vi(-1);
+
+    if (!fixIndex(ParseDecimalInt(*token, token), vsize, &vi.v_idx, false, context)) {
+        return false;
+    }
+
+    (*token) = FindIndexEnd(*token);
+    if ((*token)[0] != '/') {
+        (*ret) = vi;
+        return true;
+    }
+    (*token)++;
+
+    // i//k
+    if ((*token)[0] == '/') {
+        (*token)++;
+        if (!fixIndex(ParseDecimalInt(*token, token), vnsize, &vi.vn_idx, true, context)) {
+            return false;
+        }
+        (*token) = FindIndexEnd(*token);
+        (*ret) = vi;
+        return true;
+    }
+
+    // i/j/k or i/j
+    if (!fixIndex(ParseDecimalInt(*token, token), vtsize, &vi.vt_idx, true, context)) {
+        return false;
+    }
+
+    (*token) = FindIndexEnd(*token);
+    if ((*token)[0] != '/') {
+        (*ret) = vi;
+        return true;
+    }
+
+    // i/j/k
+    (*token)++;  // skip '/'
+    if (!fixIndex(ParseDecimalInt(*token, token), vnsize, &vi.vn_idx, true, context)) {
+        return false;
+    }
+    (*token) = FindIndexEnd(*token);
+
+    (*ret) = vi;
+
+    return true;
+}
+
+// Parse raw triples: i, i/j/k, i//k, i/j
+static vertex_index_t parseRawTriple(const char** token) {
+    vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
+
+    vi.v_idx = ParseDecimalInt(*token, token);
+    (*token) = FindIndexEnd(*token);
+    if ((*token)[0] != '/') {
+        return vi;
+    }
+    (*token)++;
+
+    // i//k
+    if ((*token)[0] == '/') {
+        (*token)++;
+        vi.vn_idx = ParseDecimalInt(*token, token);
+        (*token) = FindIndexEnd(*token);
+        return vi;
+    }
+
+    // i/j/k or i/j
+    vi.vt_idx = ParseDecimalInt(*token, token);
+    (*token) = FindIndexEnd(*token);
+    if ((*token)[0] != '/') {
+        return vi;
+    }
+
+    // i/j/k
+    (*token)++;  // skip '/'
+    vi.vn_idx = ParseDecimalInt(*token, token);
+    (*token) = FindIndexEnd(*token);
+    return vi;
+}
+
+bool ParseTextureNameAndOption(std::string* texname, texture_option_t* texopt, const char* linebuf) {
+    // @todo { write more robust lexer and parser. }
+    bool found_texname = false;
+    std::string texture_name;
+
+    const char* token = linebuf;  // Assume line ends with NULL
+
+    while (!IS_NEW_LINE((*token))) {
+        token += strspn(token, " \t");  // skip space
+        if ((0 == strncmp(token, "-blendu", 7)) && IS_SPACE((token[7]))) {
+            token += 8;
+            texopt->blendu = parseOnOff(&token, /* default */ true);
+        } else if ((0 == strncmp(token, "-blendv", 7)) && IS_SPACE((token[7]))) {
+            token += 8;
+            texopt->blendv = parseOnOff(&token, /* default */ true);
+        } else if ((0 == strncmp(token, "-clamp", 6)) && IS_SPACE((token[6]))) {
+            token += 7;
+            texopt->clamp = parseOnOff(&token, /* default */ true);
+        } else if ((0 == strncmp(token, "-boost", 6)) && IS_SPACE((token[6]))) {
+            token += 7;
+            texopt->sharpness = parseReal(&token, 1.0);
+        } else if ((0 == strncmp(token, "-bm", 3)) && IS_SPACE((token[3]))) {
+            token += 4;
+            texopt->bump_multiplier = parseReal(&token, 1.0);
+        } else if ((0 == strncmp(token, "-o", 2)) && IS_SPACE((token[2]))) {
+            token += 3;
+            parseReal3(&(texopt->origin_offset[0]), &(texopt->origin_offset[1]), &(texopt->origin_offset[2]), &token);
+        } else if ((0 == strncmp(token, "-s", 2)) && IS_SPACE((token[2]))) {
+            token += 3;
+            parseReal3(&(texopt->scale[0]), &(texopt->scale[1]), &(texopt->scale[2]), &token, 1.0, 1.0, 1.0);
+        } else if ((0 == strncmp(token, "-t", 2)) && IS_SPACE((token[2]))) {
+            token += 3;
+            parseReal3(&(texopt->turbulence[0]), &(texopt->turbulence[1]), &(texopt->turbulence[2]), &token);
+        } else if ((0 == strncmp(token, "-type", 5)) && IS_SPACE((token[5]))) {
+            token += 5;
+            texopt->type = parseTextureType((&token), TEXTURE_TYPE_NONE);
+        } else if ((0 == strncmp(token, "-texres", 7)) && IS_SPACE((token[7]))) {
+            token += 7;
+            // TODO(syoyo): Check if arg is int type.
+            texopt->texture_resolution = parseInt(&token);
+        } else if ((0 == strncmp(token, "-imfchan", 8)) && IS_SPACE((token[8]))) {
+            token += 9;
+            token += strspn(token, " \t");
+            const char* end = token + strcspn(token, " \t\r");
+            if ((end - token) == 1) {  // Assume one char for -imfchan
+                texopt->imfchan = (*token);
+            }
+            token = end;
+        } else if ((0 == strncmp(token, "-mm", 3)) && IS_SPACE((token[3]))) {
+            token += 4;
+            parseReal2(&(texopt->brightness), &(texopt->contrast), &token, 0.0, 1.0);
+        } else if ((0 == strncmp(token, "-colorspace", 11)) && IS_SPACE((token[11]))) {
+            token += 12;
+            texopt->colorspace = parseString(&token);
+        } else {
+// Assume texture filename
+#if 0
+      size_t len = strcspn(token, " \t\r");  // untile next space
+      texture_name = std::string(token, token + len);
+      token += len;
+
+      token += strspn(token, " \t");  // skip space
+#else
+            // Read filename until line end to parse filename containing whitespace
+            // TODO(syoyo): Support parsing texture option flag after the filename.
+            texture_name = std::string(token);
+            token += texture_name.length();
+#endif
+
+            found_texname = true;
+        }
+    }
+
+    if (found_texname) {
+        (*texname) = texture_name;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+static void InitTexOpt(texture_option_t* texopt, const bool is_bump) {
+    if (is_bump) {
+        texopt->imfchan = 'l';
+    } else {
+        texopt->imfchan = 'm';
+    }
+    texopt->bump_multiplier = static_cast<real_t>(1.0);
+    texopt->clamp = false;
+    texopt->blendu = true;
+    texopt->blendv = true;
+    texopt->sharpness = static_cast<real_t>(1.0);
+    texopt->brightness = static_cast<real_t>(0.0);
+    texopt->contrast = static_cast<real_t>(1.0);
+    texopt->origin_offset[0] = static_cast<real_t>(0.0);
+    texopt->origin_offset[1] = static_cast<real_t>(0.0);
+    texopt->origin_offset[2] = static_cast<real_t>(0.0);
+    texopt->scale[0] = static_cast<real_t>(1.0);
+    texopt->scale[1] = static_cast<real_t>(1.0);
+    texopt->scale[2] = static_cast<real_t>(1.0);
+    texopt->turbulence[0] = static_cast<real_t>(0.0);
+    texopt->turbulence[1] = static_cast<real_t>(0.0);
+    texopt->turbulence[2] = static_cast<real_t>(0.0);
+    texopt->texture_resolution = -1;
+    texopt->type = TEXTURE_TYPE_NONE;
+}
+
+static void InitMaterial(material_t* material) {
+    InitTexOpt(&material->ambient_texopt, /* is_bump */ false);
+    InitTexOpt(&material->diffuse_texopt, /* is_bump */ false);
+    InitTexOpt(&material->specular_texopt, /* is_bump */ false);
+    InitTexOpt(&material->specular_highlight_texopt, /* is_bump */ false);
+    InitTexOpt(&material->bump_texopt, /* is_bump */ true);
+    InitTexOpt(&material->displacement_texopt, /* is_bump */ false);
+    InitTexOpt(&material->alpha_texopt, /* is_bump */ false);
+    InitTexOpt(&material->reflection_texopt, /* is_bump */ false);
+    InitTexOpt(&material->roughness_texopt, /* is_bump */ false);
+    InitTexOpt(&material->metallic_texopt, /* is_bump */ false);
+    InitTexOpt(&material->sheen_texopt, /* is_bump */ false);
+    InitTexOpt(&material->emissive_texopt, /* is_bump */ false);
+    InitTexOpt(&material->normal_texopt,
+        /* is_bump */ false);  // @fixme { is_bump will be true? }
+    material->name = "";
+    material->ambient_texname = "";
+    material->diffuse_texname = "";
+    material->specular_texname = "";
+    material->specular_highlight_texname = "";
+    material->bump_texname = "";
+    material->displacement_texname = "";
+    material->reflection_texname = "";
+    material->alpha_texname = "";
+    for (int i = 0; i < 3; i++) {
+        material->ambient[i] = static_cast<real_t>(0.0);
+        material->diffuse[i] = static_cast<real_t>(0.0);
+        material->specular[i] = static_cast<real_t>(0.0);
+        material->transmittance[i] = static_cast<real_t>(0.0);
+        material->emission[i] = static_cast<real_t>(0.0);
+    }
+    material->illum = 0;
+    material->dissolve = static_cast<real_t>(1.0);
+    material->shininess = static_cast<real_t>(1.0);
+    material->ior = static_cast<real_t>(1.0);
+
+    material->roughness = static_cast<real_t>(0.0);
+    material->metallic = static_cast<real_t>(0.0);
+    material->sheen = static_cast<real_t>(0.0);
+    material->clearcoat_thickness = static_cast<real_t>(0.0);
+    material->clearcoat_roughness = static_cast<real_t>(0.0);
+    material->anisotropy_rotation = static_cast<real_t>(0.0);
+    material->anisotropy = static_cast<real_t>(0.0);
+    material->roughness_texname = "";
+    material->metallic_texname = "";
+    material->sheen_texname = "";
+    material->emissive_texname = "";
+    material->normal_texname = "";
+
+    material->unknown_parameter.clear();
+}
+
+// code from https://wrf.ecse.rpi.edu//Research/Short_Notes/pnpoly.html
+template <typename T>
+static int pnpoly(int nvert, T* vertx, T* verty, T testx, T testy) {
+    int i, j, c = 0;
+    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
+        if (((verty[i] > testy) != (verty[j] > testy)) &&
+            (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
+            c = !c;
+    }
+    return c;
+}
+
+struct TinyObjPoint {
+    real_t x, y, z;
+    TinyObjPoint() : x(0), y(0), z(0) {}
+    TinyObjPoint(real_t x_, real_t y_, real_t z_) : x(x_), y(y_), z(z_) {}
+};
+
+inline TinyObjPoint cross(const TinyObjPoint& v1, const TinyObjPoint& v2) {
+    return TinyObjPoint(v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x);
+}
+
+inline real_t dot(const TinyObjPoint& v1, const TinyObjPoint& v2) {
+    return (v1.x * v2.x + v1.y * v2.y + v1.z * v2.z);
+}
+
+inline real_t GetLength(TinyObjPoint& e) {
+    return std::sqrt(e.x * e.x + e.y * e.y + e.z * e.z);
+}
+
+inline TinyObjPoint Normalize(TinyObjPoint e) {
+    real_t inv_length = real_t(1) / GetLength(e);
+    return TinyObjPoint(e.x * inv_length, e.y * inv_length, e.z * inv_length);
+}
+
+inline TinyObjPoint WorldToLocal(const TinyObjPoint& a, const TinyObjPoint& u, const TinyObjPoint& v, const TinyObjPoint& w) {
+    return TinyObjPoint(dot(a, u), dot(a, v), dot(a, w));
+}
+
+// Runs `fn(i)` for each i in [0, n) on up to `num_threads` threads.
+template <typename Fn>
+static void parallelFor(size_t n, unsigned int num_threads, const Fn& fn) {
+    if (num_threads > n) {
+        num_threads = static_cast<unsigned int>(n);
+    }
+    if (num_threads <= 1) {
+        for (size_t i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (;;) {
+            size_t i = next.fetch_add(1);
+            if (i >= n) {
+                break;
+            }
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (unsigned int t = 1; t < num_threads; t++) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+}
+
+// 0 = use all hardware threads.
+static unsigned int ResolveNumThreads(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    return num_threads > 0 ? num_threads : 1;
+}
+
+// Appends `face` to `mesh`, triangulated when `triangulate` is set.
+static void exportFaceToMesh(mesh_t* mesh, const face_t& face, const int material_id, bool triangulate, const std::vector<real_t>& v,
+    std::string* warn) {
+    size_t npolys = face.vertex_indices.size();
+
+    if (npolys < 3) {
+        // Face must have 3+ vertices.
+        if (warn) {
+            (*warn) += "Degenerated face found\n.";
+        }
+        return;
+    }
+
+    if (triangulate && npolys != 3) {
+        if (npolys == 4) {
+            vertex_index_t i0 = face.vertex_indices[0];
+            vertex_index_t i1 = face.vertex_indices[1];
+            vertex_index_t i2 = face.vertex_indices[2];
+            vertex_index_t i3 = face.vertex_indices[3];
+
+            size_t vi0 = size_t(i0.v_idx);
+            size_t vi1 = size_t(i1.v_idx);
+            size_t vi2 = size_t(i2.v_idx);
+            size_t vi3 = size_t(i3.v_idx);
+
+            if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) || ((3 * vi2 + 2) >= v.size()) ||
+                ((3 * vi3 + 2) >= v.size())) {
+                // Invalid triangle.
+                // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
+                if (warn) {
+                    (*warn) += "Face with invalid vertex index found.\n";
+                }
+                return;
+            }
+
+            real_t v0x = v[vi0 * 3 + 0];
+            real_t v0y = v[vi0 * 3 + 1];
+            real_t v0z = v[vi0 * 3 + 2];
+            real_t v1x = v[vi1 * 3 + 0];
+            real_t v1y = v[vi1 * 3 + 1];
+            real_t v1z = v[vi1 * 3 + 2];
+            real_t v2x = v[vi2 * 3 + 0];
+            real_t v2y = v[vi2 * 3 + 1];
+            real_t v2z = v[vi2 * 3 + 2];
+            real_t v3x = v[vi3 * 3 + 0];
+            real_t v3y = v[vi3 * 3 + 1];
+            real_t v3z = v[vi3 * 3 + 2];
+
+            // There are two candidates to split the quad into two triangles.
+            //
+            // Choose the shortest edge.
+            // TODO: Is it better to determine the edge to split by calculating
+            // the area of each triangle?
+            //
+            // +---+
+            // |\  |
+            // | \ |
+            // |  \|
+            // +---+
+            //
+            // +---+
+            // |  /|
+            // | / |
+            // |/  |
+            // +---+
+
+            real_t e02x = v2x - v0x;
+            real_t e02y = v2y - v0y;
+            real_t e02z = v2z - v0z;
+            real_t e13x = v3x - v1x;
+            real_t e13y = v3y - v1y;
+            real_t e13z = v3z - v1z;
+
+            real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+            real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+            index_t idx0, idx1, idx2, idx3;
+
+            idx0.vertex_index = i0.v_idx;
+            idx0.normal_index = i0.vn_idx;
+            idx0.texcoord_index = i0.vt_idx;
+            idx1.vertex_index = i1.v_idx;
+            idx1.normal_index = i1.vn_idx;
+            idx1.texcoord_index = i1.vt_idx;
+            idx2.vertex_index = i2.v_idx;
+            idx2.normal_index = i2.vn_idx;
+            idx2.texcoord_index = i2.vt_idx;
+            idx3.vertex_index = i3.v_idx;
+            idx3.normal_index = i3.vn_idx;
+            idx3.texcoord_index = i3.vt_idx;
+
+            if (sqr02 < sqr13) {
+                // [0, 1, 2], [0, 2, 3]
+                mesh->indices.push_back(idx0);
+                mesh->indices.push_back(idx1);
+                mesh->indices.push_back(idx2);
+
+                mesh->indices.push_back(idx0);
+                mesh->indices.push_back(idx2);
+                mesh->indices.push_back(idx3);
+            } else {
+                // [0, 1, 3], [1, 2, 3]
+                mesh->indices.push_back(idx0);
+                mesh->indices.push_back(idx1);
+                mesh->indices.push_back(idx3);
+
+                mesh->indices.push_back(idx1);
+                mesh->indices.push_back(idx2);
+                mesh->indices.push_back(idx3);
+            }
+
+            // Two triangle faces
+            mesh->num_face_vertices.push_back(3);
+            mesh->num_face_vertices.push_back(3);
+
+            mesh->material_ids.push_back(material_id);
+            mesh->material_ids.push_back(material_id);
+
+            mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+            mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+
+        } else {
+#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
+            vertex_index_t i0 = face.vertex_indices[0];
+            vertex_index_t i0_2 = i0;
+
+            // TMW change: Find the normal axis of the polygon using Newell's method
+            TinyObjPoint n;
+            for (size_t k = 0; k < npolys; ++k) {
+                i0 = face.vertex_indices[k % npolys];
+                size_t vi0 = size_t(i0.v_idx);
+
+                size_t j = (k + 1) % npolys;
+                i0_2 = face.vertex_indices[j];
+                size_t vi0_2 = size_t(i0_2.v_idx);
+
+                real_t v0x = v[vi0 * 3 + 0];
+                real_t v0y = v[vi0 * 3 + 1];
+                real_t v0z = v[vi0 * 3 + 2];
+
+                real_t v0x_2 = v[vi0_2 * 3 + 0];
+                real_t v0y_2 = v[vi0_2 * 3 + 1];
+                real_t v0z_2 = v[vi0_2 * 3 + 2];
+
+                const TinyObjPoint point1(v0x, v0y, v0z);
+                const TinyObjPoint point2(v0x_2, v0y_2, v0z_2);
+
+                TinyObjPoint a(point1.x - point2.x, point1.y - point2.y, point1.z - point2.z);
+                TinyObjPoint b(point1.x + point2.x, point1.y + point2.y, point1.z + point2.z);
+
+                n.x += (a.y * b.z);
+                n.y += (a.z * b.x);
+                n.z += (a.x * b.y);
+            }
+            real_t length_n = GetLength(n);
+            // Check if zero length normal
+            if (length_n <= 0) {
+                return;
+            }
+            // Negative is to flip the normal to the correct direction
+            real_t inv_length = -real_t(1.0) / length_n;
+            n.x *= inv_length;
+            n.y *= inv_length;
+            n.z *= inv_length;
+
+            TinyObjPoint axis_w, axis_v, axis_u;
+            axis_w = n;
+            TinyObjPoint a;
+            if (std::abs(axis_w.x) > real_t(0.9999999)) {
+                a = TinyObjPoint(0, 1, 0);
+            } else {
+                a = TinyObjPoint(1, 0, 0);
+            }
+            axis_v = Normalize(cross(axis_w, a));
+            axis_u = cross(axis_w, axis_v);
+            using Point = std::array<real_t, 2>;
+
+            // first polyline define the main polygon.
+            // following polylines define holes(not used in tinyobj).
+            std::vector<std::vector<Point>> polygon;
+
+            std::vector<Point> polyline;
+
+            // TMW change: Find best normal and project v0x and v0y to those coordinates, instead of
+            // picking a plane aligned with an axis (which can flip polygons).
+
+            // Fill polygon data(facevarying vertices).
+            for (size_t k = 0; k < npolys; k++) {
+                i0 = face.vertex_indices[k];
+                size_t vi0 = size_t(i0.v_idx);
+
+                assert(((3 * vi0 + 2) < v.size()));
+
+                real_t v0x = v[vi0 * 3 + 0];
+                real_t v0y = v[vi0 * 3 + 1];
+                real_t v0z = v[vi0 * 3 + 2];
+
+                TinyObjPoint polypoint(v0x, v0y, v0z);
+                TinyObjPoint loc = WorldToLocal(polypoint, axis_u, axis_v, axis_w);
+
+                polyline.push_back({loc.x, loc.y});
+            }
+
+            polygon.push_back(polyline);
+            std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
+            // => result = 3 * faces, clockwise
+
+            assert(indices.size() % 3 == 0);
+
+            // Reconstruct vertex_index_t
+            for (size_t k = 0; k < indices.size() / 3; k++) {
+                {
+                    index_t idx0, idx1, idx2;
+                    idx0.vertex_index = face.vertex_indices[indices[3 * k + 0]].v_idx;
+                    idx0.normal_index = face.vertex_indices[indices[3 * k + 0]].vn_idx;
+                    idx0.texcoord_index = face.vertex_indices[indices[3 * k + 0]].vt_idx;
+                    idx1.vertex_index = face.vertex_indices[indices[3 * k + 1]].v_idx;
+                    idx1.normal_index = face.vertex_indices[indices[3 * k + 1]].vn_idx;
+                    idx1.texcoord_index = face.vertex_indices[indices[3 * k + 1]].vt_idx;
+                    idx2.vertex_index = face.vertex_indices[indices[3 * k + 2]].v_idx;
+                    idx2.normal_index = face.vertex_indices[indices[3 * k + 2]].vn_idx;
+                    idx2.texcoord_index = face.vertex_indices[indices[3 * k + 2]].vt_idx;
+
+                    mesh->indices.push_back(idx0);
+                    mesh->indices.push_back(idx1);
+                    mesh->indices.push_back(idx2);
+
+                    mesh->num_face_vertices.push_back(3);
+                    mesh->material_ids.push_back(material_id);
+                    mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+                }
+            }
+
+#else  // Built-in ear clipping triangulation
+            vertex_index_t i0 = face.vertex_indices[0];
+            vertex_index_t i1(-1);
+            vertex_index_t i2 = face.vertex_indices[1];
+
+            // find the two axes to work in
+            size_t axes[2] = {1, 2};
+            for (size_t k = 0; k < npolys; ++k) {
+                i0 = face.vertex_indices[(k + 0) % npolys];
+                i1 = face.vertex_indices[(k + 1) % npolys];
+                i2 = face.vertex_indices[(k + 2) % npolys];
+                size_t vi0 = size_t(i0.v_idx);
+                size_t vi1 = size_t(i1.v_idx);
+                size_t vi2 = size_t(i2.v_idx);
+
+                if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) || ((3 * vi2 + 2) >= v.size())) {
+                    // Invalid triangle.
+                    // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
+                    continue;
+                }
+                real_t v0x = v[vi0 * 3 + 0];
+                real_t v0y = v[vi0 * 3 + 1];
+                real_t v0z = v[vi0 * 3 + 2];
+                real_t v1x = v[vi1 * 3 + 0];
+                real_t v1y = v[vi1 * 3 + 1];
+                real_t v1z = v[vi1 * 3 + 2];
+                real_t v2x = v[vi2 * 3 + 0];
+                real_t v2y = v[vi2 * 3 + 1];
+                real_t v2z = v[vi2 * 3 + 2];
+                real_t e0x = v1x - v0x;
+                real_t e0y = v1y - v0y;
+                real_t e0z = v1z - v0z;
+                real_t e1x = v2x - v1x;
+                real_t e1y = v2y - v1y;
+                real_t e1z = v2z - v1z;
+                real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+                real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+                real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+                const real_t epsilon = std::numeric_limits<real_t>::epsilon();
+                // std::cout << "cx " << cx << ", cy " << cy << ", cz " << cz <<
+                // "\n";
+                if (cx > epsilon || cy > epsilon || cz > epsilon) {
+                    // std::cout << "corner\n";
+                    // found a corner
+                    if (cx > cy && cx > cz) {
+                        // std::cout << "pattern0\n";
+                    } else {
+                        // std::cout << "axes[0] = 0\n";
+                        axes[0] = 0;
+                        if (cz > cx && cz > cy) {
+                            // std::cout << "axes[1] = 1\n";
+                            axes[1] = 1;
+                        }
+                    }
+                    break;
+                }
+            }
+
+            face_t remainingFace = face;  // copy
+            size_t guess_vert = 0;
+            vertex_index_t ind[3];
+            real_t vx[3];
+            real_t vy[3];
+
+            // How many iterations can we do without decreasing the remaining
+            // vertices.
+            size_t remainingIterations = face.vertex_indices.size();
+            size_t previousRemainingVertices = remainingFace.vertex_indices.size();
+
+            while (remainingFace.vertex_indices.size() > 3 && remainingIterations > 0) {
+                // std::cout << "remainingIterations " << remainingIterations <<
+                // "\n";
+
+                npolys = remainingFace.vertex_indices.size();
+                if (guess_vert >= npolys) {
+                    guess_vert -= npolys;
+                }
+
+                if (previousRemainingVertices != npolys) {
+                    // The number of remaining vertices decreased. Reset counters.
+                    previousRemainingVertices = npolys;
+                    remainingIterations = npolys;
+                } else {
+                    // We didn't consume a vertex on previous iteration, reduce the
+                    // available iterations.
+                    remainingIterations--;
+                }
+
+                for (size_t k = 0; k < 3; k++) {
+                    ind[k] = remainingFace.vertex_indices[(guess_vert + k) % npolys];
+                    size_t vi = size_t(ind[k].v_idx);
+                    if (((vi * 3 + axes[0]) >= v.size()) || ((vi * 3 + axes[1]) >= v.size())) {
+                        // ???
+                        vx[k] = static_cast<real_t>(0.0);
+                        vy[k] = static_cast<real_t>(0.0);
+                    } else {
+                        vx[k] = v[vi * 3 + axes[0]];
+                        vy[k] = v[vi * 3 + axes[1]];
+                    }
+                }
+
+                //
+                // area is calculated per face
+                //
+                real_t e0x = vx[1] - vx[0];
+                real_t e0y = vy[1] - vy[0];
+                real_t e1x = vx[2] - vx[1];
+                real_t e1y = vy[2] - vy[1];
+                real_t cross = e0x * e1y - e0y * e1x;
+                // std::cout << "axes = " << axes[0] << ", " << axes[1] << "\n";
+                // std::cout << "e0x, e0y, e1x, e1y " << e0x << ", " << e0y << ", "
+                // << e1x << ", " << e1y << "\n";
+
+                real_t area = (vx[0] * vy[1] - vy[0] * vx[1]) * static_cast<real_t>(0.5);
+                // std::cout << "cross " << cross << ", area " << area << "\n";
+                // if an internal angle
+                if (cross * area < static_cast<real_t>(0.0)) {
+                    // std::cout << "internal \n";
+                    guess_vert += 1;
+                    // std::cout << "guess vert : " << guess_vert << "\n";
+                    continue;
+                }
+
+                // check all other verts in case they are inside this triangle
+                bool overlap = false;
+                for (size_t otherVert = 3; otherVert < npolys; ++otherVert) {
+                    size_t idx = (guess_vert + otherVert) % npolys;
+
+                    if (idx >= remainingFace.vertex_indices.size()) {
+                        // std::cout << "???0\n";
+                        // ???
+                        continue;
+                    }
+
+                    size_t ovi = size_t(remainingFace.vertex_indices[idx].v_idx);
+
+                    if (((ovi * 3 + axes[0]) >= v.size()) || ((ovi * 3 + axes[1]) >= v.size())) {
+                        // std::cout << "???1\n";
+                        // ???
+                        continue;
+                    }
+                    real_t tx = v[ovi * 3 + axes[0]];
+                    real_t ty = v[ovi * 3 + axes[1]];
+                    if (pnpoly(3, vx, vy, tx, ty)) {
+                        // std::cout << "overlap\n";
+                        overlap = true;
+                        break;
+                    }
+                }
+
+                if (overlap) {
+                    // std::cout << "overlap2\n";
+                    guess_vert += 1;
+                    continue;
+                }
+
+                // this triangle is an ear
+                {
+                    index_t idx0, idx1, idx2;
+                    idx0.vertex_index = ind[0].v_idx;
+                    idx0.normal_index = ind[0].vn_idx;
+                    idx0.texcoord_index = ind[0].vt_idx;
+                    idx1.vertex_index = ind[1].v_idx;
+                    idx1.normal_index = ind[1].vn_idx;
+                    idx1.texcoord_index = ind[1].vt_idx;
+                    idx2.vertex_index = ind[2].v_idx;
+                    idx2.normal_index = ind[2].vn_idx;
+                    idx2.texcoord_index = ind[2].vt_idx;
+
+                    mesh->indices.push_back(idx0);
+                    mesh->indices.push_back(idx1);
+                    mesh->indices.push_back(idx2);
+
+                    mesh->num_face_vertices.push_back(3);
+                    mesh->material_ids.push_back(material_id);
+                    mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+                }
+
+                // remove v1 from the list
+                size_t removed_vert_index = (guess_vert + 1) % npolys;
+                while (removed_vert_index + 1 < npolys) {
+                    remainingFace.vertex_indices[removed_vert_index] = remainingFace.vertex_indices[removed_vert_index + 1];
+                    removed_vert_index += 1;
+                }
+                remainingFace.vertex_indices.pop_back();
+            }
+
+            // std::cout << "remainingFace.vi.size = " <<
+            // remainingFace.vertex_indices.size() << "\n";
+            if (remainingFace.vertex_indices.size() == 3) {
+                i0 = remainingFace.vertex_indices[0];
+                i1 = remainingFace.vertex_indices[1];
+                i2 = remainingFace.vertex_indices[2];
+                {
+                    index_t idx0, idx1, idx2;
+                    idx0.vertex_index = i0.v_idx;
+                    idx0.normal_index = i0.vn_idx;
+                    idx0.texcoord_index = i0.vt_idx;
+                    idx1.vertex_index = i1.v_idx;
+                    idx1.normal_index = i1.vn_idx;
+                    idx1.texcoord_index = i1.vt_idx;
+                    idx2.vertex_index = i2.v_idx;
+                    idx2.normal_index = i2.vn_idx;
+                    idx2.texcoord_index = i2.vt_idx;
+
+                    mesh->indices.push_back(idx0);
+                    mesh->indices.push_back(idx1);
+                    mesh->indices.push_back(idx2);
+
+                    mesh->num_face_vertices.push_back(3);
+                    mesh->material_ids.push_back(material_id);
+                    mesh->smoothing_group_ids.push_back(face.smoothing_group_id);
+                }
+            }
+#endif
+        }  // npolys
+    } else {
+        for (size_t k = 0; k < npolys; k++) {
+            index_t idx;
+            idx.vertex_index = face.vertex_indices[k].v_idx;
+            idx.normal_index = face.vertex_indices[k].vn_idx;
+            idx.texcoord_index = face.vertex_indices[k].vt_idx;
+            mesh->indices.push_back(idx);
+        }
+
+        mesh->num_face_vertices.push_back(static_cast<unsigned char>(npolys));
+        mesh->material_ids.push_back(material_id);                     // per face
+        mesh->smoothing_group_ids.push_back(face.smoothing_group_id);  // per face
+    }
+}
+
+// Faces of a group below this count are exported on the calling thread.
+static const size_t kParallelTriangulateMinFaces = 16384;
+
+// Exports(and triangulates) the faces of `prim_group` in independent ranges
+// on up to `num_threads` threads. Each range is written to a mesh of its own,
+// then the ranges are copied into `mesh` at the offsets given by a prefix sum
+// over their sizes. The result and the order of the warnings are the same as
+// exporting the faces one by one.
+static void exportFacesParallel(mesh_t* mesh, const PrimGroup& prim_group, const int material_id, bool triangulate,
+    const std::vector<real_t>& v, std::string* warn, unsigned int num_threads) {
+    const size_t num_faces = prim_group.faceGroup.size();
+    const size_t num_ranges = std::min(static_cast<size_t>(num_threads) * 4, num_faces / (kParallelTriangulateMinFaces / 4));
+
+    std::vector<mesh_t> range_meshes(num_ranges);
+    std::vector<std::string> range_warns(num_ranges);
+    parallelFor(num_ranges, num_threads, [&](size_t r) {
+        const size_t begin = num_faces * r / num_ranges;
+        const size_t end = num_faces * (r + 1) / num_ranges;
+        mesh_t& range_mesh = range_meshes[r];
+        range_mesh.indices.reserve((end - begin) * 3);
+        range_mesh.num_face_vertices.reserve(end - begin);
+        range_mesh.material_ids.reserve(end - begin);
+        range_mesh.smoothing_group_ids.reserve(end - begin);
+        for (size_t i = begin; i < end; i++) {
+            exportFaceToMesh(&range_mesh, prim_group.faceGroup[i], material_id, triangulate, v, warn ? &range_warns[r] : NULL);
+        }
+    });
+
+    // Output slots of the ranges.
+    std::vector<size_t> index_offsets(num_ranges + 1, 0);
+    std::vector<size_t> face_offsets(num_ranges + 1, 0);
+    for (size_t r = 0; r < num_ranges; r++) {
+        index_offsets[r + 1] = index_offsets[r] + range_meshes[r].indices.size();
+        face_offsets[r + 1] = face_offsets[r] + range_meshes[r].num_face_vertices.size();
+    }
+
+    const size_t index_base = mesh->indices.size();
+    const size_t face_base = mesh->num_face_vertices.size();
+    const size_t material_base = mesh->material_ids.size();
+    const size_t smoothing_base = mesh->smoothing_group_ids.size();
+    mesh->indices.resize(index_base + index_offsets.back());
+    mesh->num_face_vertices.resize(face_base + face_offsets.back());
+    mesh->material_ids.resize(material_base + face_offsets.back());
+    mesh->smoothing_group_ids.resize(smoothing_base + face_offsets.back());
+
+    parallelFor(num_ranges, num_threads, [&](size_t r) {
+        mesh_t& range_mesh = range_meshes[r];
+        std::copy(range_mesh.indices.begin(), range_mesh.indices.end(), mesh->indices.begin() + index_base + index_offsets[r]);
+        std::copy(range_mesh.num_face_vertices.begin(), range_mesh.num_face_vertices.end(),
+            mesh->num_face_vertices.begin() + face_base + face_offsets[r]);
+        std::copy(
+            range_mesh.material_ids.begin(), range_mesh.material_ids.end(), mesh->material_ids.begin() + material_base + face_offsets[r]);
+        std::copy(range_mesh.smoothing_group_ids.begin(), range_mesh.smoothing_group_ids.end(),
+            mesh->smoothing_group_ids.begin() + smoothing_base + face_offsets[r]);
+        range_mesh = mesh_t();
+    });
+
+    if (warn) {
+        for (size_t r = 0; r < num_ranges; r++) {
+            (*warn) += range_warns[r];
+        }
+    }
+}
+
+// TODO(syoyo): refactor function.
+// `num_threads` > 1 exports large face groups with `exportFacesParallel`.
+static bool exportGroupsToShape(shape_t* shape, const PrimGroup& prim_group, const std::vector<tag_t>& tags, const int material_id,
+    const std::string& name, bool triangulate, const std::vector<real_t>& v, std::string* warn, unsigned int num_threads = 1) {
+    if (prim_group.IsEmpty()) {
+        return false;
+    }
+
+    shape->name = name;
+
+    // polygon
+    if (!prim_group.faceGroup.empty()) {
+        // Flatten vertices and indices
+        const size_t num_faces = prim_group.faceGroup.size();
+        if (num_threads > 1 && num_faces >= kParallelTriangulateMinFaces) {
+            exportFacesParallel(&shape->mesh, prim_group, material_id, triangulate, v, warn, num_threads);
+        } else {
+            for (size_t i = 0; i < num_faces; i++) {
+                exportFaceToMesh(&shape->mesh, prim_group.faceGroup[i], material_id, triangulate, v, warn);
+            }
+        }
+
+        shape->mesh.tags = tags;
+    }
+
+    // line
+    if (!prim_group.lineGroup.empty()) {
+        // Flatten indices
+        for (size_t i = 0; i < prim_group.lineGroup.size(); i++) {
+            for (size_t j = 0; j < prim_group.lineGroup[i].vertex_indices.size(); j++) {
+                const vertex_index_t& vi = prim_group.lineGroup[i].vertex_indices[j];
+
+                index_t idx;
+                idx.vertex_index = vi.v_idx;
+                idx.normal_index = vi.vn_idx;
+                idx.texcoord_index = vi.vt_idx;
+
+                shape->lines.indices.push_back(idx);
+            }
+
+            shape->lines.num_line_vertices.push_back(int(prim_group.lineGroup[i].vertex_indices.size()));
+        }
+    }
+
+    // points
+    if (!prim_group.pointsGroup.empty()) {
+        // Flatten & convert indices
+        for (size_t i = 0; i < prim_group.pointsGroup.size(); i++) {
+            for (size_t j = 0; j < prim_group.pointsGroup[i].vertex_indices.size(); j++) {
+                const vertex_index_t& vi = prim_group.pointsGroup[i].vertex_indices[j];
+
+                index_t idx;
+                idx.vertex_index = vi.v_idx;
+                idx.normal_index = vi.vn_idx;
+                idx.texcoord_index = vi.vt_idx;
+
+                shape->points.indices.push_back(idx);
+            }
+        }
+    }
+
+    return true;
+}
+
+// Split a string with specified delimiter character and escape character.
+// https://rosettacode.org/wiki/Tokenize_a_string_with_escaping#C.2B.2B
+static void SplitString(const std::string& s, char delim, char escape, std::vector<std::string>& elems) {
+    std::string token;
+
+    bool escaping = false;
+    for (size_t i = 0; i < s.size(); ++i) {
+        char ch = s[i];
+        if (escaping) {
+            escaping = false;
+        } else if (ch == escape) {
+            escaping = true;
+            continue;
+        } else if (ch == delim) {
+            if (!token.empty()) {
+                elems.push_back(token);
+            }
+            token.clear();
+            continue;
+        }
+        token += ch;
+    }
+
+    elems.push_back(token);
+}
+
+static std::string JoinPath(const std::string& dir, const std::string& filename) {
+    if (dir.empty()) {
+        return filename;
+    } else {
+        // check '/'
+        char lastChar = *dir.rbegin();
+        if (lastChar != '/') {
+            return dir + std::string("/") + filename;
+        } else {
+            return dir + filename;
+        }
+    }
+}
+
+void LoadMtl(std::map<std::string, int>* material_map, std::vector<material_t>* materials, std::istream* inStream, std::string* warning,
+    std::string* err) {
+    (void)err;
+
+    // Create a default material anyway.
+    material_t material;
+    InitMaterial(&material);
+
+    // Issue 43. `d` wins against `Tr` since `Tr` is not in the MTL specification.
+    bool has_d = false;
+    bool has_tr = false;
+
+    // has_kd is used to set a default diffuse value when map_Kd is present
+    // and Kd is not.
+    bool has_kd = false;
+
+    std::stringstream warn_ss;
+
+    size_t line_no = 0;
+    std::string linebuf;
+    while (inStream->peek() != -1) {
+        safeGetline(*inStream, linebuf);
+        line_no++;
+
+        // Trim trailing whitespace.
+        if (linebuf.size() > 0) {
+            linebuf = linebuf.substr(0, linebuf.find_last_not_of(" \t") + 1);
+        }
+
+        // Trim newline '\r\n' or '\n'
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+        }
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
+        }
+
+        // Skip if empty line.
+        if (linebuf.empty()) {
+            continue;
+        }
+
+        // Skip leading space.
+        const char* token = SkipSpace(linebuf.c_str());
+
+        assert(token);
+        if (token[0] == '\0') continue;  // empty line
+
+        if (token[0] == '#') continue;  // comment line
+
+        // new mtl
+        if ((0 == strncmp(token, "newmtl", 6)) && IS_SPACE((token[6]))) {
+            // flush previous material.
+            if (!material.name.empty()) {
+                material_map->insert(std::pair<std::string, int>(material.name, static_cast<int>(materials->size())));
+                materials->push_back(material);
+            }
+
+            // initial temporary material
+            InitMaterial(&material);
+
+            has_d = false;
+            has_tr = false;
+
+            // set new mtl name
+            token += 7;
+            {
+                std::string namebuf = parseString(&token);
+                // TODO: empty name check?
+                if (namebuf.empty()) {
+                    if (warning) {
+                        (*warning) += "empty material name in `newmtl`\n";
+                    }
+                }
+                material.name = namebuf;
+            }
+            continue;
+        }
+
+        // ambient
+        if (token[0] == 'K' && token[1] == 'a' && IS_SPACE((token[2]))) {
+            token += 2;
+            real_t r, g, b;
+            parseReal3(&r, &g, &b, &token);
+            material.ambient[0] = r;
+            material.ambient[1] = g;
+            material.ambient[2] = b;
+            continue;
+        }
+
+        // diffuse
+        if (token[0] == 'K' && token[1] == 'd' && IS_SPACE((token[2]))) {
+            token += 2;
+            real_t r, g, b;
+            parseReal3(&r, &g, &b, &token);
+            material.diffuse[0] = r;
+            material.diffuse[1] = g;
+            material.diffuse[2] = b;
+            has_kd = true;
+            continue;
+        }
+
+        // specular
+        if (token[0] == 'K' && token[1] == 's' && IS_SPACE((token[2]))) {
+            token += 2;
+            real_t r, g, b;
+            parseReal3(&r, &g, &b, &token);
+            material.specular[0] = r;
+            material.specular[1] = g;
+            material.specular[2] = b;
+            continue;
+        }
+
+        // transmittance
+        if ((token[0] == 'K' && token[1] == 't' && IS_SPACE((token[2]))) || (token[0] == 'T' && token[1] == 'f' && IS_SPACE((token[2])))) {
+            token += 2;
+            real_t r, g, b;
+            parseReal3(&r, &g, &b, &token);
+            material.transmittance[0] = r;
+            material.transmittance[1] = g;
+            material.transmittance[2] = b;
+            continue;
+        }
+
+        // ior(index of refraction)
+        if (token[0] == 'N' && token[1] == 'i' && IS_SPACE((token[2]))) {
+            token += 2;
+            material.ior = parseReal(&token);
+            continue;
+        }
+
+        // emission
+        if (token[0] == 'K' && token[1] == 'e' && IS_SPACE(token[2])) {
+            token += 2;
+            real_t r, g, b;
+            parseReal3(&r, &g, &b, &token);
+            material.emission[0] = r;
+            material.emission[1] = g;
+            material.emission[2] = b;
+            continue;
+        }
+
+        // shininess
+        if (token[0] == 'N' && token[1] == 's' && IS_SPACE(token[2])) {
+            token += 2;
+            material.shininess = parseReal(&token);
+            continue;
+        }
+
+        // illum model
+        if (0 == strncmp(token, "illum", 5) && IS_SPACE(token[5])) {
+            token += 6;
+            material.illum = parseInt(&token);
+            continue;
+        }
+
+        // dissolve
+        if ((token[0] == 'd' && IS_SPACE(token[1]))) {
+            token += 1;
+            material.dissolve = parseReal(&token);
+
+            if (has_tr) {
+                warn_ss << "Both `d` and `Tr` parameters defined for \"" << material.name << "\". Use the value of `d` for dissolve (line "
+                        << line_no << " in .mtl.)\n";
+            }
+            has_d = true;
+            continue;
+        }
+        if (token[0] == 'T' && token[1] == 'r' && IS_SPACE(token[2])) {
+            token += 2;
+            if (has_d) {
+                // `d` wins. Ignore `Tr` value.
+                warn_ss << "Both `d` and `Tr` parameters defined for \"" << material.name << "\". Use the value of `d` for dissolve (line "
+                        << line_no << " in .mtl.)\n";
+            } else {
+                // We invert value of Tr(assume Tr is in range [0, 1])
+                // NOTE: Interpretation of Tr is application(exporter) dependent. For
+                // some application(e.g. 3ds max obj exporter), Tr = d(Issue 43)
+                material.dissolve = static_cast<real_t>(1.0) - parseReal(&token);
+            }
+            has_tr = true;
+            continue;
+        }
+
+        // PBR: roughness
+        if (token[0] == 'P' && token[1] == 'r' && IS_SPACE(token[2])) {
+            token += 2;
+            material.roughness = parseReal(&token);
+            continue;
+        }
+
+        // PBR: metallic
+        if (token[0] == 'P' && token[1] == 'm' && IS_SPACE(token[2])) {
+            token += 2;
+            material.metallic = parseReal(&token);
+            continue;
+        }
+
+        // PBR: sheen
+        if (token[0] == 'P' && token[1] == 's' && IS_SPACE(token[2])) {
+            token += 2;
+            material.sheen = parseReal(&token);
+            continue;
+        }
+
+        // PBR: clearcoat thickness
+        if (token[0] == 'P' && token[1] == 'c' && IS_SPACE(token[2])) {
+            token += 2;
+            material.clearcoat_thickness = parseReal(&token);
+            continue;
+        }
+
+        // PBR: clearcoat roughness
+        if ((0 == strncmp(token, "Pcr", 3)) && IS_SPACE(token[3])) {
+            token += 4;
+            material.clearcoat_roughness = parseReal(&token);
+            continue;
+        }
+
+        // PBR: anisotropy
+        if ((0 == strncmp(token, "aniso", 5)) && IS_SPACE(token[5])) {
+            token += 6;
+            material.anisotropy = parseReal(&token);
+            continue;
+        }
+
+        // PBR: anisotropy rotation
+        if ((0 == strncmp(token, "anisor", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            material.anisotropy_rotation = parseReal(&token);
+            continue;
+        }
+
+        // ambient or ambient occlusion texture
+        if ((0 == strncmp(token, "map_Ka", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.ambient_texname), &(material.ambient_texopt), token);
+            continue;
+        }
+
+        // diffuse texture
+        if ((0 == strncmp(token, "map_Kd", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.diffuse_texname), &(material.diffuse_texopt), token);
+
+            // Set a decent diffuse default value if a diffuse texture is specified
+            // without a matching Kd value.
+            if (!has_kd) {
+                material.diffuse[0] = static_cast<real_t>(0.6);
+                material.diffuse[1] = static_cast<real_t>(0.6);
+                material.diffuse[2] = static_cast<real_t>(0.6);
+            }
+
+            continue;
+        }
+
+        // specular texture
+        if ((0 == strncmp(token, "map_Ks", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.specular_texname), &(material.specular_texopt), token);
+            continue;
+        }
+
+        // specular highlight texture
+        if ((0 == strncmp(token, "map_Ns", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.specular_highlight_texname), &(material.specular_highlight_texopt), token);
+            continue;
+        }
+
+        // bump texture
+        if (((0 == strncmp(token, "map_bump", 8)) || (0 == strncmp(token, "map_Bump", 8))) && IS_SPACE(token[8])) {
+            token += 9;
+            ParseTextureNameAndOption(&(material.bump_texname), &(material.bump_texopt), token);
+            continue;
+        }
+
+        // bump texture
+        if ((0 == strncmp(token, "bump", 4)) && IS_SPACE(token[4])) {
+            token += 5;
+            ParseTextureNameAndOption(&(material.bump_texname), &(material.bump_texopt), token);
+            continue;
+        }
+
+        // alpha texture
+        if ((0 == strncmp(token, "map_d", 5)) && IS_SPACE(token[5])) {
+            token += 6;
+            material.alpha_texname = token;
+            ParseTextureNameAndOption(&(material.alpha_texname), &(material.alpha_texopt), token);
+            continue;
+        }
+
+        // displacement texture
+        if (((0 == strncmp(token, "map_disp", 8)) || (0 == strncmp(token, "map_Disp", 8))) && IS_SPACE(token[8])) {
+            token += 9;
+            ParseTextureNameAndOption(&(material.displacement_texname), &(material.displacement_texopt), token);
+            continue;
+        }
+
+        // displacement texture
+        if ((0 == strncmp(token, "disp", 4)) && IS_SPACE(token[4])) {
+            token += 5;
+            ParseTextureNameAndOption(&(material.displacement_texname), &(material.displacement_texopt), token);
+            continue;
+        }
+
+        // reflection map
+        if ((0 == strncmp(token, "refl", 4)) && IS_SPACE(token[4])) {
+            token += 5;
+            ParseTextureNameAndOption(&(material.reflection_texname), &(material.reflection_texopt), token);
+            continue;
+        }
+
+        // PBR: roughness texture
+        if ((0 == strncmp(token, "map_Pr", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.roughness_texname), &(material.roughness_texopt), token);
+            continue;
+        }
+
+        // PBR: metallic texture
+        if ((0 == strncmp(token, "map_Pm", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.metallic_texname), &(material.metallic_texopt), token);
+            continue;
+        }
+
+        // PBR: sheen texture
+        if ((0 == strncmp(token, "map_Ps", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.sheen_texname), &(material.sheen_texopt), token);
+            continue;
+        }
+
+        // PBR: emissive texture
+        if ((0 == strncmp(token, "map_Ke", 6)) && IS_SPACE(token[6])) {
+            token += 7;
+            ParseTextureNameAndOption(&(material.emissive_texname), &(material.emissive_texopt), token);
+            continue;
+        }
+
+        // PBR: normal map texture
+        if ((0 == strncmp(token, "norm", 4)) && IS_SPACE(token[4])) {
+            token += 5;
+            ParseTextureNameAndOption(&(material.normal_texname), &(material.normal_texopt), token);
+            continue;
+        }
+
+        // unknown parameter
+        const char* _space = strchr(token, ' ');
+        if (!_space) {
+            _space = strchr(token, '\t');
+        }
+        if (_space) {
+            std::ptrdiff_t len = _space - token;
+            std::string key(token, static_cast<size_t>(len));
+            std::string value = _space + 1;
+            material.unknown_parameter.insert(std::pair<std::string, std::string>(key, value));
+        }
+    }
+    // flush last material.
+    material_map->insert(std::pair<std::string, int>(material.name, static_cast<int>(materials->size())));
+    materials->push_back(material);
+
+    if (warning) {
+        (*warning) = warn_ss.str();
+    }
+}
+
+// Candidate paths of .mtl file `matId`, in the order `MaterialFileReader`
+// searches them.
+static std::vector<std::string> MaterialFilePaths(const std::string& mtl_basedir, const std::string& matId) {
+    std::vector<std::string> filepaths;
+    if (mtl_basedir.empty()) {
+        filepaths.push_back(matId);
+        return filepaths;
+    }
+
+#ifdef _WIN32
+    char sep = ';';
+#else
+    char sep = ':';
+#endif
+
+    // https://stackoverflow.com/questions/5167625/splitting-a-c-stdstring-using-tokens-e-g
+    std::istringstream f(mtl_basedir);
+
+    std::string s;
+    while (getline(f, s, sep)) {
+        filepaths.push_back(JoinPath(s, matId));
+    }
+    return filepaths;
+}
+
+// Gets the size and the modification time(seconds since epoch) of a file.
+static bool GetFileStat(const char* filename, unsigned long long* size, long long* mtime) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(filename, &st) != 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        return false;
+    }
+#endif
+    (*size) = static_cast<unsigned long long>(st.st_size);
+    (*mtime) = static_cast<long long>(st.st_mtime);
+    return true;
+}
+
+static unsigned long long HashBytes(const char* data, size_t len, unsigned long long seed);
+
+// A parsed .mtl file of the process-wide cache.
+struct material_file_cache_entry_t {
+    // The file content the materials were parsed from. Size and modification
+    // time alone miss rewrites within the timestamp granularity.
+    unsigned long long size;
+    unsigned long long hash;  // HashBytes()
+    std::vector<material_t> materials;
+    std::string warning;  // `LoadMtl` warnings
+};
+
+struct material_file_cache_t {
+    std::atomic<bool> enabled;
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<const material_file_cache_entry_t> > entries;  // by path
+    MaterialFileCacheStats stats;
+
+    material_file_cache_t() : enabled(false) {}
+};
+
+static material_file_cache_t& GetMaterialFileCache() {
+    static material_file_cache_t cache;
+    return cache;
+}
+
+// Same as `LoadMtl` on the file `filepath`, but the parsed materials are
+// taken from the process-wide cache when the file content is unchanged.
+// Reading and hashing the file is much cheaper than parsing it. Returns false
+// when the file cannot be opened.
+static bool LoadMtlCached(const std::string& filepath, std::map<std::string, int>* material_map, std::vector<material_t>* materials,
+    std::string* warning, std::string* err) {
+    std::ifstream file(filepath.c_str(), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const unsigned long long size = static_cast<unsigned long long>(content.size());
+    const unsigned long long hash = HashBytes(content.data(), content.size(), 0);
+
+    material_file_cache_t& cache = GetMaterialFileCache();
+    std::shared_ptr<const material_file_cache_entry_t> entry;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        std::map<std::string, std::shared_ptr<const material_file_cache_entry_t> >::const_iterator it = cache.entries.find(filepath);
+        if (it != cache.entries.end() && it->second->size == size && it->second->hash == hash) {
+            entry = it->second;
+            cache.stats.hits++;
+        }
+    }
+
+    if (!entry) {
+        std::stringbuf content_buf(content);
+        std::istream matIStream(&content_buf);
+
+        std::shared_ptr<material_file_cache_entry_t> parsed(new material_file_cache_entry_t());
+        parsed->size = size;
+        parsed->hash = hash;
+        std::map<std::string, int> parsed_map;
+        LoadMtl(&parsed_map, &parsed->materials, &matIStream, &parsed->warning, err);
+        entry = parsed;
+
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.entries[filepath] = entry;
+        cache.stats.misses++;
+        cache.stats.num_entries = cache.entries.size();
+    }
+
+    // Append in file order, like `LoadMtl` does(the first material of a name
+    // wins).
+    const int offset = static_cast<int>(materials->size());
+    materials->reserve(materials->size() + entry->materials.size());
+    for (size_t i = 0; i < entry->materials.size(); i++) {
+        material_map->insert(std::pair<std::string, int>(entry->materials[i].name, offset + static_cast<int>(i)));
+        materials->push_back(entry->materials[i]);
+    }
+    if (warning) {
+        (*warning) = entry->warning;
+    }
+    return true;
+}
+
+void SetMaterialFileCacheEnabled(bool enabled) { GetMaterialFileCache().enabled = enabled; }
+
+bool IsMaterialFileCacheEnabled() { return GetMaterialFileCache().enabled; }
+
+void ClearMaterialFileCache() {
+    material_file_cache_t& cache = GetMaterialFileCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.entries.clear();
+    cache.stats = MaterialFileCacheStats();
+}
+
+MaterialFileCacheStats GetMaterialFileCacheStats() {
+    material_file_cache_t& cache = GetMaterialFileCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return cache.stats;
+}
+
+bool MaterialFileReader::operator()(
+    const std::string& matId, std::vector<material_t>* materials, std::map<std::string, int>* matMap, std::string* warn, std::string* err) {
+    std::vector<std::string> filepaths = MaterialFilePaths(m_mtlBaseDir, matId);
+    for (size_t i = 0; i < filepaths.size(); i++) {
+        if (m_useCache) {
+            if (LoadMtlCached(filepaths[i], matMap, materials, warn, err)) {
+                return true;
+            }
+            continue;
+        }
+
+        std::ifstream matIStream(filepaths[i].c_str());
+        if (matIStream) {
+            LoadMtl(matMap, materials, &matIStream, warn, err);
+
+            return true;
+        }
+    }
+
+    std::stringstream ss;
+    ss << "Material file [ " << matId << " ] not found in a path : " << m_mtlBaseDir << "\n";
+    if (warn) {
+        (*warn) += ss.str();
+    }
+    return false;
+}
+
+bool MaterialStreamReader::operator()(
+    const std::string& matId, std::vector<material_t>* materials, std::map<std::string, int>* matMap, std::string* warn, std::string* err) {
+    (void)err;
+    (void)matId;
+    if (!m_inStream) {
+        std::stringstream ss;
+        ss << "Material stream in error state. \n";
+        if (warn) {
+            (*warn) += ss.str();
+        }
+        return false;
+    }
+
+    LoadMtl(matMap, materials, &m_inStream, warn, err);
+
+    return true;
+}
+
+// Appends a directory separator to `mtl_basedir` when it is missing.
+static std::string MtlBaseDir(const char* mtl_basedir) {
+    std::string baseDir = mtl_basedir ? mtl_basedir : "";
+    if (!baseDir.empty()) {
+#ifndef _WIN32
+        const char dirsep = '/';
+#else
+        const char dirsep = '\\';
+#endif
+        if (baseDir[baseDir.length() - 1] != dirsep) baseDir += dirsep;
+    }
+    return baseDir;
+}
+
+bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
+    const char* filename, const char* mtl_basedir, bool triangulate, bool default_vcols_fallback, ParseArena* arena) {
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
+
+    std::stringstream errss;
+
+    std::ifstream ifs(filename);
+    if (!ifs) {
+        errss << "Cannot open file [" << filename << "]\n";
+        if (err) {
+            (*err) = errss.str();
+        }
+        return false;
+    }
+
+    MaterialFileReader matFileReader(MtlBaseDir(mtl_basedir));
+
+    return LoadObj(attrib, shapes, materials, warn, err, &ifs, &matFileReader, triangulate, default_vcols_fallback, arena);
+}
+
+// Open addressing(linear probing) map of material names to material IDs for
+// `usemtl` lookups. Filled from the `std::map` of `MaterialReader` after each
+// `mtllib` line.
+class material_name_map {
+public:
+    material_name_map() : size_(0) {}
+
+    void Assign(const std::map<std::string, int>& material_map) {
+        names_.clear();
+        slots_.assign(SlotCountFor(material_map.size()), slot_t());
+        size_ = 0;
+        for (std::map<std::string, int>::const_iterator it = material_map.begin(); it != material_map.end(); ++it) {
+            Insert(it->first, it->second);
+        }
+    }
+
+    bool Find(const std::string& name, int* material_id) const {
+        if (size_ == 0) {
+            return false;
+        }
+        const unsigned long long h = Hash(name.data(), name.size());
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = static_cast<size_t>(h) & mask;; i = (i + 1) & mask) {
+            const slot_t& slot = slots_[i];
+            if (slot.name_index < 0) {
+                return false;
+            }
+            if (slot.hash == h && names_[static_cast<size_t>(slot.name_index)] == name) {
+                (*material_id) = slot.material_id;
+                return true;
+            }
+        }
+    }
+
+private:
+    struct slot_t {
+        unsigned long long hash;
+        int name_index;  // -1 = empty
+        int material_id;
+
+        slot_t() : hash(0), name_index(-1), material_id(-1) {}
+    };
+
+    // Power of two, at most half full.
+    static size_t SlotCountFor(size_t n) {
+        size_t count = 16;
+        while (count < n * 2) {
+            count *= 2;
+        }
+        return count;
+    }
+
+    // FNV-1a
+    static unsigned long long Hash(const char* s, size_t len) {
+        unsigned long long h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < len; i++) {
+            h ^= static_cast<unsigned char>(s[i]);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    void Insert(const std::string& name, int material_id) {
+        const unsigned long long h = Hash(name.data(), name.size());
+        const size_t mask = slots_.size() - 1;
+        size_t i = static_cast<size_t>(h) & mask;
+        while (slots_[i].name_index >= 0) {
+            i = (i + 1) & mask;
+        }
+        slots_[i].hash = h;
+        slots_[i].name_index = static_cast<int>(names_.size());
+        slots_[i].material_id = material_id;
+        names_.push_back(name);
+        size_++;
+    }
+
+    std::vector<slot_t> slots_;
+    std::vector<std::string> names_;
+    size_t size_;
+};
+
+// Parser state of a .obj file, shared by the serial and the parallel readers.
+// `v_offset`, `vn_offset` and `vt_offset` are the number of elements which
+// precede `v`, `vn` and `vt` in the file. They are non-zero for the chunks of
+// a parallel parse and are used to resolve relative indices.
+struct obj_parse_state {
+    std::vector<real_t> v;
     std::vector<real_t> vn;
     std::vector<real_t> vt;
+    std::vector<real_t> vc;
+    std::vector<skin_weight_t> vw;
+    std::vector<tag_t> tags;
+    PrimGroup prim_group;
+    std::string name;
+
+    // material
+    std::set<std::string> material_filenames;
+    std::map<std::string, int> material_map;
+    material_name_map material_index;  // `material_map` for `usemtl` lookups
+    int material;
+
+    // smoothing group id
+    unsigned int current_smoothing_id;  // Initial value. 0 means no smoothing.
+
+    int greatest_v_idx;
+    int greatest_vn_idx;
+    int greatest_vt_idx;
+
+    shape_t shape;
+
+    bool found_all_colors;
+
+    size_t line_num;
+
+    size_t v_offset;
+    size_t vn_offset;
+    size_t vt_offset;
+
+    // Arena of the primitives(NULL = heap).
+    ParseArena* arena;
+
+    // Threads used to export the faces of a group(`exportGroupsToShape`).
+    unsigned int num_threads;
+
+    explicit obj_parse_state(ParseArena* parse_arena = NULL)
+        : prim_group(parse_arena), material(-1), current_smoothing_id(0), greatest_v_idx(-1), greatest_vn_idx(-1), greatest_vt_idx(-1),
+          found_all_colors(true), line_num(0), v_offset(0), vn_offset(0), vt_offset(0), arena(parse_arena), num_threads(1) {}
+
+    void SetArena(ParseArena* parse_arena) {
+        arena = parse_arena;
+        prim_group = PrimGroup(parse_arena);
+    }
+
+    int NumVertices() const { return static_cast<int>(v_offset + v.size() / 3); }
+    int NumNormals() const { return static_cast<int>(vn_offset + vn.size() / 3); }
+    int NumTexcoords() const { return static_cast<int>(vt_offset + vt.size() / 2); }
 };
 
-//
-// Manages group of primitives(face, line, points, ...)
-struct PrimGroup {
-    std::vector<face_t> faceGroup;
-    std::vector<__line_t> lineGroup;
-    std::vector<__points_t> pointsGroup;
+// Parses a single line of .obj into `state`. `linebuf` must not contain the
+// line ending. Returns false on a fatal parse error.
+static bool parseObjLine(obj_parse_state* state, const char* linebuf, std::vector<shape_t>* shapes, std::vector<material_t>* materials,
+    MaterialReader* readMatFn, bool triangulate, bool default_vcols_fallback, std::string* warn, std::string* err) {
+    std::vector<real_t>& v = state->v;
+    std::vector<real_t>& vn = state->vn;
+    std::vector<real_t>& vt = state->vt;
+    std::vector<real_t>& vc = state->vc;
+    std::vector<skin_weight_t>& vw = state->vw;
+    std::vector<tag_t>& tags = state->tags;
+    PrimGroup& prim_group = state->prim_group;
+    std::string& name = state->name;
+    std::set<std::string>& material_filenames = state->material_filenames;
+    std::map<std::string, int>& material_map = state->material_map;
+    int& material = state->material;
+    unsigned int& current_smoothing_id = state->current_smoothing_id;
+    int& greatest_v_idx = state->greatest_v_idx;
+    int& greatest_vn_idx = state->greatest_vn_idx;
+    int& greatest_vt_idx = state->greatest_vt_idx;
+    shape_t& shape = state->shape;
+    bool& found_all_colors = state->found_all_colors;
+    const size_t line_num = state->line_num;
+
+    // Skip leading space.
+    const char* token = SkipSpace(linebuf);
+
+    assert(token);
+    if (token[0] == '\0') return true;  // empty line
+
+    if (token[0] == '#') return true;  // comment line
+
+    // vertex
+    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+        token += 2;
+        real_t x, y, z;
+        real_t r, g, b;
+
+        found_all_colors &= parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+
+        v.push_back(x);
+        v.push_back(y);
+        v.push_back(z);
+
+        if (found_all_colors || default_vcols_fallback) {
+            vc.push_back(r);
+            vc.push_back(g);
+            vc.push_back(b);
+        }
+
+        return true;
+    }
+
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+        token += 3;
+        real_t x, y, z;
+        parseReal3(&x, &y, &z, &token);
+        vn.push_back(x);
+        vn.push_back(y);
+        vn.push_back(z);
+        return true;
+    }
+
+    // texcoord
+    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+        token += 3;
+        real_t x, y;
+        parseReal2(&x, &y, &token);
+        vt.push_back(x);
+        vt.push_back(y);
+        return true;
+    }
+
+    // skin weight. tinyobj extension
+    if (token[0] == 'v' && token[1] == 'w' && IS_SPACE((token[2]))) {
+        token += 3;
+
+        // vw <vid> <joint_0> <weight_0> <joint_1> <weight_1> ...
+        // example:
+        // vw 0 0 0.25 1 0.25 2 0.5
+
+        // TODO(syoyo): Add syntax check
+        int vid = 0;
+        vid = parseInt(&token);
+
+        skin_weight_t sw;
+
+        sw.vertex_id = vid;
+
+        while (!IS_NEW_LINE(token[0])) {
+            real_t j, w;
+            // joint_id should not be negative, weight may be negative
+            // TODO(syoyo): # of elements check
+            parseReal2(&j, &w, &token, -1.0);
+
+            if (j < static_cast<real_t>(0)) {
+                if (err) {
+                    std::stringstream ss;
+                    ss << "Failed parse `vw' line. joint_id is negative. "
+                          "line "
+                       << line_num << ".)\n";
+                    (*err) += ss.str();
+                }
+                return false;
+            }
+
+            joint_and_weight_t jw;
+
+            jw.joint_id = int(j);
+            jw.weight = w;
+
+            sw.weightValues.push_back(jw);
+
+            token = SkipSpaceAndCR(token);
+        }
+
+        vw.push_back(sw);
+    }
+
+    warning_context context;
+    context.warn = warn;
+    context.line_number = line_num;
+
+    // line
+    if (token[0] == 'l' && IS_SPACE((token[1]))) {
+        token += 2;
+
+        prim_group.lineGroup.push_back(__line_t(state->arena));
+        __line_t& line = prim_group.lineGroup.back();
+
+        while (!IS_NEW_LINE(token[0])) {
+            vertex_index_t vi;
+            if (!parseTriple(&token, state->NumVertices(), state->NumNormals(), state->NumTexcoords(), &vi, context)) {
+                if (err) {
+                    (*err) += "Failed to parse `l' line (e.g. a zero value for vertex index. Line " + toString(line_num) + ").\n";
+                }
+                return false;
+            }
+
+            line.vertex_indices.push_back(vi);
+
+            token = SkipSpaceAndCR(token);
+        }
+
+        return true;
+    }
+
+    // points
+    if (token[0] == 'p' && IS_SPACE((token[1]))) {
+        token += 2;
+
+        prim_group.pointsGroup.push_back(__points_t(state->arena));
+        __points_t& pts = prim_group.pointsGroup.back();
+
+        while (!IS_NEW_LINE(token[0])) {
+            vertex_index_t vi;
+            if (!parseTriple(&token, state->NumVertices(), state->NumNormals(), state->NumTexcoords(), &vi, context)) {
+                if (err) {
+                    (*err) += "Failed to parse `p' line (e.g. a zero value for vertex index. Line " + toString(line_num) + ").\n";
+                }
+                return false;
+            }
+
+            pts.vertex_indices.push_back(vi);
+
+            token = SkipSpaceAndCR(token);
+        }
+
+        return true;
+    }
+
+    // face
+    if (token[0] == 'f' && IS_SPACE((token[1]))) {
+        token = SkipSpace(token + 2);
+
+        // Parse in place to avoid copying the index array.
+        prim_group.faceGroup.push_back(face_t(state->arena));
+        face_t& face = prim_group.faceGroup.back();
+
+        face.smoothing_group_id = current_smoothing_id;
+        face.vertex_indices.reserve(3);
+
+        while (!IS_NEW_LINE(token[0])) {
+            vertex_index_t vi;
+            if (!parseTriple(&token, state->NumVertices(), state->NumNormals(), state->NumTexcoords(), &vi, context)) {
+                if (err) {
+                    (*err) += "Failed to parse `f' line (e.g. a zero value for vertex index or invalid relative vertex index). Line " +
+                              toString(line_num) + ").\n";
+                }
+                return false;
+            }
+
+            greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
+            greatest_vn_idx = greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
+            greatest_vt_idx = greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
+
+            face.vertex_indices.push_back(vi);
+            token = SkipSpaceAndCR(token);
+        }
+
+        return true;
+    }
+
+    // use mtl
+    if ((0 == strncmp(token, "usemtl", 6))) {
+        token += 6;
+        std::string namebuf = parseString(&token);
+
+        int newMaterialId = -1;
+        if (!state->material_index.Find(namebuf, &newMaterialId)) {
+            // { error!! material not found }
+            if (warn) {
+                (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
+            }
+        }
+
+        if (newMaterialId != material) {
+            // Create per-face material. Thus we don't add `shape` to `shapes` at
+            // this time.
+            // just clear `faceGroup` after `exportGroupsToShape()` call.
+            exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn, state->num_threads);
+            prim_group.faceGroup.clear();
+            material = newMaterialId;
+        }
+
+        return true;
+    }
+
+    // load mtl
+    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+        if (readMatFn) {
+            token += 7;
+
+            std::vector<std::string> filenames;
+            SplitString(std::string(token), ' ', '\\', filenames);
+
+            if (filenames.empty()) {
+                if (warn) {
+                    std::stringstream ss;
+                    ss << "Looks like empty filename for mtllib. Use default "
+                          "material (line "
+                       << line_num << ".)\n";
+
+                    (*warn) += ss.str();
+                }
+            } else {
+                bool found = false;
+                for (size_t s = 0; s < filenames.size(); s++) {
+                    if (material_filenames.count(filenames[s]) > 0) {
+                        found = true;
+                        continue;
+                    }
+
+                    std::string warn_mtl;
+                    std::string err_mtl;
+                    bool ok = (*readMatFn)(filenames[s].c_str(), materials, &material_map, &warn_mtl, &err_mtl);
+                    if (warn && (!warn_mtl.empty())) {
+                        (*warn) += warn_mtl;
+                    }
+
+                    if (err && (!err_mtl.empty())) {
+                        (*err) += err_mtl;
+                    }
+
+                    if (ok) {
+                        found = true;
+                        material_filenames.insert(filenames[s]);
+                        break;
+                    }
+                }
+                state->material_index.Assign(material_map);
+
+                if (!found) {
+                    if (warn) {
+                        (*warn) += "Failed to load material file(s). Use default "
+                                   "material.\n";
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // group name
+    if (token[0] == 'g' && IS_SPACE((token[1]))) {
+        // flush previous face group.
+        bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn, state->num_threads);
+        (void)ret;  // return value not used.
+
+        if (shape.mesh.indices.size() > 0) {
+            shapes->push_back(shape);
+        }
+
+        shape = shape_t();
+
+        // material = -1;
+        prim_group.clear();
+
+        std::vector<std::string> names;
+
+        while (!IS_NEW_LINE(token[0])) {
+            std::string str = parseString(&token);
+            names.push_back(str);
+            token += strspn(token, " \t\r");  // skip tag
+        }
+
+        // names[0] must be 'g'
+
+        if (names.size() < 2) {
+            // 'g' with empty names
+            if (warn) {
+                std::stringstream ss;
+                ss << "Empty group name. line: " << line_num << "\n";
+                (*warn) += ss.str();
+                name = "";
+            }
+        } else {
+            std::stringstream ss;
+            ss << names[1];
+
+            // tinyobjloader does not support multiple groups for a primitive.
+            // Currently we concatinate multiple group names with a space to get
+            // single group name.
+
+            for (size_t i = 2; i < names.size(); i++) {
+                ss << " " << names[i];
+            }
+
+            name = ss.str();
+        }
+
+        return true;
+    }
+
+    // object name
+    if (token[0] == 'o' && IS_SPACE((token[1]))) {
+        // flush previous face group.
+        bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn, state->num_threads);
+        (void)ret;  // return value not used.
 
-    void clear() {
-        faceGroup.clear();
-        lineGroup.clear();
-        pointsGroup.clear();
+        if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 || shape.points.indices.size() > 0) {
+            shapes->push_back(shape);
+        }
+
+        // material = -1;
+        prim_group.clear();
+        shape = shape_t();
+
+        // @todo { multiple object name? }
+        token += 2;
+        std::stringstream ss;
+        ss << token;
+        name = ss.str();
+
+        return true;
     }
 
-    bool IsEmpty() const { return faceGroup.empty() && lineGroup.empty() && pointsGroup.empty(); }
+    if (token[0] == 't' && IS_SPACE(token[1])) {
+        const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
+        tag_t tag;
 
-    // TODO(syoyo): bspline, surface, ...
-};
+        token += 2;
 
-// See
-// http://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
-static std::istream& safeGetline(std::istream& is, std::string& t) {
-    t.clear();
+        tag.name = parseString(&token);
 
-    // The characters in the stream are read one-by-one using a std::streambuf.
-    // That is faster than reading them one-by-one using the std::istream.
-    // Code that uses streambuf this way must be guarded by a sentry object.
-    // The sentry object performs various tasks,
-    // such as thread synchronization and updating the stream state.
+        tag_sizes ts = parseTagTriple(&token);
 
-    std::istream::sentry se(is, true);
-    std::streambuf* sb = is.rdbuf();
+        if (ts.num_ints < 0) {
+            ts.num_ints = 0;
+        }
+        if (ts.num_ints > max_tag_nums) {
+            ts.num_ints = max_tag_nums;
+        }
 
-    if (se) {
-        for (;;) {
-            int c = sb->sbumpc();
-            switch (c) {
-                case '\n': return is;
-                case '\r':
-                    if (sb->sgetc() == '\n') sb->sbumpc();
-                    return is;
-                case EOF:
-                    // Also handle the case when the last line has no line ending
-                    if (t.empty()) is.setstate(std::ios::eofbit);
-                    return is;
-                default: t += static_cast<char>(c);
-            }
+        if (ts.num_reals < 0) {
+            ts.num_reals = 0;
+        }
+        if (ts.num_reals > max_tag_nums) {
+            ts.num_reals = max_tag_nums;
         }
-    }
 
-    return is;
-}
+        if (ts.num_strings < 0) {
+            ts.num_strings = 0;
+        }
+        if (ts.num_strings > max_tag_nums) {
+            ts.num_strings = max_tag_nums;
+        }
 
-#define IS_SPACE(x) (((x) == ' ') || ((x) == '\t'))
-#define IS_DIGIT(x) (static_cast<unsigned int>((x) - '0') < static_cast<unsigned int>(10))
-#define IS_NEW_LINE(x) (((x) == '\r') || ((x) == '\n') || ((x) == '\0'))
+        tag.intValues.resize(static_cast<size_t>(ts.num_ints));
 
-template <typename T>
-static inline std::string toString(const T& t) {
-    std::stringstream ss;
-    ss << t;
-    return ss.str();
-}
+        for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+            tag.intValues[i] = parseInt(&token);
+        }
 
-struct warning_context {
-    std::string* warn;
-    size_t line_number;
-};
+        tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
+        for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
+            tag.floatValues[i] = parseReal(&token);
+        }
 
-// Make index zero-base, and also support relative index.
-static inline bool fixIndex(int idx, int n, int* ret, bool allow_zero, const warning_context& context) {
-    if (!ret) {
-        return false;
-    }
+        tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+        for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+            tag.stringValues[i] = parseString(&token);
+        }
+
+        tags.push_back(tag);
 
-    if (idx > 0) {
-        (*ret) = idx - 1;
         return true;
     }
 
-    if (idx == 0) {
-        // zero is not allowed according to the spec.
-        if (context.warn) {
-            (*context.warn) += "A zero value index found (will have a value of -1 for normal and tex indices. Line " +
-                               toString(context.line_number) + ").\n";
+    if (token[0] == 's' && IS_SPACE(token[1])) {
+        // smoothing group id
+        token += 2;
+
+        // skip space.
+        token += strspn(token, " \t");  // skip space
+
+        if (token[0] == '\0') {
+            return true;
         }
 
-        (*ret) = idx - 1;
-        return allow_zero;
-    }
+        if (token[0] == '\r' || token[1] == '\n') {
+            return true;
+        }
 
-    if (idx < 0) {
-        (*ret) = n + idx;  // negative value = relative
-        if ((*ret) < 0) {
-            return false;  // invalid relative index
+        if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' && token[2] == 'f') {
+            current_smoothing_id = 0;
+        } else {
+            // assume number
+            int smGroupId = parseInt(&token);
+            if (smGroupId < 0) {
+                // parse error. force set to 0.
+                // FIXME(syoyo): Report warning.
+                current_smoothing_id = 0;
+            } else {
+                current_smoothing_id = static_cast<unsigned int>(smGroupId);
+            }
         }
+
         return true;
-    }
+    }  // smoothing group id
 
-    return false;  // never reach here.
+    // Ignore unknown command.
+    return true;
 }
 
-static inline std::string parseString(const char** token) {
-    std::string s;
-    (*token) += strspn((*token), " \t");
-    size_t e = strcspn((*token), " \t\r");
-    s = std::string((*token), &(*token)[e]);
-    (*token) += e;
-    return s;
+// Flushes the pending group of `state` into `shapes` and moves the parsed
+// vertex attributes into `attrib`.
+static void finishObjParse(obj_parse_state* state, attrib_t* attrib, std::vector<shape_t>* shapes, bool triangulate,
+    bool default_vcols_fallback, std::string* warn) {
+    // not all vertices have colors, no default colors desired? -> clear colors
+    if (!state->found_all_colors && !default_vcols_fallback) {
+        state->vc.clear();
+    }
+
+    if (state->greatest_v_idx >= state->NumVertices()) {
+        if (warn) {
+            std::stringstream ss;
+            ss << "Vertex indices out of bounds (line " << state->line_num << ".)\n\n";
+            (*warn) += ss.str();
+        }
+    }
+    if (state->greatest_vn_idx >= state->NumNormals()) {
+        if (warn) {
+            std::stringstream ss;
+            ss << "Vertex normal indices out of bounds (line " << state->line_num << ".)\n\n";
+            (*warn) += ss.str();
+        }
+    }
+    if (state->greatest_vt_idx >= state->NumTexcoords()) {
+        if (warn) {
+            std::stringstream ss;
+            ss << "Vertex texcoord indices out of bounds (line " << state->line_num << ".)\n\n";
+            (*warn) += ss.str();
+        }
+    }
+
+    bool ret =
+        exportGroupsToShape(&state->shape, state->prim_group, state->tags, state->material, state->name, triangulate, state->v, warn,
+            state->num_threads);
+    // exportGroupsToShape return false when `usemtl` is called in the last
+    // line.
+    // we also add `shape` to `shapes` when `shape.mesh` has already some
+    // faces(indices)
+    if (ret || state->shape.mesh.indices.size()) {  // FIXME(syoyo): Support other prims(e.g. lines)
+        // Moved instead of copied. `ObjIncrementalReader` moves it back to
+        // continue the shape with appended faces.
+        shapes->push_back(shape_t());
+        std::swap(shapes->back(), state->shape);
+    }
+    state->prim_group.clear();  // for safety
+
+    attrib->vertices.swap(state->v);
+    attrib->vertex_weights.swap(state->v);
+    attrib->normals.swap(state->vn);
+    attrib->texcoords.swap(state->vt);
+    attrib->texcoord_ws.swap(state->vt);
+    attrib->colors.swap(state->vc);
+    attrib->skin_weights.swap(state->vw);
 }
 
-static inline int parseInt(const char** token) {
-    (*token) += strspn((*token), " \t");
-    int i = atoi((*token));
-    (*token) += strcspn((*token), " \t\r");
-    return i;
+bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
+    std::istream* inStream, MaterialReader* readMatFn /*= NULL*/, bool triangulate, bool default_vcols_fallback,
+    ParseArena* arena /*= NULL*/) {
+    std::stringstream errss;
+
+    obj_parse_state state(arena);
+
+    std::string linebuf;
+    while (inStream->peek() != -1) {
+        safeGetline(*inStream, linebuf);
+
+        state.line_num++;
+
+        // Trim newline '\r\n' or '\n'
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+        }
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
+        }
+
+        // Skip if empty line.
+        if (linebuf.empty()) {
+            continue;
+        }
+
+        if (!parseObjLine(&state, linebuf.c_str(), shapes, materials, readMatFn, triangulate, default_vcols_fallback, warn, err)) {
+            return false;
+        }
+    }
+
+    finishObjParse(&state, attrib, shapes, triangulate, default_vcols_fallback, warn);
+
+    if (err) {
+        (*err) += errss.str();
+    }
+
+    return true;
 }
 
-// Tries to parse a floating point number located at s.
-//
-// s_end should be a location in the string where reading should absolutely
-// stop. For example at the end of the string, to prevent buffer overflows.
-//
-// Parses the following EBNF grammar:
-//   sign    = "+" | "-" ;
-//   END     = ? anything not in digit ?
-//   digit   = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9" ;
-//   integer = [sign] , digit , {digit} ;
-//   decimal = integer , ["." , integer] ;
-//   float   = ( decimal , END ) | ( decimal , ("E" | "e") , integer , END ) ;
-//
-//  Valid strings are for example:
-//   -0  +3.1417e+2  -0.0E-3  1.0324  -1.41   11e2
-//
-// If the parsing is a success, result is set to the parsed value and true
-// is returned.
-//
-// The function is greedy and will parse until any of the following happens:
-//  - a non-conforming character is encountered.
-//  - s_end is reached.
 //
-// The following situations triggers a failure:
-//  - s >= s_end.
-//  - parse failure.
+// Multi-threaded loader(`LoadObjParallel`)
 //
-static bool tryParseDouble(const char* s, const char* s_end, double* result) {
-    if (s >= s_end) {
+
+// Read only view of a whole file.
+// The file is memory mapped when possible, otherwise it is read into memory.
+class MappedFile {
+public:
+    MappedFile() : data_(NULL), size_(0), mapped_(false) {
+#ifndef TINYOBJLOADER_DISABLE_MMAP
+#ifdef _WIN32
+        file_ = INVALID_HANDLE_VALUE;
+        mapping_ = NULL;
+#else
+        fd_ = -1;
+#endif
+#endif
+    }
+    ~MappedFile() { Close(); }
+
+    bool Open(const char* filename);
+    void Close();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data_;
+    size_t size_;
+    bool mapped_;
+    std::vector<char> buffer_;  // Used when the file could not be mapped.
+#ifndef TINYOBJLOADER_DISABLE_MMAP
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int fd_;
+#endif
+#endif
+};
+
+bool MappedFile::Open(const char* filename) {
+    Close();
+
+#ifndef TINYOBJLOADER_DISABLE_MMAP
+#ifdef _WIN32
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(file_, &file_size) && file_size.QuadPart > 0) {
+            mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping_) {
+                data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+                if (data_) {
+                    size_ = static_cast<size_t>(file_size.QuadPart);
+                    mapped_ = true;
+                    return true;
+                }
+            }
+        }
+        Close();
+    }
+#else
+    fd_ = open(filename, O_RDONLY);
+    if (fd_ >= 0) {
+        struct stat st;
+        if (fstat(fd_, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (addr != MAP_FAILED) {
+                data_ = static_cast<const char*>(addr);
+                size_ = static_cast<size_t>(st.st_size);
+                mapped_ = true;
+                return true;
+            }
+        }
+        Close();
+    }
+#endif
+#endif  // TINYOBJLOADER_DISABLE_MMAP
+
+    // Fallback: read the whole file.
+    std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+    ifs.seekg(0, std::ios::end);
+    std::streamoff len = ifs.tellg();
+    ifs.seekg(0, std::ios::beg);
+    if (len < 0) {
         return false;
     }
+    buffer_.resize(static_cast<size_t>(len));
+    if (len > 0 && !ifs.read(&buffer_[0], len)) {
+        buffer_.clear();
+        return false;
+    }
+    data_ = buffer_.empty() ? NULL : &buffer_[0];
+    size_ = buffer_.size();
+    return true;
+}
+
+void MappedFile::Close() {
+#ifndef TINYOBJLOADER_DISABLE_MMAP
+#ifdef _WIN32
+    if (mapped_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+#endif
+#endif  // TINYOBJLOADER_DISABLE_MMAP
+    std::vector<char>().swap(buffer_);
+    data_ = NULL;
+    size_ = 0;
+    mapped_ = false;
+}
+
+// Returns the position of the line ending('\r' or '\n') of the line starting
+// at `p`, or `end`.
+static inline const char* FindLineEnd(const char* p, const char* end) { return ScanUntilBounded<line_end_chars>(p, end); }
+
+// Skips '\n', '\r\n' or '\r'(same as `safeGetline`).
+static inline const char* SkipLineEnding(const char* p, const char* end) {
+    if (p < end && *p == '\r') {
+        p++;
+        if (p < end && *p == '\n') {
+            p++;
+        }
+    } else if (p < end && *p == '\n') {
+        p++;
+    }
+    return p;
+}
+
+// A command of a chunk which has to be processed in file order.
+// `f`, `l` and `p` lines are parsed into the PrimGroup of the chunk and
+// recorded as [begin, end) runs. Lines which modify the global parser
+// state(`g`, `o`, `usemtl`, `mtllib`, `s`, `t`) are recorded as the byte
+// range [begin, end) of the line and parsed when the chunks are merged.
+struct obj_chunk_command_t {
+    enum Type { FACES, LINES, POINTS, STATE_LINE };
+
+    Type type;
+    size_t begin;
+    size_t end;
+    size_t line_num;
+};
+
+// Newline aligned part of the .obj text.
+struct obj_chunk_t {
+    size_t begin;  // byte range in the .obj text
+    size_t end;
+
+    // Filled by `CountObjChunk`
+    size_t num_lines;
+    size_t num_v;
+    size_t num_vn;
+    size_t num_vt;
+
+    // Arena of `state`(only used in arena mode). Declared first, so it
+    // outlives the containers which allocate from it.
+    ParseArena arena;
+
+    obj_parse_state state;
+    std::vector<obj_chunk_command_t> commands;
+
+    bool ok;
+    std::string warn;
+    std::string err;
+
+    obj_chunk_t() : begin(0), end(0), num_lines(0), num_v(0), num_vn(0), num_vt(0), ok(true) {}
+};
+
+// Lines which have to be parsed in file order.
+static inline bool IsStateLine(const char* token, const char* eol) {
+    const size_t len = static_cast<size_t>(eol - token);
+    if (len >= 2 && IS_SPACE(token[1]) && (token[0] == 'g' || token[0] == 'o' || token[0] == 's' || token[0] == 't')) {
+        return true;
+    }
+    return (len >= 6) && ((0 == strncmp(token, "usemtl", 6)) || (0 == strncmp(token, "mtllib", 6)));
+}
+
+static void AppendChunkCommand(std::vector<obj_chunk_command_t>* commands, obj_chunk_command_t::Type type, size_t begin, size_t end,
+    size_t line_num) {
+    // Extend the previous run of the same primitive type.
+    if (type != obj_chunk_command_t::STATE_LINE && !commands->empty() && commands->back().type == type && commands->back().end == begin) {
+        commands->back().end = end;
+        return;
+    }
+
+    obj_chunk_command_t command;
+    command.type = type;
+    command.begin = begin;
+    command.end = end;
+    command.line_num = line_num;
+    commands->push_back(command);
+}
+
+// Pre-scan: counts lines and `v`, `vn`, `vt` elements of a chunk.
+static void CountObjChunk(const char* buf, obj_chunk_t* chunk) {
+    const char* p = buf + chunk->begin;
+    const char* end = buf + chunk->end;
+    while (p < end) {
+        const char* eol = FindLineEnd(p, end);
+        const char* token = p;
+        p = SkipLineEnding(eol, end);
+        chunk->num_lines++;
+
+        while (token < eol && IS_SPACE(*token)) {
+            token++;
+        }
+        if ((eol - token) < 2 || token[0] != 'v') {
+            continue;
+        }
+        if (IS_SPACE(token[1])) {
+            chunk->num_v++;
+        } else if ((eol - token) >= 3 && IS_SPACE(token[2])) {
+            if (token[1] == 'n') {
+                chunk->num_vn++;
+            } else if (token[1] == 't') {
+                chunk->num_vt++;
+            }
+        }
+    }
+}
 
-    double mantissa = 0.0;
-    // This exponent is base 2 rather than 10.
-    // However the exponent we parse is supposed to be one of ten,
-    // thus we must take care to convert the exponent/and or the
-    // mantissa to a * 2^E, where a is the mantissa and E is the
-    // exponent.
-    // To get the final double we will use ldexp, it requires the
-    // exponent to be in base 2.
-    int exponent = 0;
+// Parses the geometry of a chunk. `chunk->state` must have the line number
+// and the element offsets of the chunk start.
+static void ParseObjChunk(const char* buf, obj_chunk_t* chunk, bool default_vcols_fallback) {
+    obj_parse_state& state = chunk->state;
+    PrimGroup& prim_group = state.prim_group;
 
-    // NOTE: THESE MUST BE DECLARED HERE SINCE WE ARE NOT ALLOWED
-    // TO JUMP OVER DEFINITIONS.
-    char sign = '+';
-    char exp_sign = '+';
-    char const* curr = s;
+    std::string linebuf;
+    const char* p = buf + chunk->begin;
+    const char* end = buf + chunk->end;
+    while (p < end) {
+        const char* line = p;
+        const char* eol = FindLineEnd(p, end);
+        p = SkipLineEnding(eol, end);
+        state.line_num++;
+
+        const char* token = line;
+        while (token < eol && IS_SPACE(*token)) {
+            token++;
+        }
+        if (token == eol || token[0] == '#') {
+            continue;  // empty or comment line
+        }
 
-    // How many characters were read in a loop.
-    int read = 0;
-    // Tells whether a loop terminated due to reaching s_end.
-    bool end_not_reached = false;
-    bool leading_decimal_dots = false;
+        if (IsStateLine(token, eol)) {
+            AppendChunkCommand(&chunk->commands, obj_chunk_command_t::STATE_LINE, static_cast<size_t>(line - buf),
+                static_cast<size_t>(eol - buf), state.line_num);
+            continue;
+        }
 
-    /*
-            BEGIN PARSING.
-    */
+        const size_t num_faces = prim_group.faceGroup.size();
+        const size_t num_lines = prim_group.lineGroup.size();
+        const size_t num_points = prim_group.pointsGroup.size();
 
-    // Find out what sign we've got.
-    if (*curr == '+' || *curr == '-') {
-        sign = *curr;
-        curr++;
-        if ((curr != s_end) && (*curr == '.')) {
-            // accept. Somethig like `.7e+2`, `-.5234`
-            leading_decimal_dots = true;
+        linebuf.assign(line, eol);
+        if (!parseObjLine(&state, linebuf.c_str(), NULL, NULL, NULL, false, default_vcols_fallback, &chunk->warn, &chunk->err)) {
+            chunk->ok = false;
+            return;
         }
-    } else if (IS_DIGIT(*curr)) { /* Pass through. */
-    } else if (*curr == '.') {
-        // accept. Somethig like `.7e+2`, `-.5234`
-        leading_decimal_dots = true;
-    } else {
-        goto fail;
-    }
 
-    // Read the integer part.
-    end_not_reached = (curr != s_end);
-    if (!leading_decimal_dots) {
-        while (end_not_reached && IS_DIGIT(*curr)) {
-            mantissa *= 10;
-            mantissa += static_cast<int>(*curr - 0x30);
-            curr++;
-            read++;
-            end_not_reached = (curr != s_end);
+        if (prim_group.faceGroup.size() != num_faces) {
+            AppendChunkCommand(&chunk->commands, obj_chunk_command_t::FACES, num_faces, prim_group.faceGroup.size(), state.line_num);
+        } else if (prim_group.lineGroup.size() != num_lines) {
+            AppendChunkCommand(&chunk->commands, obj_chunk_command_t::LINES, num_lines, prim_group.lineGroup.size(), state.line_num);
+        } else if (prim_group.pointsGroup.size() != num_points) {
+            AppendChunkCommand(&chunk->commands, obj_chunk_command_t::POINTS, num_points, prim_group.pointsGroup.size(), state.line_num);
         }
+    }
+}
 
-        // We must make sure we actually got something.
-        if (read == 0) goto fail;
+// Copies the per chunk attribute arrays into one array.
+static void MergeChunkArrays(std::vector<real_t>* dst, std::vector<obj_chunk_t>* chunks, std::vector<real_t> obj_parse_state::*member,
+    unsigned int num_threads) {
+    std::vector<size_t> offsets(chunks->size() + 1, 0);
+    for (size_t i = 0; i < chunks->size(); i++) {
+        offsets[i + 1] = offsets[i] + ((*chunks)[i].state.*member).size();
     }
+    dst->resize(offsets.back());
 
-    // We allow numbers of form "#", "###" etc.
-    if (!end_not_reached) goto assemble;
+    parallelFor(chunks->size(), num_threads, [&](size_t i) {
+        std::vector<real_t>& src = (*chunks)[i].state.*member;
+        if (!src.empty()) {
+            memcpy(&(*dst)[offsets[i]], &src[0], src.size() * sizeof(real_t));
+        }
+        std::vector<real_t>().swap(src);
+    });
+}
 
-    // Read the decimal part.
-    if (*curr == '.') {
-        curr++;
-        read = 1;
-        end_not_reached = (curr != s_end);
-        while (end_not_reached && IS_DIGIT(*curr)) {
-            static const double pow_lut[] = {
-                1.0,
-                0.1,
-                0.01,
-                0.001,
-                0.0001,
-                0.00001,
-                0.000001,
-                0.0000001,
-            };
-            const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
+static bool LoadObjParallelFromBuffer(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials,
+    std::string* warn, std::string* err, const char* buf, size_t len, MaterialReader* readMatFn, bool triangulate,
+    bool default_vcols_fallback, unsigned int num_threads, ParseArena* arena) {
+    num_threads = ResolveNumThreads(num_threads);
+
+    // Use a few chunks per thread for load balancing, but do not split small
+    // files.
+    const size_t min_chunk_size = 1024 * 1024;
+    size_t num_chunks = std::min(static_cast<size_t>(num_threads) * 4, len / min_chunk_size);
+    if (num_chunks == 0) {
+        num_chunks = 1;
+    }
 
-            // NOTE: Don't use powf here, it will absolutely murder precision.
-            mantissa += static_cast<int>(*curr - 0x30) * (read < lut_entries ? pow_lut[read] : std::pow(10.0, -read));
-            read++;
-            curr++;
-            end_not_reached = (curr != s_end);
+    std::vector<obj_chunk_t> chunks(num_chunks);
+    size_t pos = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunks[i].begin = pos;
+        size_t split = std::max(pos, (len / num_chunks) * (i + 1));
+        if (i + 1 == num_chunks || split >= len) {
+            pos = len;
+        } else {
+            const char* newline = static_cast<const char*>(memchr(buf + split, '\n', len - split));
+            pos = newline ? static_cast<size_t>(newline - buf) + 1 : len;
+        }
+        chunks[i].end = pos;
+        if (arena) {
+            chunks[i].state.SetArena(&chunks[i].arena);
         }
-    } else if (*curr == 'e' || *curr == 'E') {
-    } else {
-        goto assemble;
     }
 
-    if (!end_not_reached) goto assemble;
+    // 1. Count elements of each chunk, so relative indices can be resolved
+    // while the chunks are parsed in parallel.
+    parallelFor(num_chunks, num_threads, [&](size_t i) { CountObjChunk(buf, &chunks[i]); });
+
+    size_t num_lines = 0;
+    size_t num_v = 0;
+    size_t num_vn = 0;
+    size_t num_vt = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        obj_parse_state& state = chunks[i].state;
+        state.line_num = num_lines;
+        state.v_offset = num_v;
+        state.vn_offset = num_vn;
+        state.vt_offset = num_vt;
+        state.v.reserve(chunks[i].num_v * 3);
+        state.vc.reserve(chunks[i].num_v * 3);
+        state.vn.reserve(chunks[i].num_vn * 3);
+        state.vt.reserve(chunks[i].num_vt * 2);
+
+        num_lines += chunks[i].num_lines;
+        num_v += chunks[i].num_v;
+        num_vn += chunks[i].num_vn;
+        num_vt += chunks[i].num_vt;
+    }
 
-    // Read the exponent part.
-    if (*curr == 'e' || *curr == 'E') {
-        curr++;
-        // Figure out if a sign is present and if it is.
-        end_not_reached = (curr != s_end);
-        if (end_not_reached && (*curr == '+' || *curr == '-')) {
-            exp_sign = *curr;
-            curr++;
-        } else if (IS_DIGIT(*curr)) { /* Pass through. */
-        } else {
-            // Empty E is not allowed.
-            goto fail;
+    // 2. Parse vertex attributes and primitives.
+    parallelFor(num_chunks, num_threads, [&](size_t i) { ParseObjChunk(buf, &chunks[i], default_vcols_fallback); });
+
+    // 3. Merge attributes.
+    // Primitives of the chunks are moved into `state` with the storage of the
+    // chunk arenas, so `state` must be destroyed before `chunks`.
+    obj_parse_state state(arena);
+    state.num_threads = num_threads;
+    for (size_t i = 0; i < num_chunks; i++) {
+        const obj_parse_state& chunk_state = chunks[i].state;
+        state.found_all_colors &= chunk_state.found_all_colors;
+        state.greatest_v_idx = std::max(state.greatest_v_idx, chunk_state.greatest_v_idx);
+        state.greatest_vn_idx = std::max(state.greatest_vn_idx, chunk_state.greatest_vn_idx);
+        state.greatest_vt_idx = std::max(state.greatest_vt_idx, chunk_state.greatest_vt_idx);
+        state.vw.insert(state.vw.end(), chunk_state.vw.begin(), chunk_state.vw.end());
+    }
+
+    MergeChunkArrays(&state.v, &chunks, &obj_parse_state::v, num_threads);
+    MergeChunkArrays(&state.vn, &chunks, &obj_parse_state::vn, num_threads);
+    MergeChunkArrays(&state.vt, &chunks, &obj_parse_state::vt, num_threads);
+    if (state.found_all_colors || default_vcols_fallback) {
+        MergeChunkArrays(&state.vc, &chunks, &obj_parse_state::vc, num_threads);
+    }
+
+    // 4. Replay primitives and state lines in file order.
+    std::string linebuf;
+    for (size_t i = 0; i < num_chunks; i++) {
+        obj_chunk_t& chunk = chunks[i];
+        if (warn) {
+            (*warn) += chunk.warn;
+        }
+        if (!chunk.ok) {
+            if (err) {
+                (*err) += chunk.err;
+            }
+            return false;
         }
 
-        read = 0;
-        end_not_reached = (curr != s_end);
-        while (end_not_reached && IS_DIGIT(*curr)) {
-            // To avoid annoying MSVC's min/max macro definiton,
-            // Use hardcoded int max value
-            if (exponent > (2147483647 / 10)) {  // 2147483647 = std::numeric_limits<int>::max()
-                // Integer overflow
-                goto fail;
+        PrimGroup& chunk_group = chunk.state.prim_group;
+        for (size_t c = 0; c < chunk.commands.size(); c++) {
+            const obj_chunk_command_t& command = chunk.commands[c];
+            switch (command.type) {
+                case obj_chunk_command_t::FACES:
+                    for (size_t f = command.begin; f < command.end; f++) {
+                        state.prim_group.faceGroup.push_back(face_t());
+                        face_t& face = state.prim_group.faceGroup.back();
+                        face.smoothing_group_id = state.current_smoothing_id;
+                        face.vertex_indices.swap(chunk_group.faceGroup[f].vertex_indices);
+                    }
+                    break;
+                case obj_chunk_command_t::LINES:
+                    for (size_t l = command.begin; l < command.end; l++) {
+                        state.prim_group.lineGroup.push_back(__line_t());
+                        state.prim_group.lineGroup.back().vertex_indices.swap(chunk_group.lineGroup[l].vertex_indices);
+                    }
+                    break;
+                case obj_chunk_command_t::POINTS:
+                    for (size_t l = command.begin; l < command.end; l++) {
+                        state.prim_group.pointsGroup.push_back(__points_t());
+                        state.prim_group.pointsGroup.back().vertex_indices.swap(chunk_group.pointsGroup[l].vertex_indices);
+                    }
+                    break;
+                case obj_chunk_command_t::STATE_LINE:
+                    state.line_num = command.line_num;
+                    linebuf.assign(buf + command.begin, buf + command.end);
+                    if (!parseObjLine(
+                            &state, linebuf.c_str(), shapes, materials, readMatFn, triangulate, default_vcols_fallback, warn, err)) {
+                        return false;
+                    }
+                    break;
             }
-            exponent *= 10;
-            exponent += static_cast<int>(*curr - 0x30);
-            curr++;
-            read++;
-            end_not_reached = (curr != s_end);
         }
-        exponent *= (exp_sign == '+' ? 1 : -1);
-        if (read == 0) goto fail;
+        chunk_group.clear();
     }
+    state.line_num = num_lines;
+
+    finishObjParse(&state, attrib, shapes, triangulate, default_vcols_fallback, warn);
 
-assemble:
-    *result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
     return true;
-fail:
-    return false;
 }
 
-static inline real_t parseReal(const char** token, double default_value = 0.0) {
-    (*token) += strspn((*token), " \t");
-    const char* end = (*token) + strcspn((*token), " \t\r");
-    double val = default_value;
-    tryParseDouble((*token), end, &val);
-    real_t f = static_cast<real_t>(val);
-    (*token) = end;
-    return f;
-}
+bool LoadObjParallel(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn,
+    std::string* err, const char* filename, const char* mtl_basedir, bool triangulate, bool default_vcols_fallback,
+    unsigned int num_threads, ParseArena* arena) {
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
 
-static inline bool parseReal(const char** token, real_t* out) {
-    (*token) += strspn((*token), " \t");
-    const char* end = (*token) + strcspn((*token), " \t\r");
-    double val;
-    bool ret = tryParseDouble((*token), end, &val);
-    if (ret) {
-        real_t f = static_cast<real_t>(val);
-        (*out) = f;
+    MappedFile file;
+    if (!file.Open(filename)) {
+        std::stringstream errss;
+        errss << "Cannot open file [" << filename << "]\n";
+        if (err) {
+            (*err) = errss.str();
+        }
+        return false;
     }
-    (*token) = end;
-    return ret;
+
+    MaterialFileReader matFileReader(MtlBaseDir(mtl_basedir));
+
+    return LoadObjParallelFromBuffer(attrib, shapes, materials, warn, err, file.data(), file.size(), &matFileReader, triangulate,
+        default_vcols_fallback, num_threads, arena);
 }
 
-static inline void parseReal2(real_t* x, real_t* y, const char** token, const double default_x = 0.0, const double default_y = 0.0) {
-    (*x) = parseReal(token, default_x);
-    (*y) = parseReal(token, default_y);
+//
+// Binary parse cache.
+//
+// Layout: obj_cache_header_t followed by the payload. The payload starts with
+// the .mtl dependencies and the parse warnings, followed by attrib, shapes
+// and materials. Arrays of POD elements are stored as a 64-bit count and the
+// raw element bytes at an 8 byte aligned offset, so they can be copied
+// straight out of the mapped file.
+//
+
+static const char kObjCacheMagic[8] = {'T', 'O', 'B', 'J', 'C', 'A', 'C', 'H'};
+static const unsigned int kObjCacheVersion = 1;
+static const unsigned int kObjCacheByteOrder = 0x01020304;
+
+enum {
+    OBJ_CACHE_TRIANGULATE = 1 << 0,
+    OBJ_CACHE_DEFAULT_VCOLS_FALLBACK = 1 << 1,
+    OBJ_CACHE_REAL_T_DOUBLE = 1 << 2,
+};
+
+struct obj_cache_header_t {
+    char magic[8];
+    unsigned int version;
+    unsigned int byte_order;          // kObjCacheByteOrder as written by the host
+    unsigned int header_size;         // sizeof(obj_cache_header_t)
+    unsigned int flags;               // OBJ_CACHE_*
+    unsigned long long source_size;   // .obj file size
+    long long source_mtime;           // .obj modification time
+    unsigned long long source_hash;   // HashBytes() of the .obj content
+    unsigned long long options_hash;  // HashBytes() of the .mtl base directory
+    unsigned long long payload_size;
+    unsigned long long payload_hash;  // HashBytes() of the payload
+};
+
+// A .mtl file(or a candidate path which did not exist) read while parsing.
+struct obj_cache_dependency_t {
+    std::string path;
+    unsigned long long size;
+    long long mtime;
+    int exists;
+
+    obj_cache_dependency_t() : size(0), mtime(0), exists(0) {}
+};
+
+static const unsigned long long kHashPrime1 = 0x9E3779B185EBCA87ULL;
+static const unsigned long long kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const unsigned long long kHashPrime3 = 0x165667B19E3779F9ULL;
+static const unsigned long long kHashPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const unsigned long long kHashPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline unsigned long long HashRotl(unsigned long long x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline unsigned long long HashRound(unsigned long long acc, unsigned long long input) {
+    acc += input * kHashPrime2;
+    acc = HashRotl(acc, 31);
+    return acc * kHashPrime1;
 }
 
-static inline void parseReal3(real_t* x, real_t* y, real_t* z, const char** token, const double default_x = 0.0,
-    const double default_y = 0.0, const double default_z = 0.0) {
-    (*x) = parseReal(token, default_x);
-    (*y) = parseReal(token, default_y);
-    (*z) = parseReal(token, default_z);
+static inline unsigned long long HashMerge(unsigned long long acc, unsigned long long lane) {
+    acc ^= HashRound(0, lane);
+    return acc * kHashPrime1 + kHashPrime4;
 }
 
-static inline void parseV(real_t* x, real_t* y, real_t* z, real_t* w, const char** token, const double default_x = 0.0,
-    const double default_y = 0.0, const double default_z = 0.0, const double default_w = 1.0) {
-    (*x) = parseReal(token, default_x);
-    (*y) = parseReal(token, default_y);
-    (*z) = parseReal(token, default_z);
-    (*w) = parseReal(token, default_w);
+static inline unsigned long long HashRead64(const char* p) {
+    unsigned long long v;
+    memcpy(&v, p, sizeof(v));
+    return v;
 }
 
-// Extension: parse vertex with colors(6 items)
-static inline bool parseVertexWithColor(real_t* x, real_t* y, real_t* z, real_t* r, real_t* g, real_t* b, const char** token,
-    const double default_x = 0.0, const double default_y = 0.0, const double default_z = 0.0) {
-    (*x) = parseReal(token, default_x);
-    (*y) = parseReal(token, default_y);
-    (*z) = parseReal(token, default_z);
+static inline unsigned int HashRead32(const char* p) {
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-    const bool found_color = parseReal(token, r) && parseReal(token, g) && parseReal(token, b);
+// 64-bit content hash(xxHash64 construction: four independent 8 byte lanes
+// per 32 byte block, so the multiplies of the lanes overlap).
+static unsigned long long HashBytes(const char* data, size_t len, unsigned long long seed) {
+    const char* p = data;
+    const char* end = data + len;
+    unsigned long long h;
+
+    if (len >= 32) {
+        unsigned long long v1 = seed + kHashPrime1 + kHashPrime2;
+        unsigned long long v2 = seed + kHashPrime2;
+        unsigned long long v3 = seed;
+        unsigned long long v4 = seed - kHashPrime1;
+        const char* limit = end - 32;
+        do {
+            v1 = HashRound(v1, HashRead64(p));
+            v2 = HashRound(v2, HashRead64(p + 8));
+            v3 = HashRound(v3, HashRead64(p + 16));
+            v4 = HashRound(v4, HashRead64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = HashRotl(v1, 1) + HashRotl(v2, 7) + HashRotl(v3, 12) + HashRotl(v4, 18);
+        h = HashMerge(h, v1);
+        h = HashMerge(h, v2);
+        h = HashMerge(h, v3);
+        h = HashMerge(h, v4);
+    } else {
+        h = seed + kHashPrime5;
+    }
 
-    if (!found_color) {
-        (*r) = (*g) = (*b) = 1.0;
+    h += static_cast<unsigned long long>(len);
+
+    while (p + 8 <= end) {
+        h ^= HashRound(0, HashRead64(p));
+        h = HashRotl(h, 27) * kHashPrime1 + kHashPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<unsigned long long>(HashRead32(p)) * kHashPrime1;
+        h = HashRotl(h, 23) * kHashPrime2 + kHashPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= static_cast<unsigned long long>(static_cast<unsigned char>(*p)) * kHashPrime5;
+        h = HashRotl(h, 11) * kHashPrime1;
+        p++;
     }
 
-    return found_color;
+    h ^= h >> 33;
+    h *= kHashPrime2;
+    h ^= h >> 29;
+    h *= kHashPrime3;
+    h ^= h >> 32;
+    return h;
 }
 
-static inline bool parseOnOff(const char** token, bool default_value = true) {
-    (*token) += strspn((*token), " \t");
-    const char* end = (*token) + strcspn((*token), " \t\r");
+// Serializes into a byte buffer.
+// The field order is defined once by the `Serialize*` templates below, which
+// are instantiated with both ObjCacheWriter and ObjCacheReader.
+class ObjCacheWriter {
+public:
+    std::vector<char> buffer;
 
-    bool ret = default_value;
-    if ((0 == strncmp((*token), "on", 2))) {
-        ret = true;
-    } else if ((0 == strncmp((*token), "off", 3))) {
-        ret = false;
+    void Bytes(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        buffer.insert(buffer.end(), p, p + size);
     }
+    void Align() { buffer.resize((buffer.size() + 7) & ~static_cast<size_t>(7), '\0'); }
 
-    (*token) = end;
-    return ret;
-}
+    template <typename T>
+    void Pod(T* value) {
+        Bytes(value, sizeof(T));
+    }
+    template <typename T>
+    void Count(std::vector<T>* v) {
+        unsigned long long n = v->size();
+        Pod(&n);
+    }
+    template <typename T>
+    void PodArray(std::vector<T>* v) {
+        Count(v);
+        Align();
+        if (!v->empty()) {
+            Bytes(&v->at(0), v->size() * sizeof(T));
+        }
+    }
+    void String(std::string* s) {
+        unsigned long long n = s->size();
+        Pod(&n);
+        Bytes(s->data(), s->size());
+    }
+    void StringMap(std::map<std::string, std::string>* m) {
+        unsigned long long n = m->size();
+        Pod(&n);
+        for (std::map<std::string, std::string>::iterator it = m->begin(); it != m->end(); ++it) {
+            std::string key = it->first;
+            String(&key);
+            String(&it->second);
+        }
+    }
+};
 
-static inline texture_type_t parseTextureType(const char** token, texture_type_t default_value = TEXTURE_TYPE_NONE) {
-    (*token) += strspn((*token), " \t");
-    const char* end = (*token) + strcspn((*token), " \t\r");
-    texture_type_t ty = default_value;
+// Deserializes from a mapped payload. Any out of bounds read marks the
+// reader as failed and yields empty values.
+class ObjCacheReader {
+public:
+    ObjCacheReader(const char* data, size_t size) : begin_(data), p_(data), end_(data + size), ok_(true) {}
 
-    if ((0 == strncmp((*token), "cube_top", strlen("cube_top")))) {
-        ty = TEXTURE_TYPE_CUBE_TOP;
-    } else if ((0 == strncmp((*token), "cube_bottom", strlen("cube_bottom")))) {
-        ty = TEXTURE_TYPE_CUBE_BOTTOM;
-    } else if ((0 == strncmp((*token), "cube_left", strlen("cube_left")))) {
-        ty = TEXTURE_TYPE_CUBE_LEFT;
-    } else if ((0 == strncmp((*token), "cube_right", strlen("cube_right")))) {
-        ty = TEXTURE_TYPE_CUBE_RIGHT;
-    } else if ((0 == strncmp((*token), "cube_front", strlen("cube_front")))) {
-        ty = TEXTURE_TYPE_CUBE_FRONT;
-    } else if ((0 == strncmp((*token), "cube_back", strlen("cube_back")))) {
-        ty = TEXTURE_TYPE_CUBE_BACK;
-    } else if ((0 == strncmp((*token), "sphere", strlen("sphere")))) {
-        ty = TEXTURE_TYPE_SPHERE;
+    bool ok() const { return ok_; }
+    bool at_end() const { return p_ == end_; }
+
+    void Bytes(void* data, size_t size) {
+        if (!ok_ || size > static_cast<size_t>(end_ - p_)) {
+            ok_ = false;
+            return;
+        }
+        memcpy(data, p_, size);
+        p_ += size;
+    }
+    void Align() {
+        size_t offset = static_cast<size_t>(p_ - begin_);
+        size_t aligned = (offset + 7) & ~static_cast<size_t>(7);
+        if (aligned > static_cast<size_t>(end_ - begin_)) {
+            ok_ = false;
+            return;
+        }
+        p_ = begin_ + aligned;
+    }
+
+    template <typename T>
+    void Pod(T* value) {
+        Bytes(value, sizeof(T));
+    }
+    template <typename T>
+    void Count(std::vector<T>* v) {
+        unsigned long long n = 0;
+        Pod(&n);
+        // Every element takes at least one byte, so this rejects corrupted
+        // counts before allocating.
+        if (!ok_ || n > static_cast<unsigned long long>(end_ - p_)) {
+            ok_ = false;
+            n = 0;
+        }
+        v->resize(static_cast<size_t>(n));
+    }
+    template <typename T>
+    void PodArray(std::vector<T>* v) {
+        Count(v);
+        Align();
+        if (!ok_ || v->size() > static_cast<size_t>(end_ - p_) / sizeof(T)) {
+            ok_ = false;
+            v->clear();
+            return;
+        }
+        if (!v->empty()) {
+            Bytes(&v->at(0), v->size() * sizeof(T));
+        }
+    }
+    void String(std::string* s) {
+        unsigned long long n = 0;
+        Pod(&n);
+        if (!ok_ || n > static_cast<unsigned long long>(end_ - p_)) {
+            ok_ = false;
+            s->clear();
+            return;
+        }
+        s->assign(p_, static_cast<size_t>(n));
+        p_ += n;
+    }
+    void StringMap(std::map<std::string, std::string>* m) {
+        unsigned long long n = 0;
+        Pod(&n);
+        m->clear();
+        for (unsigned long long i = 0; ok_ && i < n; i++) {
+            std::string key;
+            std::string value;
+            String(&key);
+            String(&value);
+            m->insert(std::pair<std::string, std::string>(key, value));
+        }
     }
 
-    (*token) = end;
-    return ty;
+private:
+    const char* begin_;
+    const char* p_;
+    const char* end_;
+    bool ok_;
+};
+
+template <typename Archive>
+static void SerializeTextureOption(Archive* ar, texture_option_t* texopt) {
+    ar->Pod(&texopt->type);
+    ar->Pod(&texopt->sharpness);
+    ar->Pod(&texopt->brightness);
+    ar->Pod(&texopt->contrast);
+    ar->Pod(&texopt->origin_offset);
+    ar->Pod(&texopt->scale);
+    ar->Pod(&texopt->turbulence);
+    ar->Pod(&texopt->texture_resolution);
+    ar->Pod(&texopt->clamp);
+    ar->Pod(&texopt->imfchan);
+    ar->Pod(&texopt->blendu);
+    ar->Pod(&texopt->blendv);
+    ar->Pod(&texopt->bump_multiplier);
+    ar->String(&texopt->colorspace);
 }
 
-static tag_sizes parseTagTriple(const char** token) {
-    tag_sizes ts;
+template <typename Archive>
+static void SerializeMaterial(Archive* ar, material_t* material) {
+    ar->String(&material->name);
+
+    ar->Pod(&material->ambient);
+    ar->Pod(&material->diffuse);
+    ar->Pod(&material->specular);
+    ar->Pod(&material->transmittance);
+    ar->Pod(&material->emission);
+    ar->Pod(&material->shininess);
+    ar->Pod(&material->ior);
+    ar->Pod(&material->dissolve);
+    ar->Pod(&material->illum);
+    ar->Pod(&material->dummy);
+
+    ar->String(&material->ambient_texname);
+    ar->String(&material->diffuse_texname);
+    ar->String(&material->specular_texname);
+    ar->String(&material->specular_highlight_texname);
+    ar->String(&material->bump_texname);
+    ar->String(&material->displacement_texname);
+    ar->String(&material->alpha_texname);
+    ar->String(&material->reflection_texname);
+
+    SerializeTextureOption(ar, &material->ambient_texopt);
+    SerializeTextureOption(ar, &material->diffuse_texopt);
+    SerializeTextureOption(ar, &material->specular_texopt);
+    SerializeTextureOption(ar, &material->specular_highlight_texopt);
+    SerializeTextureOption(ar, &material->bump_texopt);
+    SerializeTextureOption(ar, &material->displacement_texopt);
+    SerializeTextureOption(ar, &material->alpha_texopt);
+    SerializeTextureOption(ar, &material->reflection_texopt);
+
+    ar->Pod(&material->roughness);
+    ar->Pod(&material->metallic);
+    ar->Pod(&material->sheen);
+    ar->Pod(&material->clearcoat_thickness);
+    ar->Pod(&material->clearcoat_roughness);
+    ar->Pod(&material->anisotropy);
+    ar->Pod(&material->anisotropy_rotation);
+    ar->Pod(&material->pad0);
+    ar->String(&material->roughness_texname);
+    ar->String(&material->metallic_texname);
+    ar->String(&material->sheen_texname);
+    ar->String(&material->emissive_texname);
+    ar->String(&material->normal_texname);
+
+    SerializeTextureOption(ar, &material->roughness_texopt);
+    SerializeTextureOption(ar, &material->metallic_texopt);
+    SerializeTextureOption(ar, &material->sheen_texopt);
+    SerializeTextureOption(ar, &material->emissive_texopt);
+    SerializeTextureOption(ar, &material->normal_texopt);
+
+    ar->Pod(&material->pad2);
+
+    ar->StringMap(&material->unknown_parameter);
+}
 
-    (*token) += strspn((*token), " \t");
-    ts.num_ints = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
-    if ((*token)[0] != '/') {
-        return ts;
+template <typename Archive>
+static void SerializeShape(Archive* ar, shape_t* shape) {
+    ar->String(&shape->name);
+
+    mesh_t& mesh = shape->mesh;
+    ar->PodArray(&mesh.indices);
+    ar->PodArray(&mesh.num_face_vertices);
+    ar->PodArray(&mesh.material_ids);
+    ar->PodArray(&mesh.smoothing_group_ids);
+    ar->Count(&mesh.tags);
+    for (size_t i = 0; i < mesh.tags.size(); i++) {
+        tag_t& tag = mesh.tags[i];
+        ar->String(&tag.name);
+        ar->PodArray(&tag.intValues);
+        ar->PodArray(&tag.floatValues);
+        ar->Count(&tag.stringValues);
+        for (size_t k = 0; k < tag.stringValues.size(); k++) {
+            ar->String(&tag.stringValues[k]);
+        }
     }
 
-    (*token)++;  // Skip '/'
+    ar->PodArray(&shape->lines.indices);
+    ar->PodArray(&shape->lines.num_line_vertices);
+    ar->PodArray(&shape->points.indices);
+}
 
-    (*token) += strspn((*token), " \t");
-    ts.num_reals = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
-    if ((*token)[0] != '/') {
-        return ts;
+template <typename Archive>
+static void SerializeObjCacheDependencies(Archive* ar, std::vector<obj_cache_dependency_t>* dependencies) {
+    ar->Count(dependencies);
+    for (size_t i = 0; i < dependencies->size(); i++) {
+        obj_cache_dependency_t& dependency = (*dependencies)[i];
+        ar->String(&dependency.path);
+        ar->Pod(&dependency.size);
+        ar->Pod(&dependency.mtime);
+        ar->Pod(&dependency.exists);
     }
-    (*token)++;  // Skip '/'
-
-    ts.num_strings = parseInt(token);
-
-    return ts;
 }
 
-// Parse triples with index offsets: i, i/j/k, i//k, i/j
-static bool parseTriple(const char** token, int vsize, int vnsize, int vtsize, vertex_index_t* ret, const warning_context& context) {
-    if (!ret) {
-        return false;
+template <typename Archive>
+static void SerializeObjCacheData(
+    Archive* ar, std::string* warn, attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials) {
+    ar->String(warn);
+
+    ar->PodArray(&attrib->vertices);
+    ar->PodArray(&attrib->vertex_weights);
+    ar->PodArray(&attrib->normals);
+    ar->PodArray(&attrib->texcoords);
+    ar->PodArray(&attrib->texcoord_ws);
+    ar->PodArray(&attrib->colors);
+    ar->Count(&attrib->skin_weights);
+    for (size_t i = 0; i < attrib->skin_weights.size(); i++) {
+        ar->Pod(&attrib->skin_weights[i].vertex_id);
+        ar->PodArray(&attrib->skin_weights[i].weightValues);
     }
 
-    vertex_index_t vi(-1);
-
-    if (!fixIndex(atoi((*token)), vsize, &vi.v_idx, false, context)) {
-        return false;
+    ar->Count(shapes);
+    for (size_t i = 0; i < shapes->size(); i++) {
+        SerializeShape(ar, &(*shapes)[i]);
     }
 
-    (*token) += strcspn((*token), "/ \t\r");
-    if ((*token)[0] != '/') {
-        (*ret) = vi;
-        return true;
+    ar->Count(materials);
+    for (size_t i = 0; i < materials->size(); i++) {
+        SerializeMaterial(ar, &(*materials)[i]);
     }
-    (*token)++;
+}
 
-    // i//k
-    if ((*token)[0] == '/') {
-        (*token)++;
-        if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
-            return false;
+// Loads .mtl files through MaterialFileReader and records every path it
+// looked at, so the cache is invalidated when a .mtl file changes or appears.
+class MaterialFileDependencyReader : public MaterialReader {
+public:
+    explicit MaterialFileDependencyReader(const std::string& mtl_basedir) : m_reader(mtl_basedir), m_mtlBaseDir(mtl_basedir) {}
+    virtual ~MaterialFileDependencyReader() TINYOBJ_OVERRIDE {}
+    virtual bool operator()(const std::string& matId, std::vector<material_t>* materials, std::map<std::string, int>* matMap,
+        std::string* warn, std::string* err) TINYOBJ_OVERRIDE {
+        std::vector<std::string> filepaths = MaterialFilePaths(m_mtlBaseDir, matId);
+        for (size_t i = 0; i < filepaths.size(); i++) {
+            obj_cache_dependency_t dependency;
+            dependency.path = filepaths[i];
+            dependency.exists = GetFileStat(filepaths[i].c_str(), &dependency.size, &dependency.mtime) ? 1 : 0;
+            dependencies.push_back(dependency);
+            if (dependency.exists) {
+                break;  // Later candidates are not read.
+            }
         }
-        (*token) += strcspn((*token), "/ \t\r");
-        (*ret) = vi;
-        return true;
+        return m_reader(matId, materials, matMap, warn, err);
     }
 
-    // i/j/k or i/j
-    if (!fixIndex(atoi((*token)), vtsize, &vi.vt_idx, true, context)) {
-        return false;
-    }
+    std::vector<obj_cache_dependency_t> dependencies;
 
-    (*token) += strcspn((*token), "/ \t\r");
-    if ((*token)[0] != '/') {
-        (*ret) = vi;
-        return true;
+private:
+    MaterialFileReader m_reader;
+    std::string m_mtlBaseDir;
+};
+
+static unsigned int ObjCacheFlags(bool triangulate, bool default_vcols_fallback) {
+    unsigned int flags = 0;
+    if (triangulate) {
+        flags |= OBJ_CACHE_TRIANGULATE;
+    }
+    if (default_vcols_fallback) {
+        flags |= OBJ_CACHE_DEFAULT_VCOLS_FALLBACK;
     }
+    if (sizeof(real_t) == sizeof(double)) {
+        flags |= OBJ_CACHE_REAL_T_DOUBLE;
+    }
+    return flags;
+}
 
-    // i/j/k
-    (*token)++;  // skip '/'
-    if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
+// Checks everything in the cache header except the .obj content hash, which
+// is only computed when needed.
+static bool ValidateObjCacheHeader(const MappedFile& cache, const obj_cache_header_t& expected, obj_cache_header_t* header) {
+    if (cache.size() < sizeof(obj_cache_header_t)) {
         return false;
     }
-    (*token) += strcspn((*token), "/ \t\r");
+    memcpy(header, cache.data(), sizeof(obj_cache_header_t));
 
-    (*ret) = vi;
+    if (memcmp(header->magic, kObjCacheMagic, sizeof(kObjCacheMagic)) != 0 || header->version != expected.version ||
+        header->byte_order != expected.byte_order || header->header_size != expected.header_size || header->flags != expected.flags ||
+        header->options_hash != expected.options_hash || header->source_size != expected.source_size ||
+        header->source_mtime != expected.source_mtime) {
+        return false;
+    }
 
+    const char* payload = cache.data() + sizeof(obj_cache_header_t);
+    const size_t payload_size = cache.size() - sizeof(obj_cache_header_t);
+    if (header->payload_size != payload_size || header->payload_hash != HashBytes(payload, payload_size, 0)) {
+        return false;
+    }
     return true;
 }
 
-// Parse raw triples: i, i/j/k, i//k, i/j
-static vertex_index_t parseRawTriple(const char** token) {
-    vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
+// Deserializes the cache payload. Outputs are only modified on success.
+static bool ReadObjCachePayload(const char* payload, size_t payload_size, attrib_t* attrib, std::vector<shape_t>* shapes,
+    std::vector<material_t>* materials, std::string* warn) {
+    ObjCacheReader reader(payload, payload_size);
 
-    vi.v_idx = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
-    if ((*token)[0] != '/') {
-        return vi;
+    std::vector<obj_cache_dependency_t> dependencies;
+    SerializeObjCacheDependencies(&reader, &dependencies);
+    if (!reader.ok()) {
+        return false;
     }
-    (*token)++;
-
-    // i//k
-    if ((*token)[0] == '/') {
-        (*token)++;
-        vi.vn_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
-        return vi;
+    for (size_t i = 0; i < dependencies.size(); i++) {
+        const obj_cache_dependency_t& dependency = dependencies[i];
+        unsigned long long size = 0;
+        long long mtime = 0;
+        const bool exists = GetFileStat(dependency.path.c_str(), &size, &mtime);
+        if (exists != (dependency.exists != 0) || (exists && (size != dependency.size || mtime != dependency.mtime))) {
+            return false;
+        }
     }
 
-    // i/j/k or i/j
-    vi.vt_idx = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
-    if ((*token)[0] != '/') {
-        return vi;
+    std::string cached_warn;
+    attrib_t cached_attrib;
+    std::vector<shape_t> cached_shapes;
+    std::vector<material_t> cached_materials;
+    SerializeObjCacheData(&reader, &cached_warn, &cached_attrib, &cached_shapes, &cached_materials);
+    if (!reader.ok() || !reader.at_end()) {
+        return false;
     }
 
-    // i/j/k
-    (*token)++;  // skip '/'
-    vi.vn_idx = atoi((*token));
-    (*token) += strcspn((*token), "/ \t\r");
-    return vi;
+    std::swap(*attrib, cached_attrib);
+    shapes->swap(cached_shapes);
+    materials->swap(cached_materials);
+    if (warn) {
+        (*warn) += cached_warn;
+    }
+    return true;
 }
 
-bool ParseTextureNameAndOption(std::string* texname, texture_option_t* texopt, const char* linebuf) {
-    // @todo { write more robust lexer and parser. }
-    bool found_texname = false;
-    std::string texture_name;
-
-    const char* token = linebuf;  // Assume line ends with NULL
-
-    while (!IS_NEW_LINE((*token))) {
-        token += strspn(token, " \t");  // skip space
-        if ((0 == strncmp(token, "-blendu", 7)) && IS_SPACE((token[7]))) {
-            token += 8;
-            texopt->blendu = parseOnOff(&token, /* default */ true);
-        } else if ((0 == strncmp(token, "-blendv", 7)) && IS_SPACE((token[7]))) {
-            token += 8;
-            texopt->blendv = parseOnOff(&token, /* default */ true);
-        } else if ((0 == strncmp(token, "-clamp", 6)) && IS_SPACE((token[6]))) {
-            token += 7;
-            texopt->clamp = parseOnOff(&token, /* default */ true);
-        } else if ((0 == strncmp(token, "-boost", 6)) && IS_SPACE((token[6]))) {
-            token += 7;
-            texopt->sharpness = parseReal(&token, 1.0);
-        } else if ((0 == strncmp(token, "-bm", 3)) && IS_SPACE((token[3]))) {
-            token += 4;
-            texopt->bump_multiplier = parseReal(&token, 1.0);
-        } else if ((0 == strncmp(token, "-o", 2)) && IS_SPACE((token[2]))) {
-            token += 3;
-            parseReal3(&(texopt->origin_offset[0]), &(texopt->origin_offset[1]), &(texopt->origin_offset[2]), &token);
-        } else if ((0 == strncmp(token, "-s", 2)) && IS_SPACE((token[2]))) {
-            token += 3;
-            parseReal3(&(texopt->scale[0]), &(texopt->scale[1]), &(texopt->scale[2]), &token, 1.0, 1.0, 1.0);
-        } else if ((0 == strncmp(token, "-t", 2)) && IS_SPACE((token[2]))) {
-            token += 3;
-            parseReal3(&(texopt->turbulence[0]), &(texopt->turbulence[1]), &(texopt->turbulence[2]), &token);
-        } else if ((0 == strncmp(token, "-type", 5)) && IS_SPACE((token[5]))) {
-            token += 5;
-            texopt->type = parseTextureType((&token), TEXTURE_TYPE_NONE);
-        } else if ((0 == strncmp(token, "-texres", 7)) && IS_SPACE((token[7]))) {
-            token += 7;
-            // TODO(syoyo): Check if arg is int type.
-            texopt->texture_resolution = parseInt(&token);
-        } else if ((0 == strncmp(token, "-imfchan", 8)) && IS_SPACE((token[8]))) {
-            token += 9;
-            token += strspn(token, " \t");
-            const char* end = token + strcspn(token, " \t\r");
-            if ((end - token) == 1) {  // Assume one char for -imfchan
-                texopt->imfchan = (*token);
-            }
-            token = end;
-        } else if ((0 == strncmp(token, "-mm", 3)) && IS_SPACE((token[3]))) {
-            token += 4;
-            parseReal2(&(texopt->brightness), &(texopt->contrast), &token, 0.0, 1.0);
-        } else if ((0 == strncmp(token, "-colorspace", 11)) && IS_SPACE((token[11]))) {
-            token += 12;
-            texopt->colorspace = parseString(&token);
-        } else {
-// Assume texture filename
-#if 0
-      size_t len = strcspn(token, " \t\r");  // untile next space
-      texture_name = std::string(token, token + len);
-      token += len;
-
-      token += strspn(token, " \t");  // skip space
-#else
-            // Read filename until line end to parse filename containing whitespace
-            // TODO(syoyo): Support parsing texture option flag after the filename.
-            texture_name = std::string(token);
-            token += texture_name.length();
-#endif
-
-            found_texname = true;
+// Writes to a temporary file and renames it, so a reader never sees a
+// partially written cache.
+static bool WriteObjCacheFile(const std::string& cache_filename, const obj_cache_header_t& header, const std::vector<char>& payload) {
+    const std::string tmp_filename = cache_filename + ".tmp";
+    {
+        std::ofstream ofs(tmp_filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!ofs) {
+            return false;
+        }
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!payload.empty()) {
+            ofs.write(&payload[0], static_cast<std::streamsize>(payload.size()));
+        }
+        ofs.close();
+        if (!ofs) {
+            std::remove(tmp_filename.c_str());
+            return false;
         }
     }
 
-    if (found_texname) {
-        (*texname) = texture_name;
-        return true;
-    } else {
+    std::remove(cache_filename.c_str());  // rename() does not replace an existing file on Windows.
+    if (std::rename(tmp_filename.c_str(), cache_filename.c_str()) != 0) {
+        std::remove(tmp_filename.c_str());
         return false;
     }
+    return true;
 }
 
-static void InitTexOpt(texture_option_t* texopt, const bool is_bump) {
-    if (is_bump) {
-        texopt->imfchan = 'l';
-    } else {
-        texopt->imfchan = 'm';
+bool LoadObjCached(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn,
+    std::string* err, const char* filename, const char* mtl_basedir, bool triangulate, bool default_vcols_fallback,
+    const ObjCacheConfig& cache_config, bool* cache_hit) {
+    if (cache_hit) {
+        (*cache_hit) = false;
+    }
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
+    materials->clear();
+
+    const std::string baseDir = MtlBaseDir(mtl_basedir);
+    const std::string cache_filename =
+        cache_config.cache_filename.empty() ? std::string(filename) + ".tobjcache" : cache_config.cache_filename;
+
+    obj_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kObjCacheMagic, sizeof(kObjCacheMagic));
+    header.version = kObjCacheVersion;
+    header.byte_order = kObjCacheByteOrder;
+    header.header_size = sizeof(obj_cache_header_t);
+    header.flags = ObjCacheFlags(triangulate, default_vcols_fallback);
+    header.options_hash = HashBytes(baseDir.data(), baseDir.size(), 0);
+
+    MappedFile source;
+    if (!GetFileStat(filename, &header.source_size, &header.source_mtime) || !source.Open(filename)) {
+        std::stringstream errss;
+        errss << "Cannot open file [" << filename << "]\n";
+        if (err) {
+            (*err) = errss.str();
+        }
+        return false;
     }
-    texopt->bump_multiplier = static_cast<real_t>(1.0);
-    texopt->clamp = false;
-    texopt->blendu = true;
-    texopt->blendv = true;
-    texopt->sharpness = static_cast<real_t>(1.0);
-    texopt->brightness = static_cast<real_t>(0.0);
-    texopt->contrast = static_cast<real_t>(1.0);
-    texopt->origin_offset[0] = static_cast<real_t>(0.0);
-    texopt->origin_offset[1] = static_cast<real_t>(0.0);
-    texopt->origin_offset[2] = static_cast<real_t>(0.0);
-    texopt->scale[0] = static_cast<real_t>(1.0);
-    texopt->scale[1] = static_cast<real_t>(1.0);
-    texopt->scale[2] = static_cast<real_t>(1.0);
-    texopt->turbulence[0] = static_cast<real_t>(0.0);
-    texopt->turbulence[1] = static_cast<real_t>(0.0);
-    texopt->turbulence[2] = static_cast<real_t>(0.0);
-    texopt->texture_resolution = -1;
-    texopt->type = TEXTURE_TYPE_NONE;
-}
 
-static void InitMaterial(material_t* material) {
-    InitTexOpt(&material->ambient_texopt, /* is_bump */ false);
-    InitTexOpt(&material->diffuse_texopt, /* is_bump */ false);
-    InitTexOpt(&material->specular_texopt, /* is_bump */ false);
-    InitTexOpt(&material->specular_highlight_texopt, /* is_bump */ false);
-    InitTexOpt(&material->bump_texopt, /* is_bump */ true);
-    InitTexOpt(&material->displacement_texopt, /* is_bump */ false);
-    InitTexOpt(&material->alpha_texopt, /* is_bump */ false);
-    InitTexOpt(&material->reflection_texopt, /* is_bump */ false);
-    InitTexOpt(&material->roughness_texopt, /* is_bump */ false);
-    InitTexOpt(&material->metallic_texopt, /* is_bump */ false);
-    InitTexOpt(&material->sheen_texopt, /* is_bump */ false);
-    InitTexOpt(&material->emissive_texopt, /* is_bump */ false);
-    InitTexOpt(&material->normal_texopt,
-        /* is_bump */ false);  // @fixme { is_bump will be true? }
-    material->name = "";
-    material->ambient_texname = "";
-    material->diffuse_texname = "";
-    material->specular_texname = "";
-    material->specular_highlight_texname = "";
-    material->bump_texname = "";
-    material->displacement_texname = "";
-    material->reflection_texname = "";
-    material->alpha_texname = "";
-    for (int i = 0; i < 3; i++) {
-        material->ambient[i] = static_cast<real_t>(0.0);
-        material->diffuse[i] = static_cast<real_t>(0.0);
-        material->specular[i] = static_cast<real_t>(0.0);
-        material->transmittance[i] = static_cast<real_t>(0.0);
-        material->emission[i] = static_cast<real_t>(0.0);
+    bool source_hashed = false;
+    if (!cache_config.rebuild) {
+        MappedFile cache;
+        obj_cache_header_t cached_header;
+        if (cache.Open(cache_filename.c_str()) && ValidateObjCacheHeader(cache, header, &cached_header)) {
+            bool content_matches = true;
+            if (cache_config.verify_content_hash) {
+                header.source_hash = HashBytes(source.data(), source.size(), 0);
+                source_hashed = true;
+                content_matches = (header.source_hash == cached_header.source_hash);
+            }
+            if (content_matches && ReadObjCachePayload(cache.data() + sizeof(obj_cache_header_t), cache.size() - sizeof(obj_cache_header_t),
+                                       attrib, shapes, materials, warn)) {
+                if (cache_hit) {
+                    (*cache_hit) = true;
+                }
+                return true;
+            }
+        }
     }
-    material->illum = 0;
-    material->dissolve = static_cast<real_t>(1.0);
-    material->shininess = static_cast<real_t>(1.0);
-    material->ior = static_cast<real_t>(1.0);
 
-    material->roughness = static_cast<real_t>(0.0);
-    material->metallic = static_cast<real_t>(0.0);
-    material->sheen = static_cast<real_t>(0.0);
-    material->clearcoat_thickness = static_cast<real_t>(0.0);
-    material->clearcoat_roughness = static_cast<real_t>(0.0);
-    material->anisotropy_rotation = static_cast<real_t>(0.0);
-    material->anisotropy = static_cast<real_t>(0.0);
-    material->roughness_texname = "";
-    material->metallic_texname = "";
-    material->sheen_texname = "";
-    material->emissive_texname = "";
-    material->normal_texname = "";
+    // Cache miss: parse the .obj and write a new cache.
+    if (!source_hashed) {
+        header.source_hash = HashBytes(source.data(), source.size(), 0);
+    }
+
+    MaterialFileDependencyReader matFileReader(baseDir);
+    std::string parse_warn;
+    bool ret = LoadObjParallelFromBuffer(attrib, shapes, materials, &parse_warn, err, source.data(), source.size(), &matFileReader,
+        triangulate, default_vcols_fallback, cache_config.num_threads, cache_config.arena);
+    if (warn) {
+        (*warn) += parse_warn;
+    }
+    if (!ret || !cache_config.write_cache) {
+        return ret;
+    }
 
-    material->unknown_parameter.clear();
-}
+    ObjCacheWriter writer;
+    SerializeObjCacheDependencies(&writer, &matFileReader.dependencies);
+    SerializeObjCacheData(&writer, &parse_warn, attrib, shapes, materials);
+    header.payload_size = writer.buffer.size();
+    header.payload_hash = HashBytes(writer.buffer.empty() ? NULL : &writer.buffer[0], writer.buffer.size(), 0);
 
-// code from https://wrf.ecse.rpi.edu//Research/Short_Notes/pnpoly.html
-template <typename T>
-static int pnpoly(int nvert, T* vertx, T* verty, T testx, T testy) {
-    int i, j, c = 0;
-    for (i = 0, j = nvert - 1; i < nvert; j = i++) {
-        if (((verty[i] > testy) != (verty[j] > testy)) &&
-            (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
-            c = !c;
+    if (!WriteObjCacheFile(cache_filename, header, writer.buffer)) {
+        if (warn) {
+            (*warn) += "Failed to write parse cache [" + cache_filename + "]\n";
+        }
     }
-    return c;
+
+    return true;
 }
 
-struct TinyObjPoint {
-    real_t x, y, z;
-    TinyObjPoint() : x(0), y(0), z(0) {}
-    TinyObjPoint(real_t x_, real_t y_, real_t z_) : x(x_), y(y_), z(z_) {}
-};
+//
+// Shape index(`BuildObjShapeIndex`, `LoadObjShapes`).
+//
+// The index file uses the parse cache header(with its own magic) followed by
+// the serialized `obj_shape_index_t`.
+//
 
-inline TinyObjPoint cross(const TinyObjPoint& v1, const TinyObjPoint& v2) {
-    return TinyObjPoint(v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x);
-}
+static const char kObjShapeIndexMagic[8] = {'T', 'O', 'B', 'J', 'I', 'N', 'D', 'X'};
+static const unsigned int kObjShapeIndexVersion = 1;
 
-inline real_t dot(const TinyObjPoint& v1, const TinyObjPoint& v2) {
-    return (v1.x * v2.x + v1.y * v2.y + v1.z * v2.z);
+// `v`, `vn` and `vt` lines per block of `obj_shape_index_t`.
+static const size_t kObjShapeIndexBlockSize = 256;
+
+void obj_shape_index_t::FindShapes(const std::string& name, std::vector<size_t>* ids) const {
+    for (size_t i = 0; i < shapes.size(); i++) {
+        if (shapes[i].name == name) {
+            ids->push_back(i);
+        }
+    }
 }
 
-inline real_t GetLength(TinyObjPoint& e) {
-    return std::sqrt(e.x * e.x + e.y * e.y + e.z * e.z);
+// Line types told apart by the shape index(same tests as `parseObjLine`).
+enum obj_line_type_t {
+    OBJ_LINE_OTHER,
+    OBJ_LINE_V,
+    OBJ_LINE_VN,
+    OBJ_LINE_VT,
+    OBJ_LINE_F,
+    OBJ_LINE_L,
+    OBJ_LINE_P,
+    OBJ_LINE_G,
+    OBJ_LINE_O,
+    OBJ_LINE_S,
+    OBJ_LINE_T,
+    OBJ_LINE_USEMTL,
+    OBJ_LINE_MTLLIB,
+};
+
+// `token` is the first non-space character of a line ending at `eol`.
+static obj_line_type_t ClassifyObjLine(const char* token, const char* eol) {
+    const size_t len = static_cast<size_t>(eol - token);
+    if (len < 2) {
+        return OBJ_LINE_OTHER;
+    }
+    if (IS_SPACE(token[1])) {
+        switch (token[0]) {
+            case 'v':
+                return OBJ_LINE_V;
+            case 'f':
+                return OBJ_LINE_F;
+            case 'l':
+                return OBJ_LINE_L;
+            case 'p':
+                return OBJ_LINE_P;
+            case 'g':
+                return OBJ_LINE_G;
+            case 'o':
+                return OBJ_LINE_O;
+            case 's':
+                return OBJ_LINE_S;
+            case 't':
+                return OBJ_LINE_T;
+            default:
+                return OBJ_LINE_OTHER;
+        }
+    }
+    if (token[0] == 'v' && len >= 3 && IS_SPACE(token[2])) {
+        if (token[1] == 'n') {
+            return OBJ_LINE_VN;
+        }
+        if (token[1] == 't') {
+            return OBJ_LINE_VT;
+        }
+        return OBJ_LINE_OTHER;
+    }
+    if (len >= 6 && 0 == strncmp(token, "usemtl", 6)) {
+        return OBJ_LINE_USEMTL;
+    }
+    if (len >= 7 && 0 == strncmp(token, "mtllib", 6) && IS_SPACE(token[6])) {
+        return OBJ_LINE_MTLLIB;
+    }
+    return OBJ_LINE_OTHER;
 }
 
-inline TinyObjPoint Normalize(TinyObjPoint e) {
-    real_t inv_length = real_t(1) / GetLength(e);
-    return TinyObjPoint(e.x * inv_length, e.y * inv_length, e.z * inv_length);
+static inline obj_line_type_t ClassifyObjLine(const char* line, const char* eol, const char** token) {
+    const char* p = line;
+    while (p < eol && IS_SPACE(*p)) {
+        p++;
+    }
+    (*token) = p;
+    return ClassifyObjLine(p, eol);
 }
 
-inline TinyObjPoint WorldToLocal(const TinyObjPoint& a, const TinyObjPoint& u, const TinyObjPoint& v, const TinyObjPoint& w) {
-    return TinyObjPoint(dot(a, u), dot(a, v), dot(a, w));
+// Ends the group `entry` at `end`. It is kept when `LoadObj` would create a
+// shape for it: `g` only flushes groups with faces, `o` and the end of the
+// file also flush lines and points. Faces are counted by line type without
+// parsing indices, so groups of only degenerate faces are kept too.
+static void CloseObjShapeIndexEntry(obj_shape_index_t* index, const obj_shape_index_entry_t& entry, unsigned long long end,
+    bool closed_by_group) {
+    if (entry.num_faces > 0 || (!closed_by_group && (entry.num_lines > 0 || entry.num_points > 0))) {
+        index->shapes.push_back(entry);
+        index->shapes.back().end = end;
+    }
 }
 
-// TODO(syoyo): refactor function.
-static bool exportGroupsToShape(shape_t* shape, const PrimGroup& prim_group, const std::vector<tag_t>& tags, const int material_id,
-    const std::string& name, bool triangulate, const std::vector<real_t>& v, std::string* warn) {
-    if (prim_group.IsEmpty()) {
+bool BuildObjShapeIndex(obj_shape_index_t* index, std::string* err, const char* filename) {
+    (*index) = obj_shape_index_t();
+
+    MappedFile file;
+    if (!GetFileStat(filename, &index->source_size, &index->source_mtime) || !file.Open(filename)) {
+        if (err) {
+            std::stringstream errss;
+            errss << "Cannot open file [" << filename << "]\n";
+            (*err) = errss.str();
+        }
         return false;
     }
 
-    shape->name = name;
-
-    // polygon
-    if (!prim_group.faceGroup.empty()) {
-        // Flatten vertices and indices
-        for (size_t i = 0; i < prim_group.faceGroup.size(); i++) {
-            const face_t& face = prim_group.faceGroup[i];
+    // Group names are parsed by `parseObjLine` so they match `shape_t::name`.
+    obj_parse_state name_state;
+    std::vector<shape_t> name_shapes;
+    std::string name_warn;
+    std::string linebuf;
 
-            size_t npolys = face.vertex_indices.size();
+    obj_shape_index_entry_t entry;
+    unsigned long long material_line = ~0ULL;
+    unsigned long long smoothing_line = ~0ULL;
+    unsigned long long line_num = 0;
+
+    const char* data = file.data();
+    const char* end = data + file.size();
+    const char* p = data;
+    while (p < end) {
+        const char* line = p;
+        const char* eol = FindLineEnd(p, end);
+        p = SkipLineEnding(eol, end);
+        const unsigned long long offset = static_cast<unsigned long long>(line - data);
+        line_num++;
 
-            if (npolys < 3) {
-                // Face must have 3+ vertices.
-                if (warn) {
-                    (*warn) += "Degenerated face found\n.";
+        const char* token;
+        const obj_line_type_t type = ClassifyObjLine(line, eol, &token);
+        switch (type) {
+            case OBJ_LINE_V:
+                if (index->num_vertices % kObjShapeIndexBlockSize == 0) {
+                    index->vertex_blocks.push_back(offset);
                 }
-                continue;
-            }
-
-            if (triangulate && npolys != 3) {
-                if (npolys == 4) {
-                    vertex_index_t i0 = face.vertex_indices[0];
-                    vertex_index_t i1 = face.vertex_indices[1];
-                    vertex_index_t i2 = face.vertex_indices[2];
-                    vertex_index_t i3 = face.vertex_indices[3];
-
-                    size_t vi0 = size_t(i0.v_idx);
-                    size_t vi1 = size_t(i1.v_idx);
-                    size_t vi2 = size_t(i2.v_idx);
-                    size_t vi3 = size_t(i3.v_idx);
-
-                    if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) || ((3 * vi2 + 2) >= v.size()) ||
-                        ((3 * vi3 + 2) >= v.size())) {
-                        // Invalid triangle.
-                        // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
-                        if (warn) {
-                            (*warn) += "Face with invalid vertex index found.\n";
-                        }
-                        continue;
-                    }
-
-                    real_t v0x = v[vi0 * 3 + 0];
-                    real_t v0y = v[vi0 * 3 + 1];
-                    real_t v0z = v[vi0 * 3 + 2];
-                    real_t v1x = v[vi1 * 3 + 0];
-                    real_t v1y = v[vi1 * 3 + 1];
-                    real_t v1z = v[vi1 * 3 + 2];
-                    real_t v2x = v[vi2 * 3 + 0];
-                    real_t v2y = v[vi2 * 3 + 1];
-                    real_t v2z = v[vi2 * 3 + 2];
-                    real_t v3x = v[vi3 * 3 + 0];
-                    real_t v3y = v[vi3 * 3 + 1];
-                    real_t v3z = v[vi3 * 3 + 2];
-
-                    // There are two candidates to split the quad into two triangles.
-                    //
-                    // Choose the shortest edge.
-                    // TODO: Is it better to determine the edge to split by calculating
-                    // the area of each triangle?
-                    //
-                    // +---+
-                    // |\  |
-                    // | \ |
-                    // |  \|
-                    // +---+
-                    //
-                    // +---+
-                    // |  /|
-                    // | / |
-                    // |/  |
-                    // +---+
-
-                    real_t e02x = v2x - v0x;
-                    real_t e02y = v2y - v0y;
-                    real_t e02z = v2z - v0z;
-                    real_t e13x = v3x - v1x;
-                    real_t e13y = v3y - v1y;
-                    real_t e13z = v3z - v1z;
-
-                    real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
-                    real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
-
-                    index_t idx0, idx1, idx2, idx3;
-
-                    idx0.vertex_index = i0.v_idx;
-                    idx0.normal_index = i0.vn_idx;
-                    idx0.texcoord_index = i0.vt_idx;
-                    idx1.vertex_index = i1.v_idx;
-                    idx1.normal_index = i1.vn_idx;
-                    idx1.texcoord_index = i1.vt_idx;
-                    idx2.vertex_index = i2.v_idx;
-                    idx2.normal_index = i2.vn_idx;
-                    idx2.texcoord_index = i2.vt_idx;
-                    idx3.vertex_index = i3.v_idx;
-                    idx3.normal_index = i3.vn_idx;
-                    idx3.texcoord_index = i3.vt_idx;
-
-                    if (sqr02 < sqr13) {
-                        // [0, 1, 2], [0, 2, 3]
-                        shape->mesh.indices.push_back(idx0);
-                        shape->mesh.indices.push_back(idx1);
-                        shape->mesh.indices.push_back(idx2);
-
-                        shape->mesh.indices.push_back(idx0);
-                        shape->mesh.indices.push_back(idx2);
-                        shape->mesh.indices.push_back(idx3);
-                    } else {
-                        // [0, 1, 3], [1, 2, 3]
-                        shape->mesh.indices.push_back(idx0);
-                        shape->mesh.indices.push_back(idx1);
-                        shape->mesh.indices.push_back(idx3);
-
-                        shape->mesh.indices.push_back(idx1);
-                        shape->mesh.indices.push_back(idx2);
-                        shape->mesh.indices.push_back(idx3);
-                    }
-
-                    // Two triangle faces
-                    shape->mesh.num_face_vertices.push_back(3);
-                    shape->mesh.num_face_vertices.push_back(3);
-
-                    shape->mesh.material_ids.push_back(material_id);
-                    shape->mesh.material_ids.push_back(material_id);
-
-                    shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
-                    shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
+                index->num_vertices++;
+                entry.num_vertices++;
+                break;
+            case OBJ_LINE_VN:
+                if (index->num_normals % kObjShapeIndexBlockSize == 0) {
+                    index->normal_blocks.push_back(offset);
+                }
+                index->num_normals++;
+                entry.num_normals++;
+                break;
+            case OBJ_LINE_VT:
+                if (index->num_texcoords % kObjShapeIndexBlockSize == 0) {
+                    index->texcoord_blocks.push_back(offset);
+                }
+                index->num_texcoords++;
+                entry.num_texcoords++;
+                break;
+            case OBJ_LINE_F:
+                entry.num_faces++;
+                break;
+            case OBJ_LINE_L:
+                entry.num_lines++;
+                break;
+            case OBJ_LINE_P:
+                entry.num_points++;
+                break;
+            case OBJ_LINE_USEMTL:
+                material_line = offset;
+                break;
+            case OBJ_LINE_S:
+                smoothing_line = offset;
+                break;
+            case OBJ_LINE_MTLLIB:
+                index->mtllib_lines.push_back(offset);
+                break;
+            case OBJ_LINE_T:
+                index->tag_lines.push_back(offset);
+                break;
+            case OBJ_LINE_G:
+            case OBJ_LINE_O:
+                CloseObjShapeIndexEntry(index, entry, offset, type == OBJ_LINE_G);
+
+                entry = obj_shape_index_entry_t();
+                entry.begin = offset;
+                entry.vertex_offset = index->num_vertices;
+                entry.normal_offset = index->num_normals;
+                entry.texcoord_offset = index->num_texcoords;
+                entry.line_num = line_num - 1;
+                entry.material_line = material_line;
+                entry.smoothing_line = smoothing_line;
+
+                linebuf.assign(line, eol);
+                parseObjLine(&name_state, linebuf.c_str(), &name_shapes, NULL, NULL, false, true, &name_warn, NULL);
+                entry.name = name_state.name;
+                break;
+            default:
+                break;
+        }
+    }
+    CloseObjShapeIndexEntry(index, entry, static_cast<unsigned long long>(file.size()), false);
 
-                } else {
-#ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
-                    vertex_index_t i0 = face.vertex_indices[0];
-                    vertex_index_t i0_2 = i0;
+    return true;
+}
 
-                    // TMW change: Find the normal axis of the polygon using Newell's method
-                    TinyObjPoint n;
-                    for (size_t k = 0; k < npolys; ++k) {
-                        i0 = face.vertex_indices[k % npolys];
-                        size_t vi0 = size_t(i0.v_idx);
+template <typename Archive>
+static void SerializeObjShapeIndex(Archive* ar, obj_shape_index_t* index) {
+    ar->Pod(&index->num_vertices);
+    ar->Pod(&index->num_normals);
+    ar->Pod(&index->num_texcoords);
+    ar->PodArray(&index->vertex_blocks);
+    ar->PodArray(&index->normal_blocks);
+    ar->PodArray(&index->texcoord_blocks);
+    ar->PodArray(&index->mtllib_lines);
+    ar->PodArray(&index->tag_lines);
+
+    ar->Count(&index->shapes);
+    for (size_t i = 0; i < index->shapes.size(); i++) {
+        obj_shape_index_entry_t& entry = index->shapes[i];
+        ar->String(&entry.name);
+        ar->Pod(&entry.begin);
+        ar->Pod(&entry.end);
+        ar->Pod(&entry.vertex_offset);
+        ar->Pod(&entry.normal_offset);
+        ar->Pod(&entry.texcoord_offset);
+        ar->Pod(&entry.line_num);
+        ar->Pod(&entry.num_vertices);
+        ar->Pod(&entry.num_normals);
+        ar->Pod(&entry.num_texcoords);
+        ar->Pod(&entry.num_faces);
+        ar->Pod(&entry.num_lines);
+        ar->Pod(&entry.num_points);
+        ar->Pod(&entry.material_line);
+        ar->Pod(&entry.smoothing_line);
+    }
+}
 
-                        size_t j = (k + 1) % npolys;
-                        i0_2 = face.vertex_indices[j];
-                        size_t vi0_2 = size_t(i0_2.v_idx);
+static void InitObjShapeIndexHeader(obj_cache_header_t* header) {
+    memset(header, 0, sizeof(obj_cache_header_t));
+    memcpy(header->magic, kObjShapeIndexMagic, sizeof(kObjShapeIndexMagic));
+    header->version = kObjShapeIndexVersion;
+    header->byte_order = kObjCacheByteOrder;
+    header->header_size = sizeof(obj_cache_header_t);
+}
 
-                        real_t v0x = v[vi0 * 3 + 0];
-                        real_t v0y = v[vi0 * 3 + 1];
-                        real_t v0z = v[vi0 * 3 + 2];
+bool SaveObjShapeIndex(const obj_shape_index_t& index, std::string* err, const char* index_filename) {
+    obj_shape_index_t copy = index;
+    ObjCacheWriter writer;
+    SerializeObjShapeIndex(&writer, &copy);
 
-                        real_t v0x_2 = v[vi0_2 * 3 + 0];
-                        real_t v0y_2 = v[vi0_2 * 3 + 1];
-                        real_t v0z_2 = v[vi0_2 * 3 + 2];
+    obj_cache_header_t header;
+    InitObjShapeIndexHeader(&header);
+    header.source_size = index.source_size;
+    header.source_mtime = index.source_mtime;
+    header.payload_size = writer.buffer.size();
+    header.payload_hash = HashBytes(writer.buffer.empty() ? NULL : &writer.buffer[0], writer.buffer.size(), 0);
 
-                        const TinyObjPoint point1(v0x, v0y, v0z);
-                        const TinyObjPoint point2(v0x_2, v0y_2, v0z_2);
+    if (!WriteObjCacheFile(index_filename, header, writer.buffer)) {
+        if (err) {
+            (*err) = "Failed to write shape index [" + std::string(index_filename) + "]\n";
+        }
+        return false;
+    }
+    return true;
+}
 
-                        TinyObjPoint a(point1.x - point2.x, point1.y - point2.y, point1.z - point2.z);
-                        TinyObjPoint b(point1.x + point2.x, point1.y + point2.y, point1.z + point2.z);
+bool LoadObjShapeIndex(obj_shape_index_t* index, std::string* err, const char* index_filename, const char* obj_filename) {
+    MappedFile file;
+    if (!file.Open(index_filename)) {
+        if (err) {
+            (*err) = "Cannot open shape index [" + std::string(index_filename) + "]\n";
+        }
+        return false;
+    }
 
-                        n.x += (a.y * b.z);
-                        n.y += (a.z * b.x);
-                        n.z += (a.x * b.y);
-                    }
-                    real_t length_n = GetLength(n);
-                    // Check if zero length normal
-                    if (length_n <= 0) {
-                        continue;
-                    }
-                    // Negative is to flip the normal to the correct direction
-                    real_t inv_length = -real_t(1.0) / length_n;
-                    n.x *= inv_length;
-                    n.y *= inv_length;
-                    n.z *= inv_length;
-
-                    TinyObjPoint axis_w, axis_v, axis_u;
-                    axis_w = n;
-                    TinyObjPoint a;
-                    if (std::abs(axis_w.x) > real_t(0.9999999)) {
-                        a = TinyObjPoint(0, 1, 0);
-                    } else {
-                        a = TinyObjPoint(1, 0, 0);
-                    }
-                    axis_v = Normalize(cross(axis_w, a));
-                    axis_u = cross(axis_w, axis_v);
-                    using Point = std::array<real_t, 2>;
+    obj_cache_header_t expected;
+    InitObjShapeIndexHeader(&expected);
+    obj_cache_header_t header;
+    bool ok = file.size() >= sizeof(obj_cache_header_t);
+    if (ok) {
+        memcpy(&header, file.data(), sizeof(obj_cache_header_t));
+        const char* payload = file.data() + sizeof(obj_cache_header_t);
+        const size_t payload_size = file.size() - sizeof(obj_cache_header_t);
+        ok = memcmp(header.magic, expected.magic, sizeof(expected.magic)) == 0 && header.version == expected.version &&
+             header.byte_order == expected.byte_order && header.header_size == expected.header_size &&
+             header.payload_size == payload_size && header.payload_hash == HashBytes(payload, payload_size, 0);
+    }
+    if (!ok) {
+        if (err) {
+            (*err) = "Invalid shape index [" + std::string(index_filename) + "]\n";
+        }
+        return false;
+    }
 
-                    // first polyline define the main polygon.
-                    // following polylines define holes(not used in tinyobj).
-                    std::vector<std::vector<Point>> polygon;
+    if (obj_filename) {
+        unsigned long long size = 0;
+        long long mtime = 0;
+        if (!GetFileStat(obj_filename, &size, &mtime) || size != header.source_size || mtime != header.source_mtime) {
+            if (err) {
+                (*err) = "Shape index [" + std::string(index_filename) + "] is out of date\n";
+            }
+            return false;
+        }
+    }
 
-                    std::vector<Point> polyline;
+    obj_shape_index_t loaded;
+    ObjCacheReader reader(file.data() + sizeof(obj_cache_header_t), file.size() - sizeof(obj_cache_header_t));
+    SerializeObjShapeIndex(&reader, &loaded);
+    if (!reader.ok() || !reader.at_end()) {
+        if (err) {
+            (*err) = "Invalid shape index [" + std::string(index_filename) + "]\n";
+        }
+        return false;
+    }
+    loaded.source_size = header.source_size;
+    loaded.source_mtime = header.source_mtime;
+    std::swap(*index, loaded);
+    return true;
+}
 
-                    // TMW change: Find best normal and project v0x and v0y to those coordinates, instead of
-                    // picking a plane aligned with an axis (which can flip polygons).
+// Faces of a shape up to a material change(`usemtl`), exported once the
+// referenced vertices are loaded.
+struct obj_shape_segment_t {
+    PrimGroup prim_group;
+    std::vector<tag_t> tags;
+    int material;
 
-                    // Fill polygon data(facevarying vertices).
-                    for (size_t k = 0; k < npolys; k++) {
-                        i0 = face.vertex_indices[k];
-                        size_t vi0 = size_t(i0.v_idx);
+    obj_shape_segment_t() : material(-1) {}
+};
 
-                        assert(((3 * vi0 + 2) < v.size()));
+// A shape selected by `LoadObjShapes`.
+struct obj_selected_shape_t {
+    std::string name;
+    std::vector<obj_shape_segment_t> segments;
+};
 
-                        real_t v0x = v[vi0 * 3 + 0];
-                        real_t v0y = v[vi0 * 3 + 1];
-                        real_t v0z = v[vi0 * 3 + 2];
+// Moves the pending primitives of `state` into a new segment. Lines and
+// points stay pending, as with `usemtl` in `parseObjLine`.
+static void PushObjShapeSegment(obj_parse_state* state, int material, obj_selected_shape_t* shape) {
+    shape->segments.push_back(obj_shape_segment_t());
+    obj_shape_segment_t& segment = shape->segments.back();
+    segment.prim_group.faceGroup.swap(state->prim_group.faceGroup);
+    segment.prim_group.lineGroup = state->prim_group.lineGroup;
+    segment.prim_group.pointsGroup = state->prim_group.pointsGroup;
+    segment.tags = state->tags;
+    segment.material = material;
+}
 
-                        TinyObjPoint polypoint(v0x, v0y, v0z);
-                        TinyObjPoint loc = WorldToLocal(polypoint, axis_u, axis_v, axis_w);
+// Parses the line at `offset`(a state line outside the selected shapes).
+static bool ParseObjLineAt(const MappedFile& file, unsigned long long offset, obj_parse_state* state, std::vector<material_t>* materials,
+    MaterialReader* readMatFn, std::string* warn, std::string* err) {
+    if (offset >= file.size()) {
+        return true;
+    }
+    const char* line = file.data() + offset;
+    std::string linebuf(line, FindLineEnd(line, file.data() + file.size()));
+    std::vector<shape_t> no_shapes;
+    return parseObjLine(state, linebuf.c_str(), &no_shapes, materials, readMatFn, false, true, warn, err);
+}
 
-                        polyline.push_back({loc.x, loc.y});
-                    }
+// Reads the `type` lines `ids`(sorted, unique) through the block offsets
+// `blocks` and passes each to `parse` with its position in `ids`.
+template <typename ParseFn>
+static void ReadObjElements(const MappedFile& file, const std::vector<unsigned long long>& blocks, obj_line_type_t type,
+    const std::vector<int>& ids, ParseFn parse) {
+    const char* data = file.data();
+    const char* end = data + file.size();
+    std::string linebuf;
+    size_t i = 0;
+    while (i < ids.size()) {
+        const size_t block = static_cast<size_t>(ids[i]) / kObjShapeIndexBlockSize;
+        if (block >= blocks.size() || blocks[block] >= file.size()) {
+            break;
+        }
+        const size_t block_end = (block + 1) * kObjShapeIndexBlockSize;
+        size_t element = block * kObjShapeIndexBlockSize;
+        const char* p = data + blocks[block];
+        while (p < end && i < ids.size() && element < block_end) {
+            const char* line = p;
+            const char* eol = FindLineEnd(p, end);
+            p = SkipLineEnding(eol, end);
+            const char* token;
+            if (ClassifyObjLine(line, eol, &token) != type) {
+                continue;
+            }
+            if (element == static_cast<size_t>(ids[i])) {
+                linebuf.assign(token, eol);
+                parse(i, linebuf.c_str());
+                i++;
+            }
+            element++;
+        }
+        // Skip ids which were not found(the file changed since indexing).
+        while (i < ids.size() && static_cast<size_t>(ids[i]) < element) {
+            i++;
+        }
+        if (p >= end) {
+            break;
+        }
+    }
+}
 
-                    polygon.push_back(polyline);
-                    std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
-                    // => result = 3 * faces, clockwise
-
-                    assert(indices.size() % 3 == 0);
-
-                    // Reconstruct vertex_index_t
-                    for (size_t k = 0; k < indices.size() / 3; k++) {
-                        {
-                            index_t idx0, idx1, idx2;
-                            idx0.vertex_index = face.vertex_indices[indices[3 * k + 0]].v_idx;
-                            idx0.normal_index = face.vertex_indices[indices[3 * k + 0]].vn_idx;
-                            idx0.texcoord_index = face.vertex_indices[indices[3 * k + 0]].vt_idx;
-                            idx1.vertex_index = face.vertex_indices[indices[3 * k + 1]].v_idx;
-                            idx1.normal_index = face.vertex_indices[indices[3 * k + 1]].vn_idx;
-                            idx1.texcoord_index = face.vertex_indices[indices[3 * k + 1]].vt_idx;
-                            idx2.vertex_index = face.vertex_indices[indices[3 * k + 2]].v_idx;
-                            idx2.normal_index = face.vertex_indices[indices[3 * k + 2]].vn_idx;
-                            idx2.texcoord_index = face.vertex_indices[indices[3 * k + 2]].vt_idx;
-
-                            shape->mesh.indices.push_back(idx0);
-                            shape->mesh.indices.push_back(idx1);
-                            shape->mesh.indices.push_back(idx2);
-
-                            shape->mesh.num_face_vertices.push_back(3);
-                            shape->mesh.material_ids.push_back(material_id);
-                            shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
-                        }
-                    }
+// Appends the valid indices of `indices` to `v`, `vn` and `vt`.
+static void CollectObjIndices(const vertex_index_array& indices, int num_v, int num_vn, int num_vt, std::vector<int>* v,
+    std::vector<int>* vn, std::vector<int>* vt) {
+    for (size_t i = 0; i < indices.size(); i++) {
+        const vertex_index_t& vi = indices[i];
+        if (vi.v_idx >= 0 && vi.v_idx < num_v) v->push_back(vi.v_idx);
+        if (vi.vn_idx >= 0 && vi.vn_idx < num_vn) vn->push_back(vi.vn_idx);
+        if (vi.vt_idx >= 0 && vi.vt_idx < num_vt) vt->push_back(vi.vt_idx);
+    }
+}
 
-#else  // Built-in ear clipping triangulation
-                    vertex_index_t i0 = face.vertex_indices[0];
-                    vertex_index_t i1(-1);
-                    vertex_index_t i2 = face.vertex_indices[1];
-
-                    // find the two axes to work in
-                    size_t axes[2] = {1, 2};
-                    for (size_t k = 0; k < npolys; ++k) {
-                        i0 = face.vertex_indices[(k + 0) % npolys];
-                        i1 = face.vertex_indices[(k + 1) % npolys];
-                        i2 = face.vertex_indices[(k + 2) % npolys];
-                        size_t vi0 = size_t(i0.v_idx);
-                        size_t vi1 = size_t(i1.v_idx);
-                        size_t vi2 = size_t(i2.v_idx);
-
-                        if (((3 * vi0 + 2) >= v.size()) || ((3 * vi1 + 2) >= v.size()) || ((3 * vi2 + 2) >= v.size())) {
-                            // Invalid triangle.
-                            // FIXME(syoyo): Is it ok to simply skip this invalid triangle?
-                            continue;
-                        }
-                        real_t v0x = v[vi0 * 3 + 0];
-                        real_t v0y = v[vi0 * 3 + 1];
-                        real_t v0z = v[vi0 * 3 + 2];
-                        real_t v1x = v[vi1 * 3 + 0];
-                        real_t v1y = v[vi1 * 3 + 1];
-                        real_t v1z = v[vi1 * 3 + 2];
-                        real_t v2x = v[vi2 * 3 + 0];
-                        real_t v2y = v[vi2 * 3 + 1];
-                        real_t v2z = v[vi2 * 3 + 2];
-                        real_t e0x = v1x - v0x;
-                        real_t e0y = v1y - v0y;
-                        real_t e0z = v1z - v0z;
-                        real_t e1x = v2x - v1x;
-                        real_t e1y = v2y - v1y;
-                        real_t e1z = v2z - v1z;
-                        real_t cx = std::fabs(e0y * e1z - e0z * e1y);
-                        real_t cy = std::fabs(e0z * e1x - e0x * e1z);
-                        real_t cz = std::fabs(e0x * e1y - e0y * e1x);
-                        const real_t epsilon = std::numeric_limits<real_t>::epsilon();
-                        // std::cout << "cx " << cx << ", cy " << cy << ", cz " << cz <<
-                        // "\n";
-                        if (cx > epsilon || cy > epsilon || cz > epsilon) {
-                            // std::cout << "corner\n";
-                            // found a corner
-                            if (cx > cy && cx > cz) {
-                                // std::cout << "pattern0\n";
-                            } else {
-                                // std::cout << "axes[0] = 0\n";
-                                axes[0] = 0;
-                                if (cz > cx && cz > cy) {
-                                    // std::cout << "axes[1] = 1\n";
-                                    axes[1] = 1;
-                                }
-                            }
-                            break;
-                        }
-                    }
+// Maps a file index to its position in `ids`(-1 = not loaded).
+static inline int RemapObjIndex(const std::vector<int>& ids, int idx) {
+    std::vector<int>::const_iterator it = std::lower_bound(ids.begin(), ids.end(), idx);
+    if (it == ids.end() || *it != idx) {
+        return -1;
+    }
+    return static_cast<int>(it - ids.begin());
+}
 
-                    face_t remainingFace = face;  // copy
-                    size_t guess_vert = 0;
-                    vertex_index_t ind[3];
-                    real_t vx[3];
-                    real_t vy[3];
+static void RemapObjIndices(vertex_index_array* indices, const std::vector<int>& v, const std::vector<int>& vn,
+    const std::vector<int>& vt) {
+    for (size_t i = 0; i < indices->size(); i++) {
+        vertex_index_t& vi = (*indices)[i];
+        vi.v_idx = RemapObjIndex(v, vi.v_idx);
+        vi.vn_idx = RemapObjIndex(vn, vi.vn_idx);
+        vi.vt_idx = RemapObjIndex(vt, vi.vt_idx);
+    }
+}
 
-                    // How many iterations can we do without decreasing the remaining
-                    // vertices.
-                    size_t remainingIterations = face.vertex_indices.size();
-                    size_t previousRemainingVertices = remainingFace.vertex_indices.size();
+static void SortUnique(std::vector<int>* ids) {
+    std::sort(ids->begin(), ids->end());
+    ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+}
 
-                    while (remainingFace.vertex_indices.size() > 3 && remainingIterations > 0) {
-                        // std::cout << "remainingIterations " << remainingIterations <<
-                        // "\n";
+bool LoadObjShapes(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn,
+    std::string* err, const char* filename, const obj_shape_index_t& index, const std::vector<size_t>& shape_ids,
+    const char* mtl_basedir, bool triangulate, bool default_vcols_fallback) {
+    (*attrib) = attrib_t();
+    shapes->clear();
+    materials->clear();
 
-                        npolys = remainingFace.vertex_indices.size();
-                        if (guess_vert >= npolys) {
-                            guess_vert -= npolys;
-                        }
+    MappedFile file;
+    unsigned long long size = 0;
+    long long mtime = 0;
+    if (!GetFileStat(filename, &size, &mtime) || !file.Open(filename)) {
+        if (err) {
+            std::stringstream errss;
+            errss << "Cannot open file [" << filename << "]\n";
+            (*err) = errss.str();
+        }
+        return false;
+    }
+    if (size != index.source_size || mtime != index.source_mtime) {
+        if (err) {
+            (*err) = "Shape index of [" + std::string(filename) + "] is out of date\n";
+        }
+        return false;
+    }
 
-                        if (previousRemainingVertices != npolys) {
-                            // The number of remaining vertices decreased. Reset counters.
-                            previousRemainingVertices = npolys;
-                            remainingIterations = npolys;
-                        } else {
-                            // We didn't consume a vertex on previous iteration, reduce the
-                            // available iterations.
-                            remainingIterations--;
-                        }
+    std::vector<size_t> ids = shape_ids;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    if (!ids.empty() && ids.back() >= index.shapes.size()) {
+        if (err) {
+            (*err) = "Invalid shape id\n";
+        }
+        return false;
+    }
 
-                        for (size_t k = 0; k < 3; k++) {
-                            ind[k] = remainingFace.vertex_indices[(guess_vert + k) % npolys];
-                            size_t vi = size_t(ind[k].v_idx);
-                            if (((vi * 3 + axes[0]) >= v.size()) || ((vi * 3 + axes[1]) >= v.size())) {
-                                // ???
-                                vx[k] = static_cast<real_t>(0.0);
-                                vy[k] = static_cast<real_t>(0.0);
-                            } else {
-                                vx[k] = v[vi * 3 + axes[0]];
-                                vy[k] = v[vi * 3 + axes[1]];
-                            }
-                        }
+    MaterialFileReader matFileReader(MtlBaseDir(mtl_basedir));
+
+    // A local warning buffer keeps the `g` handling of `parseObjLine` the
+    // same whether or not the caller asked for warnings.
+    std::string parse_warn;
+    obj_parse_state state;
+    std::vector<shape_t> no_shapes;
+    std::vector<obj_selected_shape_t> selected(ids.size());
+    size_t mtllib_cursor = 0;
+    size_t tag_cursor = 0;
+    unsigned long long applied_material_line = ~0ULL;
+    std::string linebuf;
 
-                        //
-                        // area is calculated per face
-                        //
-                        real_t e0x = vx[1] - vx[0];
-                        real_t e0y = vy[1] - vy[0];
-                        real_t e1x = vx[2] - vx[1];
-                        real_t e1y = vy[2] - vy[1];
-                        real_t cross = e0x * e1y - e0y * e1x;
-                        // std::cout << "axes = " << axes[0] << ", " << axes[1] << "\n";
-                        // std::cout << "e0x, e0y, e1x, e1y " << e0x << ", " << e0y << ", "
-                        // << e1x << ", " << e1y << "\n";
-
-                        real_t area = (vx[0] * vy[1] - vy[0] * vx[1]) * static_cast<real_t>(0.5);
-                        // std::cout << "cross " << cross << ", area " << area << "\n";
-                        // if an internal angle
-                        if (cross * area < static_cast<real_t>(0.0)) {
-                            // std::cout << "internal \n";
-                            guess_vert += 1;
-                            // std::cout << "guess vert : " << guess_vert << "\n";
-                            continue;
-                        }
+    for (size_t s = 0; s < ids.size(); s++) {
+        const obj_shape_index_entry_t& entry = index.shapes[ids[s]];
 
-                        // check all other verts in case they are inside this triangle
-                        bool overlap = false;
-                        for (size_t otherVert = 3; otherVert < npolys; ++otherVert) {
-                            size_t idx = (guess_vert + otherVert) % npolys;
-
-                            if (idx >= remainingFace.vertex_indices.size()) {
-                                // std::cout << "???0\n";
-                                // ???
-                                continue;
-                            }
-
-                            size_t ovi = size_t(remainingFace.vertex_indices[idx].v_idx);
-
-                            if (((ovi * 3 + axes[0]) >= v.size()) || ((ovi * 3 + axes[1]) >= v.size())) {
-                                // std::cout << "???1\n";
-                                // ???
-                                continue;
-                            }
-                            real_t tx = v[ovi * 3 + axes[0]];
-                            real_t ty = v[ovi * 3 + axes[1]];
-                            if (pnpoly(3, vx, vy, tx, ty)) {
-                                // std::cout << "overlap\n";
-                                overlap = true;
-                                break;
-                            }
-                        }
+        // Replay the state lines before the shape: `mtllib`, `t`, then the
+        // active `usemtl` and `s`.
+        while (mtllib_cursor < index.mtllib_lines.size() && index.mtllib_lines[mtllib_cursor] < entry.begin &&
+               (entry.material_line == ~0ULL || index.mtllib_lines[mtllib_cursor] < entry.material_line)) {
+            ParseObjLineAt(file, index.mtllib_lines[mtllib_cursor++], &state, materials, &matFileReader, &parse_warn, err);
+        }
+        while (tag_cursor < index.tag_lines.size() && index.tag_lines[tag_cursor] < entry.begin) {
+            ParseObjLineAt(file, index.tag_lines[tag_cursor++], &state, materials, &matFileReader, &parse_warn, err);
+        }
+        if (entry.material_line != applied_material_line) {
+            ParseObjLineAt(file, entry.material_line, &state, materials, &matFileReader, &parse_warn, err);
+            applied_material_line = entry.material_line;
+        }
+        while (mtllib_cursor < index.mtllib_lines.size() && index.mtllib_lines[mtllib_cursor] < entry.begin) {
+            ParseObjLineAt(file, index.mtllib_lines[mtllib_cursor++], &state, materials, &matFileReader, &parse_warn, err);
+        }
+        state.current_smoothing_id = 0;
+        ParseObjLineAt(file, entry.smoothing_line, &state, materials, &matFileReader, &parse_warn, err);
+
+        state.shape = shape_t();
+        state.prim_group.clear();
+        state.v_offset = static_cast<size_t>(entry.vertex_offset);
+        state.vn_offset = static_cast<size_t>(entry.normal_offset);
+        state.vt_offset = static_cast<size_t>(entry.texcoord_offset);
+        state.line_num = static_cast<size_t>(entry.line_num);
+
+        obj_selected_shape_t& shape = selected[s];
+        const char* p = file.data() + entry.begin;
+        const char* end = file.data() + std::min(entry.end, static_cast<unsigned long long>(file.size()));
+        while (p < end) {
+            const char* line = p;
+            const char* eol = FindLineEnd(p, end);
+            p = SkipLineEnding(eol, end);
+            state.line_num++;
+
+            const char* token;
+            const obj_line_type_t type = ClassifyObjLine(line, eol, &token);
+            // Vertex attributes are read later, only when referenced. The
+            // offsets still advance for relative indices.
+            if (type == OBJ_LINE_V) {
+                state.v_offset++;
+                continue;
+            } else if (type == OBJ_LINE_VN) {
+                state.vn_offset++;
+                continue;
+            } else if (type == OBJ_LINE_VT) {
+                state.vt_offset++;
+                continue;
+            }
 
-                        if (overlap) {
-                            // std::cout << "overlap2\n";
-                            guess_vert += 1;
-                            continue;
-                        }
+            const unsigned long long offset = static_cast<unsigned long long>(line - file.data());
+            if (type == OBJ_LINE_MTLLIB && mtllib_cursor < index.mtllib_lines.size() && index.mtllib_lines[mtllib_cursor] == offset) {
+                mtllib_cursor++;
+            } else if (type == OBJ_LINE_T && tag_cursor < index.tag_lines.size() && index.tag_lines[tag_cursor] == offset) {
+                tag_cursor++;
+            }
 
-                        // this triangle is an ear
-                        {
-                            index_t idx0, idx1, idx2;
-                            idx0.vertex_index = ind[0].v_idx;
-                            idx0.normal_index = ind[0].vn_idx;
-                            idx0.texcoord_index = ind[0].vt_idx;
-                            idx1.vertex_index = ind[1].v_idx;
-                            idx1.normal_index = ind[1].vn_idx;
-                            idx1.texcoord_index = ind[1].vt_idx;
-                            idx2.vertex_index = ind[2].v_idx;
-                            idx2.normal_index = ind[2].vn_idx;
-                            idx2.texcoord_index = ind[2].vt_idx;
-
-                            shape->mesh.indices.push_back(idx0);
-                            shape->mesh.indices.push_back(idx1);
-                            shape->mesh.indices.push_back(idx2);
-
-                            shape->mesh.num_face_vertices.push_back(3);
-                            shape->mesh.material_ids.push_back(material_id);
-                            shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
-                        }
+            linebuf.assign(line, eol);
+            if (type == OBJ_LINE_USEMTL) {
+                // Keep `parseObjLine` from exporting: the vertices are not
+                // loaded yet.
+                PrimGroup pending;
+                std::swap(pending, state.prim_group);
+                const int material = state.material;
+                parseObjLine(&state, linebuf.c_str(), &no_shapes, materials, &matFileReader, false, true, &parse_warn, err);
+                std::swap(pending, state.prim_group);
+                if (state.material != material) {
+                    PushObjShapeSegment(&state, material, &shape);
+                }
+                applied_material_line = offset;
+                continue;
+            }
+            if (!parseObjLine(&state, linebuf.c_str(), &no_shapes, materials, &matFileReader, false, true, &parse_warn, err)) {
+                if (warn) {
+                    (*warn) += parse_warn;
+                }
+                return false;
+            }
+        }
+        PushObjShapeSegment(&state, state.material, &shape);
+        shape.name = state.name;
+        state.prim_group.clear();
+    }
 
-                        // remove v1 from the list
-                        size_t removed_vert_index = (guess_vert + 1) % npolys;
-                        while (removed_vert_index + 1 < npolys) {
-                            remainingFace.vertex_indices[removed_vert_index] = remainingFace.vertex_indices[removed_vert_index + 1];
-                            removed_vert_index += 1;
-                        }
-                        remainingFace.vertex_indices.pop_back();
-                    }
+    // `mtllib` lines after the last selected shape.
+    while (mtllib_cursor < index.mtllib_lines.size()) {
+        ParseObjLineAt(file, index.mtllib_lines[mtllib_cursor++], &state, materials, &matFileReader, &parse_warn, err);
+    }
 
-                    // std::cout << "remainingFace.vi.size = " <<
-                    // remainingFace.vertex_indices.size() << "\n";
-                    if (remainingFace.vertex_indices.size() == 3) {
-                        i0 = remainingFace.vertex_indices[0];
-                        i1 = remainingFace.vertex_indices[1];
-                        i2 = remainingFace.vertex_indices[2];
-                        {
-                            index_t idx0, idx1, idx2;
-                            idx0.vertex_index = i0.v_idx;
-                            idx0.normal_index = i0.vn_idx;
-                            idx0.texcoord_index = i0.vt_idx;
-                            idx1.vertex_index = i1.v_idx;
-                            idx1.normal_index = i1.vn_idx;
-                            idx1.texcoord_index = i1.vt_idx;
-                            idx2.vertex_index = i2.v_idx;
-                            idx2.normal_index = i2.vn_idx;
-                            idx2.texcoord_index = i2.vt_idx;
-
-                            shape->mesh.indices.push_back(idx0);
-                            shape->mesh.indices.push_back(idx1);
-                            shape->mesh.indices.push_back(idx2);
-
-                            shape->mesh.num_face_vertices.push_back(3);
-                            shape->mesh.material_ids.push_back(material_id);
-                            shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);
-                        }
-                    }
-#endif
-                }  // npolys
-            } else {
-                for (size_t k = 0; k < npolys; k++) {
-                    index_t idx;
-                    idx.vertex_index = face.vertex_indices[k].v_idx;
-                    idx.normal_index = face.vertex_indices[k].vn_idx;
-                    idx.texcoord_index = face.vertex_indices[k].vt_idx;
-                    shape->mesh.indices.push_back(idx);
-                }
+    // Read only the vertex attributes the selected shapes reference.
+    const int num_v = static_cast<int>(index.num_vertices);
+    const int num_vn = static_cast<int>(index.num_normals);
+    const int num_vt = static_cast<int>(index.num_texcoords);
+    std::vector<int> v_ids, vn_ids, vt_ids;
+    for (size_t s = 0; s < selected.size(); s++) {
+        for (size_t g = 0; g < selected[s].segments.size(); g++) {
+            const PrimGroup& group = selected[s].segments[g].prim_group;
+            for (size_t i = 0; i < group.faceGroup.size(); i++) {
+                CollectObjIndices(group.faceGroup[i].vertex_indices, num_v, num_vn, num_vt, &v_ids, &vn_ids, &vt_ids);
+            }
+            for (size_t i = 0; i < group.lineGroup.size(); i++) {
+                CollectObjIndices(group.lineGroup[i].vertex_indices, num_v, num_vn, num_vt, &v_ids, &vn_ids, &vt_ids);
+            }
+            for (size_t i = 0; i < group.pointsGroup.size(); i++) {
+                CollectObjIndices(group.pointsGroup[i].vertex_indices, num_v, num_vn, num_vt, &v_ids, &vn_ids, &vt_ids);
+            }
+        }
+    }
+    const bool out_of_bounds = state.greatest_v_idx >= num_v || state.greatest_vn_idx >= num_vn || state.greatest_vt_idx >= num_vt;
+    SortUnique(&v_ids);
+    SortUnique(&vn_ids);
+    SortUnique(&vt_ids);
+
+    std::vector<real_t>& v = attrib->vertices;
+    std::vector<real_t>& vc = attrib->colors;
+    v.assign(v_ids.size() * 3, static_cast<real_t>(0));
+    vc.assign(v_ids.size() * 3, static_cast<real_t>(1));
+    bool found_all_colors = true;
+    ReadObjElements(file, index.vertex_blocks, OBJ_LINE_V, v_ids, [&](size_t i, const char* token) {
+        token += 2;
+        found_all_colors &= parseVertexWithColor(&v[3 * i + 0], &v[3 * i + 1], &v[3 * i + 2], &vc[3 * i + 0], &vc[3 * i + 1],
+            &vc[3 * i + 2], &token);
+    });
+    if (!found_all_colors && !default_vcols_fallback) {
+        vc.clear();
+    }
 
-                shape->mesh.num_face_vertices.push_back(static_cast<unsigned char>(npolys));
-                shape->mesh.material_ids.push_back(material_id);                     // per face
-                shape->mesh.smoothing_group_ids.push_back(face.smoothing_group_id);  // per face
+    std::vector<real_t>& vn = attrib->normals;
+    vn.assign(vn_ids.size() * 3, static_cast<real_t>(0));
+    ReadObjElements(file, index.normal_blocks, OBJ_LINE_VN, vn_ids, [&](size_t i, const char* token) {
+        token += 3;
+        parseReal3(&vn[3 * i + 0], &vn[3 * i + 1], &vn[3 * i + 2], &token);
+    });
+
+    std::vector<real_t>& vt = attrib->texcoords;
+    vt.assign(vt_ids.size() * 2, static_cast<real_t>(0));
+    ReadObjElements(file, index.texcoord_blocks, OBJ_LINE_VT, vt_ids, [&](size_t i, const char* token) {
+        token += 3;
+        parseReal2(&vt[2 * i + 0], &vt[2 * i + 1], &token);
+    });
+
+    // Remap the indices into `attrib` and export like `LoadObj`.
+    for (size_t s = 0; s < selected.size(); s++) {
+        obj_selected_shape_t& selected_shape = selected[s];
+        shape_t shape;
+        for (size_t g = 0; g < selected_shape.segments.size(); g++) {
+            obj_shape_segment_t& segment = selected_shape.segments[g];
+            PrimGroup& group = segment.prim_group;
+            for (size_t i = 0; i < group.faceGroup.size(); i++) {
+                RemapObjIndices(&group.faceGroup[i].vertex_indices, v_ids, vn_ids, vt_ids);
+            }
+            for (size_t i = 0; i < group.lineGroup.size(); i++) {
+                RemapObjIndices(&group.lineGroup[i].vertex_indices, v_ids, vn_ids, vt_ids);
+            }
+            for (size_t i = 0; i < group.pointsGroup.size(); i++) {
+                RemapObjIndices(&group.pointsGroup[i].vertex_indices, v_ids, vn_ids, vt_ids);
             }
+            exportGroupsToShape(&shape, group, segment.tags, segment.material, selected_shape.name, triangulate, v, &parse_warn);
         }
+        if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 || shape.points.indices.size() > 0) {
+            shapes->push_back(shape_t());
+            std::swap(shapes->back(), shape);
+        }
+    }
 
-        shape->mesh.tags = tags;
+    if (out_of_bounds) {
+        parse_warn += "Vertex indices out of bounds. Unresolved indices are set to -1.\n";
+    }
+    if (warn) {
+        (*warn) += parse_warn;
     }
+    return true;
+}
 
-    // line
-    if (!prim_group.lineGroup.empty()) {
-        // Flatten indices
-        for (size_t i = 0; i < prim_group.lineGroup.size(); i++) {
-            for (size_t j = 0; j < prim_group.lineGroup[i].vertex_indices.size(); j++) {
-                const vertex_index_t& vi = prim_group.lineGroup[i].vertex_indices[j];
+// Line parser state of `LoadObjWithCallback`.
+struct callback_parse_state {
+    std::set<std::string> material_filenames;
+    std::map<std::string, int> material_map;
+    material_name_map material_index;  // `material_map` for `usemtl` lookups
+    int material_id;  // -1 = invalid
 
-                index_t idx;
-                idx.vertex_index = vi.v_idx;
-                idx.normal_index = vi.vn_idx;
-                idx.texcoord_index = vi.vt_idx;
+    std::vector<index_t> indices;
+    std::vector<material_t> materials;
+    std::vector<std::string> names;
+    std::vector<const char*> names_out;
 
-                shape->lines.indices.push_back(idx);
-            }
+    callback_parse_state() : material_id(-1) { names.reserve(2); }
+};
 
-            shape->lines.num_line_vertices.push_back(int(prim_group.lineGroup[i].vertex_indices.size()));
+// Forwards each parsed element to the per-element callbacks of `callback_t`.
+struct callback_sink {
+    const callback_t& callback;
+    void* user_data;
+
+    callback_sink(const callback_t& cb, void* ud) : callback(cb), user_data(ud) {}
+
+    void Vertex(real_t x, real_t y, real_t z, real_t r, real_t g, real_t b, bool has_color) {
+        if (callback.vertex_cb) {
+            callback.vertex_cb(user_data, x, y, z, r);  // r=w is optional
+        }
+        if (callback.vertex_color_cb) {
+            callback.vertex_color_cb(user_data, x, y, z, r, g, b, has_color);
         }
     }
 
-    // points
-    if (!prim_group.pointsGroup.empty()) {
-        // Flatten & convert indices
-        for (size_t i = 0; i < prim_group.pointsGroup.size(); i++) {
-            for (size_t j = 0; j < prim_group.pointsGroup[i].vertex_indices.size(); j++) {
-                const vertex_index_t& vi = prim_group.pointsGroup[i].vertex_indices[j];
+    void Normal(real_t x, real_t y, real_t z) {
+        if (callback.normal_cb) {
+            callback.normal_cb(user_data, x, y, z);
+        }
+    }
 
-                index_t idx;
-                idx.vertex_index = vi.v_idx;
-                idx.normal_index = vi.vn_idx;
-                idx.texcoord_index = vi.vt_idx;
+    void Texcoord(real_t x, real_t y, real_t z) {
+        if (callback.texcoord_cb) {
+            callback.texcoord_cb(user_data, x, y, z);
+        }
+    }
 
-                shape->points.indices.push_back(idx);
-            }
+    void Face(index_t* indices, int num_indices) {
+        if (callback.index_cb) {
+            callback.index_cb(user_data, indices, num_indices);
         }
     }
 
-    return true;
-}
+    bool HasUsemtl() const { return callback.usemtl_cb != NULL; }
 
-// Split a string with specified delimiter character and escape character.
-// https://rosettacode.org/wiki/Tokenize_a_string_with_escaping#C.2B.2B
-static void SplitString(const std::string& s, char delim, char escape, std::vector<std::string>& elems) {
-    std::string token;
+    void Usemtl(const char* name, int material_id) {
+        if (callback.usemtl_cb) {
+            callback.usemtl_cb(user_data, name, material_id);
+        }
+    }
 
-    bool escaping = false;
-    for (size_t i = 0; i < s.size(); ++i) {
-        char ch = s[i];
-        if (escaping) {
-            escaping = false;
-        } else if (ch == escape) {
-            escaping = true;
-            continue;
-        } else if (ch == delim) {
-            if (!token.empty()) {
-                elems.push_back(token);
-            }
-            token.clear();
-            continue;
+    void Mtllib(const material_t* materials, int num_materials) {
+        if (callback.mtllib_cb) {
+            callback.mtllib_cb(user_data, materials, num_materials);
         }
-        token += ch;
     }
 
-    elems.push_back(token);
-}
+    void Group(const char** names, int num_names) {
+        if (callback.group_cb) {
+            callback.group_cb(user_data, names, num_names);
+        }
+    }
 
-static std::string JoinPath(const std::string& dir, const std::string& filename) {
-    if (dir.empty()) {
-        return filename;
-    } else {
-        // check '/'
-        char lastChar = *dir.rbegin();
-        if (lastChar != '/') {
-            return dir + std::string("/") + filename;
-        } else {
-            return dir + filename;
+    void Object(const char* name) {
+        if (callback.object_cb) {
+            callback.object_cb(user_data, name);
         }
     }
-}
 
-void LoadMtl(std::map<std::string, int>* material_map, std::vector<material_t>* materials, std::istream* inStream, std::string* warning,
-    std::string* err) {
-    (void)err;
+private:
+    callback_sink& operator=(const callback_sink&);
+};
 
-    // Create a default material anyway.
-    material_t material;
-    InitMaterial(&material);
+// Parses a single .obj line(without the line ending) and passes the parsed
+// element to `sink`(`callback_sink` or `batch_callback_sink`).
+template <typename Sink>
+static void parseCallbackLine(callback_parse_state* state, const char* linebuf, Sink& sink, MaterialReader* readMatFn,
+    std::string* warn, std::string* err) {
+    std::set<std::string>& material_filenames = state->material_filenames;
+    std::map<std::string, int>& material_map = state->material_map;
+    int& material_id = state->material_id;
+    std::vector<index_t>& indices = state->indices;
+    std::vector<material_t>& materials = state->materials;
+    std::vector<std::string>& names = state->names;
+    std::vector<const char*>& names_out = state->names_out;
+
+    // Skip leading space.
+    const char* token = SkipSpace(linebuf);
+
+    assert(token);
+    if (token[0] == '\0') return;  // empty line
+
+    if (token[0] == '#') return;  // comment line
+
+    // vertex
+    if (token[0] == 'v' && IS_SPACE((token[1]))) {
+        token += 2;
+        real_t x, y, z;
+        real_t r, g, b;
+
+        bool found_color = parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+        sink.Vertex(x, y, z, r, g, b, found_color);
+        return;
+    }
 
-    // Issue 43. `d` wins against `Tr` since `Tr` is not in the MTL specification.
-    bool has_d = false;
-    bool has_tr = false;
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+        token += 3;
+        real_t x, y, z;
+        parseReal3(&x, &y, &z, &token);
+        sink.Normal(x, y, z);
+        return;
+    }
 
-    // has_kd is used to set a default diffuse value when map_Kd is present
-    // and Kd is not.
-    bool has_kd = false;
+    // texcoord
+    if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+        token += 3;
+        real_t x, y, z;  // y and z are optional. default = 0.0
+        parseReal3(&x, &y, &z, &token);
+        sink.Texcoord(x, y, z);
+        return;
+    }
 
-    std::stringstream warn_ss;
+    // face
+    if (token[0] == 'f' && IS_SPACE((token[1]))) {
+        token = SkipSpace(token + 2);
 
-    size_t line_no = 0;
-    std::string linebuf;
-    while (inStream->peek() != -1) {
-        safeGetline(*inStream, linebuf);
-        line_no++;
+        indices.clear();
+        while (!IS_NEW_LINE(token[0])) {
+            vertex_index_t vi = parseRawTriple(&token);
 
-        // Trim trailing whitespace.
-        if (linebuf.size() > 0) {
-            linebuf = linebuf.substr(0, linebuf.find_last_not_of(" \t") + 1);
+            index_t idx;
+            idx.vertex_index = vi.v_idx;
+            idx.normal_index = vi.vn_idx;
+            idx.texcoord_index = vi.vt_idx;
+
+            indices.push_back(idx);
+            token = SkipSpaceAndCR(token);
         }
 
-        // Trim newline '\r\n' or '\n'
-        if (linebuf.size() > 0) {
-            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+        if (indices.size() > 0) {
+            sink.Face(&indices.at(0), static_cast<int>(indices.size()));
         }
-        if (linebuf.size() > 0) {
-            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
+
+        return;
+    }
+
+    // use mtl
+    if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
+        token += 7;
+        std::stringstream ss;
+        ss << token;
+        std::string namebuf = ss.str();
+
+        int newMaterialId = -1;
+        if (!state->material_index.Find(namebuf, &newMaterialId)) {
+            // { warn!! material not found }
+            if (warn && (!sink.HasUsemtl())) {
+                (*warn) += "material [ " + namebuf + " ] not found in .mtl\n";
+            }
         }
 
-        // Skip if empty line.
-        if (linebuf.empty()) {
-            continue;
+        if (newMaterialId != material_id) {
+            material_id = newMaterialId;
         }
 
-        // Skip leading space.
-        const char* token = linebuf.c_str();
-        token += strspn(token, " \t");
+        sink.Usemtl(namebuf.c_str(), material_id);
 
-        assert(token);
-        if (token[0] == '\0') continue;  // empty line
+        return;
+    }
 
-        if (token[0] == '#') continue;  // comment line
+    // load mtl
+    if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
+        if (readMatFn) {
+            token += 7;
 
-        // new mtl
-        if ((0 == strncmp(token, "newmtl", 6)) && IS_SPACE((token[6]))) {
-            // flush previous material.
-            if (!material.name.empty()) {
-                material_map->insert(std::pair<std::string, int>(material.name, static_cast<int>(materials->size())));
-                materials->push_back(material);
-            }
+            std::vector<std::string> filenames;
+            SplitString(std::string(token), ' ', '\\', filenames);
 
-            // initial temporary material
-            InitMaterial(&material);
+            if (filenames.empty()) {
+                if (warn) {
+                    (*warn) += "Looks like empty filename for mtllib. Use default "
+                               "material. \n";
+                }
+            } else {
+                bool found = false;
+                for (size_t s = 0; s < filenames.size(); s++) {
+                    if (material_filenames.count(filenames[s]) > 0) {
+                        found = true;
+                        continue;
+                    }
 
-            has_d = false;
-            has_tr = false;
+                    std::string warn_mtl;
+                    std::string err_mtl;
+                    bool ok = (*readMatFn)(filenames[s].c_str(), &materials, &material_map, &warn_mtl, &err_mtl);
 
-            // set new mtl name
-            token += 7;
-            {
-                std::string namebuf = parseString(&token);
-                // TODO: empty name check?
-                if (namebuf.empty()) {
-                    if (warning) {
-                        (*warning) += "empty material name in `newmtl`\n";
+                    if (warn && (!warn_mtl.empty())) {
+                        (*warn) += warn_mtl;  // This should be warn message.
+                    }
+
+                    if (err && (!err_mtl.empty())) {
+                        (*err) += err_mtl;
+                    }
+
+                    if (ok) {
+                        found = true;
+                        material_filenames.insert(filenames[s]);
+                        break;
                     }
                 }
-                material.name = namebuf;
+                state->material_index.Assign(material_map);
+
+                if (!found) {
+                    if (warn) {
+                        (*warn) += "Failed to load material file(s). Use default "
+                                   "material.\n";
+                    }
+                } else {
+                    sink.Mtllib(&materials.at(0), static_cast<int>(materials.size()));
+                }
             }
-            continue;
         }
 
-        // ambient
-        if (token[0] == 'K' && token[1] == 'a' && IS_SPACE((token[2]))) {
-            token += 2;
-            real_t r, g, b;
-            parseReal3(&r, &g, &b, &token);
-            material.ambient[0] = r;
-            material.ambient[1] = g;
-            material.ambient[2] = b;
-            continue;
-        }
+        return;
+    }
 
-        // diffuse
-        if (token[0] == 'K' && token[1] == 'd' && IS_SPACE((token[2]))) {
-            token += 2;
-            real_t r, g, b;
-            parseReal3(&r, &g, &b, &token);
-            material.diffuse[0] = r;
-            material.diffuse[1] = g;
-            material.diffuse[2] = b;
-            has_kd = true;
-            continue;
-        }
+    // group name
+    if (token[0] == 'g' && IS_SPACE((token[1]))) {
+        names.clear();
 
-        // specular
-        if (token[0] == 'K' && token[1] == 's' && IS_SPACE((token[2]))) {
-            token += 2;
-            real_t r, g, b;
-            parseReal3(&r, &g, &b, &token);
-            material.specular[0] = r;
-            material.specular[1] = g;
-            material.specular[2] = b;
-            continue;
+        while (!IS_NEW_LINE(token[0])) {
+            std::string str = parseString(&token);
+            names.push_back(str);
+            token += strspn(token, " \t\r");  // skip tag
         }
 
-        // transmittance
-        if ((token[0] == 'K' && token[1] == 't' && IS_SPACE((token[2]))) || (token[0] == 'T' && token[1] == 'f' && IS_SPACE((token[2])))) {
-            token += 2;
-            real_t r, g, b;
-            parseReal3(&r, &g, &b, &token);
-            material.transmittance[0] = r;
-            material.transmittance[1] = g;
-            material.transmittance[2] = b;
-            continue;
-        }
+        assert(names.size() > 0);
 
-        // ior(index of refraction)
-        if (token[0] == 'N' && token[1] == 'i' && IS_SPACE((token[2]))) {
-            token += 2;
-            material.ior = parseReal(&token);
-            continue;
-        }
+        if (names.size() > 1) {
+            // create const char* array.
+            names_out.resize(names.size() - 1);
+            for (size_t j = 0; j < names_out.size(); j++) {
+                names_out[j] = names[j + 1].c_str();
+            }
+            sink.Group(&names_out.at(0), static_cast<int>(names_out.size()));
 
-        // emission
-        if (token[0] == 'K' && token[1] == 'e' && IS_SPACE(token[2])) {
-            token += 2;
-            real_t r, g, b;
-            parseReal3(&r, &g, &b, &token);
-            material.emission[0] = r;
-            material.emission[1] = g;
-            material.emission[2] = b;
-            continue;
+        } else {
+            sink.Group(NULL, 0);
         }
 
-        // shininess
-        if (token[0] == 'N' && token[1] == 's' && IS_SPACE(token[2])) {
-            token += 2;
-            material.shininess = parseReal(&token);
-            continue;
+        return;
+    }
+
+    // object name
+    if (token[0] == 'o' && IS_SPACE((token[1]))) {
+        // @todo { multiple object name? }
+        token += 2;
+
+        std::stringstream ss;
+        ss << token;
+        std::string object_name = ss.str();
+
+        sink.Object(object_name.c_str());
+
+        return;
+    }
+
+#if 0  // @todo
+    if (token[0] == 't' && IS_SPACE(token[1])) {
+      tag_t tag;
+
+      token += 2;
+      std::stringstream ss;
+      ss << token;
+      tag.name = ss.str();
+
+      token += tag.name.size() + 1;
+
+      tag_sizes ts = parseTagTriple(&token);
+
+      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
+
+      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
+        tag.intValues[i] = atoi(token);
+        token += strcspn(token, "/ \t\r") + 1;
+      }
+
+      tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
+      for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
+        tag.floatValues[i] = parseReal(&token);
+        token += strcspn(token, "/ \t\r") + 1;
+      }
+
+      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
+      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
+        std::stringstream ss;
+        ss << token;
+        tag.stringValues[i] = ss.str();
+        token += tag.stringValues[i].size() + 1;
+      }
+
+      tags.push_back(tag);
+    }
+#endif
+
+    // Ignore unknown command.
+}
+
+bool LoadObjWithCallback(std::istream& inStream, const callback_t& callback, void* user_data /*= NULL*/,
+    MaterialReader* readMatFn /*= NULL*/, std::string* warn, /* = NULL*/
+    std::string* err /*= NULL*/) {
+    std::stringstream errss;
+
+    callback_parse_state state;
+    callback_sink sink(callback, user_data);
+
+    std::string linebuf;
+    while (inStream.peek() != -1) {
+        safeGetline(inStream, linebuf);
+
+        // Trim newline '\r\n' or '\n'
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+        }
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
         }
 
-        // illum model
-        if (0 == strncmp(token, "illum", 5) && IS_SPACE(token[5])) {
-            token += 6;
-            material.illum = parseInt(&token);
+        // Skip if empty line.
+        if (linebuf.empty()) {
             continue;
         }
 
-        // dissolve
-        if ((token[0] == 'd' && IS_SPACE(token[1]))) {
-            token += 1;
-            material.dissolve = parseReal(&token);
+        parseCallbackLine(&state, linebuf.c_str(), sink, readMatFn, warn, err);
+    }
 
-            if (has_tr) {
-                warn_ss << "Both `d` and `Tr` parameters defined for \"" << material.name << "\". Use the value of `d` for dissolve (line "
-                        << line_no << " in .mtl.)\n";
-            }
-            has_d = true;
-            continue;
+    if (err) {
+        (*err) += errss.str();
+    }
+
+    return true;
+}
+
+// 1-based or relative .obj index => 0-based absolute index(-1 = not used or invalid).
+static inline int ResolveStreamIndex(int idx, size_t count) {
+    if (idx > 0) {
+        return idx - 1;
+    }
+    if (idx < 0 && static_cast<size_t>(-static_cast<long long>(idx)) <= count) {
+        return static_cast<int>(static_cast<long long>(count) + idx);
+    }
+    return -1;
+}
+
+// Buffers the parsed elements and passes them to `batch_callback_t` in spans.
+struct batch_callback_sink {
+    const batch_callback_t& callback;
+    void* user_data;
+    size_t batch_size;
+
+    std::vector<real_t> vertices;
+    std::vector<real_t> colors;
+    std::vector<real_t> normals;
+    std::vector<real_t> texcoords;
+    std::vector<index_t> indices;
+    std::vector<unsigned int> num_face_vertices;
+
+    // Number of elements parsed so far(for resolving relative indices).
+    size_t num_vertices;
+    size_t num_normals;
+    size_t num_texcoords;
+
+    batch_callback_sink(const batch_callback_t& cb, void* ud)
+        : callback(cb), user_data(ud), batch_size(cb.batch_size > 0 ? cb.batch_size : 1), num_vertices(0), num_normals(0),
+          num_texcoords(0) {
+        if (callback.vertices_cb) {
+            vertices.reserve(3 * batch_size);
+            colors.reserve(3 * batch_size);
         }
-        if (token[0] == 'T' && token[1] == 'r' && IS_SPACE(token[2])) {
-            token += 2;
-            if (has_d) {
-                // `d` wins. Ignore `Tr` value.
-                warn_ss << "Both `d` and `Tr` parameters defined for \"" << material.name << "\". Use the value of `d` for dissolve (line "
-                        << line_no << " in .mtl.)\n";
-            } else {
-                // We invert value of Tr(assume Tr is in range [0, 1])
-                // NOTE: Interpretation of Tr is application(exporter) dependent. For
-                // some application(e.g. 3ds max obj exporter), Tr = d(Issue 43)
-                material.dissolve = static_cast<real_t>(1.0) - parseReal(&token);
-            }
-            has_tr = true;
-            continue;
+        if (callback.normals_cb) normals.reserve(3 * batch_size);
+        if (callback.texcoords_cb) texcoords.reserve(3 * batch_size);
+        if (callback.faces_cb) {
+            indices.reserve(4 * batch_size);
+            num_face_vertices.reserve(batch_size);
         }
+    }
 
-        // PBR: roughness
-        if (token[0] == 'P' && token[1] == 'r' && IS_SPACE(token[2])) {
-            token += 2;
-            material.roughness = parseReal(&token);
-            continue;
-        }
+    void Vertex(real_t x, real_t y, real_t z, real_t r, real_t g, real_t b, bool has_color) {
+        (void)has_color;  // r, g, b are 1.0 when the line has no color.
+        num_vertices++;
+        if (!callback.vertices_cb) return;
+        vertices.push_back(x);
+        vertices.push_back(y);
+        vertices.push_back(z);
+        colors.push_back(r);
+        colors.push_back(g);
+        colors.push_back(b);
+        if (vertices.size() >= 3 * batch_size) FlushVertices();
+    }
 
-        // PBR: metallic
-        if (token[0] == 'P' && token[1] == 'm' && IS_SPACE(token[2])) {
-            token += 2;
-            material.metallic = parseReal(&token);
-            continue;
-        }
+    void Normal(real_t x, real_t y, real_t z) {
+        num_normals++;
+        if (!callback.normals_cb) return;
+        normals.push_back(x);
+        normals.push_back(y);
+        normals.push_back(z);
+        if (normals.size() >= 3 * batch_size) FlushNormals();
+    }
 
-        // PBR: sheen
-        if (token[0] == 'P' && token[1] == 's' && IS_SPACE(token[2])) {
-            token += 2;
-            material.sheen = parseReal(&token);
-            continue;
-        }
+    void Texcoord(real_t x, real_t y, real_t z) {
+        num_texcoords++;
+        if (!callback.texcoords_cb) return;
+        texcoords.push_back(x);
+        texcoords.push_back(y);
+        texcoords.push_back(z);
+        if (texcoords.size() >= 3 * batch_size) FlushTexcoords();
+    }
 
-        // PBR: clearcoat thickness
-        if (token[0] == 'P' && token[1] == 'c' && IS_SPACE(token[2])) {
-            token += 2;
-            material.clearcoat_thickness = parseReal(&token);
-            continue;
+    void Face(index_t* face, int num_indices) {
+        if (!callback.faces_cb) return;
+        for (int i = 0; i < num_indices; i++) {
+            index_t idx;
+            idx.vertex_index = ResolveStreamIndex(face[i].vertex_index, num_vertices);
+            idx.normal_index = ResolveStreamIndex(face[i].normal_index, num_normals);
+            idx.texcoord_index = ResolveStreamIndex(face[i].texcoord_index, num_texcoords);
+            indices.push_back(idx);
         }
+        num_face_vertices.push_back(static_cast<unsigned int>(num_indices));
+        if (num_face_vertices.size() >= batch_size) FlushFaces();
+    }
 
-        // PBR: clearcoat roughness
-        if ((0 == strncmp(token, "Pcr", 3)) && IS_SPACE(token[3])) {
-            token += 4;
-            material.clearcoat_roughness = parseReal(&token);
-            continue;
+    bool HasUsemtl() const { return callback.usemtl_cb != NULL; }
+
+    void Usemtl(const char* name, int material_id) {
+        if (callback.usemtl_cb) {
+            Flush();
+            callback.usemtl_cb(user_data, name, material_id);
         }
+    }
 
-        // PBR: anisotropy
-        if ((0 == strncmp(token, "aniso", 5)) && IS_SPACE(token[5])) {
-            token += 6;
-            material.anisotropy = parseReal(&token);
-            continue;
+    void Mtllib(const material_t* materials, int num_materials) {
+        if (callback.mtllib_cb) {
+            Flush();
+            callback.mtllib_cb(user_data, materials, num_materials);
         }
+    }
 
-        // PBR: anisotropy rotation
-        if ((0 == strncmp(token, "anisor", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            material.anisotropy_rotation = parseReal(&token);
-            continue;
+    void Group(const char** names, int num_names) {
+        if (callback.group_cb) {
+            Flush();
+            callback.group_cb(user_data, names, num_names);
         }
+    }
 
-        // ambient or ambient occlusion texture
-        if ((0 == strncmp(token, "map_Ka", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.ambient_texname), &(material.ambient_texopt), token);
-            continue;
+    void Object(const char* name) {
+        if (callback.object_cb) {
+            Flush();
+            callback.object_cb(user_data, name);
         }
+    }
 
-        // diffuse texture
-        if ((0 == strncmp(token, "map_Kd", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.diffuse_texname), &(material.diffuse_texopt), token);
+    void FlushVertices() {
+        if (vertices.empty()) return;
+        callback.vertices_cb(user_data, &vertices.at(0), &colors.at(0), vertices.size() / 3);
+        vertices.clear();
+        colors.clear();
+    }
 
-            // Set a decent diffuse default value if a diffuse texture is specified
-            // without a matching Kd value.
-            if (!has_kd) {
-                material.diffuse[0] = static_cast<real_t>(0.6);
-                material.diffuse[1] = static_cast<real_t>(0.6);
-                material.diffuse[2] = static_cast<real_t>(0.6);
-            }
+    void FlushNormals() {
+        if (normals.empty()) return;
+        callback.normals_cb(user_data, &normals.at(0), normals.size() / 3);
+        normals.clear();
+    }
 
-            continue;
+    void FlushTexcoords() {
+        if (texcoords.empty()) return;
+        callback.texcoords_cb(user_data, &texcoords.at(0), texcoords.size() / 3);
+        texcoords.clear();
+    }
+
+    // Faces may refer to any of the pending elements, so those go first.
+    void FlushFaces() {
+        FlushVertices();
+        FlushNormals();
+        FlushTexcoords();
+        if (num_face_vertices.empty()) return;
+        callback.faces_cb(user_data, &indices.at(0), &num_face_vertices.at(0), num_face_vertices.size());
+        indices.clear();
+        num_face_vertices.clear();
+    }
+
+    void Flush() { FlushFaces(); }
+
+private:
+    batch_callback_sink& operator=(const batch_callback_sink&);
+};
+
+bool LoadObjWithCallback(std::istream& inStream, const batch_callback_t& callback, void* user_data /*= NULL*/,
+    MaterialReader* readMatFn /*= NULL*/, std::string* warn /*= NULL*/, std::string* err /*= NULL*/) {
+    callback_parse_state state;
+    batch_callback_sink sink(callback, user_data);
+
+    std::string linebuf;
+    while (inStream.peek() != -1) {
+        safeGetline(inStream, linebuf);
+
+        // Trim newline '\r\n' or '\n'
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+        }
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
         }
 
-        // specular texture
-        if ((0 == strncmp(token, "map_Ks", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.specular_texname), &(material.specular_texopt), token);
+        // Skip if empty line.
+        if (linebuf.empty()) {
             continue;
         }
 
-        // specular highlight texture
-        if ((0 == strncmp(token, "map_Ns", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.specular_highlight_texname), &(material.specular_highlight_texopt), token);
-            continue;
+        parseCallbackLine(&state, linebuf.c_str(), sink, readMatFn, warn, err);
+    }
+    sink.Flush();
+
+    return true;
+}
+
+void obj_stream_batch_t::clear() {
+    vertices.clear();
+    colors.clear();
+    normals.clear();
+    texcoords.clear();
+    indices.clear();
+    num_face_vertices.clear();
+    material_ids.clear();
+    shape_names.clear();
+    shape_face_offsets.clear();
+    vertex_offset = 0;
+    normal_offset = 0;
+    texcoord_offset = 0;
+    face_offset = 0;
+}
+
+// State of ObjStreamReader. Receives the callbacks of `parseCallbackLine`
+// and appends them to the current batch.
+class obj_stream_state {
+public:
+    obj_stream_state()
+        : stream(NULL), readMatFn(NULL), file_reader(NULL), batch(NULL), num_vertices(0), num_normals(0), num_texcoords(0),
+          num_faces(0), material_id(-1), warn(NULL) {}
+    ~obj_stream_state() { delete file_reader; }
+
+    std::ifstream file;
+    std::istream* stream;
+    MaterialReader* readMatFn;
+    MaterialFileReader* file_reader;  // Owned. Used when reading from `file`.
+    ObjStreamReaderConfig config;
+
+    callback_t callback;
+    callback_parse_state parse_state;
+    std::vector<material_t> materials;
+    std::string linebuf;
+
+    obj_stream_batch_t* batch;
+    size_t num_vertices;
+    size_t num_normals;
+    size_t num_texcoords;
+    size_t num_faces;
+    int material_id;
+    std::string* warn;
+
+    size_t BatchElements() const {
+        return batch->num_vertices() + batch->num_normals() + batch->num_texcoords() + batch->num_faces();
+    }
+
+    size_t BatchBytes() const {
+        return (batch->vertices.size() + batch->colors.size() + batch->normals.size() + batch->texcoords.size()) * sizeof(real_t) +
+               batch->indices.size() * sizeof(index_t) + batch->num_face_vertices.size() * (sizeof(unsigned int) + sizeof(int)) +
+               batch->shape_face_offsets.size() * sizeof(size_t);
+    }
+
+    bool BatchFull() const {
+        return (config.batch_size > 0 && BatchElements() >= config.batch_size) ||
+               (config.max_batch_bytes > 0 && BatchBytes() >= config.max_batch_bytes);
+    }
+};
+
+static void StreamVertexCallback(void* user_data, real_t x, real_t y, real_t z, real_t r, real_t g, real_t b, bool has_color) {
+    (void)has_color;  // r, g, b are white when the line has no color.
+    obj_stream_state* state = static_cast<obj_stream_state*>(user_data);
+    obj_stream_batch_t* batch = state->batch;
+    batch->vertices.push_back(x);
+    batch->vertices.push_back(y);
+    batch->vertices.push_back(z);
+    if (state->config.vertex_color) {
+        batch->colors.push_back(r);
+        batch->colors.push_back(g);
+        batch->colors.push_back(b);
+    }
+    state->num_vertices++;
+}
+
+static void StreamNormalCallback(void* user_data, real_t x, real_t y, real_t z) {
+    obj_stream_state* state = static_cast<obj_stream_state*>(user_data);
+    state->batch->normals.push_back(x);
+    state->batch->normals.push_back(y);
+    state->batch->normals.push_back(z);
+    state->num_normals++;
+}
+
+static void StreamTexcoordCallback(void* user_data, real_t x, real_t y, real_t z) {
+    (void)z;
+    obj_stream_state* state = static_cast<obj_stream_state*>(user_data);
+    state->batch->texcoords.push_back(x);
+    state->batch->texcoords.push_back(y);
+    state->num_texcoords++;
+}
+
+static void StreamIndexCallback(void* user_data, index_t* indices, int num_indices) {
+    obj_stream_state* state = static_cast<obj_stream_state*>(user_data);
+    obj_stream_batch_t* batch = state->batch;
+    for (int i = 0; i < num_indices; i++) {
+        index_t idx;
+        idx.vertex_index = ResolveStreamIndex(indices[i].vertex_index, state->num_vertices);
+        idx.normal_index = ResolveStreamIndex(indices[i].normal_index, state->num_normals);
+        idx.texcoord_index = ResolveStreamIndex(indices[i].texcoord_index, state->num_texcoords);
+        batch->indices.push_back(idx);
+    }
+    batch->num_face_vertices.push_back(static_cast<unsigned int>(num_indices));
+    batch->material_ids.push_back(state->material_id);
+    state->num_faces++;
+}
+
+static void StreamUsemtlCallback(void* user_data, const char* name, int material_id) {
+    obj_stream_state* state = static_cast<obj_stream_state*>(user_data);
+    state->material_id = material_id;
+    if (material_id < 0 && state->warn) {
+        (*state->warn) += "material [ " + std::string(name) + " ] not found in .mtl\n";
+    }
+}
+
+static void StreamMtllibCallback(void* user_data, const material_t* materials, int num_materials) {
+    obj_stream_state* state = static_cast<obj_stream_state*>(user_data);
+    state->materials.assign(materials, materials + num_materials);
+}
+
+static void StreamShapeStart(obj_stream_state* state, const char* name) {
+    state->batch->shape_names.push_back(name);
+    state->batch->shape_face_offsets.push_back(state->num_faces);
+}
+
+static void StreamGroupCallback(void* user_data, const char** names, int num_names) {
+    StreamShapeStart(static_cast<obj_stream_state*>(user_data), num_names > 0 ? names[0] : "");
+}
+
+static void StreamObjectCallback(void* user_data, const char* name) { StreamShapeStart(static_cast<obj_stream_state*>(user_data), name); }
+
+ObjStreamReader::ObjStreamReader() : state_(NULL) {}
+
+ObjStreamReader::~ObjStreamReader() { delete state_; }
+
+bool ObjStreamReader::Open(const std::string& filename, const ObjStreamReaderConfig& config) {
+    std::string mtl_search_path = config.mtl_search_path;
+    if (mtl_search_path.empty()) {
+        size_t pos = filename.find_last_of("/\\");
+        if (pos != std::string::npos) {
+            mtl_search_path = filename.substr(0, pos);
         }
+    }
 
-        // bump texture
-        if (((0 == strncmp(token, "map_bump", 8)) || (0 == strncmp(token, "map_Bump", 8))) && IS_SPACE(token[8])) {
-            token += 9;
-            ParseTextureNameAndOption(&(material.bump_texname), &(material.bump_texopt), token);
-            continue;
+    delete state_;
+    state_ = new obj_stream_state();
+    state_->file.open(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!state_->file) {
+        delete state_;
+        state_ = NULL;
+        error_ = "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+    state_->file_reader = new MaterialFileReader(MtlBaseDir(mtl_search_path.c_str()));
+
+    return Open(&state_->file, state_->file_reader, config);
+}
+
+bool ObjStreamReader::Open(std::istream* inStream, MaterialReader* readMatFn, const ObjStreamReaderConfig& config) {
+    // Keep the state when called from Open(filename), which owns the stream.
+    if (!state_ || inStream != &state_->file) {
+        delete state_;
+        state_ = new obj_stream_state();
+    }
+    warning_.clear();
+    error_.clear();
+
+    state_->stream = inStream;
+    state_->readMatFn = readMatFn;
+    state_->config = config;
+    state_->warn = &warning_;
+
+    callback_t& callback = state_->callback;
+    callback.vertex_color_cb = StreamVertexCallback;
+    callback.normal_cb = StreamNormalCallback;
+    callback.texcoord_cb = StreamTexcoordCallback;
+    callback.index_cb = StreamIndexCallback;
+    callback.usemtl_cb = StreamUsemtlCallback;
+    callback.mtllib_cb = StreamMtllibCallback;
+    callback.group_cb = StreamGroupCallback;
+    callback.object_cb = StreamObjectCallback;
+
+    return inStream != NULL;
+}
+
+bool ObjStreamReader::Next(obj_stream_batch_t* batch) {
+    batch->clear();
+    if (!state_ || !state_->stream) {
+        return false;
+    }
+
+    batch->vertex_offset = state_->num_vertices;
+    batch->normal_offset = state_->num_normals;
+    batch->texcoord_offset = state_->num_texcoords;
+    batch->face_offset = state_->num_faces;
+
+    state_->batch = batch;
+    callback_sink sink(state_->callback, state_);
+    std::istream& inStream = *state_->stream;
+    std::string& linebuf = state_->linebuf;
+    while (inStream.peek() != -1) {
+        safeGetline(inStream, linebuf);
+
+        // Trim newline '\r\n' or '\n'
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+        }
+        if (linebuf.size() > 0) {
+            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
         }
 
-        // bump texture
-        if ((0 == strncmp(token, "bump", 4)) && IS_SPACE(token[4])) {
-            token += 5;
-            ParseTextureNameAndOption(&(material.bump_texname), &(material.bump_texopt), token);
+        // Skip if empty line.
+        if (linebuf.empty()) {
             continue;
         }
 
-        // alpha texture
-        if ((0 == strncmp(token, "map_d", 5)) && IS_SPACE(token[5])) {
-            token += 6;
-            material.alpha_texname = token;
-            ParseTextureNameAndOption(&(material.alpha_texname), &(material.alpha_texopt), token);
-            continue;
+        parseCallbackLine(&state_->parse_state, linebuf.c_str(), sink, state_->readMatFn, &warning_, &error_);
+
+        if (state_->BatchFull()) {
+            break;
         }
+    }
+    state_->batch = NULL;
 
-        // displacement texture
-        if (((0 == strncmp(token, "map_disp", 8)) || (0 == strncmp(token, "map_Disp", 8))) && IS_SPACE(token[8])) {
-            token += 9;
-            ParseTextureNameAndOption(&(material.displacement_texname), &(material.displacement_texopt), token);
-            continue;
+    return !batch->empty();
+}
+
+const std::vector<material_t>& ObjStreamReader::GetMaterials() const {
+    static const std::vector<material_t> empty_materials;
+    return state_ ? state_->materials : empty_materials;
+}
+
+// Block size of the checkpoint hash of `ObjIncrementalReader`.
+static const size_t kIncrementalHashBlockSize = 1024 * 1024;
+
+// Parser state and checkpoint of `ObjIncrementalReader`.
+class obj_incremental_state {
+public:
+    obj_parse_state parse;
+
+    std::string filename;
+    ObjIncrementalReaderConfig config;
+
+    // Checkpoint: the first `offset` bytes of the file have been parsed.
+    // `block_hash` chains `HashBytes` over the whole blocks before `offset`,
+    // `tail_hash` continues it over the remaining bytes up to `offset`.
+    size_t offset;
+    unsigned long long block_hash;
+    unsigned long long tail_hash;
+
+    // The last element of the reader's shapes is `parse.shape`, moved out by
+    // `finishObjParse`.
+    bool pending_shape;
+
+    // `finishObjParse` flushes the open group into `parse.shape` at the
+    // checkpoint. Faces are exported only once either way, but lines and
+    // points stay in the group of a full parse(and are exported again at the
+    // next `usemtl`), so they are kept here with the sizes of `parse.shape`
+    // before the flush, to undo it when resuming.
+    PrimGroup flushed;
+    size_t num_shape_line_indices;
+    size_t num_shape_lines;
+    size_t num_shape_point_indices;
+
+    // Faces were flushed at a checkpoint and no face followed yet. A full
+    // parse would assign `tags` to the shape at the next export of the group.
+    bool flushed_faces;
+
+    obj_incremental_state()
+        : offset(0), block_hash(0), tail_hash(0), pending_shape(false), num_shape_line_indices(0), num_shape_lines(0),
+          num_shape_point_indices(0), flushed_faces(false) {}
+};
+
+static bool SameIncrementalConfig(const ObjIncrementalReaderConfig& a, const ObjIncrementalReaderConfig& b) {
+    return a.triangulate == b.triangulate && a.vertex_color == b.vertex_color && a.mtl_search_path == b.mtl_search_path;
+}
+
+// Reads bytes [begin, end) of `ifs` into `buf`.
+static bool ReadFileRange(std::ifstream& ifs, size_t begin, size_t end, std::vector<char>* buf) {
+    buf->resize(end - begin);
+    ifs.clear();
+    ifs.seekg(static_cast<std::streamoff>(begin));
+    if (buf->empty()) {
+        return true;
+    }
+    ifs.read(&(*buf)[0], static_cast<std::streamsize>(buf->size()));
+    return ifs.gcount() == static_cast<std::streamsize>(buf->size());
+}
+
+// Chained hash of the whole blocks in [0, end) of `ifs`(`end` is block aligned).
+static bool HashFileBlocks(std::ifstream& ifs, size_t end, unsigned long long* hash) {
+    std::vector<char> block(kIncrementalHashBlockSize);
+    unsigned long long h = 0;
+    ifs.clear();
+    ifs.seekg(0);
+    for (size_t pos = 0; pos < end; pos += kIncrementalHashBlockSize) {
+        ifs.read(&block[0], static_cast<std::streamsize>(kIncrementalHashBlockSize));
+        if (ifs.gcount() != static_cast<std::streamsize>(kIncrementalHashBlockSize)) {
+            return false;
         }
+        h = HashBytes(&block[0], kIncrementalHashBlockSize, h);
+    }
+    (*hash) = h;
+    return true;
+}
+
+ObjIncrementalReader::ObjIncrementalReader() : state_(NULL), appended_(false), num_parsed_bytes_(0) {}
+
+ObjIncrementalReader::~ObjIncrementalReader() { delete state_; }
+
+void ObjIncrementalReader::Reset() {
+    delete state_;
+    state_ = NULL;
+    attrib_ = attrib_t();
+    shapes_.clear();
+    materials_.clear();
+    appended_ = false;
+    num_parsed_bytes_ = 0;
+}
 
-        // displacement texture
-        if ((0 == strncmp(token, "disp", 4)) && IS_SPACE(token[4])) {
-            token += 5;
-            ParseTextureNameAndOption(&(material.displacement_texname), &(material.displacement_texopt), token);
-            continue;
-        }
+size_t ObjIncrementalReader::CheckpointOffset() const { return state_ ? state_->offset : 0; }
 
-        // reflection map
-        if ((0 == strncmp(token, "refl", 4)) && IS_SPACE(token[4])) {
-            token += 5;
-            ParseTextureNameAndOption(&(material.reflection_texname), &(material.reflection_texopt), token);
-            continue;
-        }
+bool ObjIncrementalReader::Load(const std::string& filename, const ObjIncrementalReaderConfig& config) {
+    warning_.clear();
+    error_.clear();
+    appended_ = false;
+    num_parsed_bytes_ = 0;
 
-        // PBR: roughness texture
-        if ((0 == strncmp(token, "map_Pr", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.roughness_texname), &(material.roughness_texopt), token);
-            continue;
+    unsigned long long file_size = 0;
+    long long mtime = 0;
+    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs || !GetFileStat(filename.c_str(), &file_size, &mtime)) {
+        error_ = "Cannot open file [" + filename + "]\n";
+        return false;
+    }
+    const size_t size = static_cast<size_t>(file_size);
+
+    // Bytes [base, size) of the file. `base` is the start of the block of the
+    // checkpoint, so the hash of the partial block can be checked.
+    std::vector<char> buf;
+    size_t base = 0;
+    unsigned long long block_hash = 0;
+
+    bool resume = state_ && state_->filename == filename && SameIncrementalConfig(state_->config, config) && size >= state_->offset;
+    if (resume) {
+        base = state_->offset - state_->offset % kIncrementalHashBlockSize;
+        block_hash = state_->block_hash;
+        if (config.verify_prefix) {
+            unsigned long long h = 0;
+            resume = HashFileBlocks(ifs, base, &h) && h == state_->block_hash;
         }
+        resume = resume && ReadFileRange(ifs, base, size, &buf) &&
+                 HashBytes(buf.empty() ? NULL : &buf[0], state_->offset - base, block_hash) == state_->tail_hash;
+    }
 
-        // PBR: metallic texture
-        if ((0 == strncmp(token, "map_Pm", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.metallic_texname), &(material.metallic_texopt), token);
-            continue;
+    if (!resume) {
+        Reset();
+        state_ = new obj_incremental_state();
+        state_->filename = filename;
+        state_->config = config;
+        base = 0;
+        block_hash = 0;
+        if (!ReadFileRange(ifs, 0, size, &buf)) {
+            error_ = "Failed to read file [" + filename + "]\n";
+            Reset();
+            return false;
         }
+    }
 
-        // PBR: sheen texture
-        if ((0 == strncmp(token, "map_Ps", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.sheen_texname), &(material.sheen_texopt), token);
-            continue;
+    std::string mtl_search_path = config.mtl_search_path;
+    if (mtl_search_path.empty()) {
+        size_t pos = filename.find_last_of("/\\");
+        if (pos != std::string::npos) {
+            mtl_search_path = filename.substr(0, pos);
+        }
+    }
+    MaterialFileReader matFileReader(MtlBaseDir(mtl_search_path.c_str()));
+
+    // Continue from the checkpoint: take the arrays and the open shape back.
+    obj_parse_state& state = state_->parse;
+    state.v.swap(attrib_.vertices);
+    state.vn.swap(attrib_.normals);
+    state.vt.swap(attrib_.texcoords);
+    state.vc.swap(attrib_.colors);
+    state.vw.swap(attrib_.skin_weights);
+    if (state_->pending_shape) {
+        std::swap(state.shape, shapes_.back());
+        shapes_.pop_back();
+    }
+    state.shape.lines.indices.resize(state_->num_shape_line_indices);
+    state.shape.lines.num_line_vertices.resize(state_->num_shape_lines);
+    state.shape.points.indices.resize(state_->num_shape_point_indices);
+    state.prim_group.lineGroup.swap(state_->flushed.lineGroup);
+    state.prim_group.pointsGroup.swap(state_->flushed.pointsGroup);
+
+    const char* begin = buf.empty() ? NULL : &buf[0];
+    const char* end = begin + buf.size();
+    const char* p = begin + (state_->offset - base);
+    std::string linebuf;
+    while (p < end) {
+        const char* eol = FindLineEnd(p, end);
+        if (eol == end || (*eol == '\r' && eol + 1 == end)) {
+            break;  // The last line is still being written.
         }
+        linebuf.assign(p, eol);
+        p = SkipLineEnding(eol, end);
+        state.line_num++;
 
-        // PBR: emissive texture
-        if ((0 == strncmp(token, "map_Ke", 6)) && IS_SPACE(token[6])) {
-            token += 7;
-            ParseTextureNameAndOption(&(material.emissive_texname), &(material.emissive_texopt), token);
+        if (linebuf.empty()) {
             continue;
         }
 
-        // PBR: normal map texture
-        if ((0 == strncmp(token, "norm", 4)) && IS_SPACE(token[4])) {
-            token += 5;
-            ParseTextureNameAndOption(&(material.normal_texname), &(material.normal_texopt), token);
-            continue;
+        const char* token = SkipSpace(linebuf.c_str());
+        const bool group_line = (token[0] == 'g' || token[0] == 'o') && IS_SPACE(token[1]);
+        const int material = state.material;
+        if (state_->flushed_faces && group_line) {
+            state.shape.mesh.tags = state.tags;
         }
 
-        // unknown parameter
-        const char* _space = strchr(token, ' ');
-        if (!_space) {
-            _space = strchr(token, '\t');
+        if (!parseObjLine(&state, linebuf.c_str(), &shapes_, &materials_, &matFileReader, config.triangulate, config.vertex_color,
+                &warning_, &error_)) {
+            Reset();
+            return false;
         }
-        if (_space) {
-            std::ptrdiff_t len = _space - token;
-            std::string key(token, static_cast<size_t>(len));
-            std::string value = _space + 1;
-            material.unknown_parameter.insert(std::pair<std::string, std::string>(key, value));
+
+        if (state_->flushed_faces && (group_line || state.material != material || !state.prim_group.faceGroup.empty())) {
+            if (state.material != material) {
+                state.shape.mesh.tags = state.tags;
+            }
+            state_->flushed_faces = false;
         }
     }
-    // flush last material.
-    material_map->insert(std::pair<std::string, int>(material.name, static_cast<int>(materials->size())));
-    materials->push_back(material);
 
-    if (warning) {
-        (*warning) = warn_ss.str();
+    // Checkpoint(see `obj_incremental_state::flushed`).
+    if (state_->flushed_faces) {
+        state.shape.mesh.tags = state.tags;
     }
-}
+    state_->flushed_faces = state_->flushed_faces || !state.prim_group.faceGroup.empty();
+    state_->flushed.lineGroup = state.prim_group.lineGroup;
+    state_->flushed.pointsGroup = state.prim_group.pointsGroup;
+    state_->num_shape_line_indices = state.shape.lines.indices.size();
+    state_->num_shape_lines = state.shape.lines.num_line_vertices.size();
+    state_->num_shape_point_indices = state.shape.points.indices.size();
+
+    const size_t num_shapes = shapes_.size();
+    finishObjParse(&state, &attrib_, &shapes_, config.triangulate, config.vertex_color, &warning_);
+    state_->pending_shape = shapes_.size() > num_shapes;
+
+    // Move the checkpoint past the parsed lines.
+    const size_t offset = static_cast<size_t>(p - begin) + base;
+    const size_t new_base = offset - offset % kIncrementalHashBlockSize;
+    for (size_t pos = base; pos < new_base; pos += kIncrementalHashBlockSize) {
+        block_hash = HashBytes(begin + (pos - base), kIncrementalHashBlockSize, block_hash);
+    }
+    num_parsed_bytes_ = offset - state_->offset;
+    appended_ = resume;
+    state_->offset = offset;
+    state_->block_hash = block_hash;
+    state_->tail_hash = HashBytes(begin ? begin + (new_base - base) : NULL, offset - new_base, block_hash);
 
-bool MaterialFileReader::operator()(
-    const std::string& matId, std::vector<material_t>* materials, std::map<std::string, int>* matMap, std::string* warn, std::string* err) {
-    if (!m_mtlBaseDir.empty()) {
-#ifdef _WIN32
-        char sep = ';';
-#else
-        char sep = ':';
-#endif
+    return true;
+}
 
-        // https://stackoverflow.com/questions/5167625/splitting-a-c-stdstring-using-tokens-e-g
-        std::vector<std::string> paths;
-        std::istringstream f(m_mtlBaseDir);
+// IEEE 754 binary16 conversion(round to nearest even) for
+// `compact_attrib_t::texcoords`.
+static unsigned short FloatToHalf(float value) {
+    unsigned int f;
+    memcpy(&f, &value, sizeof(f));
+    const unsigned int sign = (f >> 16) & 0x8000u;
+    f &= 0x7FFFFFFFu;
 
-        std::string s;
-        while (getline(f, s, sep)) {
-            paths.push_back(s);
+    if (f >= 0x7F800000u) {  // inf or NaN
+        return static_cast<unsigned short>(sign | 0x7C00u | (f > 0x7F800000u ? 0x200u : 0u));
+    }
+    if (f >= 0x477FF000u) {  // rounds above 65504
+        return static_cast<unsigned short>(sign | 0x7C00u);
+    }
+    if (f < 0x38800000u) {  // subnormal half
+        if (f < 0x33000000u) {
+            return static_cast<unsigned short>(sign);
         }
+        const unsigned int shift = 126u - (f >> 23);
+        const unsigned int m = (f & 0x7FFFFFu) | 0x800000u;
+        const unsigned int rem = m & ((1u << shift) - 1u);
+        const unsigned int halfway = 1u << (shift - 1u);
+        unsigned int h = m >> shift;
+        if (rem > halfway || (rem == halfway && (h & 1u))) {
+            h++;
+        }
+        return static_cast<unsigned short>(sign | h);
+    }
 
-        for (size_t i = 0; i < paths.size(); i++) {
-            std::string filepath = JoinPath(paths[i], matId);
-
-            std::ifstream matIStream(filepath.c_str());
-            if (matIStream) {
-                LoadMtl(matMap, materials, &matIStream, warn, err);
+    unsigned int h = (f - 0x38000000u) >> 13;  // rebias the exponent from 127 to 15
+    const unsigned int rem = f & 0x1FFFu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) {
+        h++;
+    }
+    return static_cast<unsigned short>(sign | h);
+}
 
-                return true;
+static float HalfToFloat(unsigned short h) {
+    const unsigned int sign = static_cast<unsigned int>(h & 0x8000u) << 16;
+    unsigned int exponent = (h >> 10) & 0x1Fu;
+    unsigned int mantissa = h & 0x3FFu;
+
+    unsigned int f;
+    if (exponent == 0x1Fu) {
+        f = sign | 0x7F800000u | (mantissa << 13);
+    } else if (exponent == 0) {
+        if (mantissa == 0) {
+            f = sign;
+        } else {
+            exponent = 113;
+            while ((mantissa & 0x400u) == 0) {
+                mantissa <<= 1;
+                exponent--;
             }
+            f = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
         }
+    } else {
+        f = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    }
 
-        std::stringstream ss;
-        ss << "Material file [ " << matId << " ] not found in a path : " << m_mtlBaseDir << "\n";
-        if (warn) {
-            (*warn) += ss.str();
-        }
-        return false;
+    float value;
+    memcpy(&value, &f, sizeof(value));
+    return value;
+}
 
-    } else {
-        std::string filepath = matId;
-        std::ifstream matIStream(filepath.c_str());
-        if (matIStream) {
-            LoadMtl(matMap, materials, &matIStream, warn, err);
+static inline short RealToSnorm16(real_t v) {
+    v = (std::max)(static_cast<real_t>(-1.0), (std::min)(static_cast<real_t>(1.0), v));
+    return static_cast<short>(v >= static_cast<real_t>(0.0) ? v * 32767 + static_cast<real_t>(0.5) : v * 32767 - static_cast<real_t>(0.5));
+}
 
-            return true;
-        }
+static inline real_t SignNotZero(real_t v) {
+    return v >= static_cast<real_t>(0.0) ? static_cast<real_t>(1.0) : static_cast<real_t>(-1.0);
+}
 
-        std::stringstream ss;
-        ss << "Material file [ " << filepath << " ] not found in a path : " << m_mtlBaseDir << "\n";
-        if (warn) {
-            (*warn) += ss.str();
-        }
+// Octahedral normal encoding for `compact_attrib_t::normals`.
+// A zero(or NaN) normal is stored as +Z.
+static void EncodeOctahedral(const real_t* n, short* out) {
+    const real_t l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    if (!(l1 > static_cast<real_t>(0.0))) {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
 
-        return false;
+    real_t x = n[0] / l1;
+    real_t y = n[1] / l1;
+    if (n[2] < static_cast<real_t>(0.0)) {
+        const real_t ox = x;
+        x = (1 - std::fabs(y)) * SignNotZero(x);
+        y = (1 - std::fabs(ox)) * SignNotZero(y);
     }
+    out[0] = RealToSnorm16(x);
+    out[1] = RealToSnorm16(y);
 }
 
-bool MaterialStreamReader::operator()(
-    const std::string& matId, std::vector<material_t>* materials, std::map<std::string, int>* matMap, std::string* warn, std::string* err) {
-    (void)err;
-    (void)matId;
-    if (!m_inStream) {
-        std::stringstream ss;
-        ss << "Material stream in error state. \n";
-        if (warn) {
-            (*warn) += ss.str();
-        }
-        return false;
+static void DecodeOctahedral(const short* in, real_t* n) {
+    real_t x = (std::max)(static_cast<real_t>(in[0]) / 32767, static_cast<real_t>(-1.0));
+    real_t y = (std::max)(static_cast<real_t>(in[1]) / 32767, static_cast<real_t>(-1.0));
+    const real_t z = 1 - std::fabs(x) - std::fabs(y);
+    if (z < static_cast<real_t>(0.0)) {
+        const real_t ox = x;
+        x = (1 - std::fabs(y)) * SignNotZero(x);
+        y = (1 - std::fabs(ox)) * SignNotZero(y);
     }
+    const real_t len = std::sqrt(x * x + y * y + z * z);
+    n[0] = x / len;
+    n[1] = y / len;
+    n[2] = z / len;
+}
 
-    LoadMtl(matMap, materials, &m_inStream, warn, err);
+size_t attrib_accessor_t::num_vertices() const {
+    return compact_ ? compact_->num_vertices() : attrib_->vertices.size() / 3;
+}
 
-    return true;
+size_t attrib_accessor_t::num_normals() const {
+    return compact_ ? compact_->num_normals() : attrib_->normals.size() / 3;
 }
 
-bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
-    const char* filename, const char* mtl_basedir, bool triangulate, bool default_vcols_fallback) {
-    attrib->vertices.clear();
-    attrib->normals.clear();
-    attrib->texcoords.clear();
-    attrib->colors.clear();
-    shapes->clear();
+size_t attrib_accessor_t::num_texcoords() const {
+    return compact_ ? compact_->num_texcoords() : attrib_->texcoords.size() / 2;
+}
 
-    std::stringstream errss;
+bool attrib_accessor_t::has_colors() const {
+    return compact_ ? compact_->has_colors() : !attrib_->colors.empty();
+}
 
-    std::ifstream ifs(filename);
-    if (!ifs) {
-        errss << "Cannot open file [" << filename << "]\n";
-        if (err) {
-            (*err) = errss.str();
-        }
-        return false;
-    }
+void attrib_accessor_t::GetVertex(size_t i, real_t* xyz) const {
+    const real_t* p = compact_ ? &compact_->vertices[3 * i] : &attrib_->vertices[3 * i];
+    xyz[0] = p[0];
+    xyz[1] = p[1];
+    xyz[2] = p[2];
+}
 
-    std::string baseDir = mtl_basedir ? mtl_basedir : "";
-    if (!baseDir.empty()) {
-#ifndef _WIN32
-        const char dirsep = '/';
-#else
-        const char dirsep = '\\';
-#endif
-        if (baseDir[baseDir.length() - 1] != dirsep) baseDir += dirsep;
+void attrib_accessor_t::GetNormal(size_t i, real_t* xyz) const {
+    if (compact_) {
+        DecodeOctahedral(&compact_->normals[2 * i], xyz);
+        return;
     }
-    MaterialFileReader matFileReader(baseDir);
+    const real_t* n = &attrib_->normals[3 * i];
+    xyz[0] = n[0];
+    xyz[1] = n[1];
+    xyz[2] = n[2];
+}
 
-    return LoadObj(attrib, shapes, materials, warn, err, &ifs, &matFileReader, triangulate, default_vcols_fallback);
+void attrib_accessor_t::GetTexcoord(size_t i, real_t* uv) const {
+    if (compact_) {
+        uv[0] = static_cast<real_t>(HalfToFloat(compact_->texcoords[2 * i + 0]));
+        uv[1] = static_cast<real_t>(HalfToFloat(compact_->texcoords[2 * i + 1]));
+        return;
+    }
+    uv[0] = attrib_->texcoords[2 * i + 0];
+    uv[1] = attrib_->texcoords[2 * i + 1];
 }
 
-bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes, std::vector<material_t>* materials, std::string* warn, std::string* err,
-    std::istream* inStream, MaterialReader* readMatFn /*= NULL*/, bool triangulate, bool default_vcols_fallback) {
-    std::stringstream errss;
+void attrib_accessor_t::GetColor(size_t i, real_t* rgb) const {
+    if (compact_) {
+        if (3 * i + 2 < compact_->colors.size()) {
+            for (int k = 0; k < 3; k++) {
+                rgb[k] = static_cast<real_t>(compact_->colors[3 * i + k]) / 255;
+            }
+            return;
+        }
+    } else if (3 * i + 2 < attrib_->colors.size()) {
+        for (int k = 0; k < 3; k++) {
+            rgb[k] = attrib_->colors[3 * i + k];
+        }
+        return;
+    }
+    rgb[0] = rgb[1] = rgb[2] = static_cast<real_t>(1.0);
+}
 
-    std::vector<real_t> v;
-    std::vector<real_t> vn;
-    std::vector<real_t> vt;
-    std::vector<real_t> vc;
-    std::vector<skin_weight_t> vw;
-    std::vector<tag_t> tags;
-    PrimGroup prim_group;
-    std::string name;
+void CompactAttrib(attrib_t* attrib, compact_attrib_t* compact) {
+    compact->vertices.swap(attrib->vertices);
 
-    // material
-    std::set<std::string> material_filenames;
-    std::map<std::string, int> material_map;
-    int material = -1;
+    const size_t num_normals = attrib->normals.size() / 3;
+    compact->normals.resize(2 * num_normals);
+    for (size_t i = 0; i < num_normals; i++) {
+        EncodeOctahedral(&attrib->normals[3 * i], &compact->normals[2 * i]);
+    }
 
-    // smoothing group id
-    unsigned int current_smoothing_id = 0;  // Initial value. 0 means no smoothing.
+    const size_t num_texcoords = attrib->texcoords.size() / 2;
+    compact->texcoords.resize(2 * num_texcoords);
+    for (size_t i = 0; i < 2 * num_texcoords; i++) {
+        compact->texcoords[i] = FloatToHalf(static_cast<float>(attrib->texcoords[i]));
+    }
 
-    int greatest_v_idx = -1;
-    int greatest_vn_idx = -1;
-    int greatest_vt_idx = -1;
+    // `default_vcols_fallback` fills missing colors with white; store them
+    // only when they carry information.
+    bool has_colors = false;
+    for (size_t i = 0; i < attrib->colors.size(); i++) {
+        if (attrib->colors[i] != static_cast<real_t>(1.0)) {
+            has_colors = true;
+            break;
+        }
+    }
+    compact->colors.clear();
+    if (has_colors) {
+        compact->colors.resize(attrib->colors.size());
+        for (size_t i = 0; i < attrib->colors.size(); i++) {
+            const real_t c = (std::max)(static_cast<real_t>(0.0), (std::min)(static_cast<real_t>(1.0), attrib->colors[i]));
+            compact->colors[i] = static_cast<unsigned char>(c * 255 + static_cast<real_t>(0.5));
+        }
+    }
 
-    shape_t shape;
+    // Release the full precision arrays.
+    (*attrib) = attrib_t();
+}
 
-    bool found_all_colors = true;
+static inline unsigned int HashVertexIndex(const index_t& idx) {
+    unsigned long long h = static_cast<unsigned long long>(static_cast<unsigned int>(idx.vertex_index)) * kHashPrime1;
+    h ^= static_cast<unsigned long long>(static_cast<unsigned int>(idx.normal_index)) * kHashPrime2;
+    h ^= static_cast<unsigned long long>(static_cast<unsigned int>(idx.texcoord_index)) * kHashPrime3;
+    h ^= h >> 29;
+    return static_cast<unsigned int>(h ^ (h >> 32));
+}
 
-    size_t line_num = 0;
-    std::string linebuf;
-    while (inStream->peek() != -1) {
-        safeGetline(*inStream, linebuf);
+bool BuildIndexedMesh(const attrib_accessor_t& attrib, const shape_t& shape, indexed_mesh_t* indexed_mesh) {
+    const mesh_t& mesh = shape.mesh;
+    const size_t num_corners = mesh.indices.size();
+    const int num_v = static_cast<int>(attrib.num_vertices());
+    const int num_vn = static_cast<int>(attrib.num_normals());
+    const int num_vt = static_cast<int>(attrib.num_texcoords());
+
+    indexed_mesh_t& out = (*indexed_mesh);
+    out.vertices.clear();
+    out.vertex_sources.clear();
+    out.indices.clear();
+    out.tangents.clear();
+
+    // An attribute is stored when any corner of the shape references it.
+    bool has_normals = false;
+    bool has_texcoords = false;
+    for (size_t i = 0; i < num_corners; i++) {
+        const index_t& idx = mesh.indices[i];
+        if (idx.vertex_index < 0 || idx.vertex_index >= num_v) {
+            return false;
+        }
+        has_normals |= (idx.normal_index >= 0 && idx.normal_index < num_vn);
+        has_texcoords |= (idx.texcoord_index >= 0 && idx.texcoord_index < num_vt);
+    }
+    if (num_corners >= 0xFFFFFFFFu) {
+        return false;  // Does not fit 32-bit indices.
+    }
 
-        line_num++;
+    out.vertex_stride = 3;
+    out.normal_offset = -1;
+    out.texcoord_offset = -1;
+    if (has_normals) {
+        out.normal_offset = out.vertex_stride;
+        out.vertex_stride += 3;
+    }
+    if (has_texcoords) {
+        out.texcoord_offset = out.vertex_stride;
+        out.vertex_stride += 2;
+    }
 
-        // Trim newline '\r\n' or '\n'
-        if (linebuf.size() > 0) {
-            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
+    // Open addressing table of vertex ids, kept at most half full.
+    const unsigned int kEmpty = 0xFFFFFFFFu;
+    size_t table_size = 16;
+    while (table_size < num_corners * 2) {
+        table_size <<= 1;
+    }
+    const size_t table_mask = table_size - 1;
+    std::vector<unsigned int> table(table_size, kEmpty);
+
+    out.indices.resize(num_corners);
+    for (size_t i = 0; i < num_corners; i++) {
+        index_t key = mesh.indices[i];
+        if (key.normal_index < 0 || key.normal_index >= num_vn) {
+            key.normal_index = -1;
         }
-        if (linebuf.size() > 0) {
-            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
+        if (key.texcoord_index < 0 || key.texcoord_index >= num_vt) {
+            key.texcoord_index = -1;
         }
 
-        // Skip if empty line.
-        if (linebuf.empty()) {
-            continue;
-        }
+        size_t slot = HashVertexIndex(key) & table_mask;
+        for (;;) {
+            unsigned int id = table[slot];
+            if (id == kEmpty) {
+                id = static_cast<unsigned int>(out.vertex_sources.size());
+                table[slot] = id;
+                out.vertex_sources.push_back(key);
+
+                out.vertices.resize(out.vertices.size() + size_t(out.vertex_stride), static_cast<real_t>(0.0));
+                real_t* vertex = &out.vertices[out.vertices.size() - size_t(out.vertex_stride)];
+                attrib.GetVertex(size_t(key.vertex_index), vertex);
+                if (key.normal_index >= 0) {
+                    attrib.GetNormal(size_t(key.normal_index), vertex + out.normal_offset);
+                }
+                if (key.texcoord_index >= 0) {
+                    attrib.GetTexcoord(size_t(key.texcoord_index), vertex + out.texcoord_offset);
+                }
 
-        // Skip leading space.
-        const char* token = linebuf.c_str();
-        token += strspn(token, " \t");
+                out.indices[i] = id;
+                break;
+            }
 
-        assert(token);
-        if (token[0] == '\0') continue;  // empty line
+            const index_t& other = out.vertex_sources[id];
+            if (other.vertex_index == key.vertex_index && other.normal_index == key.normal_index &&
+                other.texcoord_index == key.texcoord_index) {
+                out.indices[i] = id;
+                break;
+            }
+            slot = (slot + 1) & table_mask;
+        }
+    }
 
-        if (token[0] == '#') continue;  // comment line
+    return true;
+}
 
-        // vertex
-        if (token[0] == 'v' && IS_SPACE((token[1]))) {
-            token += 2;
-            real_t x, y, z;
-            real_t r, g, b;
+bool BuildIndexedMesh(const attrib_t& attrib, const shape_t& shape, indexed_mesh_t* indexed_mesh) {
+    return BuildIndexedMesh(attrib_accessor_t(attrib), shape, indexed_mesh);
+}
 
-            found_all_colors &= parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
+// Face of `GenerateSmoothingGroupNormals`.
+struct normal_face_t {
+    size_t shape;
+    size_t offset;  // first corner in `mesh_t::indices`
+    size_t corner;  // first corner in the corner angles of all faces
+    unsigned int num_vertices;
+    unsigned int smoothing_group_id;
+    bool valid;          // all vertex indices are in range
+    bool needs_normals;  // some corner gets a generated normal
+    double normal[3];    // area weighted face normal(Newell's method)
+};
 
-            v.push_back(x);
-            v.push_back(y);
-            v.push_back(z);
+// A smooth face corner in the per vertex buckets of
+// `GenerateSmoothingGroupNormals`.
+struct normal_corner_t {
+    unsigned int smoothing_group_id;
+    unsigned int face;
+    unsigned int corner;  // 0 .. num_vertices - 1
+
+    bool operator<(const normal_corner_t& other) const {
+        if (smoothing_group_id != other.smoothing_group_id) return smoothing_group_id < other.smoothing_group_id;
+        if (face != other.face) return face < other.face;
+        return corner < other.corner;
+    }
+};
 
-            if (found_all_colors || default_vcols_fallback) {
-                vc.push_back(r);
-                vc.push_back(g);
-                vc.push_back(b);
-            }
+// Faces or vertices per task of `GenerateSmoothingGroupNormals`.
+static const size_t kNormalBlockSize = 4096;
 
-            continue;
-        }
+static inline bool CornerNeedsNormal(const index_t& idx, int num_vn, bool overwrite) {
+    return overwrite || idx.normal_index < 0 || idx.normal_index >= num_vn;
+}
 
-        // normal
-        if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-            token += 3;
-            real_t x, y, z;
-            parseReal3(&x, &y, &z, &token);
-            vn.push_back(x);
-            vn.push_back(y);
-            vn.push_back(z);
-            continue;
-        }
+// Angle of the corner `k` of a face, used as the weight of the face normal.
+static double CornerAngle(const std::vector<real_t>& v, const index_t* idx, unsigned int n, unsigned int k) {
+    const real_t* p = &v[3 * static_cast<size_t>(idx[k].vertex_index)];
+    const real_t* prev = &v[3 * static_cast<size_t>(idx[(k + n - 1) % n].vertex_index)];
+    const real_t* next = &v[3 * static_cast<size_t>(idx[(k + 1) % n].vertex_index)];
 
-        // texcoord
-        if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
-            token += 3;
-            real_t x, y;
-            parseReal2(&x, &y, &token);
-            vt.push_back(x);
-            vt.push_back(y);
-            continue;
-        }
+    double e0[3], e1[3];
+    for (int i = 0; i < 3; i++) {
+        e0[i] = static_cast<double>(prev[i]) - p[i];
+        e1[i] = static_cast<double>(next[i]) - p[i];
+    }
+    if ((e0[0] == 0.0 && e0[1] == 0.0 && e0[2] == 0.0) || (e1[0] == 0.0 && e1[1] == 0.0 && e1[2] == 0.0)) {
+        return 0.0;  // Repeated vertex: no angle.
+    }
+    const double cx = e0[1] * e1[2] - e0[2] * e1[1];
+    const double cy = e0[2] * e1[0] - e0[0] * e1[2];
+    const double cz = e0[0] * e1[1] - e0[1] * e1[0];
+    return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), e0[0] * e1[0] + e0[1] * e1[1] + e0[2] * e1[2]);
+}
 
-        // skin weight. tinyobj extension
-        if (token[0] == 'v' && token[1] == 'w' && IS_SPACE((token[2]))) {
-            token += 3;
+// Writes the normalized `n` to `out`(zero for a degenerate normal).
+static void StoreNormal(const double* n, real_t* out) {
+    const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    const double inv = len > 0.0 ? 1.0 / len : 0.0;
+    for (int i = 0; i < 3; i++) {
+        out[i] = static_cast<real_t>(n[i] * inv);
+    }
+}
 
-            // vw <vid> <joint_0> <weight_0> <joint_1> <weight_1> ...
-            // example:
-            // vw 0 0 0.25 1 0.25 2 0.5
+bool GenerateSmoothingGroupNormals(attrib_t* attrib, std::vector<shape_t>* shapes, bool overwrite, unsigned int num_threads) {
+    num_threads = ResolveNumThreads(num_threads);
+    const std::vector<real_t>& v = attrib->vertices;
+    const int num_v = static_cast<int>(v.size() / 3);
+    const int num_vn = static_cast<int>(attrib->normals.size() / 3);
 
-            // TODO(syoyo): Add syntax check
-            int vid = 0;
-            vid = parseInt(&token);
+    size_t num_faces = 0;
+    for (size_t s = 0; s < shapes->size(); s++) {
+        num_faces += (*shapes)[s].mesh.num_face_vertices.size();
+    }
+    std::vector<normal_face_t> faces;
+    faces.reserve(num_faces);
+    size_t num_corners = 0;
+    for (size_t s = 0; s < shapes->size(); s++) {
+        const mesh_t& mesh = (*shapes)[s].mesh;
+        size_t offset = 0;
+        for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
+            normal_face_t face;
+            face.shape = s;
+            face.offset = offset;
+            face.corner = num_corners;
+            face.num_vertices = mesh.num_face_vertices[f];
+            face.smoothing_group_id = f < mesh.smoothing_group_ids.size() ? mesh.smoothing_group_ids[f] : 0;
+            face.valid = face.num_vertices >= 3 && offset + face.num_vertices <= mesh.indices.size();
+            face.needs_normals = false;
+            faces.push_back(face);
+            offset += face.num_vertices;
+            num_corners += face.num_vertices;
+        }
+    }
 
-            skin_weight_t sw;
+    // Face normals and corner angles(parallel over faces).
+    std::vector<double> corner_angles(num_corners, 0.0);
+    const size_t num_face_blocks = (faces.size() + kNormalBlockSize - 1) / kNormalBlockSize;
+    parallelFor(num_face_blocks, num_threads, [&](size_t b) {
+        const size_t face_end = std::min(faces.size(), (b + 1) * kNormalBlockSize);
+        for (size_t f = b * kNormalBlockSize; f < face_end; f++) {
+            normal_face_t& face = faces[f];
+            face.normal[0] = face.normal[1] = face.normal[2] = 0.0;
+            if (!face.valid) {
+                continue;
+            }
+            const index_t* idx = &(*shapes)[face.shape].mesh.indices[face.offset];
+            for (unsigned int k = 0; k < face.num_vertices; k++) {
+                face.valid &= idx[k].vertex_index >= 0 && idx[k].vertex_index < num_v;
+                face.needs_normals |= CornerNeedsNormal(idx[k], num_vn, overwrite);
+            }
+            if (!face.valid) {
+                continue;
+            }
+            for (unsigned int k = 0; k < face.num_vertices; k++) {
+                const real_t* p0 = &v[3 * static_cast<size_t>(idx[k].vertex_index)];
+                const real_t* p1 = &v[3 * static_cast<size_t>(idx[(k + 1) % face.num_vertices].vertex_index)];
+                face.normal[0] += (static_cast<double>(p0[1]) - p1[1]) * (static_cast<double>(p0[2]) + p1[2]);
+                face.normal[1] += (static_cast<double>(p0[2]) - p1[2]) * (static_cast<double>(p0[0]) + p1[0]);
+                face.normal[2] += (static_cast<double>(p0[0]) - p1[0]) * (static_cast<double>(p0[1]) + p1[1]);
+                corner_angles[face.corner + k] = CornerAngle(v, idx, face.num_vertices, k);
+            }
+        }
+    });
+
+    // Bucket the corners of smooth faces by vertex(counting sort, so every
+    // bucket is gathered by a single task without locks).
+    std::vector<size_t> bucket_begin(static_cast<size_t>(num_v) + 1, 0);
+    bool ret = true;
+    for (size_t f = 0; f < faces.size(); f++) {
+        const normal_face_t& face = faces[f];
+        ret &= face.valid;
+        if (!face.valid || face.smoothing_group_id == 0) {
+            continue;
+        }
+        const index_t* idx = &(*shapes)[face.shape].mesh.indices[face.offset];
+        for (unsigned int k = 0; k < face.num_vertices; k++) {
+            bucket_begin[static_cast<size_t>(idx[k].vertex_index) + 1]++;
+        }
+    }
+    for (size_t i = 0; i < static_cast<size_t>(num_v); i++) {
+        bucket_begin[i + 1] += bucket_begin[i];
+    }
+    std::vector<normal_corner_t> corners(bucket_begin[static_cast<size_t>(num_v)]);
+    {
+        std::vector<size_t> fill(bucket_begin.begin(), bucket_begin.end() - 1);
+        for (size_t f = 0; f < faces.size(); f++) {
+            const normal_face_t& face = faces[f];
+            if (!face.valid || face.smoothing_group_id == 0) {
+                continue;
+            }
+            const index_t* idx = &(*shapes)[face.shape].mesh.indices[face.offset];
+            for (unsigned int k = 0; k < face.num_vertices; k++) {
+                normal_corner_t& corner = corners[fill[static_cast<size_t>(idx[k].vertex_index)]++];
+                corner.smoothing_group_id = face.smoothing_group_id;
+                corner.face = static_cast<unsigned int>(f);
+                corner.corner = k;
+            }
+        }
+    }
 
-            sw.vertex_id = vid;
+    // Count the (vertex, smoothing group) normals that some corner uses.
+    const size_t num_vertex_blocks = (static_cast<size_t>(num_v) + kNormalBlockSize - 1) / kNormalBlockSize;
+    std::vector<size_t> block_normals(num_vertex_blocks + 1, 0);
+    parallelFor(num_vertex_blocks, num_threads, [&](size_t b) {
+        const size_t vertex_end = std::min(static_cast<size_t>(num_v), (b + 1) * kNormalBlockSize);
+        size_t count = 0;
+        for (size_t i = b * kNormalBlockSize; i < vertex_end; i++) {
+            std::sort(corners.begin() + bucket_begin[i], corners.begin() + bucket_begin[i + 1]);
+            bool needed = false;
+            for (size_t c = bucket_begin[i]; c < bucket_begin[i + 1]; c++) {
+                const normal_face_t& face = faces[corners[c].face];
+                needed |= CornerNeedsNormal((*shapes)[face.shape].mesh.indices[face.offset + corners[c].corner], num_vn, overwrite);
+                if (c + 1 == bucket_begin[i + 1] || corners[c + 1].smoothing_group_id != corners[c].smoothing_group_id) {
+                    count += needed ? 1 : 0;
+                    needed = false;
+                }
+            }
+        }
+        block_normals[b + 1] = count;
+    });
+    for (size_t b = 0; b < num_vertex_blocks; b++) {
+        block_normals[b + 1] += block_normals[b];
+    }
 
-            while (!IS_NEW_LINE(token[0])) {
-                real_t j, w;
-                // joint_id should not be negative, weight may be negative
-                // TODO(syoyo): # of elements check
-                parseReal2(&j, &w, &token, -1.0);
+    // Flat faces get one normal each, after the smooth normals.
+    std::vector<size_t> flat_normal(faces.size(), 0);
+    size_t num_normals = block_normals[num_vertex_blocks];
+    for (size_t f = 0; f < faces.size(); f++) {
+        if (faces[f].valid && faces[f].needs_normals && faces[f].smoothing_group_id == 0) {
+            flat_normal[f] = num_normals++;
+        }
+    }
 
-                if (j < static_cast<real_t>(0)) {
-                    if (err) {
-                        std::stringstream ss;
-                        ss << "Failed parse `vw' line. joint_id is negative. "
-                              "line "
-                           << line_num << ".)\n";
-                        (*err) += ss.str();
+    std::vector<real_t>& vn = attrib->normals;
+    vn.resize(3 * (static_cast<size_t>(num_vn) + num_normals));
+    real_t* out = vn.empty() ? NULL : &vn[3 * static_cast<size_t>(num_vn)];
+
+    // Gather the smooth normals. Each corner belongs to exactly one bucket,
+    // so its normal index is written by one task.
+    parallelFor(num_vertex_blocks, num_threads, [&](size_t b) {
+        const size_t vertex_end = std::min(static_cast<size_t>(num_v), (b + 1) * kNormalBlockSize);
+        size_t slot = block_normals[b];
+        for (size_t i = b * kNormalBlockSize; i < vertex_end; i++) {
+            size_t group_begin = bucket_begin[i];
+            for (size_t c = bucket_begin[i]; c < bucket_begin[i + 1]; c++) {
+                if (c + 1 != bucket_begin[i + 1] && corners[c + 1].smoothing_group_id == corners[c].smoothing_group_id) {
+                    continue;
+                }
+                double sum[3] = {0.0, 0.0, 0.0};
+                bool needed = false;
+                for (size_t g = group_begin; g <= c; g++) {
+                    const normal_face_t& face = faces[corners[g].face];
+                    const double angle = corner_angles[face.corner + corners[g].corner];
+                    for (int k = 0; k < 3; k++) {
+                        sum[k] += face.normal[k] * angle;
                     }
-                    return false;
+                    needed |= CornerNeedsNormal((*shapes)[face.shape].mesh.indices[face.offset + corners[g].corner], num_vn, overwrite);
                 }
-
-                joint_and_weight_t jw;
-
-                jw.joint_id = int(j);
-                jw.weight = w;
-
-                sw.weightValues.push_back(jw);
-
-                size_t n = strspn(token, " \t\r");
-                token += n;
+                if (needed) {
+                    StoreNormal(sum, out + 3 * slot);
+                    const int normal_index = num_vn + static_cast<int>(slot);
+                    for (size_t g = group_begin; g <= c; g++) {
+                        const normal_face_t& face = faces[corners[g].face];
+                        index_t& idx = (*shapes)[face.shape].mesh.indices[face.offset + corners[g].corner];
+                        if (CornerNeedsNormal(idx, num_vn, overwrite)) {
+                            idx.normal_index = normal_index;
+                        }
+                    }
+                    slot++;
+                }
+                group_begin = c + 1;
             }
+        }
+    });
 
-            vw.push_back(sw);
+    parallelFor(num_face_blocks, num_threads, [&](size_t b) {
+        const size_t face_end = std::min(faces.size(), (b + 1) * kNormalBlockSize);
+        for (size_t f = b * kNormalBlockSize; f < face_end; f++) {
+            const normal_face_t& face = faces[f];
+            if (!face.valid || !face.needs_normals || face.smoothing_group_id != 0) {
+                continue;
+            }
+            StoreNormal(face.normal, out + 3 * flat_normal[f]);
+            index_t* idx = &(*shapes)[face.shape].mesh.indices[face.offset];
+            for (unsigned int k = 0; k < face.num_vertices; k++) {
+                if (CornerNeedsNormal(idx[k], num_vn, overwrite)) {
+                    idx[k].normal_index = num_vn + static_cast<int>(flat_normal[f]);
+                }
+            }
         }
+    });
 
-        warning_context context;
-        context.warn = warn;
-        context.line_number = line_num;
+    return ret;
+}
 
-        // line
-        if (token[0] == 'l' && IS_SPACE((token[1]))) {
-            token += 2;
+// Tangent contribution of a triangle corner(`GenerateTangents`). Stored as
+// float to keep the per corner array small; the sums are in double.
+struct tangent_corner_t {
+    float tangent[3];  // projected tangent, weighted by the corner angle
+    float weight;      // corner angle(0 = no contribution)
+    bool orientation_preserving;
+};
 
-            __line_t line;
+static inline double Dot3(const double* a, const double* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
 
-            while (!IS_NEW_LINE(token[0])) {
-                vertex_index_t vi;
-                if (!parseTriple(&token, static_cast<int>(v.size() / 3), static_cast<int>(vn.size() / 3), static_cast<int>(vt.size() / 2),
-                        &vi, context)) {
-                    if (err) {
-                        (*err) += "Failed to parse `l' line (e.g. a zero value for vertex index. Line " + toString(line_num) + ").\n";
-                    }
-                    return false;
-                }
+// Removes the component along the unit vector `n` and normalizes. Returns
+// false for a zero result.
+static inline bool ProjectToPlane(double* v, const double* n) {
+    const double d = Dot3(v, n);
+    for (int i = 0; i < 3; i++) {
+        v[i] -= d * n[i];
+    }
+    const double len = std::sqrt(Dot3(v, v));
+    if (!(len > 0.0)) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        v[i] /= len;
+    }
+    return true;
+}
 
-                line.vertex_indices.push_back(vi);
+// MikkTSpace's per triangle tangent(`InitTriInfo`) and per corner weight
+// (`EvalTspace`) for the triangle `tri` of `mesh`.
+static void EvalTriangleTangents(const indexed_mesh_t& mesh, const unsigned int* tri, tangent_corner_t* corners) {
+    const real_t* vtx[3];
+    for (int k = 0; k < 3; k++) {
+        vtx[k] = &mesh.vertices[static_cast<size_t>(tri[k]) * mesh.vertex_stride];
+        corners[k].tangent[0] = corners[k].tangent[1] = corners[k].tangent[2] = 0.0f;
+        corners[k].weight = 0.0f;
+        corners[k].orientation_preserving = true;
+    }
 
-                size_t n = strspn(token, " \t\r");
-                token += n;
-            }
+    const real_t* t1 = vtx[0] + mesh.texcoord_offset;
+    const real_t* t2 = vtx[1] + mesh.texcoord_offset;
+    const real_t* t3 = vtx[2] + mesh.texcoord_offset;
+    const double t21x = static_cast<double>(t2[0]) - t1[0];
+    const double t21y = static_cast<double>(t2[1]) - t1[1];
+    const double t31x = static_cast<double>(t3[0]) - t1[0];
+    const double t31y = static_cast<double>(t3[1]) - t1[1];
+    const double signed_area_st_x2 = t21x * t31y - t21y * t31x;
+    if (!(std::fabs(signed_area_st_x2) > static_cast<double>(std::numeric_limits<float>::min()))) {
+        return;  // Degenerate in texture space.
+    }
 
-            prim_group.lineGroup.push_back(line);
+    // `os` is dP/du scaled by `signed_area_st_x2`; the sign is removed so
+    // mirrored triangles point along dP/du too.
+    const bool orientation_preserving = signed_area_st_x2 > 0.0;
+    const double fs = orientation_preserving ? 1.0 : -1.0;
+    double os[3];
+    for (int i = 0; i < 3; i++) {
+        const double d1 = static_cast<double>(vtx[1][i]) - vtx[0][i];
+        const double d2 = static_cast<double>(vtx[2][i]) - vtx[0][i];
+        os[i] = fs * (t31y * d1 - t21y * d2);
+    }
 
+    for (int k = 0; k < 3; k++) {
+        const real_t* p0 = vtx[(k + 2) % 3];
+        const real_t* p1 = vtx[k];
+        const real_t* p2 = vtx[(k + 1) % 3];
+        const real_t* nr = p1 + mesh.normal_offset;
+        double n[3] = {nr[0], nr[1], nr[2]};
+        const double nlen = std::sqrt(Dot3(n, n));
+        if (!(nlen > 0.0)) {
             continue;
         }
+        for (int i = 0; i < 3; i++) {
+            n[i] /= nlen;
+        }
 
-        // points
-        if (token[0] == 'p' && IS_SPACE((token[1]))) {
-            token += 2;
+        double tangent[3] = {os[0], os[1], os[2]};
+        double e1[3], e2[3];
+        for (int i = 0; i < 3; i++) {
+            e1[i] = static_cast<double>(p0[i]) - p1[i];
+            e2[i] = static_cast<double>(p2[i]) - p1[i];
+        }
+        if (!ProjectToPlane(tangent, n) || !ProjectToPlane(e1, n) || !ProjectToPlane(e2, n)) {
+            continue;
+        }
+        const double c = std::max(-1.0, std::min(1.0, Dot3(e1, e2)));
+        const double angle = std::acos(c);
+        for (int i = 0; i < 3; i++) {
+            corners[k].tangent[i] = static_cast<float>(tangent[i] * angle);
+        }
+        corners[k].weight = static_cast<float>(angle);
+        corners[k].orientation_preserving = orientation_preserving;
+    }
+}
 
-            __points_t pts;
+// A tangent perpendicular to the unit normal `n`, for vertices without a
+// usable texture space.
+static void AnyTangent(const double* n, double* t) {
+    const double axis[3] = {std::fabs(n[0]) < 0.9 ? 1.0 : 0.0, std::fabs(n[0]) < 0.9 ? 0.0 : 1.0, 0.0};
+    t[0] = axis[0];
+    t[1] = axis[1];
+    t[2] = axis[2];
+    if (!ProjectToPlane(t, n)) {
+        t[0] = 1.0;
+        t[1] = t[2] = 0.0;
+    }
+}
 
-            while (!IS_NEW_LINE(token[0])) {
-                vertex_index_t vi;
-                if (!parseTriple(&token, static_cast<int>(v.size() / 3), static_cast<int>(vn.size() / 3), static_cast<int>(vt.size() / 2),
-                        &vi, context)) {
-                    if (err) {
-                        (*err) += "Failed to parse `p' line (e.g. a zero value for vertex index. Line " + toString(line_num) + ").\n";
-                    }
-                    return false;
+bool GenerateTangents(indexed_mesh_t* indexed_mesh, const shape_t& shape, unsigned int num_threads) {
+    indexed_mesh_t& mesh = (*indexed_mesh);
+    mesh.tangents.clear();
+    if (mesh.normal_offset < 0 || mesh.texcoord_offset < 0) {
+        return false;
+    }
+    num_threads = ResolveNumThreads(num_threads);
+
+    // Triangle fans of the faces, as the first corner of each triangle.
+    const std::vector<unsigned char>& num_face_vertices = shape.mesh.num_face_vertices;
+    std::vector<size_t> face_offsets(num_face_vertices.size() + 1, 0);
+    std::vector<size_t> face_triangles(num_face_vertices.size() + 1, 0);
+    for (size_t f = 0; f < num_face_vertices.size(); f++) {
+        const size_t n = num_face_vertices[f];
+        face_offsets[f + 1] = face_offsets[f] + n;
+        face_triangles[f + 1] = face_triangles[f] + (n >= 3 ? n - 2 : 0);
+    }
+    if (face_offsets.back() > mesh.indices.size()) {
+        return false;
+    }
+    const size_t num_triangles = face_triangles.back();
+
+    // Corner contributions(parallel over faces).
+    std::vector<tangent_corner_t> corners(3 * num_triangles);
+    std::vector<unsigned int> corner_vertices(3 * num_triangles);
+    const size_t num_face_blocks = (num_face_vertices.size() + kNormalBlockSize - 1) / kNormalBlockSize;
+    parallelFor(num_face_blocks, num_threads, [&](size_t b) {
+        const size_t face_end = std::min(num_face_vertices.size(), (b + 1) * kNormalBlockSize);
+        for (size_t f = b * kNormalBlockSize; f < face_end; f++) {
+            const unsigned int* face = mesh.indices.empty() ? NULL : &mesh.indices[face_offsets[f]];
+            size_t t = face_triangles[f];
+            for (size_t k = 1; k + 1 < num_face_vertices[f]; k++, t++) {
+                const unsigned int tri[3] = {face[0], face[k], face[k + 1]};
+                EvalTriangleTangents(mesh, tri, &corners[3 * t]);
+                for (int c = 0; c < 3; c++) {
+                    corner_vertices[3 * t + c] = tri[c];
                 }
-
-                pts.vertex_indices.push_back(vi);
-
-                size_t n = strspn(token, " \t\r");
-                token += n;
             }
-
-            prim_group.pointsGroup.push_back(pts);
-
-            continue;
         }
+    });
+
+    // Bucket the corners by vertex(counting sort in corner order), then
+    // gather each vertex in one task.
+    const size_t num_vertices = mesh.num_vertices();
+    std::vector<size_t> bucket_begin(num_vertices + 1, 0);
+    for (size_t c = 0; c < corner_vertices.size(); c++) {
+        bucket_begin[corner_vertices[c] + 1]++;
+    }
+    for (size_t i = 0; i < num_vertices; i++) {
+        bucket_begin[i + 1] += bucket_begin[i];
+    }
+    std::vector<size_t> bucket_corners(corner_vertices.size());
+    {
+        std::vector<size_t> fill(bucket_begin.begin(), bucket_begin.end() - 1);
+        for (size_t c = 0; c < corner_vertices.size(); c++) {
+            bucket_corners[fill[corner_vertices[c]]++] = c;
+        }
+    }
 
-        // face
-        if (token[0] == 'f' && IS_SPACE((token[1]))) {
-            token += 2;
-            token += strspn(token, " \t");
-
-            face_t face;
-
-            face.smoothing_group_id = current_smoothing_id;
-            face.vertex_indices.reserve(3);
-
-            while (!IS_NEW_LINE(token[0])) {
-                vertex_index_t vi;
-                if (!parseTriple(&token, static_cast<int>(v.size() / 3), static_cast<int>(vn.size() / 3), static_cast<int>(vt.size() / 2),
-                        &vi, context)) {
-                    if (err) {
-                        (*err) += "Failed to parse `f' line (e.g. a zero value for vertex index or invalid relative vertex index). Line " +
-                                  toString(line_num) + ").\n";
-                    }
-                    return false;
+    mesh.tangents.resize(4 * num_vertices);
+    const size_t num_vertex_blocks = (num_vertices + kNormalBlockSize - 1) / kNormalBlockSize;
+    parallelFor(num_vertex_blocks, num_threads, [&](size_t b) {
+        const size_t vertex_end = std::min(num_vertices, (b + 1) * kNormalBlockSize);
+        for (size_t i = b * kNormalBlockSize; i < vertex_end; i++) {
+            // [0] = orientation preserving, [1] = flipped.
+            double sum[2][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+            double weight[2] = {0.0, 0.0};
+            for (size_t j = bucket_begin[i]; j < bucket_begin[i + 1]; j++) {
+                const tangent_corner_t& corner = corners[bucket_corners[j]];
+                const int o = corner.orientation_preserving ? 0 : 1;
+                for (int k = 0; k < 3; k++) {
+                    sum[o][k] += corner.tangent[k];
                 }
-
-                greatest_v_idx = greatest_v_idx > vi.v_idx ? greatest_v_idx : vi.v_idx;
-                greatest_vn_idx = greatest_vn_idx > vi.vn_idx ? greatest_vn_idx : vi.vn_idx;
-                greatest_vt_idx = greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
-
-                face.vertex_indices.push_back(vi);
-                size_t n = strspn(token, " \t\r");
-                token += n;
+                weight[o] += corner.weight;
             }
+            const int o = weight[1] > weight[0] ? 1 : 0;
 
-            // replace with emplace_back + std::move on C++11
-            prim_group.faceGroup.push_back(face);
+            const real_t* nr = &mesh.vertices[i * mesh.vertex_stride + mesh.normal_offset];
+            double n[3] = {nr[0], nr[1], nr[2]};
+            const double nlen = std::sqrt(Dot3(n, n));
+            for (int k = 0; k < 3; k++) {
+                n[k] = nlen > 0.0 ? n[k] / nlen : (k == 2 ? 1.0 : 0.0);
+            }
+            double t[3] = {sum[o][0], sum[o][1], sum[o][2]};
+            if (!(weight[o] > 0.0) || !ProjectToPlane(t, n)) {
+                AnyTangent(n, t);
+            }
 
-            continue;
+            real_t* out = &mesh.tangents[4 * i];
+            out[0] = static_cast<real_t>(t[0]);
+            out[1] = static_cast<real_t>(t[1]);
+            out[2] = static_cast<real_t>(t[2]);
+            out[3] = static_cast<real_t>(o == 0 ? 1.0 : -1.0);
         }
+    });
 
-        // use mtl
-        if ((0 == strncmp(token, "usemtl", 6))) {
-            token += 6;
-            std::string namebuf = parseString(&token);
-
-            int newMaterialId = -1;
-            std::map<std::string, int>::const_iterator it = material_map.find(namebuf);
-            if (it != material_map.end()) {
-                newMaterialId = it->second;
-            } else {
-                // { error!! material not found }
-                if (warn) {
-                    (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
-                }
-            }
+    return true;
+}
 
-            if (newMaterialId != material) {
-                // Create per-face material. Thus we don't add `shape` to `shapes` at
-                // this time.
-                // just clear `faceGroup` after `exportGroupsToShape()` call.
-                exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn);
-                prim_group.faceGroup.clear();
-                material = newMaterialId;
-            }
+vertex_cache_stats_t AnalyzeVertexCache(const indexed_mesh_t& indexed_mesh, unsigned int cache_size) {
+    vertex_cache_stats_t stats;
+    const std::vector<unsigned int>& indices = indexed_mesh.indices;
+    stats.num_triangles = indices.size() / 3;
+    if (stats.num_triangles == 0) {
+        return stats;
+    }
 
+    // A vertex is in the FIFO cache while fewer than `cache_size` misses
+    // happened since it was loaded.
+    std::vector<size_t> loaded_at(indexed_mesh.num_vertices(), 0);
+    std::vector<char> referenced(indexed_mesh.num_vertices(), 0);
+    size_t time = static_cast<size_t>(cache_size) + 1;
+    for (size_t i = 0; i < 3 * stats.num_triangles; i++) {
+        const unsigned int v = indices[i];
+        if (v >= loaded_at.size()) {
             continue;
         }
+        if (time - loaded_at[v] > cache_size) {
+            loaded_at[v] = time++;
+            stats.num_transformed++;
+        }
+        if (!referenced[v]) {
+            referenced[v] = 1;
+            stats.num_vertices++;
+        }
+    }
 
-        // load mtl
-        if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-            if (readMatFn) {
-                token += 7;
-
-                std::vector<std::string> filenames;
-                SplitString(std::string(token), ' ', '\\', filenames);
+    stats.acmr = static_cast<double>(stats.num_transformed) / static_cast<double>(stats.num_triangles);
+    stats.atvr = stats.num_vertices > 0 ? static_cast<double>(stats.num_transformed) / static_cast<double>(stats.num_vertices) : 0.0;
+    return stats;
+}
 
-                if (filenames.empty()) {
-                    if (warn) {
-                        std::stringstream ss;
-                        ss << "Looks like empty filename for mtllib. Use default "
-                              "material (line "
-                           << line_num << ".)\n";
+static const unsigned int kVertexCacheMaxSize = 64;
 
-                        (*warn) += ss.str();
-                    }
-                } else {
-                    bool found = false;
-                    for (size_t s = 0; s < filenames.size(); s++) {
-                        if (material_filenames.count(filenames[s]) > 0) {
-                            found = true;
-                            continue;
-                        }
+// Vertex score of Forsyth's algorithm. `cache_position` -1 = not in cache.
+static float VertexCacheScore(int cache_position, unsigned int remaining_triangles, unsigned int cache_size) {
+    if (remaining_triangles == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // The vertices of the last triangle get a fixed score, so the
+            // next triangle does not simply reuse its edge.
+            score = 0.75f;
+        } else {
+            const float scale = 1.0f / static_cast<float>(cache_size - 3);
+            score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scale, 1.5f);
+        }
+    }
+    // Boost vertices with few triangles left, to finish them off.
+    score += 2.0f / std::sqrt(static_cast<float>(remaining_triangles));
+    return score;
+}
 
-                        std::string warn_mtl;
-                        std::string err_mtl;
-                        bool ok = (*readMatFn)(filenames[s].c_str(), materials, &material_map, &warn_mtl, &err_mtl);
-                        if (warn && (!warn_mtl.empty())) {
-                            (*warn) += warn_mtl;
-                        }
+bool OptimizeVertexCache(indexed_mesh_t* indexed_mesh, shape_t* shape, unsigned int cache_size) {
+    mesh_t& mesh = shape->mesh;
+    const size_t num_triangles = mesh.num_face_vertices.size();
+    for (size_t f = 0; f < num_triangles; f++) {
+        if (mesh.num_face_vertices[f] != 3) {
+            return false;
+        }
+    }
+    std::vector<unsigned int>& indices = indexed_mesh->indices;
+    const size_t num_vertices = indexed_mesh->num_vertices();
+    if (indices.size() != 3 * num_triangles || mesh.indices.size() != 3 * num_triangles) {
+        return false;
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] >= num_vertices) {
+            return false;
+        }
+    }
+    cache_size = std::max(4u, std::min(cache_size, kVertexCacheMaxSize));
 
-                        if (err && (!err_mtl.empty())) {
-                            (*err) += err_mtl;
-                        }
+    // Triangles of each vertex. The first `remaining[v]` entries of a
+    // vertex's list are the triangles not emitted yet.
+    std::vector<size_t> triangles_begin(num_vertices + 1, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        triangles_begin[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < num_vertices; v++) {
+        triangles_begin[v + 1] += triangles_begin[v];
+    }
+    std::vector<unsigned int> remaining(num_vertices, 0);
+    std::vector<size_t> vertex_triangles(indices.size());
+    for (size_t t = 0; t < num_triangles; t++) {
+        for (int k = 0; k < 3; k++) {
+            const unsigned int v = indices[3 * t + k];
+            vertex_triangles[triangles_begin[v] + remaining[v]++] = t;
+        }
+    }
 
-                        if (ok) {
-                            found = true;
-                            material_filenames.insert(filenames[s]);
-                            break;
-                        }
-                    }
+    std::vector<int> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; v++) {
+        vertex_score[v] = VertexCacheScore(-1, remaining[v], cache_size);
+    }
+    std::vector<float> triangle_score(num_triangles);
+    std::vector<char> emitted(num_triangles, 0);
+    for (size_t t = 0; t < num_triangles; t++) {
+        triangle_score[t] = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+    }
 
-                    if (!found) {
-                        if (warn) {
-                            (*warn) += "Failed to load material file(s). Use default "
-                                       "material.\n";
-                        }
-                    }
+    std::vector<size_t> order;
+    order.reserve(num_triangles);
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> new_cache;
+    cache.reserve(cache_size + 3);
+    new_cache.reserve(cache_size + 3);
+    size_t cursor = 0;  // next candidate when no cached vertex has triangles left
+    size_t best = num_triangles;
+    while (order.size() < num_triangles) {
+        if (best == num_triangles) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+        emitted[best] = 1;
+        order.push_back(best);
+
+        // Remove the triangle from its vertices and put them in front of
+        // the LRU cache.
+        new_cache.clear();
+        for (int k = 0; k < 3; k++) {
+            const unsigned int v = indices[3 * best + k];
+            size_t* list = &vertex_triangles[triangles_begin[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++) {
+                if (list[i] == best) {
+                    std::swap(list[i], list[remaining[v] - 1]);
+                    break;
                 }
             }
-
-            continue;
+            remaining[v]--;
+            new_cache.push_back(v);
+        }
+        for (size_t i = 0; i < cache.size(); i++) {
+            const unsigned int v = cache[i];
+            if (v != new_cache[0] && v != new_cache[1] && v != new_cache[2]) {
+                new_cache.push_back(v);
+            }
+        }
+        // Vertices pushed out of the cache lose their cache score.
+        for (size_t i = cache_size; i < new_cache.size(); i++) {
+            const unsigned int v = new_cache[i];
+            cache_position[v] = -1;
+            vertex_score[v] = VertexCacheScore(-1, remaining[v], cache_size);
         }
+        if (new_cache.size() > cache_size) {
+            new_cache.resize(cache_size);
+        }
+        cache.swap(new_cache);
+
+        // Rescore the cached vertices and their triangles, and pick the best
+        // triangle among them.
+        for (size_t i = 0; i < cache.size(); i++) {
+            const unsigned int v = cache[i];
+            cache_position[v] = static_cast<int>(i);
+            vertex_score[v] = VertexCacheScore(static_cast<int>(i), remaining[v], cache_size);
+        }
+        best = num_triangles;
+        float best_score = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++) {
+            const unsigned int v = cache[i];
+            const size_t* list = &vertex_triangles[triangles_begin[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++) {
+                const size_t t = list[j];
+                const float score =
+                    vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+                triangle_score[t] = score;
+                if (score > best_score) {
+                    best_score = score;
+                    best = t;
+                }
+            }
+        }
+    }
 
-        // group name
-        if (token[0] == 'g' && IS_SPACE((token[1]))) {
-            // flush previous face group.
-            bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn);
-            (void)ret;  // return value not used.
+    // Reorder the triangles and the per face arrays of the shape.
+    std::vector<unsigned int> new_indices(indices.size());
+    std::vector<index_t> new_mesh_indices(mesh.indices.size());
+    for (size_t i = 0; i < num_triangles; i++) {
+        for (int k = 0; k < 3; k++) {
+            new_indices[3 * i + k] = indices[3 * order[i] + k];
+            new_mesh_indices[3 * i + k] = mesh.indices[3 * order[i] + k];
+        }
+    }
+    mesh.indices.swap(new_mesh_indices);
+    if (mesh.material_ids.size() == num_triangles) {
+        std::vector<int> material_ids(num_triangles);
+        for (size_t i = 0; i < num_triangles; i++) {
+            material_ids[i] = mesh.material_ids[order[i]];
+        }
+        mesh.material_ids.swap(material_ids);
+    }
+    if (mesh.smoothing_group_ids.size() == num_triangles) {
+        std::vector<unsigned int> smoothing_group_ids(num_triangles);
+        for (size_t i = 0; i < num_triangles; i++) {
+            smoothing_group_ids[i] = mesh.smoothing_group_ids[order[i]];
+        }
+        mesh.smoothing_group_ids.swap(smoothing_group_ids);
+    }
 
-            if (shape.mesh.indices.size() > 0) {
-                shapes->push_back(shape);
-            }
+    // Renumber the vertices in first-use order(unused vertices go last).
+    const unsigned int kUnassigned = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(num_vertices, kUnassigned);
+    unsigned int next_vertex = 0;
+    for (size_t i = 0; i < new_indices.size(); i++) {
+        unsigned int& r = remap[new_indices[i]];
+        if (r == kUnassigned) {
+            r = next_vertex++;
+        }
+        new_indices[i] = r;
+    }
+    for (size_t v = 0; v < num_vertices; v++) {
+        if (remap[v] == kUnassigned) {
+            remap[v] = next_vertex++;
+        }
+    }
+    indices.swap(new_indices);
+
+    const size_t stride = static_cast<size_t>(indexed_mesh->vertex_stride);
+    std::vector<real_t> vertices(indexed_mesh->vertices.size());
+    std::vector<index_t> vertex_sources(num_vertices);
+    const bool has_tangents = indexed_mesh->tangents.size() == 4 * num_vertices;
+    std::vector<real_t> tangents(has_tangents ? 4 * num_vertices : 0);
+    for (size_t v = 0; v < num_vertices; v++) {
+        const size_t r = remap[v];
+        std::copy(indexed_mesh->vertices.begin() + v * stride, indexed_mesh->vertices.begin() + (v + 1) * stride, vertices.begin() + r * stride);
+        vertex_sources[r] = indexed_mesh->vertex_sources[v];
+        if (has_tangents) {
+            std::copy(indexed_mesh->tangents.begin() + 4 * v, indexed_mesh->tangents.begin() + 4 * (v + 1), tangents.begin() + 4 * r);
+        }
+    }
+    indexed_mesh->vertices.swap(vertices);
+    indexed_mesh->vertex_sources.swap(vertex_sources);
+    if (has_tangents) {
+        indexed_mesh->tangents.swap(tangents);
+    }
+    return true;
+}
 
-            shape = shape_t();
+// Symmetric 4x4 quadric of weighted squared plane distances, upper triangle
+// row by row: aa ab ac ad bb bc bd cc cd dd.
+struct simplify_quadric_t {
+    double m[10];
+};
 
-            // material = -1;
-            prim_group.clear();
+static void AddPlaneQuadric(simplify_quadric_t* q, const double n[3], double d, double weight) {
+    double* m = q->m;
+    m[0] += weight * n[0] * n[0];
+    m[1] += weight * n[0] * n[1];
+    m[2] += weight * n[0] * n[2];
+    m[3] += weight * n[0] * d;
+    m[4] += weight * n[1] * n[1];
+    m[5] += weight * n[1] * n[2];
+    m[6] += weight * n[1] * d;
+    m[7] += weight * n[2] * n[2];
+    m[8] += weight * n[2] * d;
+    m[9] += weight * d * d;
+}
 
-            std::vector<std::string> names;
+static double QuadricError(const simplify_quadric_t& q, const double p[3]) {
+    const double* m = q.m;
+    const double x = p[0], y = p[1], z = p[2];
+    const double e = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x + m[4] * y * y + 2.0 * m[5] * y * z +
+                     2.0 * m[6] * y + m[7] * z * z + 2.0 * m[8] * z + m[9];
+    return e > 0.0 ? e : 0.0;
+}
 
-            while (!IS_NEW_LINE(token[0])) {
-                std::string str = parseString(&token);
-                names.push_back(str);
-                token += strspn(token, " \t\r");  // skip tag
-            }
+// Boundary planes weigh more than surface planes, so borders and seams keep
+// their shape.
+static const double kSimplifyBoundaryWeight = 10.0;
+// Positions per spatial cell collapses are applied in.
+static const double kSimplifyCellPositions = 4096.0;
+
+enum simplify_vertex_kind_t {
+    SIMPLIFY_VERTEX_MANIFOLD,  // interior, collapses onto any neighbour
+    SIMPLIFY_VERTEX_BORDER,    // on an open border, collapses along it
+    SIMPLIFY_VERTEX_SEAM,      // on a UV seam or material boundary, collapses along it
+    SIMPLIFY_VERTEX_LOCKED     // corner or non-manifold, never collapses
+};
 
-            // names[0] must be 'g'
+// Edge between a position and one of its neighbours.
+struct simplify_edge_t {
+    unsigned int other;
+    unsigned int count;     // triangles on the edge
+    unsigned int triangle;  // first triangle on the edge
+    bool forward;           // the edge runs position -> other in `triangle`
+    bool manifold;          // at most two triangles, opposite orientations
+    bool seam;              // two triangles with different wedges or materials
+};
 
-            if (names.size() < 2) {
-                // 'g' with empty names
-                if (warn) {
-                    std::stringstream ss;
-                    ss << "Empty group name. line: " << line_num << "\n";
-                    (*warn) += ss.str();
-                    name = "";
-                }
-            } else {
-                std::stringstream ss;
-                ss << names[1];
+// Triangles of the mesh being simplified. A wedge is a welded vertex, a
+// position groups the wedges at the same point.
+struct simplify_mesh_t {
+    std::vector<unsigned int> triangle_wedges;     // 3 per triangle
+    std::vector<unsigned int> triangle_positions;  // 3 per triangle
+    std::vector<int> triangle_materials;
+    std::vector<size_t> position_begin;              // triangles of each position(CSR)
+    std::vector<unsigned int> position_triangles;
+    std::vector<double> positions;                 // 3 per position
+    std::vector<unsigned int> wedge_positions;
+
+    size_t num_triangles() const { return triangle_materials.size(); }
+
+    // Corner of triangle `t` at position `p`.
+    int Corner(size_t t, unsigned int p) const {
+        const unsigned int* tp = &triangle_positions[3 * t];
+        return tp[0] == p ? 0 : (tp[1] == p ? 1 : 2);
+    }
 
-                // tinyobjloader does not support multiple groups for a primitive.
-                // Currently we concatinate multiple group names with a space to get
-                // single group name.
+    void BuildAdjacency() {
+        const size_t num_positions = positions.size() / 3;
+        position_begin.assign(num_positions + 1, 0);
+        for (size_t i = 0; i < triangle_positions.size(); i++) {
+            position_begin[triangle_positions[i] + 1]++;
+        }
+        for (size_t p = 0; p < num_positions; p++) {
+            position_begin[p + 1] += position_begin[p];
+        }
+        position_triangles.resize(triangle_positions.size());
+        std::vector<size_t> fill(position_begin.begin(), position_begin.end() - 1);
+        for (size_t i = 0; i < triangle_positions.size(); i++) {
+            position_triangles[fill[triangle_positions[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    }
+};
 
-                for (size_t i = 2; i < names.size(); i++) {
-                    ss << " " << names[i];
+// Collects the edges of position `p` and classifies it.
+static simplify_vertex_kind_t ClassifySimplifyVertex(const simplify_mesh_t& mesh, unsigned int p, std::vector<simplify_edge_t>* edges) {
+    edges->clear();
+    for (size_t i = mesh.position_begin[p]; i < mesh.position_begin[p + 1]; i++) {
+        const unsigned int t = mesh.position_triangles[i];
+        const int k = mesh.Corner(t, p);
+        for (int dir = 0; dir < 2; dir++) {
+            const int other_corner = (k + 1 + dir) % 3;
+            const unsigned int other = mesh.triangle_positions[3 * t + other_corner];
+            const bool forward = dir == 0;
+            simplify_edge_t* edge = NULL;
+            for (size_t e = 0; e < edges->size(); e++) {
+                if ((*edges)[e].other == other) {
+                    edge = &(*edges)[e];
+                    break;
                 }
-
-                name = ss.str();
             }
-
-            continue;
+            if (!edge) {
+                simplify_edge_t e;
+                e.other = other;
+                e.count = 1;
+                e.triangle = t;
+                e.forward = forward;
+                e.manifold = true;
+                e.seam = false;
+                edges->push_back(e);
+                continue;
+            }
+            edge->count++;
+            if (edge->count > 2 || edge->forward == forward) {
+                edge->manifold = false;
+                continue;
+            }
+            const size_t t0 = edge->triangle;
+            const int k0 = mesh.Corner(t0, p);
+            const int other0 = mesh.Corner(t0, other);
+            edge->seam = mesh.triangle_wedges[3 * t0 + k0] != mesh.triangle_wedges[3 * t + k] ||
+                         mesh.triangle_wedges[3 * t0 + other0] != mesh.triangle_wedges[3 * t + other_corner] ||
+                         mesh.triangle_materials[t0] != mesh.triangle_materials[t];
         }
+    }
 
-        // object name
-        if (token[0] == 'o' && IS_SPACE((token[1]))) {
-            // flush previous face group.
-            bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn);
-            (void)ret;  // return value not used.
+    int num_border = 0;
+    int num_seam = 0;
+    for (size_t e = 0; e < edges->size(); e++) {
+        const simplify_edge_t& edge = (*edges)[e];
+        if (!edge.manifold) {
+            return SIMPLIFY_VERTEX_LOCKED;
+        }
+        num_border += edge.count == 1 ? 1 : 0;
+        num_seam += edge.seam ? 1 : 0;
+    }
+    if (num_border == 0 && num_seam == 0) {
+        return SIMPLIFY_VERTEX_MANIFOLD;
+    }
+    if (num_border == 2 && num_seam == 0) {
+        return SIMPLIFY_VERTEX_BORDER;
+    }
+    if (num_border == 0 && num_seam == 2) {
+        return SIMPLIFY_VERTEX_SEAM;
+    }
+    return SIMPLIFY_VERTEX_LOCKED;
+}
 
-            if (shape.mesh.indices.size() > 0 || shape.lines.indices.size() > 0 || shape.points.indices.size() > 0) {
-                shapes->push_back(shape);
+// Maps each wedge of `p` to the wedge of `q` it shares an edge triangle
+// with. Fails when a wedge has no such partner or more than one.
+static bool MapCollapseWedges(const simplify_mesh_t& mesh, unsigned int p, unsigned int q,
+    std::vector<std::pair<unsigned int, unsigned int> >* wedge_map) {
+    wedge_map->clear();
+    for (size_t i = mesh.position_begin[p]; i < mesh.position_begin[p + 1]; i++) {
+        const unsigned int t = mesh.position_triangles[i];
+        const unsigned int* tp = &mesh.triangle_positions[3 * t];
+        if (tp[0] != q && tp[1] != q && tp[2] != q) {
+            continue;
+        }
+        const unsigned int wp = mesh.triangle_wedges[3 * t + mesh.Corner(t, p)];
+        const unsigned int wq = mesh.triangle_wedges[3 * t + mesh.Corner(t, q)];
+        bool found = false;
+        for (size_t m = 0; m < wedge_map->size(); m++) {
+            if ((*wedge_map)[m].first == wp) {
+                if ((*wedge_map)[m].second != wq) {
+                    return false;
+                }
+                found = true;
             }
+        }
+        if (!found) {
+            wedge_map->push_back(std::make_pair(wp, wq));
+        }
+    }
+    for (size_t i = mesh.position_begin[p]; i < mesh.position_begin[p + 1]; i++) {
+        const unsigned int t = mesh.position_triangles[i];
+        const unsigned int wp = mesh.triangle_wedges[3 * t + mesh.Corner(t, p)];
+        bool found = false;
+        for (size_t m = 0; m < wedge_map->size() && !found; m++) {
+            found = (*wedge_map)[m].first == wp;
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
 
-            // material = -1;
-            prim_group.clear();
-            shape = shape_t();
+static void TriangleCross(const double* a, const double* b, const double* c, double n[3]) {
+    const double e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const double e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
 
-            // @todo { multiple object name? }
-            token += 2;
-            std::stringstream ss;
-            ss << token;
-            name = ss.str();
+// Whether collapsing `p` onto `q` keeps the topology(link condition) and
+// does not flip any remaining triangle of `p`.
+static bool IsCollapseValid(const simplify_mesh_t& mesh, unsigned int p, const simplify_edge_t& edge,
+    const std::vector<simplify_edge_t>& edges, std::vector<unsigned int>* scratch) {
+    const unsigned int q = edge.other;
+    std::vector<unsigned int>& q_neighbours = *scratch;
+    q_neighbours.clear();
+    for (size_t i = mesh.position_begin[q]; i < mesh.position_begin[q + 1]; i++) {
+        const unsigned int* tp = &mesh.triangle_positions[3 * mesh.position_triangles[i]];
+        for (int k = 0; k < 3; k++) {
+            if (tp[k] != q) {
+                q_neighbours.push_back(tp[k]);
+            }
+        }
+    }
+    unsigned int num_common = 0;
+    for (size_t e = 0; e < edges.size(); e++) {
+        if (edges[e].other != q && std::find(q_neighbours.begin(), q_neighbours.end(), edges[e].other) != q_neighbours.end()) {
+            num_common++;
+        }
+    }
+    if (num_common > edge.count) {
+        return false;
+    }
 
+    const double* pp = &mesh.positions[3 * p];
+    const double* pq = &mesh.positions[3 * q];
+    for (size_t i = mesh.position_begin[p]; i < mesh.position_begin[p + 1]; i++) {
+        const unsigned int t = mesh.position_triangles[i];
+        const unsigned int* tp = &mesh.triangle_positions[3 * t];
+        if (tp[0] == q || tp[1] == q || tp[2] == q) {
             continue;
         }
+        const int k = mesh.Corner(t, p);
+        const double* a = &mesh.positions[3 * tp[(k + 1) % 3]];
+        const double* b = &mesh.positions[3 * tp[(k + 2) % 3]];
+        double n0[3], n1[3];
+        TriangleCross(pp, a, b, n0);
+        TriangleCross(pq, a, b, n1);
+        const double d = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        const double l0 = std::sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+        const double l1 = std::sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+        if (d <= 0.1 * l0 * l1) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        if (token[0] == 't' && IS_SPACE(token[1])) {
-            const int max_tag_nums = 8192;  // FIXME(syoyo): Parameterize.
-            tag_t tag;
-
-            token += 2;
-
-            tag.name = parseString(&token);
-
-            tag_sizes ts = parseTagTriple(&token);
-
-            if (ts.num_ints < 0) {
-                ts.num_ints = 0;
+bool SimplifyIndexedMesh(const indexed_mesh_t& indexed_mesh, const shape_t& shape, double target_ratio, indexed_mesh_t* lod_mesh,
+    shape_t* lod_shape, unsigned int num_threads) {
+    const mesh_t& src = shape.mesh;
+    const size_t num_faces = src.num_face_vertices.size();
+    const size_t num_wedges = indexed_mesh.num_vertices();
+    for (size_t f = 0; f < num_faces; f++) {
+        if (src.num_face_vertices[f] != 3) {
+            return false;
+        }
+    }
+    if (indexed_mesh.indices.size() != 3 * num_faces) {
+        return false;
+    }
+    for (size_t i = 0; i < indexed_mesh.indices.size(); i++) {
+        if (indexed_mesh.indices[i] >= num_wedges) {
+            return false;
+        }
+    }
+    num_threads = ResolveNumThreads(num_threads);
+    const size_t stride = static_cast<size_t>(indexed_mesh.vertex_stride);
+    const bool has_materials = src.material_ids.size() == num_faces;
+    const bool has_smoothing_groups = src.smoothing_group_ids.size() == num_faces;
+
+    // Group the wedges by position.
+    simplify_mesh_t mesh;
+    {
+        std::vector<unsigned int> order(num_wedges);
+        for (size_t w = 0; w < num_wedges; w++) {
+            order[w] = static_cast<unsigned int>(w);
+        }
+        const real_t* v = indexed_mesh.vertices.empty() ? NULL : &indexed_mesh.vertices[0];
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            for (int c = 0; c < 3; c++) {
+                if (v[a * stride + c] != v[b * stride + c]) {
+                    return v[a * stride + c] < v[b * stride + c];
+                }
             }
-            if (ts.num_ints > max_tag_nums) {
-                ts.num_ints = max_tag_nums;
+            return a < b;
+        });
+        mesh.wedge_positions.resize(num_wedges);
+        for (size_t i = 0; i < num_wedges; i++) {
+            const unsigned int w = order[i];
+            if (i == 0 || v[w * stride] != v[order[i - 1] * stride] || v[w * stride + 1] != v[order[i - 1] * stride + 1] ||
+                v[w * stride + 2] != v[order[i - 1] * stride + 2]) {
+                for (int c = 0; c < 3; c++) {
+                    mesh.positions.push_back(static_cast<double>(v[w * stride + c]));
+                }
             }
-
-            if (ts.num_reals < 0) {
-                ts.num_reals = 0;
+            mesh.wedge_positions[w] = static_cast<unsigned int>(mesh.positions.size() / 3 - 1);
+        }
+    }
+    const size_t num_positions = mesh.positions.size() / 3;
+
+    // Triangles, without the ones already degenerate at the position level.
+    std::vector<unsigned int> triangle_sources;  // source face of each triangle
+    mesh.triangle_wedges.reserve(3 * num_faces);
+    mesh.triangle_positions.reserve(3 * num_faces);
+    mesh.triangle_materials.reserve(num_faces);
+    triangle_sources.reserve(num_faces);
+    for (size_t f = 0; f < num_faces; f++) {
+        const unsigned int* w = &indexed_mesh.indices[3 * f];
+        const unsigned int p0 = mesh.wedge_positions[w[0]], p1 = mesh.wedge_positions[w[1]], p2 = mesh.wedge_positions[w[2]];
+        if (p0 == p1 || p1 == p2 || p2 == p0) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            mesh.triangle_wedges.push_back(w[k]);
+        }
+        mesh.triangle_positions.push_back(p0);
+        mesh.triangle_positions.push_back(p1);
+        mesh.triangle_positions.push_back(p2);
+        mesh.triangle_materials.push_back(has_materials ? src.material_ids[f] : 0);
+        triangle_sources.push_back(static_cast<unsigned int>(f));
+    }
+    mesh.BuildAdjacency();
+
+    // Quadric of each position: the planes of its triangles weighted by
+    // area, plus planes through its border and seam edges.
+    std::vector<simplify_quadric_t> quadrics(num_positions);
+    const size_t num_position_blocks = (num_positions + kNormalBlockSize - 1) / kNormalBlockSize;
+    parallelFor(num_position_blocks, num_threads, [&](size_t b) {
+        std::vector<simplify_edge_t> edges;
+        const size_t position_end = std::min(num_positions, (b + 1) * kNormalBlockSize);
+        for (size_t p = b * kNormalBlockSize; p < position_end; p++) {
+            simplify_quadric_t& q = quadrics[p];
+            std::fill(q.m, q.m + 10, 0.0);
+            const double* pp = &mesh.positions[3 * p];
+            for (size_t i = mesh.position_begin[p]; i < mesh.position_begin[p + 1]; i++) {
+                const unsigned int* tp = &mesh.triangle_positions[3 * mesh.position_triangles[i]];
+                double n[3];
+                TriangleCross(&mesh.positions[3 * tp[0]], &mesh.positions[3 * tp[1]], &mesh.positions[3 * tp[2]], n);
+                const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (len > 0.0) {
+                    n[0] /= len, n[1] /= len, n[2] /= len;
+                    AddPlaneQuadric(&q, n, -(n[0] * pp[0] + n[1] * pp[1] + n[2] * pp[2]), 0.5 * len);
+                }
             }
-            if (ts.num_reals > max_tag_nums) {
-                ts.num_reals = max_tag_nums;
+            ClassifySimplifyVertex(mesh, static_cast<unsigned int>(p), &edges);
+            for (size_t e = 0; e < edges.size(); e++) {
+                if (edges[e].count != 1 && !edges[e].seam) {
+                    continue;
+                }
+                const unsigned int* tp = &mesh.triangle_positions[3 * edges[e].triangle];
+                const double* po = &mesh.positions[3 * edges[e].other];
+                const double edge[3] = {po[0] - pp[0], po[1] - pp[1], po[2] - pp[2]};
+                double fn[3], n[3];
+                TriangleCross(&mesh.positions[3 * tp[0]], &mesh.positions[3 * tp[1]], &mesh.positions[3 * tp[2]], fn);
+                n[0] = edge[1] * fn[2] - edge[2] * fn[1];
+                n[1] = edge[2] * fn[0] - edge[0] * fn[2];
+                n[2] = edge[0] * fn[1] - edge[1] * fn[0];
+                const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (len > 0.0) {
+                    n[0] /= len, n[1] /= len, n[2] /= len;
+                    const double edge_length2 = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+                    AddPlaneQuadric(&q, n, -(n[0] * pp[0] + n[1] * pp[1] + n[2] * pp[2]), kSimplifyBoundaryWeight * edge_length2);
+                }
             }
+        }
+    });
+
+    // Spatial cells: cubes sized for about kSimplifyCellPositions positions
+    // per cell on a surface spanning the bounding box.
+    double bmin[3] = {0.0, 0.0, 0.0}, bmax[3] = {0.0, 0.0, 0.0};
+    for (size_t p = 0; p < num_positions; p++) {
+        for (int c = 0; c < 3; c++) {
+            const double x = mesh.positions[3 * p + c];
+            bmin[c] = (p == 0 || x < bmin[c]) ? x : bmin[c];
+            bmax[c] = (p == 0 || x > bmax[c]) ? x : bmax[c];
+        }
+    }
+    const double extent = std::max(bmax[0] - bmin[0], std::max(bmax[1] - bmin[1], bmax[2] - bmin[2]));
+    const size_t grid = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(num_positions) / kSimplifyCellPositions)));
+    const double cell_scale = extent > 0.0 ? static_cast<double>(grid) / extent : 0.0;
+    const size_t cells_per_axis = grid + 1;  // shifted grids have one more cell
+    const size_t num_cells = cells_per_axis * cells_per_axis * cells_per_axis;
+
+    const size_t target_triangles = static_cast<size_t>(std::max(0.0, std::min(1.0, target_ratio)) * static_cast<double>(num_faces));
+    const double kNoCollapse = std::numeric_limits<double>::max();
+    std::vector<double> collapse_errors(num_positions);
+    std::vector<unsigned int> collapse_targets(num_positions);
+    std::vector<unsigned int> position_cells(num_positions);
+    std::vector<size_t> cell_begin(num_cells + 1);
+    std::vector<unsigned int> cell_positions;
+    std::vector<size_t> cell_collapses(num_cells);
+    std::vector<char> touched(num_positions);
+    std::vector<unsigned int> wedge_remap(num_wedges);
+    for (size_t w = 0; w < num_wedges; w++) {
+        wedge_remap[w] = static_cast<unsigned int>(w);
+    }
 
-            if (ts.num_strings < 0) {
-                ts.num_strings = 0;
+    int idle_passes = 0;
+    for (int pass = 0; mesh.num_triangles() > target_triangles && idle_passes < 2; pass++) {
+        // Cheapest valid collapse of each position. After the first pass only
+        // the positions whose neighbourhood or collapse target changed are
+        // evaluated again.
+        parallelFor(num_position_blocks, num_threads, [&](size_t b) {
+            std::vector<simplify_edge_t> edges;
+            std::vector<std::pair<unsigned int, unsigned int> > wedge_map;
+            std::vector<unsigned int> scratch;
+            std::vector<std::pair<double, size_t> > options;
+            const size_t position_end = std::min(num_positions, (b + 1) * kNormalBlockSize);
+            for (size_t p = b * kNormalBlockSize; p < position_end; p++) {
+                if (pass > 0 && !touched[p] && (collapse_errors[p] == kNoCollapse || !touched[collapse_targets[p]])) {
+                    continue;
+                }
+                collapse_errors[p] = kNoCollapse;
+                if (mesh.position_begin[p] == mesh.position_begin[p + 1]) {
+                    continue;
+                }
+                const unsigned int pi = static_cast<unsigned int>(p);
+                const simplify_vertex_kind_t kind = ClassifySimplifyVertex(mesh, pi, &edges);
+                if (kind == SIMPLIFY_VERTEX_LOCKED) {
+                    continue;
+                }
+                // Validate the allowed collapses cheapest first.
+                options.clear();
+                for (size_t e = 0; e < edges.size(); e++) {
+                    const simplify_edge_t& edge = edges[e];
+                    if ((kind == SIMPLIFY_VERTEX_BORDER && edge.count != 1) || (kind == SIMPLIFY_VERTEX_SEAM && !edge.seam)) {
+                        continue;
+                    }
+                    options.push_back(std::make_pair(QuadricError(quadrics[p], &mesh.positions[3 * edge.other]), e));
+                }
+                std::sort(options.begin(), options.end());
+                for (size_t o = 0; o < options.size(); o++) {
+                    const simplify_edge_t& edge = edges[options[o].second];
+                    if (MapCollapseWedges(mesh, pi, edge.other, &wedge_map) && IsCollapseValid(mesh, pi, edge, edges, &scratch)) {
+                        collapse_errors[p] = options[o].first;
+                        collapse_targets[p] = edge.other;
+                        break;
+                    }
+                }
             }
-            if (ts.num_strings > max_tag_nums) {
-                ts.num_strings = max_tag_nums;
+        });
+
+        // Each collapse removes about two triangles. Only the cheapest
+        // collapses that would reach the target are allowed, or a quarter of
+        // the candidates when fewer, so passes near the target still make
+        // progress(the cell goals bound the number of collapses).
+        const size_t remove_goal = mesh.num_triangles() - target_triangles;
+        std::vector<double> errors;
+        for (size_t p = 0; p < num_positions; p++) {
+            if (collapse_errors[p] != kNoCollapse) {
+                errors.push_back(collapse_errors[p]);
             }
+        }
+        double error_limit = kNoCollapse;
+        const size_t limit_rank = std::max((remove_goal + 1) / 2, errors.size() / 4);
+        if (limit_rank < errors.size()) {
+            std::nth_element(errors.begin(), errors.begin() + limit_rank, errors.end());
+            error_limit = errors[limit_rank];
+        }
 
-            tag.intValues.resize(static_cast<size_t>(ts.num_ints));
-
-            for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-                tag.intValues[i] = parseInt(&token);
+        // Assign the positions to cells, shifted by half a cell every other
+        // pass so cell borders do not stay locked.
+        const double shift = (pass & 1) ? 0.5 : 0.0;
+        std::fill(cell_begin.begin(), cell_begin.end(), 0);
+        for (size_t p = 0; p < num_positions; p++) {
+            size_t cell = 0;
+            for (int c = 2; c >= 0; c--) {
+                const double x = (mesh.positions[3 * p + c] - bmin[c]) * cell_scale + shift;
+                cell = cell * cells_per_axis + std::min(cells_per_axis - 1, static_cast<size_t>(std::max(0.0, x)));
             }
+            position_cells[p] = static_cast<unsigned int>(cell);
+            cell_begin[cell + 1]++;
+        }
+        for (size_t c = 0; c < num_cells; c++) {
+            cell_begin[c + 1] += cell_begin[c];
+        }
+        cell_positions.resize(num_positions);
+        {
+            std::vector<size_t> fill(cell_begin.begin(), cell_begin.end() - 1);
+            for (size_t p = 0; p < num_positions; p++) {
+                cell_positions[fill[position_cells[p]]++] = static_cast<unsigned int>(p);
+            }
+        }
 
-            tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
-            for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
-                tag.floatValues[i] = parseReal(&token);
+        // Apply the collapses of each cell, cheapest first. A collapse only
+        // touches the triangles around its position, so the positions whose
+        // neighbours all lie in the same cell are independent of other cells.
+        // A position whose neighbourhood changed waits for the next pass.
+        std::fill(touched.begin(), touched.end(), 0);
+        const double current_triangles = static_cast<double>(mesh.num_triangles());
+        parallelFor(num_cells, num_threads, [&](size_t cell) {
+            std::vector<std::pair<double, unsigned int> > candidates;
+            size_t cell_corners = 0;
+            for (size_t i = cell_begin[cell]; i < cell_begin[cell + 1]; i++) {
+                const unsigned int p = cell_positions[i];
+                cell_corners += mesh.position_begin[p + 1] - mesh.position_begin[p];
+                if (collapse_errors[p] == kNoCollapse || collapse_errors[p] > error_limit) {
+                    continue;
+                }
+                bool inside = true;
+                for (size_t j = mesh.position_begin[p]; j < mesh.position_begin[p + 1] && inside; j++) {
+                    const unsigned int* tp = &mesh.triangle_positions[3 * mesh.position_triangles[j]];
+                    inside = position_cells[tp[0]] == cell && position_cells[tp[1]] == cell && position_cells[tp[2]] == cell;
+                }
+                if (inside) {
+                    candidates.push_back(std::make_pair(collapse_errors[p], p));
+                }
             }
-
-            tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-            for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-                tag.stringValues[i] = parseString(&token);
+            std::sort(candidates.begin(), candidates.end());
+
+            const double cell_goal = static_cast<double>(remove_goal) * static_cast<double>(cell_corners) / (3.0 * current_triangles);
+            std::vector<std::pair<unsigned int, unsigned int> > wedge_map;
+            size_t removed = 0;
+            size_t collapses = 0;
+            for (size_t i = 0; i < candidates.size() && static_cast<double>(removed) < cell_goal; i++) {
+                const unsigned int p = candidates[i].second;
+                const unsigned int q = collapse_targets[p];
+                if (touched[p] || touched[q]) {
+                    continue;
+                }
+                MapCollapseWedges(mesh, p, q, &wedge_map);
+                for (size_t m = 0; m < wedge_map.size(); m++) {
+                    wedge_remap[wedge_map[m].first] = wedge_map[m].second;
+                }
+                for (int k = 0; k < 10; k++) {
+                    quadrics[q].m[k] += quadrics[p].m[k];
+                }
+                for (size_t j = mesh.position_begin[p]; j < mesh.position_begin[p + 1]; j++) {
+                    const unsigned int t = mesh.position_triangles[j];
+                    const unsigned int* tp = &mesh.triangle_positions[3 * t];
+                    touched[tp[0]] = touched[tp[1]] = touched[tp[2]] = 1;
+                    removed += (tp[0] == q || tp[1] == q || tp[2] == q) ? 1 : 0;
+                }
+                collapses++;
             }
-
-            tags.push_back(tag);
-
+            cell_collapses[cell] = collapses;
+        });
+        size_t num_collapses = 0;
+        for (size_t c = 0; c < num_cells; c++) {
+            num_collapses += cell_collapses[c];
+        }
+        idle_passes = num_collapses == 0 ? idle_passes + 1 : 0;
+        if (num_collapses == 0) {
             continue;
         }
 
-        if (token[0] == 's' && IS_SPACE(token[1])) {
-            // smoothing group id
-            token += 2;
-
-            // skip space.
-            token += strspn(token, " \t");  // skip space
-
-            if (token[0] == '\0') {
-                continue;
+        // Remap the collapsed wedges and drop the triangles that became
+        // degenerate.
+        size_t kept = 0;
+        for (size_t t = 0; t < mesh.num_triangles(); t++) {
+            unsigned int w[3], p[3];
+            for (int k = 0; k < 3; k++) {
+                w[k] = wedge_remap[mesh.triangle_wedges[3 * t + k]];
+                p[k] = mesh.wedge_positions[w[k]];
             }
-
-            if (token[0] == '\r' || token[1] == '\n') {
+            if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0]) {
                 continue;
             }
-
-            if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' && token[2] == 'f') {
-                current_smoothing_id = 0;
-            } else {
-                // assume number
-                int smGroupId = parseInt(&token);
-                if (smGroupId < 0) {
-                    // parse error. force set to 0.
-                    // FIXME(syoyo): Report warning.
-                    current_smoothing_id = 0;
-                } else {
-                    current_smoothing_id = static_cast<unsigned int>(smGroupId);
-                }
+            for (int k = 0; k < 3; k++) {
+                mesh.triangle_wedges[3 * kept + k] = w[k];
+                mesh.triangle_positions[3 * kept + k] = p[k];
             }
-
-            continue;
-        }  // smoothing group id
-
-        // Ignore unknown command.
+            mesh.triangle_materials[kept] = mesh.triangle_materials[t];
+            triangle_sources[kept] = triangle_sources[t];
+            kept++;
+        }
+        mesh.triangle_wedges.resize(3 * kept);
+        mesh.triangle_positions.resize(3 * kept);
+        mesh.triangle_materials.resize(kept);
+        triangle_sources.resize(kept);
+        mesh.BuildAdjacency();
     }
 
-    // not all vertices have colors, no default colors desired? -> clear colors
-    if (!found_all_colors && !default_vcols_fallback) {
-        vc.clear();
+    // Keep the used wedges, in their original order.
+    const unsigned int kUnused = 0xFFFFFFFFu;
+    std::vector<unsigned int> lod_index(num_wedges, kUnused);
+    for (size_t i = 0; i < mesh.triangle_wedges.size(); i++) {
+        lod_index[mesh.triangle_wedges[i]] = 0;
     }
-
-    if (greatest_v_idx >= static_cast<int>(v.size() / 3)) {
-        if (warn) {
-            std::stringstream ss;
-            ss << "Vertex indices out of bounds (line " << line_num << ".)\n\n";
-            (*warn) += ss.str();
+    indexed_mesh_t& lod = *lod_mesh;
+    lod.vertex_stride = indexed_mesh.vertex_stride;
+    lod.normal_offset = indexed_mesh.normal_offset;
+    lod.texcoord_offset = indexed_mesh.texcoord_offset;
+    lod.vertices.clear();
+    lod.vertex_sources.clear();
+    lod.tangents.clear();
+    const bool has_tangents = indexed_mesh.tangents.size() == 4 * num_wedges;
+    for (size_t w = 0; w < num_wedges; w++) {
+        if (lod_index[w] == kUnused) {
+            continue;
         }
-    }
-    if (greatest_vn_idx >= static_cast<int>(vn.size() / 3)) {
-        if (warn) {
-            std::stringstream ss;
-            ss << "Vertex normal indices out of bounds (line " << line_num << ".)\n\n";
-            (*warn) += ss.str();
+        lod_index[w] = static_cast<unsigned int>(lod.vertex_sources.size());
+        lod.vertices.insert(lod.vertices.end(), indexed_mesh.vertices.begin() + w * stride, indexed_mesh.vertices.begin() + (w + 1) * stride);
+        lod.vertex_sources.push_back(indexed_mesh.vertex_sources[w]);
+        if (has_tangents) {
+            lod.tangents.insert(lod.tangents.end(), indexed_mesh.tangents.begin() + 4 * w, indexed_mesh.tangents.begin() + 4 * (w + 1));
         }
     }
-    if (greatest_vt_idx >= static_cast<int>(vt.size() / 2)) {
-        if (warn) {
-            std::stringstream ss;
-            ss << "Vertex texcoord indices out of bounds (line " << line_num << ".)\n\n";
-            (*warn) += ss.str();
-        }
+    lod.indices.resize(mesh.triangle_wedges.size());
+    for (size_t i = 0; i < mesh.triangle_wedges.size(); i++) {
+        lod.indices[i] = lod_index[mesh.triangle_wedges[i]];
     }
 
-    bool ret = exportGroupsToShape(&shape, prim_group, tags, material, name, triangulate, v, warn);
-    // exportGroupsToShape return false when `usemtl` is called in the last
-    // line.
-    // we also add `shape` to `shapes` when `shape.mesh` has already some
-    // faces(indices)
-    if (ret || shape.mesh.indices.size()) {  // FIXME(syoyo): Support other prims(e.g. lines)
-        shapes->push_back(shape);
+    mesh_t& dst = lod_shape->mesh;
+    lod_shape->name = shape.name;
+    lod_shape->lines = lines_t();
+    lod_shape->points = points_t();
+    dst = mesh_t();
+    const size_t num_triangles = mesh.num_triangles();
+    dst.indices.resize(3 * num_triangles);
+    dst.num_face_vertices.assign(num_triangles, 3);
+    for (size_t i = 0; i < mesh.triangle_wedges.size(); i++) {
+        dst.indices[i] = indexed_mesh.vertex_sources[mesh.triangle_wedges[i]];
     }
-    prim_group.clear();  // for safety
-
-    if (err) {
-        (*err) += errss.str();
+    if (has_materials) {
+        dst.material_ids.resize(num_triangles);
+        for (size_t t = 0; t < num_triangles; t++) {
+            dst.material_ids[t] = src.material_ids[triangle_sources[t]];
+        }
+    }
+    if (has_smoothing_groups) {
+        dst.smoothing_group_ids.resize(num_triangles);
+        for (size_t t = 0; t < num_triangles; t++) {
+            dst.smoothing_group_ids[t] = src.smoothing_group_ids[triangle_sources[t]];
+        }
     }
-
-    attrib->vertices.swap(v);
-    attrib->vertex_weights.swap(v);
-    attrib->normals.swap(vn);
-    attrib->texcoords.swap(vt);
-    attrib->texcoord_ws.swap(vt);
-    attrib->colors.swap(vc);
-    attrib->skin_weights.swap(vw);
-
     return true;
 }
 
-bool LoadObjWithCallback(std::istream& inStream, const callback_t& callback, void* user_data /*= NULL*/,
-    MaterialReader* readMatFn /*= NULL*/, std::string* warn, /* = NULL*/
-    std::string* err /*= NULL*/) {
-    std::stringstream errss;
-
-    // material
-    std::set<std::string> material_filenames;
-    std::map<std::string, int> material_map;
-    int material_id = -1;  // -1 = invalid
-
-    std::vector<index_t> indices;
-    std::vector<material_t> materials;
-    std::vector<std::string> names;
-    names.reserve(2);
-    std::vector<const char*> names_out;
-
-    std::string linebuf;
-    while (inStream.peek() != -1) {
-        safeGetline(inStream, linebuf);
-
-        // Trim newline '\r\n' or '\n'
-        if (linebuf.size() > 0) {
-            if (linebuf[linebuf.size() - 1] == '\n') linebuf.erase(linebuf.size() - 1);
-        }
-        if (linebuf.size() > 0) {
-            if (linebuf[linebuf.size() - 1] == '\r') linebuf.erase(linebuf.size() - 1);
-        }
+// Triangles per chunk clustered in one task.
+static const size_t kMeshletChunkTriangles = 16384;
+
+// Spreads the low 10 bits of `x` to every third bit.
+static unsigned int MortonSpread(unsigned int x) {
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
 
-        // Skip if empty line.
-        if (linebuf.empty()) {
-            continue;
+// Greedily clusters the triangles `order[begin, end)`. Each meshlet grows
+// by the triangle around its last triangle(or around any of its vertices)
+// that adds the fewest vertices, preferring vertices with few triangles
+// left so meshlets stay compact, and continues along `order` when no
+// adjacent triangle is left.
+static void BuildChunkMeshlets(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& order, size_t begin,
+    size_t end, unsigned int max_vertices, unsigned int max_triangles, meshlets_t* out) {
+    const size_t n = end - begin;
+
+    // Chunk-local vertices, with their corners sorted by vertex.
+    std::vector<std::pair<unsigned int, unsigned int> > corners(3 * n);  // (vertex, corner)
+    for (size_t i = 0; i < 3 * n; i++) {
+        corners[i] = std::make_pair(indices[3 * order[begin + i / 3] + i % 3], static_cast<unsigned int>(i));
+    }
+    std::sort(corners.begin(), corners.end());
+    std::vector<unsigned int> corner_vertices(3 * n);
+    std::vector<size_t> vertex_begin;
+    std::vector<unsigned int> vertex_globals;
+    for (size_t i = 0; i < corners.size(); i++) {
+        if (i == 0 || corners[i].first != corners[i - 1].first) {
+            vertex_begin.push_back(i);
+            vertex_globals.push_back(corners[i].first);
         }
+        corner_vertices[corners[i].second] = static_cast<unsigned int>(vertex_globals.size() - 1);
+    }
+    vertex_begin.push_back(corners.size());
+    const size_t num_vertices = vertex_globals.size();
+    std::vector<unsigned int> live(num_vertices);  // triangles left around each vertex
+    for (size_t v = 0; v < num_vertices; v++) {
+        live[v] = static_cast<unsigned int>(vertex_begin[v + 1] - vertex_begin[v]);
+    }
 
-        // Skip leading space.
-        const char* token = linebuf.c_str();
-        token += strspn(token, " \t");
-
-        assert(token);
-        if (token[0] == '\0') continue;  // empty line
-
-        if (token[0] == '#') continue;  // comment line
-
-        // vertex
-        if (token[0] == 'v' && IS_SPACE((token[1]))) {
-            token += 2;
-            real_t x, y, z;
-            real_t r, g, b;
-
-            bool found_color = parseVertexWithColor(&x, &y, &z, &r, &g, &b, &token);
-            if (callback.vertex_cb) {
-                callback.vertex_cb(user_data, x, y, z, r);  // r=w is optional
+    std::vector<char> emitted(n, 0);
+    std::vector<int> meshlet_index(num_vertices, -1);  // index in the current meshlet
+    std::vector<unsigned int> meshlet_vertices;
+    meshlet_t current;
+    std::memset(&current, 0, sizeof(current));
+
+    size_t best = n;
+    unsigned int best_new = 0, best_live = 0;
+    auto consider_vertex = [&](unsigned int v) {
+        for (size_t j = vertex_begin[v]; j < vertex_begin[v + 1]; j++) {
+            const size_t t = corners[j].second / 3;
+            if (emitted[t]) {
+                continue;
             }
-            if (callback.vertex_color_cb) {
-                callback.vertex_color_cb(user_data, x, y, z, r, g, b, found_color);
+            unsigned int added = 0, live_sum = 0;
+            for (int k = 0; k < 3; k++) {
+                const unsigned int u = corner_vertices[3 * t + k];
+                added += meshlet_index[u] < 0 ? 1 : 0;
+                live_sum += live[u];
             }
-            continue;
-        }
-
-        // normal
-        if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
-            token += 3;
-            real_t x, y, z;
-            parseReal3(&x, &y, &z, &token);
-            if (callback.normal_cb) {
-                callback.normal_cb(user_data, x, y, z);
+            if (best == n || added < best_new || (added == best_new && (live_sum < best_live || (live_sum == best_live && t < best)))) {
+                best = t;
+                best_new = added;
+                best_live = live_sum;
             }
-            continue;
         }
-
-        // texcoord
-        if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
-            token += 3;
-            real_t x, y, z;  // y and z are optional. default = 0.0
-            parseReal3(&x, &y, &z, &token);
-            if (callback.texcoord_cb) {
-                callback.texcoord_cb(user_data, x, y, z);
+    };
+
+    size_t cursor = 0;
+    size_t last = n;  // last triangle added to the current meshlet
+    for (size_t count = 0; count < n; count++) {
+        best = n;
+        if (last < n) {
+            for (int k = 0; k < 3; k++) {
+                consider_vertex(corner_vertices[3 * last + k]);
+            }
+            // Look around the whole meshlet unless a triangle adds no vertex.
+            for (size_t i = 0; (best == n || best_new > 0) && i < meshlet_vertices.size(); i++) {
+                consider_vertex(meshlet_vertices[i]);
             }
-            continue;
         }
-
-        // face
-        if (token[0] == 'f' && IS_SPACE((token[1]))) {
-            token += 2;
-            token += strspn(token, " \t");
-
-            indices.clear();
-            while (!IS_NEW_LINE(token[0])) {
-                vertex_index_t vi = parseRawTriple(&token);
-
-                index_t idx;
-                idx.vertex_index = vi.v_idx;
-                idx.normal_index = vi.vn_idx;
-                idx.texcoord_index = vi.vt_idx;
-
-                indices.push_back(idx);
-                size_t n = strspn(token, " \t\r");
-                token += n;
+        if (best == n) {
+            while (emitted[cursor]) {
+                cursor++;
             }
-
-            if (callback.index_cb && indices.size() > 0) {
-                callback.index_cb(user_data, &indices.at(0), static_cast<int>(indices.size()));
+            best = cursor;
+            best_new = 0;
+            for (int k = 0; k < 3; k++) {
+                best_new += meshlet_index[corner_vertices[3 * best + k]] < 0 ? 1 : 0;
             }
-
-            continue;
         }
 
-        // use mtl
-        if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
-            token += 7;
-            std::stringstream ss;
-            ss << token;
-            std::string namebuf = ss.str();
-
-            int newMaterialId = -1;
-            std::map<std::string, int>::const_iterator it = material_map.find(namebuf);
-            if (it != material_map.end()) {
-                newMaterialId = it->second;
-            } else {
-                // { warn!! material not found }
-                if (warn && (!callback.usemtl_cb)) {
-                    (*warn) += "material [ " + namebuf + " ] not found in .mtl\n";
-                }
-            }
-
-            if (newMaterialId != material_id) {
-                material_id = newMaterialId;
+        if (meshlet_vertices.size() + best_new > max_vertices || current.triangle_count == max_triangles) {
+            out->meshlets.push_back(current);
+            for (size_t i = 0; i < meshlet_vertices.size(); i++) {
+                meshlet_index[meshlet_vertices[i]] = -1;
             }
+            meshlet_vertices.clear();
+            current.vertex_offset = static_cast<unsigned int>(out->vertices.size());
+            current.triangle_offset = static_cast<unsigned int>(out->triangles.size());
+            current.vertex_count = 0;
+            current.triangle_count = 0;
+        }
 
-            if (callback.usemtl_cb) {
-                callback.usemtl_cb(user_data, namebuf.c_str(), material_id);
+        emitted[best] = 1;
+        for (int k = 0; k < 3; k++) {
+            const unsigned int v = corner_vertices[3 * best + k];
+            live[v]--;
+            if (meshlet_index[v] < 0) {
+                meshlet_index[v] = static_cast<int>(meshlet_vertices.size());
+                meshlet_vertices.push_back(v);
+                out->vertices.push_back(vertex_globals[v]);
+                current.vertex_count++;
             }
-
-            continue;
+            out->triangles.push_back(static_cast<unsigned char>(meshlet_index[v]));
         }
+        current.triangle_count++;
+        last = best;
+    }
+    if (current.triangle_count > 0) {
+        out->meshlets.push_back(current);
+    }
+}
 
-        // load mtl
-        if ((0 == strncmp(token, "mtllib", 6)) && IS_SPACE((token[6]))) {
-            if (readMatFn) {
-                token += 7;
-
-                std::vector<std::string> filenames;
-                SplitString(std::string(token), ' ', '\\', filenames);
-
-                if (filenames.empty()) {
-                    if (warn) {
-                        (*warn) += "Looks like empty filename for mtllib. Use default "
-                                   "material. \n";
-                    }
-                } else {
-                    bool found = false;
-                    for (size_t s = 0; s < filenames.size(); s++) {
-                        if (material_filenames.count(filenames[s]) > 0) {
-                            found = true;
-                            continue;
-                        }
-
-                        std::string warn_mtl;
-                        std::string err_mtl;
-                        bool ok = (*readMatFn)(filenames[s].c_str(), &materials, &material_map, &warn_mtl, &err_mtl);
-
-                        if (warn && (!warn_mtl.empty())) {
-                            (*warn) += warn_mtl;  // This should be warn message.
-                        }
-
-                        if (err && (!err_mtl.empty())) {
-                            (*err) += err_mtl;
-                        }
-
-                        if (ok) {
-                            found = true;
-                            material_filenames.insert(filenames[s]);
-                            break;
-                        }
-                    }
+// Bounding sphere and normal cone of a meshlet.
+static void ComputeMeshletBounds(const indexed_mesh_t& indexed_mesh, const meshlets_t& meshlets, meshlet_t* meshlet) {
+    const size_t stride = static_cast<size_t>(indexed_mesh.vertex_stride);
+    const unsigned int* vertices = &meshlets.vertices[meshlet->vertex_offset];
+    const unsigned char* triangles = &meshlets.triangles[meshlet->triangle_offset];
+
+    // Sphere around the box center.
+    double bmin[3], bmax[3];
+    for (unsigned int i = 0; i < meshlet->vertex_count; i++) {
+        const real_t* p = &indexed_mesh.vertices[vertices[i] * stride];
+        for (int c = 0; c < 3; c++) {
+            bmin[c] = (i == 0 || p[c] < bmin[c]) ? p[c] : bmin[c];
+            bmax[c] = (i == 0 || p[c] > bmax[c]) ? p[c] : bmax[c];
+        }
+    }
+    double center[3], radius2 = 0.0;
+    for (int c = 0; c < 3; c++) {
+        center[c] = 0.5 * (bmin[c] + bmax[c]);
+    }
+    for (unsigned int i = 0; i < meshlet->vertex_count; i++) {
+        const real_t* p = &indexed_mesh.vertices[vertices[i] * stride];
+        const double d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+        radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
 
-                    if (!found) {
-                        if (warn) {
-                            (*warn) += "Failed to load material file(s). Use default "
-                                       "material.\n";
-                        }
-                    } else {
-                        if (callback.mtllib_cb) {
-                            callback.mtllib_cb(user_data, &materials.at(0), static_cast<int>(materials.size()));
-                        }
-                    }
-                }
+    // Cone axis: average of the unit triangle normals(degenerate triangles
+    // keep a zero normal and are skipped).
+    std::vector<double> normals(3 * meshlet->triangle_count, 0.0);
+    double axis[3] = {0.0, 0.0, 0.0};
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++) {
+        double p[3][3];
+        for (int k = 0; k < 3; k++) {
+            const real_t* v = &indexed_mesh.vertices[vertices[triangles[3 * t + k]] * stride];
+            p[k][0] = v[0], p[k][1] = v[1], p[k][2] = v[2];
+        }
+        double* n = &normals[3 * t];
+        TriangleCross(p[0], p[1], p[2], n);
+        const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len > 0.0) {
+            for (int c = 0; c < 3; c++) {
+                n[c] /= len;
+                axis[c] += n[c];
             }
-
-            continue;
         }
-
-        // group name
-        if (token[0] == 'g' && IS_SPACE((token[1]))) {
-            names.clear();
-
-            while (!IS_NEW_LINE(token[0])) {
-                std::string str = parseString(&token);
-                names.push_back(str);
-                token += strspn(token, " \t\r");  // skip tag
+    }
+    const double axis_len = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    double min_dot = 1.0;
+    if (axis_len > 0.0) {
+        for (int c = 0; c < 3; c++) {
+            axis[c] /= axis_len;
+        }
+        for (unsigned int t = 0; t < meshlet->triangle_count; t++) {
+            const double* n = &normals[3 * t];
+            if (n[0] != 0.0 || n[1] != 0.0 || n[2] != 0.0) {
+                min_dot = std::min(min_dot, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
             }
+        }
+    } else {
+        min_dot = -1.0;
+    }
 
-            assert(names.size() > 0);
-
-            if (callback.group_cb) {
-                if (names.size() > 1) {
-                    // create const char* array.
-                    names_out.resize(names.size() - 1);
-                    for (size_t j = 0; j < names_out.size(); j++) {
-                        names_out[j] = names[j + 1].c_str();
-                    }
-                    callback.group_cb(user_data, &names_out.at(0), static_cast<int>(names_out.size()));
-
-                } else {
-                    callback.group_cb(user_data, NULL, 0);
-                }
-            }
+    for (int c = 0; c < 3; c++) {
+        meshlet->center[c] = static_cast<float>(center[c]);
+        meshlet->cone_apex[c] = static_cast<float>(center[c]);
+        meshlet->cone_axis[c] = static_cast<float>(axis[c]);
+    }
+    meshlet->radius = static_cast<float>(std::sqrt(radius2));
+    if (min_dot <= 0.1) {
+        // Wider than about 84 degrees: the cone can not cull anything.
+        meshlet->cone_cutoff = 1.0f;
+        return;
+    }
 
+    // Move the apex back along the axis until every triangle plane lies in
+    // front of it.
+    double max_t = 0.0;
+    for (unsigned int t = 0; t < meshlet->triangle_count; t++) {
+        const double* n = &normals[3 * t];
+        if (n[0] == 0.0 && n[1] == 0.0 && n[2] == 0.0) {
             continue;
         }
+        const real_t* p0 = &indexed_mesh.vertices[vertices[triangles[3 * t]] * stride];
+        const double dc = (center[0] - p0[0]) * n[0] + (center[1] - p0[1]) * n[1] + (center[2] - p0[2]) * n[2];
+        const double dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+        max_t = std::max(max_t, dc / dn);
+    }
+    for (int c = 0; c < 3; c++) {
+        meshlet->cone_apex[c] = static_cast<float>(center[c] - axis[c] * max_t);
+    }
+    meshlet->cone_cutoff = static_cast<float>(std::sqrt(1.0 - min_dot * min_dot));
+}
 
-        // object name
-        if (token[0] == 'o' && IS_SPACE((token[1]))) {
-            // @todo { multiple object name? }
-            token += 2;
-
-            std::stringstream ss;
-            ss << token;
-            std::string object_name = ss.str();
-
-            if (callback.object_cb) {
-                callback.object_cb(user_data, object_name.c_str());
+bool BuildMeshlets(const indexed_mesh_t& indexed_mesh, const shape_t& shape, meshlets_t* meshlets, unsigned int max_vertices,
+    unsigned int max_triangles, unsigned int num_threads) {
+    meshlets->meshlets.clear();
+    meshlets->vertices.clear();
+    meshlets->triangles.clear();
+    const std::vector<unsigned char>& num_face_vertices = shape.mesh.num_face_vertices;
+    const size_t num_triangles = num_face_vertices.size();
+    if (max_vertices < 3 || max_vertices > 255 || max_triangles < 1 || max_triangles > 512) {
+        return false;
+    }
+    for (size_t f = 0; f < num_triangles; f++) {
+        if (num_face_vertices[f] != 3) {
+            return false;
+        }
+    }
+    const std::vector<unsigned int>& indices = indexed_mesh.indices;
+    if (indices.size() != 3 * num_triangles) {
+        return false;
+    }
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] >= indexed_mesh.num_vertices()) {
+            return false;
+        }
+    }
+    num_threads = ResolveNumThreads(num_threads);
+    const size_t stride = static_cast<size_t>(indexed_mesh.vertex_stride);
+
+    // Sort the triangles along a Morton curve of their centroids.
+    double bmin[3] = {0.0, 0.0, 0.0}, bmax[3] = {0.0, 0.0, 0.0};
+    for (size_t v = 0; v < indexed_mesh.num_vertices(); v++) {
+        for (int c = 0; c < 3; c++) {
+            const double x = indexed_mesh.vertices[v * stride + c];
+            bmin[c] = (v == 0 || x < bmin[c]) ? x : bmin[c];
+            bmax[c] = (v == 0 || x > bmax[c]) ? x : bmax[c];
+        }
+    }
+    const double extent = std::max(bmax[0] - bmin[0], std::max(bmax[1] - bmin[1], bmax[2] - bmin[2]));
+    const double scale = extent > 0.0 ? 1023.0 / extent : 0.0;
+    std::vector<std::pair<unsigned int, unsigned int> > keys(num_triangles);
+    const size_t num_triangle_blocks = (num_triangles + kNormalBlockSize - 1) / kNormalBlockSize;
+    parallelFor(num_triangle_blocks, num_threads, [&](size_t b) {
+        const size_t triangle_end = std::min(num_triangles, (b + 1) * kNormalBlockSize);
+        for (size_t t = b * kNormalBlockSize; t < triangle_end; t++) {
+            unsigned int code = 0;
+            for (int c = 0; c < 3; c++) {
+                const double x = (indexed_mesh.vertices[indices[3 * t] * stride + c] + indexed_mesh.vertices[indices[3 * t + 1] * stride + c] +
+                                     indexed_mesh.vertices[indices[3 * t + 2] * stride + c]) /
+                                 3.0;
+                code |= MortonSpread(static_cast<unsigned int>((x - bmin[c]) * scale)) << c;
             }
-
-            continue;
+            keys[t] = std::make_pair(code, static_cast<unsigned int>(t));
         }
-
-#if 0  // @todo
-    if (token[0] == 't' && IS_SPACE(token[1])) {
-      tag_t tag;
-
-      token += 2;
-      std::stringstream ss;
-      ss << token;
-      tag.name = ss.str();
-
-      token += tag.name.size() + 1;
-
-      tag_sizes ts = parseTagTriple(&token);
-
-      tag.intValues.resize(static_cast<size_t>(ts.num_ints));
-
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_ints); ++i) {
-        tag.intValues[i] = atoi(token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
-
-      tag.floatValues.resize(static_cast<size_t>(ts.num_reals));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_reals); ++i) {
-        tag.floatValues[i] = parseReal(&token);
-        token += strcspn(token, "/ \t\r") + 1;
-      }
-
-      tag.stringValues.resize(static_cast<size_t>(ts.num_strings));
-      for (size_t i = 0; i < static_cast<size_t>(ts.num_strings); ++i) {
-        std::stringstream ss;
-        ss << token;
-        tag.stringValues[i] = ss.str();
-        token += tag.stringValues[i].size() + 1;
-      }
-
-      tags.push_back(tag);
+    });
+    std::sort(keys.begin(), keys.end());
+    std::vector<unsigned int> order(num_triangles);
+    for (size_t t = 0; t < num_triangles; t++) {
+        order[t] = keys[t].second;
     }
-#endif
 
-        // Ignore unknown command.
+    // Cluster each chunk of the curve in parallel.
+    const size_t num_chunks = (num_triangles + kMeshletChunkTriangles - 1) / kMeshletChunkTriangles;
+    std::vector<meshlets_t> chunks(num_chunks);
+    parallelFor(num_chunks, num_threads, [&](size_t c) {
+        BuildChunkMeshlets(indices, order, c * kMeshletChunkTriangles, std::min(num_triangles, (c + 1) * kMeshletChunkTriangles), max_vertices,
+            max_triangles, &chunks[c]);
+    });
+
+    // Concatenate the chunks, then compute the bounds in parallel.
+    size_t num_meshlets = 0, num_vertices = 0, num_corners = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+        num_meshlets += chunks[c].meshlets.size();
+        num_vertices += chunks[c].vertices.size();
+        num_corners += chunks[c].triangles.size();
     }
-
-    if (err) {
-        (*err) += errss.str();
+    meshlets->meshlets.reserve(num_meshlets);
+    meshlets->vertices.reserve(num_vertices);
+    meshlets->triangles.reserve(num_corners);
+    for (size_t c = 0; c < num_chunks; c++) {
+        const unsigned int vertex_base = static_cast<unsigned int>(meshlets->vertices.size());
+        const unsigned int triangle_base = static_cast<unsigned int>(meshlets->triangles.size());
+        for (size_t m = 0; m < chunks[c].meshlets.size(); m++) {
+            meshlet_t meshlet = chunks[c].meshlets[m];
+            meshlet.vertex_offset += vertex_base;
+            meshlet.triangle_offset += triangle_base;
+            meshlets->meshlets.push_back(meshlet);
+        }
+        meshlets->vertices.insert(meshlets->vertices.end(), chunks[c].vertices.begin(), chunks[c].vertices.end());
+        meshlets->triangles.insert(meshlets->triangles.end(), chunks[c].triangles.begin(), chunks[c].triangles.end());
+        chunks[c] = meshlets_t();
     }
-
+    parallelFor(num_meshlets, num_threads, [&](size_t m) { ComputeMeshletBounds(indexed_mesh, *meshlets, &meshlets->meshlets[m]); });
     return true;
 }
 
+// Builds the `ObjReaderConfig::indexed_vertices` output of every shape.
+static bool BuildIndexedMeshes(const attrib_accessor_t& attrib, const std::vector<shape_t>& shapes, unsigned int num_threads,
+    std::vector<indexed_mesh_t>* indexed_meshes, std::string* err) {
+    indexed_meshes->clear();
+    indexed_meshes->resize(shapes.size());
+
+    std::vector<char> built(shapes.size(), 0);
+    parallelFor(shapes.size(), ResolveNumThreads(num_threads),
+        [&](size_t i) { built[i] = BuildIndexedMesh(attrib, shapes[i], &(*indexed_meshes)[i]) ? 1 : 0; });
+
+    bool ret = true;
+    for (size_t i = 0; i < shapes.size(); i++) {
+        if (!built[i]) {
+            if (err) {
+                (*err) += "Invalid vertex index in shape [" + shapes[i].name + "]. Cannot build indexed vertices.\n";
+            }
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+// `default_vcols_fallback` of the loaders for `config`. Compact mode stores
+// colors only when the file has them, so the white fallback colors are not
+// allocated at all.
+static bool DefaultVertexColors(const ObjReaderConfig& config) { return config.vertex_color && !config.compact_attrib; }
+
 bool ObjReader::ParseFromFile(const std::string& filename, const ObjReaderConfig& config) {
     std::string mtl_search_path;
 
@@ -3263,8 +9455,28 @@ bool ObjReader::ParseFromFile(const std::string& filename, const ObjReaderConfig
         mtl_search_path = config.mtl_search_path;
     }
 
-    valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_, filename.c_str(), mtl_search_path.c_str(), config.triangulate,
-        config.vertex_color);
+    if (config.num_threads == 1) {
+        valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_, filename.c_str(), mtl_search_path.c_str(),
+            config.triangulate, DefaultVertexColors(config), config.arena);
+    } else {
+        valid_ = LoadObjParallel(&attrib_, &shapes_, &materials_, &warning_, &error_, filename.c_str(), mtl_search_path.c_str(),
+            config.triangulate, DefaultVertexColors(config), config.num_threads, config.arena);
+    }
+
+    if (valid_ && config.generate_normals) {
+        GenerateSmoothingGroupNormals(&attrib_, &shapes_, false, config.num_threads);
+    }
+
+    compact_attrib_ = compact_attrib_t();
+    if (valid_ && config.compact_attrib) {
+        CompactAttrib(&attrib_, &compact_attrib_);
+    }
+
+    indexed_meshes_.clear();
+    if (valid_ && config.indexed_vertices) {
+        const attrib_accessor_t attrib = config.compact_attrib ? attrib_accessor_t(compact_attrib_) : attrib_accessor_t(attrib_);
+        valid_ = BuildIndexedMeshes(attrib, shapes_, config.num_threads, &indexed_meshes_, &error_);
+    }
 
     return valid_;
 }
@@ -3278,7 +9490,23 @@ bool ObjReader::ParseFromString(const std::string& obj_text, const std::string&
 
     MaterialStreamReader mtl_ss(mtl_ifs);
 
-    valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_, &obj_ifs, &mtl_ss, config.triangulate, config.vertex_color);
+    valid_ = LoadObj(&attrib_, &shapes_, &materials_, &warning_, &error_, &obj_ifs, &mtl_ss, config.triangulate, DefaultVertexColors(config),
+        config.arena);
+
+    if (valid_ && config.generate_normals) {
+        GenerateSmoothingGroupNormals(&attrib_, &shapes_, false, config.num_threads);
+    }
+
+    compact_attrib_ = compact_attrib_t();
+    if (valid_ && config.compact_attrib) {
+        CompactAttrib(&attrib_, &compact_attrib_);
+    }
+
+    indexed_meshes_.clear();
+    if (valid_ && config.indexed_vertices) {
+        const attrib_accessor_t attrib = config.compact_attrib ? attrib_accessor_t(compact_attrib_) : attrib_accessor_t(attrib_);
+        valid_ = BuildIndexedMeshes(attrib, shapes_, config.num_threads, &indexed_meshes_, &error_);
+    }
 
     return valid_;
 }
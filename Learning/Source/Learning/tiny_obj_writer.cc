@@ -0,0 +1,2 @@
+#define TINYOBJWRITER_IMPLEMENTATION
+#include "tiny_obj_writer.h"
\ No newline at end of file
@@ -0,0 +1,1007 @@
+//
+// Buffered Wavefront .obj/.mtl writer.
+// Counterpart of tiny_obj_loader.h without any engine dependency.
+//
+
+//
+// Use this in *one* .cc
+//   #define TINYOBJWRITER_IMPLEMENTATION
+//   #include "tiny_obj_writer.h"
+//
+
+#ifndef TINY_OBJ_WRITER_H_
+#define TINY_OBJ_WRITER_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace tinyobj {
+
+struct obj_writer_workers_t;
+
+///
+/// Buffered .obj/.mtl text writer.
+/// Lines are formatted straight into one large buffer, which is written to
+/// the file only when it is full or on `Flush`/`Close`(there is no flush per
+/// line). Numbers are formatted with std::to_chars, so the output does not
+/// depend on the C/C++ locale and no stream state is involved.
+/// The single element functions allocate nothing after construction.
+///
+class ObjWriter {
+public:
+    static const size_t kDefaultBufferSize = 1 << 20;
+    static const size_t kMinBufferSize = 4096;
+
+    ///
+    /// @param[in] buffer_size Size of the write buffer in bytes(at least `kMinBufferSize`)
+    ///
+    explicit ObjWriter(size_t buffer_size = kDefaultBufferSize);
+    ~ObjWriter();
+
+    ///
+    /// Creates(or truncates) `filename`. A file which is still open is closed first.
+    ///
+    bool Open(const char* filename);
+#ifdef _WIN32
+    bool Open(const wchar_t* filename);
+#endif
+
+    ///
+    /// Writes the buffered bytes and closes the file.
+    /// Returns false when any write since `Open` failed(or no file is open).
+    ///
+    bool Close();
+
+    ///
+    /// Writes the buffered bytes to the file.
+    ///
+    bool Flush();
+
+    bool IsOpen() const { return file_ != NULL; }
+
+    ///
+    /// False when no file is open or once a write failed. Formatting calls are
+    /// ignored then.
+    ///
+    bool good() const { return good_; }
+
+    ///
+    /// Number of bytes formatted since `Open`(written or still buffered).
+    ///
+    unsigned long long bytes_written() const { return flushed_bytes_ + static_cast<unsigned long long>(pos_); }
+
+    ///
+    /// Sets the float format of `Position`, `Normal`, `TexCoord` and the float `Statement`.
+    ///
+    /// @param[in] precision Digits after the decimal point(clamped to 9), or a
+    ///                      negative value for the shortest representation which reads back to the same float
+    ///
+    void SetPrecision(int precision);
+    int precision() const { return precision_; }
+
+    /// "# `text`"
+    void Comment(const char* text);
+
+    /// "`keyword` `text`", e.g. `mtllib`, `g`, `o`, `usemtl`, `newmtl`, `map_Kd`.
+    void Statement(const char* keyword, const char* text);
+
+    /// "`keyword` `x` `y` `z`" for the three float statements of .mtl files(`Ka`, `Kd`, ...).
+    void Statement(const char* keyword, float x, float y, float z);
+
+    /// An empty line.
+    void BlankLine();
+
+    /// "v `x` `y` `z`"
+    void Position(float x, float y, float z);
+
+    /// "vn `x` `y` `z`"
+    void Normal(float x, float y, float z);
+
+    /// "vt `u` `v`"
+    void TexCoord(float u, float v);
+
+    ///
+    /// "f v/vt/vn ..." with 1-based(or negative, relative) indices.
+    ///
+    /// @param[in] v Position index per corner
+    /// @param[in] vt Texcoord index per corner, or NULL
+    /// @param[in] vn Normal index per corner, or NULL
+    /// @param[in] num_corners Number of corners of the face
+    ///
+    void Face(const int* v, const int* vt, const int* vn, size_t num_corners);
+
+    ///
+    /// "f a/a/a b/b/b c/c/c": a triangle using the same index for the position,
+    /// texcoord and normal of each corner(unshared per-corner attributes).
+    ///
+    void Triangle(long long a, long long b, long long c);
+
+    /// Appends `len` bytes as is.
+    void Write(const char* data, size_t len);
+
+    ///
+    /// Bulk variants of the element functions for whole sections.
+    /// The elements are split into chunks of `kParallelChunkSize`, which
+    /// `num_threads` worker threads format into a ring of chunk buffers while
+    /// the calling thread writes the finished chunks in order: with vectored
+    /// writes(writev) on POSIX, and gathered into the write buffer and written
+    /// one full buffer at a time on Windows. The output is byte-identical to
+    /// calling the single element functions in order, for any number of
+    /// threads.
+    /// The worker threads and chunk buffers are created by the first parallel
+    /// call and serve every following section until the writer is destroyed
+    /// (a call with another thread count re-creates them).
+    ///
+    /// @param[in] num_threads Number of threads. 0 = use std::thread::hardware_concurrency().
+    ///
+    static const size_t kParallelChunkSize = 8192;
+
+    /// `Position` for `count` xyz triples.
+    void Positions(const float* xyz, size_t count, unsigned int num_threads = 0);
+
+    /// `Normal` for `count` xyz triples.
+    void Normals(const float* xyz, size_t count, unsigned int num_threads = 0);
+
+    ///
+    /// `TexCoord` for `count` uv pairs.
+    ///
+    /// @param[in] flip_v Writes `1 - v` instead of `v`(e.g. for UE texcoords)
+    ///
+    void TexCoords(const float* uv, size_t count, bool flip_v, unsigned int num_threads = 0);
+
+    ///
+    /// `Face` for `count` triangles. `v`, `vt` and `vn` hold 3 indices per
+    /// triangle; `vt` and `vn` may be NULL.
+    ///
+    void Triangles(const int* v, const int* vt, const int* vn, size_t count, unsigned int num_threads = 0);
+
+    ///
+    /// `Triangle(first + 3 * i, first + 3 * i + 1, first + 3 * i + 2)` for i in
+    /// [0, count): triangles over unshared per-corner attributes.
+    ///
+    void SequentialTriangles(long long first, size_t count, unsigned int num_threads = 0);
+
+private:
+    ObjWriter(const ObjWriter&);
+    ObjWriter& operator=(const ObjWriter&);
+
+    // Formats the elements [begin, end) of a bulk call to `out` and returns
+    // the end of the text. `out` has room for `max_line_len` bytes per element.
+    typedef char* (*chunk_format_fn)(const void* args, size_t begin, size_t end, int precision, char* out);
+
+    // Returns room for at least `len` bytes, flushing when the buffer is too
+    // full. Returns NULL when a write failed.
+    char* Reserve(size_t len);
+    bool WriteToFile(const char* data, size_t len);
+    // Writes the chunks [first_chunk, first_chunk + count) from the ring of
+    // chunk buffers of `workers_`.
+    bool WriteChunksToFile(size_t first_chunk, size_t count);
+    void WriteChunks(chunk_format_fn format, const void* args, size_t count, size_t max_line_len, unsigned int num_threads);
+
+    std::vector<char> buffer_;
+    obj_writer_workers_t* workers_;  // NULL until the first parallel bulk call
+    size_t pos_;
+    unsigned long long flushed_bytes_;
+    FILE* file_;
+    bool good_;
+    int precision_;
+};
+
+///
+/// Deduplicates float vectors(e.g. normals and texcoords) for indexed export.
+/// Each value is quantized to a grid of `tolerance` per component and
+/// hashed into an open addressing table, so values in the same grid cell
+/// share one index. The first value of a cell is kept as is. Values beyond
+/// 2^62 cells(where the float spacing exceeds the tolerance) are only merged
+/// when bitwise equal.
+/// With a tolerance of 0 only bitwise equal values(-0 = +0) are merged.
+///
+class ObjAttributeDeduplicator {
+public:
+    ///
+    /// @param[in] num_components Components per value(1 to 4)
+    /// @param[in] tolerance Quantization step
+    ///
+    ObjAttributeDeduplicator(int num_components, float tolerance);
+
+    /// Prepares for `count` unique values without rehashing.
+    void Reserve(size_t count);
+
+    ///
+    /// Returns the 0-based index of the value matching `value`, which is
+    /// added when there is none.
+    ///
+    int Insert(const float* value);
+
+    /// Number of unique values.
+    size_t size() const { return values_.size() / static_cast<size_t>(num_components_); }
+
+    /// Unique values, `num_components` per value, in insertion order.
+    const std::vector<float>& values() const { return values_; }
+
+    void Clear();
+
+private:
+    void Rehash(size_t num_slots);
+
+    int num_components_;
+    float inv_tolerance_;  // 0 = exact
+    std::vector<float> values_;
+    // Open addressing table. A slot is the unique value index(-1 = empty)
+    // followed by its quantized components, so a probe touches one slot only.
+    std::vector<long long> slots_;
+    size_t num_slots_;
+};
+
+}  // namespace tinyobj
+
+#endif  // TINY_OBJ_WRITER_H_
+
+#ifdef TINYOBJWRITER_IMPLEMENTATION
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace tinyobj {
+
+// Longest formatted float: sign, 39 integer digits of FLT_MAX, '.' and 9
+// decimals. The shortest representation is at most 15 characters.
+static const size_t kObjWriterMaxFloatChars = 52;
+// Longest formatted integer(sign and 19 digits).
+static const size_t kObjWriterMaxIntChars = 20;
+static const int kObjWriterMaxPrecision = 9;
+
+static char* WriteObjFloat(char* p, float value, int precision) {
+#if defined(__cpp_lib_to_chars)
+    std::to_chars_result result = precision < 0
+        ? std::to_chars(p, p + kObjWriterMaxFloatChars, value)
+        : std::to_chars(p, p + kObjWriterMaxFloatChars, value, std::chars_format::fixed, precision);
+    return result.ptr;
+#else
+    // No floating point std::to_chars in this standard library(e.g. libstdc++
+    // before GCC 11). snprintf is slower and uses the C locale's decimal point.
+    int len = precision < 0 ? snprintf(p, kObjWriterMaxFloatChars + 1, "%.9g", static_cast<double>(value))
+                            : snprintf(p, kObjWriterMaxFloatChars + 1, "%.*f", precision, static_cast<double>(value));
+    return p + (len > 0 ? len : 0);
+#endif
+}
+
+static char* WriteObjInt(char* p, long long value) {
+    unsigned long long u = static_cast<unsigned long long>(value);
+    if (value < 0) {
+        *p++ = '-';
+        u = 0ull - u;
+    }
+    char digits[kObjWriterMaxIntChars];
+    size_t n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + (u % 10));
+        u /= 10;
+    } while (u);
+    while (n) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+static char* WriteObjText(char* p, const char* text, size_t len) {
+    memcpy(p, text, len);
+    return p + len;
+}
+
+// Longest lines of the element functions(the vec3 line without its keyword).
+static const size_t kObjWriterMaxVec3Line = 3 * (kObjWriterMaxFloatChars + 1) + 1;
+static const size_t kObjWriterMaxVec2Line = 3 + 2 * (kObjWriterMaxFloatChars + 1) + 1;
+static const size_t kObjWriterMaxTriangleLine = 2 + 3 * (3 * (kObjWriterMaxIntChars + 1) + 1);
+
+// Element formatters shared by the single element functions and the bulk
+// functions, so both produce the same bytes.
+static char* WriteObjVec3Line(char* p, const char* keyword, size_t keyword_len, float x, float y, float z, int precision) {
+    p = WriteObjText(p, keyword, keyword_len);
+    *p++ = ' ';
+    p = WriteObjFloat(p, x, precision);
+    *p++ = ' ';
+    p = WriteObjFloat(p, y, precision);
+    *p++ = ' ';
+    p = WriteObjFloat(p, z, precision);
+    *p++ = '\n';
+    return p;
+}
+
+static char* WriteObjTexCoordLine(char* p, float u, float v, int precision) {
+    *p++ = 'v';
+    *p++ = 't';
+    *p++ = ' ';
+    p = WriteObjFloat(p, u, precision);
+    *p++ = ' ';
+    p = WriteObjFloat(p, v, precision);
+    *p++ = '\n';
+    return p;
+}
+
+// " v[/vt][/vn]" of one face corner.
+static char* WriteObjCorner(char* p, const int* v, const int* vt, const int* vn, size_t i) {
+    *p++ = ' ';
+    p = WriteObjInt(p, v[i]);
+    if (vt || vn) {
+        *p++ = '/';
+        if (vt) {
+            p = WriteObjInt(p, vt[i]);
+        }
+        if (vn) {
+            *p++ = '/';
+            p = WriteObjInt(p, vn[i]);
+        }
+    }
+    return p;
+}
+
+static char* WriteObjTriangleLine(char* p, long long a, long long b, long long c) {
+    const long long corners[3] = {a, b, c};
+    *p++ = 'f';
+    for (int i = 0; i < 3; i++) {
+        char* index = p + 1;
+        *p++ = ' ';
+        p = WriteObjInt(p, corners[i]);
+        size_t len = static_cast<size_t>(p - index);
+        *p++ = '/';
+        p = WriteObjText(p, index, len);
+        *p++ = '/';
+        p = WriteObjText(p, index, len);
+    }
+    *p++ = '\n';
+    return p;
+}
+
+// Worker threads of the bulk functions of `ObjWriter`.
+// The workers claim chunks in order and format chunk `c` into ring slot
+// `c % slots`, once the writer has written the chunk that used the slot
+// before. The writer(the thread calling the bulk function) waits for the
+// chunks in order and writes every run of finished chunks at once.
+struct obj_writer_workers_t {
+    typedef char* (*format_fn)(const void* args, size_t begin, size_t end, int precision, char* out);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work_cv;   // workers: a chunk can be claimed, or stop
+    std::condition_variable ready_cv;  // writer: a chunk is formatted
+
+    // Ring of chunk buffers.
+    std::vector<std::vector<char> > buffers;
+    std::vector<size_t> lengths;
+    std::vector<size_t> slot_chunks;  // chunk formatted into each slot, or kNoChunk
+    size_t num_slots;
+
+    // Current section. Guarded by `mutex`.
+    format_fn format;
+    const void* args;
+    size_t count;
+    size_t num_chunks;  // 0 = no section in progress
+    int precision;
+    size_t next_chunk;      // next chunk to claim
+    size_t written_chunks;  // chunks written by the writer
+    unsigned int busy;      // chunks being formatted
+    bool abort;             // a write failed, claim no more chunks
+    bool stop;
+
+    static const size_t kNoChunk = static_cast<size_t>(-1);
+
+    explicit obj_writer_workers_t(unsigned int num_threads)
+        : num_slots(0),
+          format(NULL),
+          args(NULL),
+          count(0),
+          num_chunks(0),
+          precision(-1),
+          next_chunk(0),
+          written_chunks(0),
+          busy(0),
+          abort(false),
+          stop(false) {
+        // Two chunks per thread in flight balance uneven chunks and keep the
+        // workers busy while the writer waits on the file.
+        buffers.resize(2 * static_cast<size_t>(num_threads));
+        lengths.resize(buffers.size());
+        slot_chunks.resize(buffers.size(), kNoChunk);
+        threads.reserve(num_threads);
+        for (unsigned int t = 0; t < num_threads; t++) {
+            threads.push_back(std::thread(&obj_writer_workers_t::Work, this));
+        }
+    }
+
+    ~obj_writer_workers_t() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        work_cv.notify_all();
+        for (size_t t = 0; t < threads.size(); t++) {
+            threads[t].join();
+        }
+    }
+
+    bool CanClaim() const { return num_chunks > 0 && !abort && next_chunk < num_chunks && next_chunk < written_chunks + num_slots; }
+
+    void Work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            work_cv.wait(lock, [this]() { return stop || CanClaim(); });
+            if (stop) {
+                return;
+            }
+            const size_t chunk = next_chunk++;
+            const size_t slot = chunk % num_slots;
+            busy++;
+            lock.unlock();
+
+            const size_t begin = chunk * ObjWriter::kParallelChunkSize;
+            const size_t end = begin + ObjWriter::kParallelChunkSize < count ? begin + ObjWriter::kParallelChunkSize : count;
+            char* out = &buffers[slot][0];
+            lengths[slot] = static_cast<size_t>(format(args, begin, end, precision, out) - out);
+
+            lock.lock();
+            slot_chunks[slot] = chunk;
+            busy--;
+            ready_cv.notify_one();
+        }
+    }
+};
+
+const size_t obj_writer_workers_t::kNoChunk;
+
+// 0 = use all hardware threads.
+static unsigned int ResolveObjWriterThreads(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    return num_threads > 0 ? num_threads : 1;
+}
+
+// Arguments of the bulk functions for their `chunk_format_fn`.
+struct obj_write_floats_args_t {
+    const float* values;
+    const char* keyword;
+    size_t keyword_len;
+    bool flip_v;
+};
+
+struct obj_write_triangles_args_t {
+    const int* v;
+    const int* vt;
+    const int* vn;
+    long long first;
+};
+
+static char* FormatObjVec3Chunk(const void* args, size_t begin, size_t end, int precision, char* p) {
+    const obj_write_floats_args_t& a = *static_cast<const obj_write_floats_args_t*>(args);
+    for (size_t i = begin; i < end; i++) {
+        const float* xyz = a.values + 3 * i;
+        p = WriteObjVec3Line(p, a.keyword, a.keyword_len, xyz[0], xyz[1], xyz[2], precision);
+    }
+    return p;
+}
+
+static char* FormatObjTexCoordChunk(const void* args, size_t begin, size_t end, int precision, char* p) {
+    const obj_write_floats_args_t& a = *static_cast<const obj_write_floats_args_t*>(args);
+    for (size_t i = begin; i < end; i++) {
+        const float* uv = a.values + 2 * i;
+        p = WriteObjTexCoordLine(p, uv[0], a.flip_v ? 1.0f - uv[1] : uv[1], precision);
+    }
+    return p;
+}
+
+static char* FormatObjTrianglesChunk(const void* args, size_t begin, size_t end, int, char* p) {
+    const obj_write_triangles_args_t& a = *static_cast<const obj_write_triangles_args_t*>(args);
+    for (size_t i = begin; i < end; i++) {
+        *p++ = 'f';
+        for (size_t k = 3 * i; k < 3 * i + 3; k++) {
+            p = WriteObjCorner(p, a.v, a.vt, a.vn, k);
+        }
+        *p++ = '\n';
+    }
+    return p;
+}
+
+static char* FormatObjSequentialTrianglesChunk(const void* args, size_t begin, size_t end, int, char* p) {
+    const obj_write_triangles_args_t& a = *static_cast<const obj_write_triangles_args_t*>(args);
+    for (size_t i = begin; i < end; i++) {
+        long long index = a.first + 3 * static_cast<long long>(i);
+        p = WriteObjTriangleLine(p, index, index + 1, index + 2);
+    }
+    return p;
+}
+
+const size_t ObjWriter::kDefaultBufferSize;
+const size_t ObjWriter::kMinBufferSize;
+const size_t ObjWriter::kParallelChunkSize;
+
+ObjWriter::ObjWriter(size_t buffer_size)
+    : buffer_(buffer_size < kMinBufferSize ? kMinBufferSize : buffer_size),
+      workers_(NULL),
+      pos_(0),
+      flushed_bytes_(0),
+      file_(NULL),
+      good_(false),
+      precision_(-1) {}
+
+ObjWriter::~ObjWriter() {
+    Close();
+    delete workers_;
+}
+
+bool ObjWriter::Open(const char* filename) {
+    Close();
+#ifdef _MSC_VER
+    if (fopen_s(&file_, filename, "wb") != 0) {
+        file_ = NULL;
+    }
+#else
+    file_ = fopen(filename, "wb");
+#endif
+    pos_ = 0;
+    flushed_bytes_ = 0;
+    good_ = file_ != NULL;
+    if (file_) {
+        // Our buffer is the only one.
+        setvbuf(file_, NULL, _IONBF, 0);
+    }
+    return good_;
+}
+
+#ifdef _WIN32
+bool ObjWriter::Open(const wchar_t* filename) {
+    Close();
+#ifdef _MSC_VER
+    if (_wfopen_s(&file_, filename, L"wb") != 0) {
+        file_ = NULL;
+    }
+#else
+    file_ = _wfopen(filename, L"wb");
+#endif
+    pos_ = 0;
+    flushed_bytes_ = 0;
+    good_ = file_ != NULL;
+    if (file_) {
+        setvbuf(file_, NULL, _IONBF, 0);
+    }
+    return good_;
+}
+#endif
+
+bool ObjWriter::Close() {
+    if (!file_) {
+        return false;
+    }
+    Flush();
+    bool ok = good_;
+    if (fclose(file_) != 0) {
+        ok = false;
+    }
+    file_ = NULL;
+    good_ = false;
+    return ok;
+}
+
+bool ObjWriter::Flush() {
+    if (pos_ > 0 && good_) {
+        WriteToFile(&buffer_[0], pos_);
+    }
+    flushed_bytes_ += pos_;
+    pos_ = 0;
+    return good_;
+}
+
+bool ObjWriter::WriteToFile(const char* data, size_t len) {
+    if (!file_ || fwrite(data, 1, len, file_) != len) {
+        good_ = false;
+    }
+    return good_;
+}
+
+char* ObjWriter::Reserve(size_t len) {
+    if (buffer_.size() - pos_ < len) {
+        Flush();
+    }
+    return good_ ? &buffer_[pos_] : NULL;
+}
+
+void ObjWriter::SetPrecision(int precision) {
+    precision_ = precision > kObjWriterMaxPrecision ? kObjWriterMaxPrecision : precision;
+}
+
+void ObjWriter::Comment(const char* text) { Statement("#", text); }
+
+void ObjWriter::Statement(const char* keyword, const char* text) {
+    size_t keyword_len = strlen(keyword);
+    size_t text_len = strlen(text);
+    if (keyword_len + text_len + 2 > buffer_.size()) {
+        Write(keyword, keyword_len);
+        Write(" ", 1);
+        Write(text, text_len);
+        Write("\n", 1);
+        return;
+    }
+    char* p = Reserve(keyword_len + text_len + 2);
+    if (!p) {
+        return;
+    }
+    char* begin = p;
+    p = WriteObjText(p, keyword, keyword_len);
+    *p++ = ' ';
+    p = WriteObjText(p, text, text_len);
+    *p++ = '\n';
+    pos_ += static_cast<size_t>(p - begin);
+}
+
+void ObjWriter::Statement(const char* keyword, float x, float y, float z) {
+    size_t keyword_len = strlen(keyword);
+    char* p = Reserve(keyword_len + kObjWriterMaxVec3Line);
+    if (!p) {
+        return;
+    }
+    pos_ += static_cast<size_t>(WriteObjVec3Line(p, keyword, keyword_len, x, y, z, precision_) - p);
+}
+
+void ObjWriter::BlankLine() { Write("\n", 1); }
+
+void ObjWriter::Position(float x, float y, float z) { Statement("v", x, y, z); }
+
+void ObjWriter::Normal(float x, float y, float z) { Statement("vn", x, y, z); }
+
+void ObjWriter::TexCoord(float u, float v) {
+    char* p = Reserve(kObjWriterMaxVec2Line);
+    if (!p) {
+        return;
+    }
+    pos_ += static_cast<size_t>(WriteObjTexCoordLine(p, u, v, precision_) - p);
+}
+
+void ObjWriter::Face(const int* v, const int* vt, const int* vn, size_t num_corners) {
+    // Corners are reserved one by one, so faces of any size fit.
+    char* p = Reserve(2);
+    if (!p) {
+        return;
+    }
+    *p++ = 'f';
+    pos_++;
+    for (size_t i = 0; i < num_corners; i++) {
+        p = Reserve(3 * (kObjWriterMaxIntChars + 1) + 1);
+        if (!p) {
+            return;
+        }
+        pos_ += static_cast<size_t>(WriteObjCorner(p, v, vt, vn, i) - p);
+    }
+    p = Reserve(1);
+    if (p) {
+        *p = '\n';
+        pos_++;
+    }
+}
+
+void ObjWriter::Triangle(long long a, long long b, long long c) {
+    char* p = Reserve(kObjWriterMaxTriangleLine);
+    if (!p) {
+        return;
+    }
+    pos_ += static_cast<size_t>(WriteObjTriangleLine(p, a, b, c) - p);
+}
+
+void ObjWriter::Write(const char* data, size_t len) {
+    if (len > buffer_.size()) {
+        // Larger than the buffer: write it directly.
+        if (Flush()) {
+            WriteToFile(data, len);
+            flushed_bytes_ += len;
+        }
+        return;
+    }
+    char* p = Reserve(len);
+    if (!p) {
+        return;
+    }
+    memcpy(p, data, len);
+    pos_ += len;
+}
+
+bool ObjWriter::WriteChunksToFile(size_t first_chunk, size_t count) {
+    obj_writer_workers_t& workers = *workers_;
+#ifndef _WIN32
+    // Vectored writes of up to IOV_MAX chunks, retried on partial writes.
+    if (!file_) {
+        good_ = false;
+        return false;
+    }
+    int fd = fileno(file_);
+    struct iovec iov[IOV_MAX < 64 ? IOV_MAX : 64];
+    const size_t max_iov = sizeof(iov) / sizeof(iov[0]);
+    size_t chunk = first_chunk;
+    const size_t end_chunk = first_chunk + count;
+    while (chunk < end_chunk) {
+        size_t n = 0;
+        for (; chunk < end_chunk && n < max_iov; chunk++) {
+            const size_t slot = chunk % workers.num_slots;
+            if (workers.lengths[slot] > 0) {
+                iov[n].iov_base = &workers.buffers[slot][0];
+                iov[n].iov_len = workers.lengths[slot];
+                n++;
+            }
+        }
+        size_t first = 0;
+        while (first < n) {
+            ssize_t written = writev(fd, &iov[first], static_cast<int>(n - first));
+            if (written < 0) {
+                good_ = false;
+                return false;
+            }
+            flushed_bytes_ += static_cast<unsigned long long>(written);
+            size_t left = static_cast<size_t>(written);
+            while (first < n && left >= iov[first].iov_len) {
+                left -= iov[first].iov_len;
+                first++;
+            }
+            if (left > 0) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+    }
+    return true;
+#else
+    // WriteFileGather needs unbuffered, page aligned I/O, so the chunks are
+    // gathered into the write buffer instead, which is written whenever it
+    // is full: one fwrite per buffer rather than one per chunk.
+    for (size_t chunk = first_chunk; chunk < first_chunk + count && good_; chunk++) {
+        const size_t slot = chunk % workers.num_slots;
+        const char* data = workers.lengths[slot] > 0 ? &workers.buffers[slot][0] : NULL;
+        size_t len = workers.lengths[slot];
+        while (len > 0 && good_) {
+            if (pos_ == buffer_.size()) {
+                Flush();
+            }
+            size_t n = buffer_.size() - pos_ < len ? buffer_.size() - pos_ : len;
+            memcpy(&buffer_[pos_], data, n);
+            pos_ += n;
+            data += n;
+            len -= n;
+        }
+    }
+    return good_;
+#endif
+}
+
+void ObjWriter::WriteChunks(chunk_format_fn format, const void* args, size_t count, size_t max_line_len, unsigned int num_threads) {
+    if (!good_ || count == 0) {
+        return;
+    }
+    num_threads = ResolveObjWriterThreads(num_threads);
+    size_t num_chunks = (count + kParallelChunkSize - 1) / kParallelChunkSize;
+    if (num_threads <= 1 || num_chunks <= 1) {
+        // Format in place, chunk by chunk.
+        for (size_t begin = 0; begin < count && good_; begin += kParallelChunkSize) {
+            size_t end = begin + kParallelChunkSize < count ? begin + kParallelChunkSize : count;
+            for (size_t i = begin; i < end; i++) {
+                char* p = Reserve(max_line_len);
+                if (!p) {
+                    return;
+                }
+                pos_ += static_cast<size_t>(format(args, i, i + 1, precision_, p) - p);
+            }
+        }
+        return;
+    }
+
+#ifndef _WIN32
+    // The pending text goes first. On Windows the chunks are appended to it.
+    if (!Flush()) {
+        return;
+    }
+#endif
+
+    if (workers_ && workers_->threads.size() != num_threads) {
+        delete workers_;
+        workers_ = NULL;
+    }
+    if (!workers_) {
+        workers_ = new obj_writer_workers_t(num_threads);
+    }
+    obj_writer_workers_t& workers = *workers_;
+    // No worker runs between sections, so the buffers can be resized here.
+    workers.num_slots = num_chunks < workers.buffers.size() ? num_chunks : workers.buffers.size();
+    size_t chunk_capacity = kParallelChunkSize * max_line_len;
+    for (size_t slot = 0; slot < workers.num_slots; slot++) {
+        if (workers.buffers[slot].size() < chunk_capacity) {
+            workers.buffers[slot].resize(chunk_capacity);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    workers.format = format;
+    workers.args = args;
+    workers.count = count;
+    workers.precision = precision_;
+    workers.next_chunk = 0;
+    workers.written_chunks = 0;
+    workers.abort = false;
+    std::fill(workers.slot_chunks.begin(), workers.slot_chunks.end(), obj_writer_workers_t::kNoChunk);
+    workers.num_chunks = num_chunks;
+    workers.work_cv.notify_all();
+
+    size_t chunk = 0;
+    while (chunk < num_chunks) {
+        workers.ready_cv.wait(lock, [&]() { return workers.slot_chunks[chunk % workers.num_slots] == chunk; });
+        // Every finished chunk in order goes into one write.
+        size_t n = 1;
+        while (chunk + n < num_chunks && n < workers.num_slots && workers.slot_chunks[(chunk + n) % workers.num_slots] == chunk + n) {
+            n++;
+        }
+        lock.unlock();
+        bool ok = WriteChunksToFile(chunk, n);
+        lock.lock();
+        if (!ok) {
+            workers.abort = true;
+            break;
+        }
+        chunk += n;
+        workers.written_chunks = chunk;
+        workers.work_cv.notify_all();
+    }
+    // `args` and the buffers must outlive the chunks still being formatted.
+    workers.ready_cv.wait(lock, [&]() { return workers.busy == 0; });
+    workers.num_chunks = 0;
+}
+
+void ObjWriter::Positions(const float* xyz, size_t count, unsigned int num_threads) {
+    obj_write_floats_args_t args = {xyz, "v", 1, false};
+    WriteChunks(FormatObjVec3Chunk, &args, count, kObjWriterMaxVec3Line + 1, num_threads);
+}
+
+void ObjWriter::Normals(const float* xyz, size_t count, unsigned int num_threads) {
+    obj_write_floats_args_t args = {xyz, "vn", 2, false};
+    WriteChunks(FormatObjVec3Chunk, &args, count, kObjWriterMaxVec3Line + 2, num_threads);
+}
+
+void ObjWriter::TexCoords(const float* uv, size_t count, bool flip_v, unsigned int num_threads) {
+    obj_write_floats_args_t args = {uv, "vt", 2, flip_v};
+    WriteChunks(FormatObjTexCoordChunk, &args, count, kObjWriterMaxVec2Line, num_threads);
+}
+
+void ObjWriter::Triangles(const int* v, const int* vt, const int* vn, size_t count, unsigned int num_threads) {
+    obj_write_triangles_args_t args = {v, vt, vn, 0};
+    WriteChunks(FormatObjTrianglesChunk, &args, count, kObjWriterMaxTriangleLine, num_threads);
+}
+
+void ObjWriter::SequentialTriangles(long long first, size_t count, unsigned int num_threads) {
+    obj_write_triangles_args_t args = {NULL, NULL, NULL, first};
+    WriteChunks(FormatObjSequentialTrianglesChunk, &args, count, kObjWriterMaxTriangleLine, num_threads);
+}
+
+// Grid cells of `ObjAttributeDeduplicator` are in (-2^62, 2^62).
+static const double kObjAttributeMaxCell = 4611686018427387904.0;
+
+// Quantized key of one component of `ObjAttributeDeduplicator`.
+static long long QuantizeObjAttribute(float value, float inv_tolerance) {
+    unsigned int bits;
+    float v = value == 0.0f ? 0.0f : value;  // -0 = +0
+    memcpy(&bits, &v, sizeof(bits));
+    if (inv_tolerance == 0.0f) {
+        return static_cast<long long>(bits);
+    }
+    if (!(value == value)) {
+        return LLONG_MIN;  // NaN
+    }
+    double q = std::floor(static_cast<double>(value) * static_cast<double>(inv_tolerance) + 0.5);
+    if (q <= -kObjAttributeMaxCell || q >= kObjAttributeMaxCell) {
+        // Beyond the grid the float spacing is far above the tolerance, so
+        // merge bitwise equal values only, keyed outside the grid range.
+        return (1LL << 62) + static_cast<long long>(bits);
+    }
+    return static_cast<long long>(q);
+}
+
+static size_t HashObjAttributeKey(const long long* key, int num_components) {
+    unsigned long long h = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < num_components; i++) {
+        h = (h ^ static_cast<unsigned long long>(key[i])) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    return static_cast<size_t>(h);
+}
+
+ObjAttributeDeduplicator::ObjAttributeDeduplicator(int num_components, float tolerance)
+    : num_components_(num_components < 1 ? 1 : (num_components > 4 ? 4 : num_components)),
+      inv_tolerance_(tolerance > 0.0f ? 1.0f / tolerance : 0.0f),
+      num_slots_(0) {
+    Rehash(64);
+}
+
+void ObjAttributeDeduplicator::Clear() {
+    values_.clear();
+    size_t stride = static_cast<size_t>(num_components_) + 1;
+    for (size_t slot = 0; slot < num_slots_; slot++) {
+        slots_[slot * stride] = -1;
+    }
+}
+
+void ObjAttributeDeduplicator::Reserve(size_t count) {
+    values_.reserve(count * static_cast<size_t>(num_components_));
+    if (2 * count > num_slots_) {
+        Rehash(2 * count);
+    }
+}
+
+void ObjAttributeDeduplicator::Rehash(size_t num_slots) {
+    size_t n = 64;
+    while (n < num_slots) {
+        n *= 2;
+    }
+    size_t stride = static_cast<size_t>(num_components_) + 1;
+    std::vector<long long> old_slots(n * stride, -1);
+    old_slots.swap(slots_);
+    size_t old_num_slots = num_slots_;
+    num_slots_ = n;
+    size_t mask = n - 1;
+    for (size_t i = 0; i < old_num_slots; i++) {
+        const long long* old_slot = &old_slots[i * stride];
+        if (old_slot[0] < 0) {
+            continue;
+        }
+        size_t slot = HashObjAttributeKey(old_slot + 1, num_components_) & mask;
+        while (slots_[slot * stride] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        memcpy(&slots_[slot * stride], old_slot, stride * sizeof(long long));
+    }
+}
+
+int ObjAttributeDeduplicator::Insert(const float* value) {
+    long long key[4];
+    for (int i = 0; i < num_components_; i++) {
+        key[i] = QuantizeObjAttribute(value[i], inv_tolerance_);
+    }
+    size_t components = static_cast<size_t>(num_components_);
+    size_t stride = components + 1;
+    size_t mask = num_slots_ - 1;
+    size_t slot = HashObjAttributeKey(key, num_components_) & mask;
+    for (;;) {
+        const long long* entry = &slots_[slot * stride];
+        if (entry[0] < 0) {
+            break;
+        }
+        if (memcmp(entry + 1, key, components * sizeof(long long)) == 0) {
+            return static_cast<int>(entry[0]);
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    int index = static_cast<int>(size());
+    values_.insert(values_.end(), value, value + components);
+    long long* entry = &slots_[slot * stride];
+    entry[0] = index;
+    memcpy(entry + 1, key, components * sizeof(long long));
+    // Keep the load factor at most 1/2.
+    if (2 * size() > num_slots_) {
+        Rehash(2 * num_slots_);
+    }
+    return index;
+}
+
+}  // namespace tinyobj
+
+#endif  // TINYOBJWRITER_IMPLEMENTATION
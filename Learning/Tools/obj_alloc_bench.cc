@@ -0,0 +1,175 @@
+//
+// Command-line harness for the ParseArena mode of tiny_obj_loader.
+// Loads an .obj file(or a synthetic face-heavy grid) with LoadObj and
+// LoadObjParallel, once with the temporary containers on the heap and once
+// in a ParseArena, and reports the heap allocations(global operator new) and
+// the time of each load.
+//
+// Build(no engine needed):
+//   g++ -O2 -std=c++17 -pthread -o obj_alloc_bench obj_alloc_bench.cc
+//   cl /O2 /std:c++17 /EHsc obj_alloc_bench.cc
+//
+// Usage:
+//   obj_alloc_bench [-i input.obj | -n num_faces] [-t threads]
+//
+//   -i  Loads a .obj file.
+//   -n  Loads a synthetic grid with this many `f v/vt/vn` triangles(default
+//       1000000), written to `obj_alloc_bench.tmp.obj` and removed afterwards.
+//   -t  Threads of LoadObjParallel. 0 = all hardware threads(default).
+//
+
+#include "obj_bench_common.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+// Replacing operator new with malloc/free is the standard way to count heap
+// allocations, GCC cannot tell inlined replacements apart from the built-ins.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+static std::atomic<unsigned long long> g_num_allocations(0);
+static std::atomic<unsigned long long> g_num_bytes(0);
+
+void* operator new(size_t size) {
+    g_num_allocations++;
+    g_num_bytes += size;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Square grid of quads split into triangles, every corner with its own
+// texcoord and normal index, so that nearly all lines are faces.
+static bool WriteGrid(const char* filename, size_t num_faces) {
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        return false;
+    }
+    size_t n = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(num_faces) / 2.0)));
+    if (n == 0) {
+        n = 1;
+    }
+    for (size_t y = 0; y <= n; y++) {
+        for (size_t x = 0; x <= n; x++) {
+            fprintf(fp, "v %.4f %.4f 0\nvt %.4f %.4f\n", static_cast<double>(x), static_cast<double>(y), static_cast<double>(x) / n,
+                static_cast<double>(y) / n);
+        }
+    }
+    fprintf(fp, "vn 0 0 1\ng grid\n");
+    size_t written = 0;
+    for (size_t y = 0; y < n && written < num_faces; y++) {
+        for (size_t x = 0; x < n && written < num_faces; x++) {
+            size_t a = y * (n + 1) + x + 1;
+            size_t b = a + 1;
+            size_t c = a + n + 1;
+            size_t d = c + 1;
+            fprintf(fp, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, b, b, d, d);
+            written++;
+            if (written < num_faces) {
+                fprintf(fp, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, d, d, c, c);
+                written++;
+            }
+        }
+    }
+    return fclose(fp) == 0;
+}
+
+// Loads `filename` with LoadObj or LoadObjParallel and prints the heap
+// allocations of the load.
+static bool Load(const char* label, const char* filename, bool parallel, unsigned int num_threads, tinyobj::ParseArena* arena,
+    size_t* num_indices) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    unsigned long long allocations_before = g_num_allocations;
+    unsigned long long bytes_before = g_num_bytes;
+    double t0 = Now();
+    bool ok = parallel ? tinyobj::LoadObjParallel(&attrib, &shapes, &materials, &warn, &err, filename, NULL, true, true, num_threads, arena)
+                       : tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, NULL, true, true, arena);
+    double t = Now() - t0;
+    unsigned long long allocations = g_num_allocations - allocations_before;
+    unsigned long long bytes = g_num_bytes - bytes_before;
+    if (!ok) {
+        fprintf(stderr, "failed to load %s: %s\n", filename, err.c_str());
+        return false;
+    }
+    *num_indices = 0;
+    for (size_t s = 0; s < shapes.size(); s++) {
+        *num_indices += shapes[s].mesh.indices.size();
+    }
+    printf("%-24s %10llu allocations, %8.1f MB, %.3f s", label, allocations, bytes / 1e6, t);
+    if (arena) {
+        printf("  (arena: %zu allocations, %zu blocks)", arena->NumAllocations(), arena->NumBlockAllocations());
+    }
+    printf("\n");
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* input = NULL;
+    size_t num_faces = 1000000;
+    unsigned int num_threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            input = argv[++i];
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            num_faces = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            num_threads = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        } else {
+            fprintf(stderr, "usage: %s [-i input.obj | -n num_faces] [-t threads]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const char* filename = input;
+    const char* synthetic = "obj_alloc_bench.tmp.obj";
+    if (!filename) {
+        if (!WriteGrid(synthetic, num_faces)) {
+            fprintf(stderr, "failed to write %s\n", synthetic);
+            return 1;
+        }
+        filename = synthetic;
+    }
+
+    size_t heap_indices = 0, arena_indices = 0, parallel_indices = 0;
+    tinyobj::ParseArena arena;
+    bool ok = Load("LoadObj, heap", filename, false, 0, NULL, &heap_indices);
+    ok = ok && Load("LoadObj, arena", filename, false, 0, &arena, &arena_indices);
+    // Reset keeps the largest block, so a second parse of the same file needs
+    // fewer block allocations.
+    arena.Reset();
+    ok = ok && Load("LoadObj, reused arena", filename, false, 0, &arena, &arena_indices);
+    arena.Release();
+    ok = ok && Load("LoadObjParallel, heap", filename, true, num_threads, NULL, &parallel_indices);
+    ok = ok && Load("LoadObjParallel, arena", filename, true, num_threads, &arena, &parallel_indices);
+    if (!input) {
+        remove(synthetic);
+    }
+    if (!ok) {
+        return 1;
+    }
+    if (heap_indices != arena_indices || heap_indices != parallel_indices) {
+        printf("MISMATCH: %zu / %zu / %zu indices\n", heap_indices, arena_indices, parallel_indices);
+        return 2;
+    }
+    printf("%zu triangles\n", heap_indices / 3);
+    return 0;
+}
@@ -0,0 +1,147 @@
+//
+// Shared pieces of the command-line harnesses in this directory: the timer,
+// the synthetic grid fixture, .obj loading for `-i` and the triangle
+// comparison of the reordering/clustering checks.
+// Includes the implementation of tiny_obj_loader, so a harness includes this
+// header instead of tiny_obj_loader.h and is still built as a single file.
+//
+
+#ifndef OBJ_BENCH_COMMON_H_
+#define OBJ_BENCH_COMMON_H_
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../Source/Learning/tiny_obj_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Seconds of a steady clock.
+static inline double Now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Triangles of a square grid of about `num_triangles` triangles, as 0-based
+// vertex indices into its (n + 1) x (n + 1) vertices, in row order.
+static inline std::vector<int> GridTriangles(size_t num_triangles, size_t* n_out) {
+    size_t n = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(num_triangles) / 2.0)));
+    if (n == 0) {
+        n = 1;
+    }
+    std::vector<int> corners;
+    corners.reserve(6 * n * n);
+    for (size_t y = 0; y < n; y++) {
+        for (size_t x = 0; x < n; x++) {
+            int a = static_cast<int>(y * (n + 1) + x);
+            int b = a + 1;
+            int c = a + static_cast<int>(n) + 1;
+            int d = c + 1;
+            int quad[6] = {a, b, d, a, d, c};
+            corners.insert(corners.end(), quad, quad + 6);
+        }
+    }
+    *n_out = n;
+    return corners;
+}
+
+// Two shapes over the same grid vertices: "grid" with the triangles in row
+// order and "scan" with them shuffled, as in the output of photogrammetry
+// tools. Every position has a texcoord, all corners share one normal.
+// `height_noise` > 0 displaces the vertices by a random height in
+// [-height_noise, height_noise].
+static inline void MakeGridShapes(size_t num_triangles, float height_noise, tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes) {
+    size_t n = 0;
+    const std::vector<int> corners = GridTriangles(num_triangles, &n);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> height(-height_noise, height_noise);
+    for (size_t y = 0; y <= n; y++) {
+        for (size_t x = 0; x <= n; x++) {
+            attrib->vertices.push_back(static_cast<tinyobj::real_t>(x));
+            attrib->vertices.push_back(static_cast<tinyobj::real_t>(y));
+            attrib->vertices.push_back(height_noise > 0.0f ? height(rng) : 0.0f);
+            attrib->texcoords.push_back(static_cast<tinyobj::real_t>(x) / n);
+            attrib->texcoords.push_back(static_cast<tinyobj::real_t>(y) / n);
+        }
+    }
+    attrib->normals.push_back(0.0f);
+    attrib->normals.push_back(0.0f);
+    attrib->normals.push_back(1.0f);
+
+    std::vector<size_t> order(corners.size() / 3);
+    for (size_t t = 0; t < order.size(); t++) {
+        order[t] = t;
+    }
+    shapes->resize(2);
+    for (int s = 0; s < 2; s++) {
+        if (s == 1) {
+            std::shuffle(order.begin(), order.end(), rng);
+        }
+        tinyobj::shape_t& shape = (*shapes)[s];
+        shape.name = s == 0 ? "grid" : "scan";
+        for (size_t t = 0; t < order.size(); t++) {
+            for (int k = 0; k < 3; k++) {
+                tinyobj::index_t idx;
+                idx.vertex_index = corners[3 * order[t] + k];
+                idx.normal_index = 0;
+                idx.texcoord_index = idx.vertex_index;
+                shape.mesh.indices.push_back(idx);
+            }
+            shape.mesh.num_face_vertices.push_back(3);
+            shape.mesh.material_ids.push_back(0);
+            shape.mesh.smoothing_group_ids.push_back(0);
+        }
+    }
+}
+
+// Loads the shapes of `filename` with LoadObjParallel, as the importers do.
+static inline bool LoadShapes(const char* filename, tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes) {
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObjParallel(attrib, shapes, &materials, &warn, &err, filename)) {
+        fprintf(stderr, "failed to load %s: %s\n", filename, err.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The `-i` / `-n` input of the harnesses: the shapes of `input`, or the grid
+// shapes of MakeGridShapes when `input` is NULL.
+static inline bool LoadOrMakeShapes(const char* input, size_t num_triangles, float height_noise, tinyobj::attrib_t* attrib,
+    std::vector<tinyobj::shape_t>* shapes) {
+    if (input) {
+        return LoadShapes(input, attrib, shapes);
+    }
+    MakeGridShapes(num_triangles, height_noise, attrib, shapes);
+    return true;
+}
+
+// Triangles given as `corner_size` ints per corner, each rotated to start at
+// its smallest corner(the winding is kept) and sorted, so that two orderings
+// of the same triangles compare equal.
+static inline std::vector<std::vector<int> > SortedTriangles(const std::vector<int>& corners, size_t corner_size) {
+    const size_t triangle_size = 3 * corner_size;
+    std::vector<std::vector<int> > triangles(corners.size() / triangle_size);
+    for (size_t t = 0; t < triangles.size(); t++) {
+        const int* triangle = &corners[t * triangle_size];
+        int first = 0;
+        for (int k = 1; k < 3; k++) {
+            if (std::lexicographical_compare(triangle + k * corner_size, triangle + (k + 1) * corner_size, triangle + first * corner_size,
+                    triangle + (first + 1) * corner_size)) {
+                first = k;
+            }
+        }
+        triangles[t].reserve(triangle_size);
+        for (int k = 0; k < 3; k++) {
+            const int* corner = triangle + ((first + k) % 3) * corner_size;
+            triangles[t].insert(triangles[t].end(), corner, corner + corner_size);
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+#endif  // OBJ_BENCH_COMMON_H_
@@ -0,0 +1,370 @@
+//
+// Command-line harness for the .obj export path of AExportOBJActor.
+// Writes a mesh in the actor's layout(unshared per-corner v/vn/vt and
+// `f i/i/i` triangles, or the indexed layout of `bIndexedExport`) with
+// tinyobj::ObjWriter, serially and with the parallel chunked formatter,
+// checks that both files are byte-identical and reports the throughput of
+// each. With `-b` the mesh is also written as the actor did before
+// ObjWriter(std::ofstream, `std::endl` after every line) for comparison.
+//
+// Build(no engine needed):
+//   g++ -O2 -std=c++17 -pthread -o obj_export_bench obj_export_bench.cc
+//   cl /O2 /std:c++17 /EHsc obj_export_bench.cc
+//
+// Usage:
+//   obj_export_bench [-i input.obj | -n num_triangles] [-t threads] [-p precision] [-x [tolerance]] [-b] output.obj
+//
+//   -i  Exports the triangles of a .obj file(loaded with LoadObjParallel).
+//   -n  Exports a random mesh with this many triangles(default 1000000).
+//   -t  Formatting threads of the parallel pass. 0 = all hardware threads(default).
+//   -p  Float precision as AExportOBJActor::floatPrecision(default 4, <0 = shortest).
+//   -x  Indexed export as AExportOBJActor::bIndexedExport: positions are shared
+//       by vertex index, normals and texcoords are deduplicated with the
+//       given tolerance(default 1e-5).
+//   -b  Baseline: also writes the mesh with std::ofstream and std::endl, as
+//       ExportToOBJFile did before ObjWriter, to `output.obj.baseline`
+//       (removed afterwards). Its text is not compared: iostreams may format
+//       some values(e.g. -0) differently.
+//
+// The serial result is written to `output.obj.serial` and removed when it
+// matches.
+//
+
+#include "obj_bench_common.h"
+#define TINYOBJWRITER_IMPLEMENTATION
+#include "../Source/Learning/tiny_obj_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+// Export data, as gathered by AExportOBJActor.
+struct export_mesh_t {
+    std::vector<float> positions;  // xyz per corner
+    std::vector<float> normals;    // xyz per corner
+    std::vector<float> uvs;        // uv per corner(UE convention, v is flipped on write)
+    std::vector<int> vertex_ids;   // source vertex per corner(FVertexID)
+    std::vector<int> normal_ids;   // source normal/texcoord per corner(stands in for FVertexInstanceID)
+    std::vector<int> uv_ids;
+
+    // Indexed export: 1-based indices per corner into the unique values above.
+    std::vector<int> position_indices;
+    std::vector<int> uv_indices;
+    std::vector<int> normal_indices;
+};
+
+static void MakeRandomMesh(size_t num_triangles, export_mesh_t* mesh) {
+    size_t n = 3 * num_triangles;
+    mesh->positions.resize(3 * n);
+    mesh->normals.resize(3 * n);
+    mesh->uvs.resize(2 * n);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < n; i++) {
+        float nx = 2.0f * unit(rng) - 1.0f;
+        float ny = 2.0f * unit(rng) - 1.0f;
+        float nz = 2.0f * unit(rng) - 1.0f;
+        float len = std::sqrt(nx * nx + ny * ny + nz * nz) + 1e-6f;
+        for (int k = 0; k < 3; k++) {
+            mesh->positions[3 * i + k] = pos(rng);
+        }
+        mesh->normals[3 * i + 0] = nx / len;
+        mesh->normals[3 * i + 1] = ny / len;
+        mesh->normals[3 * i + 2] = nz / len;
+        mesh->uvs[2 * i + 0] = unit(rng);
+        mesh->uvs[2 * i + 1] = unit(rng);
+        mesh->vertex_ids.push_back(static_cast<int>(i));
+        mesh->normal_ids.push_back(static_cast<int>(i));
+        mesh->uv_ids.push_back(static_cast<int>(i));
+    }
+}
+
+static bool LoadMesh(const char* filename, export_mesh_t* mesh) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    if (!LoadShapes(filename, &attrib, &shapes)) {
+        return false;
+    }
+    for (size_t s = 0; s < shapes.size(); s++) {
+        const std::vector<tinyobj::index_t>& indices = shapes[s].mesh.indices;
+        for (size_t i = 0; i < indices.size(); i++) {
+            const tinyobj::index_t& idx = indices[i];
+            mesh->vertex_ids.push_back(idx.vertex_index);
+            mesh->normal_ids.push_back(idx.normal_index);
+            mesh->uv_ids.push_back(idx.texcoord_index);
+            for (int k = 0; k < 3; k++) {
+                mesh->positions.push_back(static_cast<float>(attrib.vertices[3 * idx.vertex_index + k]));
+                mesh->normals.push_back(idx.normal_index >= 0 ? static_cast<float>(attrib.normals[3 * idx.normal_index + k]) : 0.0f);
+            }
+            for (int k = 0; k < 2; k++) {
+                // Back to the UE convention, the writer flips v again.
+                float t = idx.texcoord_index >= 0 ? static_cast<float>(attrib.texcoords[2 * idx.texcoord_index + k]) : 0.0f;
+                mesh->uvs.push_back(k == 1 ? 1.0f - t : t);
+            }
+        }
+    }
+    return true;
+}
+
+// Same deduplication as AExportOBJActor::GetTriangleDataFromMeshData with
+// bIndexedExport.
+static void MakeIndexed(const export_mesh_t& mesh, float tolerance, export_mesh_t* indexed) {
+    size_t n = mesh.vertex_ids.size();
+    int max_id = 0;
+    for (size_t i = 0; i < n; i++) {
+        max_id = std::max(max_id, std::max(mesh.vertex_ids[i], std::max(mesh.normal_ids[i], mesh.uv_ids[i])));
+    }
+    std::vector<int> position_remap(static_cast<size_t>(max_id + 1), -1);
+    std::vector<int> normal_remap(static_cast<size_t>(max_id + 2), -1);  // +1: missing(-1) is id 0
+    std::vector<int> uv_remap(static_cast<size_t>(max_id + 2), -1);
+    tinyobj::ObjAttributeDeduplicator normal_dedup(3, tolerance);
+    tinyobj::ObjAttributeDeduplicator uv_dedup(2, tolerance);
+    normal_dedup.Reserve(static_cast<size_t>(max_id + 1));
+    indexed->position_indices.reserve(n);
+    indexed->uv_indices.reserve(n);
+    indexed->normal_indices.reserve(n);
+    uv_dedup.Reserve(static_cast<size_t>(max_id + 1));
+    for (size_t i = 0; i < n; i++) {
+        int& position_index = position_remap[static_cast<size_t>(mesh.vertex_ids[i])];
+        if (position_index < 0) {
+            position_index = static_cast<int>(indexed->positions.size() / 3);
+            indexed->positions.insert(indexed->positions.end(), &mesh.positions[3 * i], &mesh.positions[3 * i] + 3);
+        }
+        indexed->position_indices.push_back(position_index + 1);
+        int& normal_index = normal_remap[static_cast<size_t>(mesh.normal_ids[i] + 1)];
+        if (normal_index < 0) {
+            normal_index = normal_dedup.Insert(&mesh.normals[3 * i]);
+        }
+        int& uv_index = uv_remap[static_cast<size_t>(mesh.uv_ids[i] + 1)];
+        if (uv_index < 0) {
+            uv_index = uv_dedup.Insert(&mesh.uvs[2 * i]);
+        }
+        indexed->normal_indices.push_back(normal_index + 1);
+        indexed->uv_indices.push_back(uv_index + 1);
+    }
+    indexed->normals = normal_dedup.values();
+    indexed->uvs = uv_dedup.values();
+}
+
+// Same statements and sections as AExportOBJActor::ExportToOBJFile.
+static bool WriteMesh(const export_mesh_t& mesh, const char* filename, int precision, unsigned int num_threads,
+    unsigned long long* num_bytes) {
+    tinyobj::ObjWriter out;
+    if (!out.Open(filename)) {
+        return false;
+    }
+    out.SetPrecision(precision);
+    size_t num_positions = mesh.positions.size() / 3;
+    size_t num_normals = mesh.normals.size() / 3;
+    size_t num_uvs = mesh.uvs.size() / 2;
+
+    out.Comment("Export from obj_export_bench");
+    out.BlankLine();
+    out.Statement("mtllib", "bench.mtl");
+    out.Statement("g", "bench");
+    out.BlankLine();
+    out.Positions(num_positions ? &mesh.positions[0] : NULL, num_positions, num_threads);
+    out.BlankLine();
+    out.Normals(num_normals ? &mesh.normals[0] : NULL, num_normals, num_threads);
+    out.BlankLine();
+    out.TexCoords(num_uvs ? &mesh.uvs[0] : NULL, num_uvs, true, num_threads);
+    out.BlankLine();
+    out.Statement("usemtl", "bench");
+    out.BlankLine();
+    if (!mesh.position_indices.empty()) {
+        out.Triangles(&mesh.position_indices[0], &mesh.uv_indices[0], &mesh.normal_indices[0], mesh.position_indices.size() / 3,
+            num_threads);
+    } else {
+        out.SequentialTriangles(1, num_positions / 3, num_threads);
+    }
+
+    *num_bytes = out.bytes_written();
+    return out.Close();
+}
+
+// Same statements and sections as WriteMesh, written the way ExportToOBJFile
+// did before ObjWriter: std::ofstream with `std::endl`(a flush) after every
+// line.
+static bool WriteMeshBaseline(const export_mesh_t& mesh, const char* filename, int precision, unsigned long long* num_bytes) {
+    std::ofstream out(filename);
+    if (!out) {
+        return false;
+    }
+    size_t num_positions = mesh.positions.size() / 3;
+    size_t num_normals = mesh.normals.size() / 3;
+    size_t num_uvs = mesh.uvs.size() / 2;
+
+    out << "# Export from obj_export_bench" << std::endl;
+    out << std::endl;
+    out << "mtllib " << "bench.mtl" << std::endl;
+    out << "g " << "bench" << std::endl;
+    out << std::endl;
+    if (precision >= 0) {
+        out << std::setprecision(precision) << std::fixed;
+    } else {
+        out << std::setprecision(9);
+    }
+    for (size_t i = 0; i < num_positions; ++i) {
+        const float* v = &mesh.positions[3 * i];
+        out << "v " << v[0] << " " << v[1] << " " << v[2] << std::endl;
+    }
+    out << std::endl;
+    for (size_t i = 0; i < num_normals; ++i) {
+        const float* n = &mesh.normals[3 * i];
+        out << "vn " << n[0] << " " << n[1] << " " << n[2] << std::endl;
+    }
+    out << std::endl;
+    for (size_t i = 0; i < num_uvs; ++i) {
+        const float* uv = &mesh.uvs[2 * i];
+        out << "vt " << uv[0] << " " << 1.0 - uv[1] << std::endl;
+    }
+    out << std::endl;
+    out << "usemtl " << "bench" << std::endl << std::endl;
+    if (!mesh.position_indices.empty()) {
+        for (size_t i = 0; i < mesh.position_indices.size(); i += 3) {
+            out << "f";
+            for (size_t k = i; k < i + 3; k++) {
+                out << " " << mesh.position_indices[k] << "/" << mesh.uv_indices[k] << "/" << mesh.normal_indices[k];
+            }
+            out << std::endl;
+        }
+    } else {
+        for (size_t i = 0; i < num_positions; i += 3) {
+            out << "f " << (i + 1) << "/" << (i + 1) << "/" << (i + 1) << " " << (i + 2) << "/" << (i + 2) << "/" << (i + 2) << " "
+                << (i + 3) << "/" << (i + 3) << "/" << (i + 3) << std::endl;
+        }
+    }
+
+    *num_bytes = static_cast<unsigned long long>(out.tellp());
+    out.close();
+    return !out.fail();
+}
+
+static bool SameFiles(const char* a, const char* b) {
+    FILE* fa = fopen(a, "rb");
+    FILE* fb = fopen(b, "rb");
+    bool same = fa && fb;
+    std::vector<char> ba(1 << 20), bb(1 << 20);
+    while (same) {
+        size_t na = fread(&ba[0], 1, ba.size(), fa);
+        size_t nb = fread(&bb[0], 1, bb.size(), fb);
+        if (na != nb || memcmp(&ba[0], &bb[0], na) != 0) {
+            same = false;
+        }
+        if (na == 0) {
+            break;
+        }
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+int main(int argc, char** argv) {
+    const char* input = NULL;
+    const char* output = NULL;
+    size_t num_triangles = 1000000;
+    unsigned int num_threads = 0;
+    int precision = 4;
+    bool indexed = false;
+    float tolerance = 1e-5f;
+    bool baseline = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            input = argv[++i];
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            num_triangles = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            num_threads = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            precision = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-x")) {
+            indexed = true;
+            if (i + 2 < argc && argv[i + 1][0] != '-') {
+                tolerance = static_cast<float>(atof(argv[++i]));
+            }
+        } else if (!strcmp(argv[i], "-b")) {
+            baseline = true;
+        } else if (!output && argv[i][0] != '-') {
+            output = argv[i];
+        } else {
+            output = NULL;
+            break;
+        }
+    }
+    if (!output) {
+        fprintf(stderr, "usage: %s [-i input.obj | -n num_triangles] [-t threads] [-p precision] [-x [tolerance]] [-b] output.obj\n", argv[0]);
+        return 1;
+    }
+
+    export_mesh_t mesh;
+    if (input ? !LoadMesh(input, &mesh) : (MakeRandomMesh(num_triangles, &mesh), false)) {
+        return 1;
+    }
+    size_t num_triangles_in = mesh.vertex_ids.size() / 3;
+    if (indexed) {
+        double dedup_start = Now();
+        export_mesh_t indexed_mesh;
+        MakeIndexed(mesh, tolerance, &indexed_mesh);
+        mesh.positions.swap(indexed_mesh.positions);
+        mesh.normals.swap(indexed_mesh.normals);
+        mesh.uvs.swap(indexed_mesh.uvs);
+        mesh.position_indices.swap(indexed_mesh.position_indices);
+        mesh.uv_indices.swap(indexed_mesh.uv_indices);
+        mesh.normal_indices.swap(indexed_mesh.normal_indices);
+        printf("indexed: %zu positions, %zu normals, %zu uvs, %.3f s\n", mesh.positions.size() / 3, mesh.normals.size() / 3,
+            mesh.uvs.size() / 2, Now() - dedup_start);
+    }
+    double num_lines = static_cast<double>(mesh.positions.size() / 3 + mesh.normals.size() / 3 + mesh.uvs.size() / 2 + num_triangles_in);
+    printf("%zu triangles, %.0f lines\n", num_triangles_in, num_lines);
+
+    double t0 = 0.0;
+    if (baseline) {
+        std::string baseline_output = std::string(output) + ".baseline";
+        unsigned long long baseline_bytes = 0;
+        t0 = Now();
+        if (!WriteMeshBaseline(mesh, baseline_output.c_str(), precision, &baseline_bytes)) {
+            fprintf(stderr, "failed to write %s\n", baseline_output.c_str());
+            return 1;
+        }
+        double baseline_time = Now() - t0;
+        printf("baseline: %.3f s, %.2f M lines/s, %.1f MB/s (ofstream, std::endl)\n", baseline_time, num_lines / baseline_time / 1e6,
+            baseline_bytes / baseline_time / 1e6);
+        remove(baseline_output.c_str());
+    }
+
+    std::string serial = std::string(output) + ".serial";
+    unsigned long long serial_bytes = 0, parallel_bytes = 0;
+    t0 = Now();
+    if (!WriteMesh(mesh, serial.c_str(), precision, 1, &serial_bytes)) {
+        fprintf(stderr, "failed to write %s\n", serial.c_str());
+        return 1;
+    }
+    double serial_time = Now() - t0;
+    printf("serial:   %.3f s, %.2f M lines/s, %.1f MB/s\n", serial_time, num_lines / serial_time / 1e6, serial_bytes / serial_time / 1e6);
+
+    t0 = Now();
+    if (!WriteMesh(mesh, output, precision, num_threads, &parallel_bytes)) {
+        fprintf(stderr, "failed to write %s\n", output);
+        return 1;
+    }
+    double parallel_time = Now() - t0;
+    printf("parallel: %.3f s, %.2f M lines/s, %.1f MB/s (%u threads)\n", parallel_time, num_lines / parallel_time / 1e6,
+        parallel_bytes / parallel_time / 1e6, num_threads ? num_threads : std::thread::hardware_concurrency());
+
+    if (!SameFiles(serial.c_str(), output)) {
+        printf("MISMATCH: %s and %s differ\n", serial.c_str(), output);
+        return 2;
+    }
+    remove(serial.c_str());
+    printf("identical (%llu bytes)\n", parallel_bytes);
+    return 0;
+}
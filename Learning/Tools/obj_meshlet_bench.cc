@@ -0,0 +1,143 @@
+//
+// Command-line harness for BuildMeshlets of tiny_obj_loader.
+// Welds each triangle shape of an .obj file(or of synthetic grid and
+// scan-like meshes) with BuildIndexedMesh as AImportOBJNoMTLActor does,
+// partitions it into meshlets and reports the clustering throughput in
+// triangles per second. Checks that every triangle lands in exactly one
+// meshlet, that the limits hold and that the bounding spheres contain their
+// vertices.
+//
+// Build(no engine needed):
+//   g++ -O2 -std=c++17 -pthread -o obj_meshlet_bench obj_meshlet_bench.cc
+//   cl /O2 /std:c++17 /EHsc obj_meshlet_bench.cc
+//
+// Usage:
+//   obj_meshlet_bench [-i input.obj | -n num_triangles] [-v max_vertices] [-m max_triangles] [-t threads]
+//
+//   -i  Clusters the shapes of a .obj file(loaded with LoadObjParallel).
+//   -n  Clusters a synthetic grid with height noise in row order and the same
+//       grid with its triangles shuffled, as in a photogrammetry scan
+//       (default 500000 triangles each).
+//   -v  Vertices per meshlet as AImportOBJNoMTLActor::MeshletMaxVertices(default 64).
+//   -m  Triangles per meshlet as AImportOBJNoMTLActor::MeshletMaxTriangles(default 124).
+//   -t  Clustering threads. 0 = all hardware threads(default).
+//
+
+#include "obj_bench_common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Returns an empty string when the meshlets are a valid partition of
+// `indexed_mesh`, otherwise what is wrong.
+static std::string CheckMeshlets(const tinyobj::indexed_mesh_t& indexed_mesh, const tinyobj::meshlets_t& meshlets, unsigned int max_vertices,
+    unsigned int max_triangles) {
+    std::vector<int> expected(indexed_mesh.indices.begin(), indexed_mesh.indices.end());
+    std::vector<int> actual;
+    actual.reserve(expected.size());
+    const size_t stride = static_cast<size_t>(indexed_mesh.vertex_stride);
+    for (size_t m = 0; m < meshlets.meshlets.size(); m++) {
+        const tinyobj::meshlet_t& meshlet = meshlets.meshlets[m];
+        if (meshlet.vertex_count > max_vertices || meshlet.triangle_count > max_triangles) {
+            return "meshlet over the limits";
+        }
+        const unsigned int* vertices = &meshlets.vertices[meshlet.vertex_offset];
+        const unsigned char* local = &meshlets.triangles[meshlet.triangle_offset];
+        for (unsigned int t = 0; t < meshlet.triangle_count; t++) {
+            if (local[3 * t] >= meshlet.vertex_count || local[3 * t + 1] >= meshlet.vertex_count || local[3 * t + 2] >= meshlet.vertex_count) {
+                return "meshlet-local index out of range";
+            }
+            for (int k = 0; k < 3; k++) {
+                actual.push_back(static_cast<int>(vertices[local[3 * t + k]]));
+            }
+        }
+        for (unsigned int v = 0; v < meshlet.vertex_count; v++) {
+            const tinyobj::real_t* position = &indexed_mesh.vertices[vertices[v] * stride];
+            double dx = position[0] - meshlet.center[0];
+            double dy = position[1] - meshlet.center[1];
+            double dz = position[2] - meshlet.center[2];
+            if (std::sqrt(dx * dx + dy * dy + dz * dz) > meshlet.radius * 1.0001 + 1e-5) {
+                return "vertex outside the bounding sphere";
+            }
+        }
+    }
+    if (SortedTriangles(expected, 1) != SortedTriangles(actual, 1)) {
+        return "triangles lost or duplicated";
+    }
+    return std::string();
+}
+
+// Same steps as AImportOBJNoMTLActor: weld, then cluster LOD0.
+static bool ClusterShape(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape, unsigned int max_vertices, unsigned int max_triangles,
+    unsigned int num_threads) {
+    const char* name = shape.name.empty() ? "(unnamed)" : shape.name.c_str();
+    tinyobj::indexed_mesh_t indexed_mesh;
+    if (!tinyobj::BuildIndexedMesh(attrib, shape, &indexed_mesh)) {
+        printf("%-16s skipped: invalid indices\n", name);
+        return true;
+    }
+    tinyobj::meshlets_t meshlets;
+    double t0 = Now();
+    if (!tinyobj::BuildMeshlets(indexed_mesh, shape, &meshlets, max_vertices, max_triangles, num_threads)) {
+        printf("%-16s skipped: not all faces are triangles or the limits are out of range\n", name);
+        return true;
+    }
+    double t = Now() - t0;
+    size_t num_triangles = indexed_mesh.indices.size() / 3;
+    size_t num_meshlets = meshlets.meshlets.size();
+    printf("%-16s %9zu tris -> %7zu meshlets, %5.1f tris/meshlet, %5.1f verts/meshlet  %.3f s, %.2f M tris/s\n", name, num_triangles,
+        num_meshlets, num_triangles / std::max<double>(static_cast<double>(num_meshlets), 1.0),
+        meshlets.vertices.size() / std::max<double>(static_cast<double>(num_meshlets), 1.0), t, num_triangles / std::max(t, 1e-9) / 1e6);
+    std::string error = CheckMeshlets(indexed_mesh, meshlets, max_vertices, max_triangles);
+    if (!error.empty()) {
+        printf("MISMATCH: %s: %s\n", name, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* input = NULL;
+    size_t num_triangles = 500000;
+    unsigned int max_vertices = 64;
+    unsigned int max_triangles = 124;
+    unsigned int num_threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            input = argv[++i];
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            num_triangles = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-v") && i + 1 < argc) {
+            max_vertices = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            max_triangles = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            num_threads = static_cast<unsigned int>(strtoul(argv[++i], NULL, 10));
+        } else {
+            fprintf(stderr, "usage: %s [-i input.obj | -n num_triangles] [-v max_vertices] [-m max_triangles] [-t threads]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    // Height noise, so that the bounding spheres are not flat.
+    if (!LoadOrMakeShapes(input, num_triangles, 0.25f, &attrib, &shapes)) {
+        return 1;
+    }
+
+    printf("meshlets of %u vertices / %u triangles, %u threads\n", max_vertices, max_triangles,
+        num_threads ? num_threads : std::thread::hardware_concurrency());
+    for (size_t s = 0; s < shapes.size(); s++) {
+        if (!ClusterShape(attrib, shapes[s], max_vertices, max_triangles, num_threads)) {
+            return 2;
+        }
+    }
+    return 0;
+}
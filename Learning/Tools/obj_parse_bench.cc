@@ -0,0 +1,344 @@
+//
+// Command-line harness for the number parsing of tiny_obj_loader.
+// Parses the `v`/`vn`/`vt` reals and `f` indices of an .obj file(or of
+// synthetic `v x y z` lines) with the scalar strspn/strcspn/atoi parser the
+// loader used before the SIMD token scanners and with the current one,
+// checks that both give bit-identical values and reports the throughput of
+// each in MB/s of parsed lines.
+//
+// Build(no engine needed):
+//   g++ -O2 -std=c++17 -o obj_parse_bench obj_parse_bench.cc
+//   g++ -O2 -std=c++17 -mavx2 -DTINYOBJLOADER_USE_AVX2 -o obj_parse_bench obj_parse_bench.cc
+//   g++ -O2 -std=c++17 -DTINYOBJLOADER_NO_SIMD -o obj_parse_bench obj_parse_bench.cc
+//   cl /O2 /std:c++17 /EHsc obj_parse_bench.cc
+//
+// Usage:
+//   obj_parse_bench [-i input.obj | -n num_vertices] [-r repeats]
+//
+//   -i  Parses the lines of a .obj file.
+//   -n  Parses this many synthetic `v x y z` lines(default 2000000).
+//   -r  Timed passes of each parser, the fastest is reported(default 5).
+//
+
+#include "obj_bench_common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// The parser before the SIMD token scanners(comments dropped), the reference.
+namespace baseline {
+
+static bool tryParseDouble(const char* s, const char* s_end, double* result) {
+    if (s >= s_end) {
+        return false;
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+';
+    char exp_sign = '+';
+    char const* curr = s;
+    int read = 0;
+    bool end_not_reached = false;
+    bool leading_decimal_dots = false;
+
+    if (*curr == '+' || *curr == '-') {
+        sign = *curr;
+        curr++;
+        if ((curr != s_end) && (*curr == '.')) {
+            leading_decimal_dots = true;
+        }
+    } else if (IS_DIGIT(*curr)) {
+    } else if (*curr == '.') {
+        leading_decimal_dots = true;
+    } else {
+        goto fail;
+    }
+
+    end_not_reached = (curr != s_end);
+    if (!leading_decimal_dots) {
+        while (end_not_reached && IS_DIGIT(*curr)) {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+        if (read == 0) goto fail;
+    }
+
+    if (!end_not_reached) goto assemble;
+
+    if (*curr == '.') {
+        curr++;
+        read = 1;
+        end_not_reached = (curr != s_end);
+        while (end_not_reached && IS_DIGIT(*curr)) {
+            static const double pow_lut[] = {
+                1.0,
+                0.1,
+                0.01,
+                0.001,
+                0.0001,
+                0.00001,
+                0.000001,
+                0.0000001,
+            };
+            const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
+            mantissa += static_cast<int>(*curr - 0x30) * (read < lut_entries ? pow_lut[read] : std::pow(10.0, -read));
+            read++;
+            curr++;
+            end_not_reached = (curr != s_end);
+        }
+    } else if (*curr == 'e' || *curr == 'E') {
+    } else {
+        goto assemble;
+    }
+
+    if (!end_not_reached) goto assemble;
+
+    if (*curr == 'e' || *curr == 'E') {
+        curr++;
+        end_not_reached = (curr != s_end);
+        if (end_not_reached && (*curr == '+' || *curr == '-')) {
+            exp_sign = *curr;
+            curr++;
+        } else if (IS_DIGIT(*curr)) {
+        } else {
+            goto fail;
+        }
+
+        read = 0;
+        end_not_reached = (curr != s_end);
+        while (end_not_reached && IS_DIGIT(*curr)) {
+            if (exponent > (2147483647 / 10)) {
+                goto fail;
+            }
+            exponent *= 10;
+            exponent += static_cast<int>(*curr - 0x30);
+            curr++;
+            read++;
+            end_not_reached = (curr != s_end);
+        }
+        exponent *= (exp_sign == '+' ? 1 : -1);
+        if (read == 0) goto fail;
+    }
+
+assemble:
+    *result = (sign == '+' ? 1 : -1) * (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+    return true;
+fail:
+    return false;
+}
+
+static inline tinyobj::real_t parseReal(const char** token, double default_value = 0.0) {
+    (*token) += strspn((*token), " \t");
+    const char* end = (*token) + strcspn((*token), " \t\r");
+    double val = default_value;
+    tryParseDouble((*token), end, &val);
+    tinyobj::real_t f = static_cast<tinyobj::real_t>(val);
+    (*token) = end;
+    return f;
+}
+
+static tinyobj::vertex_index_t parseRawTriple(const char** token) {
+    tinyobj::vertex_index_t vi(static_cast<int>(0));
+
+    vi.v_idx = atoi((*token));
+    (*token) += strcspn((*token), "/ \t\r");
+    if ((*token)[0] != '/') {
+        return vi;
+    }
+    (*token)++;
+
+    if ((*token)[0] == '/') {
+        (*token)++;
+        vi.vn_idx = atoi((*token));
+        (*token) += strcspn((*token), "/ \t\r");
+        return vi;
+    }
+
+    vi.vt_idx = atoi((*token));
+    (*token) += strcspn((*token), "/ \t\r");
+    if ((*token)[0] != '/') {
+        return vi;
+    }
+
+    (*token)++;
+    vi.vn_idx = atoi((*token));
+    (*token) += strcspn((*token), "/ \t\r");
+    return vi;
+}
+
+}  // namespace baseline
+
+// Parsed values of one pass, compared between the parsers.
+struct parse_result_t {
+    std::vector<tinyobj::real_t> reals;
+    std::vector<int> indices;
+};
+
+// Splits `text` into '\0' terminated lines as LoadObj hands them to the
+// parser, keeping only the `v`/`vn`/`vt`/`f` lines.
+static size_t SplitLines(std::vector<char>* text, std::vector<const char*>* lines) {
+    size_t num_bytes = 0;
+    char* p = text->empty() ? NULL : &(*text)[0];
+    char* end = p + text->size();
+    while (p < end) {
+        char* line = p;
+        while (p < end && *p != '\n') {
+            p++;
+        }
+        if (p < end) {
+            *p++ = '\0';
+        }
+        const char* token = line + strspn(line, " \t");
+        if ((token[0] == 'v' && (IS_SPACE(token[1]) || ((token[1] == 'n' || token[1] == 't') && IS_SPACE(token[2])))) ||
+            (token[0] == 'f' && IS_SPACE(token[1]))) {
+            lines->push_back(token);
+            num_bytes += static_cast<size_t>(p - line);
+        }
+    }
+    return num_bytes;
+}
+
+static void MakeSyntheticLines(size_t num_vertices, std::vector<char>* text) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+    char line[128];
+    for (size_t i = 0; i < num_vertices; i++) {
+        int n = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", pos(rng), pos(rng), pos(rng));
+        text->insert(text->end(), line, line + n);
+    }
+}
+
+static bool ReadFile(const char* filename, std::vector<char>* text) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        return false;
+    }
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        text->insert(text->end(), buffer, buffer + n);
+    }
+    fclose(fp);
+    return true;
+}
+
+// Same tokenization as the `v`/`vn`/`vt`/`f` branches of LoadObj.
+template <typename Parser>
+static void ParseLines(const std::vector<const char*>& lines, parse_result_t* result) {
+    result->reals.clear();
+    result->indices.clear();
+    for (size_t i = 0; i < lines.size(); i++) {
+        const char* token = lines[i];
+        if (token[0] == 'f') {
+            token += 2;
+            token += strspn(token, " \t");
+            while (!IS_NEW_LINE(token[0])) {
+                tinyobj::vertex_index_t vi = Parser::parseRawTriple(&token);
+                result->indices.push_back(vi.v_idx);
+                result->indices.push_back(vi.vt_idx);
+                result->indices.push_back(vi.vn_idx);
+                token += strspn(token, " \t\r");
+            }
+            continue;
+        }
+        token += (token[1] == ' ' || token[1] == '\t') ? 2 : 3;
+        while (!IS_NEW_LINE(token[0])) {
+            result->reals.push_back(Parser::parseReal(&token));
+            token += strspn(token, " \t\r");
+        }
+    }
+}
+
+struct baseline_parser {
+    static tinyobj::real_t parseReal(const char** token) { return baseline::parseReal(token); }
+    static tinyobj::vertex_index_t parseRawTriple(const char** token) { return baseline::parseRawTriple(token); }
+};
+
+// The current parser, the same entry points LoadObj calls per line.
+struct current_parser {
+    static tinyobj::real_t parseReal(const char** token) { return tinyobj::parseReal(token); }
+    static tinyobj::vertex_index_t parseRawTriple(const char** token) { return tinyobj::parseRawTriple(token); }
+};
+
+template <typename Parser>
+static double TimeParser(const std::vector<const char*>& lines, int repeats, parse_result_t* result) {
+    double best = 0.0;
+    for (int r = 0; r < repeats; r++) {
+        double t0 = Now();
+        ParseLines<Parser>(lines, result);
+        double t = Now() - t0;
+        if (r == 0 || t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static const char* SimdName() {
+#if defined(TINYOBJLOADER_SIMD_AVX2)
+    return "AVX2";
+#elif defined(TINYOBJLOADER_SIMD_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+int main(int argc, char** argv) {
+    const char* input = NULL;
+    size_t num_vertices = 2000000;
+    int repeats = 5;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            input = argv[++i];
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            num_vertices = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-i input.obj | -n num_vertices] [-r repeats]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repeats < 1) {
+        repeats = 1;
+    }
+
+    std::vector<char> text;
+    if (input) {
+        if (!ReadFile(input, &text)) {
+            fprintf(stderr, "failed to read %s\n", input);
+            return 1;
+        }
+    } else {
+        MakeSyntheticLines(num_vertices, &text);
+    }
+    std::vector<const char*> lines;
+    double num_bytes = static_cast<double>(SplitLines(&text, &lines));
+
+    parse_result_t baseline_result, current_result;
+    double baseline_time = TimeParser<baseline_parser>(lines, repeats, &baseline_result);
+    double current_time = TimeParser<current_parser>(lines, repeats, &current_result);
+    printf("%zu lines, %.1f MB, %zu reals, %zu indices\n", lines.size(), num_bytes / 1e6, current_result.reals.size(),
+        current_result.indices.size() / 3);
+    printf("baseline: %.3f s, %.1f MB/s\n", baseline_time, num_bytes / baseline_time / 1e6);
+    printf("current:  %.3f s, %.1f MB/s (%s, %.2fx)\n", current_time, num_bytes / current_time / 1e6, SimdName(),
+        baseline_time / current_time);
+
+    if (baseline_result.indices != current_result.indices || baseline_result.reals.size() != current_result.reals.size() ||
+        (!baseline_result.reals.empty() &&
+            memcmp(&baseline_result.reals[0], &current_result.reals[0], baseline_result.reals.size() * sizeof(tinyobj::real_t)) != 0)) {
+        printf("MISMATCH: the parsers disagree\n");
+        return 2;
+    }
+    printf("identical\n");
+    return 0;
+}